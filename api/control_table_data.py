@@ -58,4 +58,10 @@ CONTROL_TABLE = [
     {'instr': 'ori', 'PCsrc': 0, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 3, 'MemWr': False, 'ResSrc': 1, 'ImmSrc': 0, 'mask': 28799, 'value': 24595, 'type': 'I', 'cycles': 4, 'control_word': 26632},
     {'instr': 'lui', 'PCsrc': 0, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': False, 'ResSrc': 1, 'ImmSrc': 4, 'mask': 127, 'value': 55, 'type': 'U', 'cycles': 4, 'control_word': 3080},
     {'instr': 'jalr', 'PCsrc': 2, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': False, 'ResSrc': 2, 'ImmSrc': 0, 'mask': 28799, 'value': 103, 'type': 'I', 'cycles': 4, 'control_word': 4232},
+    {'instr': 'lb', 'PCsrc': 0, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': False, 'ResSrc': 0, 'ImmSrc': 0, 'mask': 28799, 'value': 3, 'type': 'I', 'cycles': 5, 'control_word': 8},
+    {'instr': 'lh', 'PCsrc': 0, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': False, 'ResSrc': 0, 'ImmSrc': 0, 'mask': 28799, 'value': 4099, 'type': 'I', 'cycles': 5, 'control_word': 8},
+    {'instr': 'lbu', 'PCsrc': 0, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': False, 'ResSrc': 0, 'ImmSrc': 0, 'mask': 28799, 'value': 16387, 'type': 'I', 'cycles': 5, 'control_word': 8},
+    {'instr': 'lhu', 'PCsrc': 0, 'BRwr': True, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': False, 'ResSrc': 0, 'ImmSrc': 0, 'mask': 28799, 'value': 20483, 'type': 'I', 'cycles': 5, 'control_word': 8},
+    {'instr': 'sb', 'PCsrc': 0, 'BRwr': False, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': True, 'ResSrc': -1, 'ImmSrc': 1, 'mask': 28799, 'value': 35, 'type': 'S', 'cycles': 4, 'control_word': 6404},
+    {'instr': 'sh', 'PCsrc': 0, 'BRwr': False, 'ALUsrc': 0, 'ALUctr': 0, 'MemWr': True, 'ResSrc': -1, 'ImmSrc': 1, 'mask': 28799, 'value': 4131, 'type': 'S', 'cycles': 4, 'control_word': 6404},
 ]
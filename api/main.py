@@ -1,10 +1,13 @@
 import ctypes
 import pathlib
+import struct
 import base64
 import json
+import os
 import sys
 import threading
 import uuid
+from contextlib import contextmanager
 from fastapi import FastAPI, Body, Response, HTTPException, Query
 from pydantic import BaseModel, Field
 from typing import Literal, Union, List, Dict
@@ -174,14 +177,94 @@ class DatapathState(ctypes.Structure):
         ("bus_ForwardM", Signal_u32),
     ]
 
+SNAPSHOT_MAX_WINDOWS = 4
+
+class MemoryWindow(ctypes.Structure):
+    _fields_ = [
+        ("address", ctypes.c_uint32),
+        ("length", ctypes.c_uint32),
+        ("buffer", ctypes.POINTER(ctypes.c_uint8)),
+        ("copied", ctypes.c_uint32),
+    ]
+
+# Igual que SnapshotView en CoreTypes.h
+class SnapshotView(ctypes.Structure):
+    _fields_ = [
+        ("pc", ctypes.c_uint32),
+        ("status_register", ctypes.c_uint32),
+        ("cycle", ctypes.c_uint32),
+        ("registers", ctypes.c_uint32 * 32),
+        ("instruction", ctypes.c_char * 256),
+        ("datapath", DatapathState),
+        ("window_count", ctypes.c_uint32),
+        ("windows", MemoryWindow * SNAPSHOT_MAX_WINDOWS),
+    ]
+
+# Avance de una ejecución en segundo plano (RunProgress en Simulator.h).
+class RunProgress(ctypes.Structure):
+    _fields_ = [
+        ("running", ctypes.c_bool),
+        ("cancelled", ctypes.c_bool),
+        ("failed", ctypes.c_bool),
+        ("steps", ctypes.c_int32),
+        ("pc", ctypes.c_uint32),
+    ]
+
+def run_progress(obj) -> dict:
+    """Avance de la ejecución en segundo plano de la instancia `obj`. Ni
+    Simulator_poll ni Simulator_cancel esperan al cerrojo del núcleo."""
+    progress = RunProgress()
+    core_lib.Simulator_poll(obj, ctypes.byref(progress))
+    return {"running": progress.running, "cancelled": progress.cancelled,
+            "failed": progress.failed, "steps": progress.steps, "pc": progress.pc}
+
 # --- Paso 3: Definir los prototipos de las funciones C ---
 
 core_lib.Simulator_new.argtypes = [ctypes.c_size_t, ctypes.c_int]
 core_lib.Simulator_new.restype = ctypes.c_void_p
 
+core_lib.Simulator_set_log_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+core_lib.Simulator_set_log_file.restype = None
+
 core_lib.Simulator_delete.argtypes = [ctypes.c_void_p]
 core_lib.Simulator_delete.restype = None
 
+core_lib.Simulator_reconfigure.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_size_t, ctypes.c_bool]
+core_lib.Simulator_reconfigure.restype = ctypes.c_bool
+
+core_lib.Simulator_pool_prewarm.argtypes = [ctypes.c_size_t, ctypes.c_size_t, ctypes.c_int]
+core_lib.Simulator_pool_prewarm.restype = None
+
+core_lib.Simulator_pool_acquire.argtypes = [ctypes.c_size_t, ctypes.c_int, ctypes.c_bool]
+core_lib.Simulator_pool_acquire.restype = ctypes.c_void_p
+
+core_lib.Simulator_pool_release.argtypes = [ctypes.c_void_p]
+core_lib.Simulator_pool_release.restype = None
+
+core_lib.SessionRegistry_create.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_size_t]
+core_lib.SessionRegistry_create.restype = ctypes.c_bool
+
+core_lib.SessionRegistry_fork.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+core_lib.SessionRegistry_fork.restype = ctypes.c_bool
+
+core_lib.Simulator_fork.argtypes = [ctypes.c_void_p]
+core_lib.Simulator_fork.restype = ctypes.c_void_p
+
+core_lib.SessionRegistry_acquire.argtypes = [ctypes.c_char_p]
+core_lib.SessionRegistry_acquire.restype = ctypes.c_void_p
+
+core_lib.SessionRegistry_release.argtypes = [ctypes.c_char_p]
+core_lib.SessionRegistry_release.restype = None
+
+core_lib.SessionRegistry_configure.argtypes = [ctypes.c_size_t, ctypes.c_uint32]
+core_lib.SessionRegistry_configure.restype = None
+
+core_lib.SessionRegistry_set_log_directory.argtypes = [ctypes.c_char_p]
+core_lib.SessionRegistry_set_log_directory.restype = None
+
+core_lib.SessionRegistry_get_stats.argtypes = []
+core_lib.SessionRegistry_get_stats.restype = ctypes.c_char_p
+
 core_lib.Simulator_load_program.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t, ctypes.c_int]
 core_lib.Simulator_load_program.restype = None
 
@@ -198,9 +281,85 @@ core_lib.Simulator_step.restype = ctypes.c_char_p
 core_lib.Simulator_step_back.argtypes = [ctypes.c_void_p]
 core_lib.Simulator_step_back.restype = ctypes.c_char_p
 
+core_lib.Simulator_seek.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+core_lib.Simulator_seek.restype = ctypes.c_char_p
+
+core_lib.Simulator_get_history_range.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint32)]
+core_lib.Simulator_get_history_range.restype = None
+
+core_lib.Simulator_get_state_binary.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t]
+core_lib.Simulator_get_state_binary.restype = ctypes.c_size_t
+
+core_lib.Simulator_get_state_binary_ex.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t, ctypes.c_uint32]
+core_lib.Simulator_get_state_binary_ex.restype = ctypes.c_size_t
+
+core_lib.Simulator_get_state_schema.argtypes = []
+core_lib.Simulator_get_state_schema.restype = ctypes.c_char_p
+
+core_lib.Simulator_get_instruction_text.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32]
+core_lib.Simulator_get_instruction_text.restype = ctypes.c_char_p
+
+core_lib.Simulator_get_state_delta.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+core_lib.Simulator_get_state_delta.restype = ctypes.c_char_p
+
+core_lib.Simulator_save_state.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_size_t)]
+core_lib.Simulator_save_state.restype = ctypes.POINTER(ctypes.c_uint8)
+
+core_lib.Simulator_load_state.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+core_lib.Simulator_load_state.restype = ctypes.c_bool
+
+core_lib.Simulator_get_model.argtypes = [ctypes.c_void_p]
+core_lib.Simulator_get_model.restype = ctypes.c_int
+
+# Flags del estado guardado (StateSave.h)
+STATE_SAVE_HISTORY = 1
+
+# Flags del estado binario (StateBinary.h)
+STATE_BINARY_MEMORY = 1
+STATE_BINARY_MEMORY_RESYNC = 2
+STATE_BINARY_SCHEMA = json.loads(core_lib.Simulator_get_state_schema().decode('utf-8'))
+
+def decode_state_binary(data: bytes) -> dict:
+    """Decodifica el estado binario con el esquema: campos fijos, señales y rangos de memoria."""
+    header = struct.unpack_from('<IHHIIIIIII', data, 0)
+    _, _, _, _, flags, count, values_at, ready_at, active_at, memory_at = header
+    state = {"flags": flags}
+    for name, field in STATE_BINARY_SCHEMA["fields"].items():
+        n = field.get("count", 1)
+        values = struct.unpack_from(f'<{n}I', data, field["offset"])
+        state[name] = list(values) if "count" in field else values[0]
+    values = struct.unpack_from(f'<{count}I', data, values_at)
+    ready = struct.unpack_from(f'<{count}I', data, ready_at)
+    signals = {}
+    for i, signal in enumerate(STATE_BINARY_SCHEMA["signals"][:count]):
+        signals[signal["name"]] = {"value": values[i], "ready_at": ready[i], "is_active": data[active_at + i]}
+    state["signals"] = signals
+    if memory_at:
+        ranges, = struct.unpack_from('<I', data, memory_at)
+        offset = memory_at + 8
+        state["memory"] = []
+        for _ in range(ranges):
+            memory, address, length = struct.unpack_from('<III', data, offset)
+            offset += 12
+            state["memory"].append((memory, address, data[offset:offset + length]))
+            offset += (length + 3) & ~3
+    return state
+
 core_lib.Simulator_steps_until.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32), ctypes.c_size_t]
 core_lib.Simulator_steps_until.restype = ctypes.c_char_p
 
+core_lib.Simulator_run_async.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32), ctypes.c_size_t]
+core_lib.Simulator_run_async.restype = ctypes.c_bool
+
+core_lib.Simulator_poll.argtypes = [ctypes.c_void_p, ctypes.POINTER(RunProgress)]
+core_lib.Simulator_poll.restype = ctypes.c_bool
+
+core_lib.Simulator_cancel.argtypes = [ctypes.c_void_p]
+core_lib.Simulator_cancel.restype = None
+
+core_lib.Simulator_stop_run.argtypes = [ctypes.c_void_p]
+core_lib.Simulator_stop_run.restype = None
+
 core_lib.Simulator_reset_with_model.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_uint]
 core_lib.Simulator_reset_with_model.restype = ctypes.c_char_p
 
@@ -219,6 +378,9 @@ core_lib.Simulator_get_all_registers.restype = None
 core_lib.Simulator_get_datapath_state.argtypes = [ctypes.c_void_p]
 core_lib.Simulator_get_datapath_state.restype = DatapathState
 
+core_lib.Simulator_get_snapshot.argtypes = [ctypes.c_void_p, ctypes.POINTER(SnapshotView)]
+core_lib.Simulator_get_snapshot.restype = ctypes.c_bool
+
 core_lib.Simulator_get_d_mem.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t]
 core_lib.Simulator_get_d_mem.restype = None
 
@@ -237,12 +399,36 @@ core_lib.Simulator_get_i_mem.restype = ctypes.c_size_t
 
 class Simulator:
     """Wrapper de Python para el simulador C++."""
-    def __init__(self, mem_size: int = 1024 * 1024, model: int = 0):
+    def __init__(self, mem_size: int = 1 << 32, model: int = 0, session_id: str = "", fork_of: str = ""):
+        # La memoria es dispersa: todo el espacio de 32 bits solo ocupa las páginas tocadas.
         # model: 3=General, 0=SingleCycle, etc. Ver Simulator.h
         self.model = model
-        self.obj = core_lib.Simulator_new(mem_size, model)
+        self.mem_size = mem_size
+        self.session_id = session_id
+        if session_id:
+            # El simulador de una sesión es del SessionRegistry del núcleo, que
+            # puede hibernarlo entre peticiones: `obj` solo es válido dentro de
+            # locked_session.
+            self.obj = None
+            if fork_of:
+                # Bifurcación de otra sesión: mismo punto, memorias compartidas.
+                if not core_lib.SessionRegistry_fork(session_id.encode('utf-8'), fork_of.encode('utf-8')):
+                    raise MemoryError("No se pudo bifurcar la sesión en C++.")
+            elif not core_lib.SessionRegistry_create(session_id.encode('utf-8'), model, mem_size):
+                raise MemoryError("No se pudo crear la sesión en C++.")
+            return
+        # Se reutiliza una instancia del pool (ver SIMULATOR_POOL_PREWARM) si queda alguna.
+        self.obj = core_lib.Simulator_pool_acquire(mem_size, model, True)
         if not self.obj:
             raise MemoryError("No se pudo crear el objeto Simulator en C++.")
+        self._set_log_file()
+
+    def _set_log_file(self):
+        # Varias instancias no pueden compartir un log: cada una escribe el
+        # suyo en SIMULATOR_LOG_DIR, o ninguno si no está definido.
+        log_dir = os.environ.get("SIMULATOR_LOG_DIR")
+        log_path = str(pathlib.Path(log_dir) / f"simulator-{id(self)}.log") if log_dir else ""
+        core_lib.Simulator_set_log_file(self.obj, log_path.encode('utf-8'))
 
     def load_program(self, program: bytes):
         prog_array = (ctypes.c_uint8 * len(program))(*program)
@@ -277,6 +463,46 @@ class Simulator:
         print("Llamando al step back de la dll...")
         return core_lib.Simulator_step_back(self.obj).decode('utf-8')
 
+    def seek(self, cycle: int):
+        return core_lib.Simulator_seek(self.obj, cycle).decode('utf-8')
+
+    def get_history_range(self):
+        first = ctypes.c_uint32()
+        last = ctypes.c_uint32()
+        core_lib.Simulator_get_history_range(self.obj, ctypes.byref(first), ctypes.byref(last))
+        return first.value, last.value
+
+    def get_state_binary(self, flags: int = 0) -> bytes:
+        """Estado en binario (ver StateBinary.h); se pide el tamaño y luego se rellena."""
+        size = core_lib.Simulator_get_state_binary_ex(self.obj, None, 0, flags)
+        buffer = (ctypes.c_uint8 * size)()
+        written = core_lib.Simulator_get_state_binary_ex(self.obj, buffer, size, flags)
+        if written > size:
+            # Entre las dos llamadas no se ejecuta nada, pero por si acaso.
+            return self.get_state_binary(flags)
+        return bytes(buffer)
+
+    def get_state_delta(self, since_version: int) -> dict:
+        """Campos que han cambiado desde `since_version` (0 = estado completo)."""
+        return json.loads(core_lib.Simulator_get_state_delta(self.obj, since_version).decode('utf-8'))
+
+    def save_state(self, history: bool = False) -> bytes:
+        """Estado completo del simulador en un bloque binario (ver StateSave.h)."""
+        size = ctypes.c_size_t(0)
+        data = core_lib.Simulator_save_state(self.obj, STATE_SAVE_HISTORY if history else 0, ctypes.byref(size))
+        if not data:
+            raise RuntimeError("No se pudo guardar el estado del simulador.")
+        return ctypes.string_at(data, size.value)
+
+    def load_state(self, data: bytes):
+        """Restaura un estado de save_state; el modelo pasa a ser el guardado."""
+        if not core_lib.Simulator_load_state(self.obj, data, len(data)):
+            raise ValueError("Estado guardado no válido.")
+        self.model = core_lib.Simulator_get_model(self.obj)
+
+    def get_instruction_text(self, text_id: int, instruction: int) -> str:
+        return core_lib.Simulator_get_instruction_text(self.obj, text_id, instruction).decode('utf-8')
+
     def steps_until(self, breakpoints: List[int]):
         num_breakpoints = len(breakpoints)
         print(f"Llamando a steps_until de la dll con {num_breakpoints} breakpoints...")
@@ -288,6 +514,20 @@ class Simulator:
         breakpoints_array = (ctypes.c_uint32 * num_breakpoints)(*breakpoints)
         return core_lib.Simulator_steps_until(self.obj, breakpoints_array, num_breakpoints).decode('utf-8')
 
+    def run_async(self, breakpoints: List[int]) -> bool:
+        """Lanza steps_until en un hilo del núcleo; False si ya hay una ejecución en marcha."""
+        breakpoints_array = (ctypes.c_uint32 * len(breakpoints))(*breakpoints) if breakpoints else None
+        return core_lib.Simulator_run_async(self.obj, breakpoints_array, len(breakpoints))
+
+    def poll(self) -> dict:
+        """Avance de la ejecución en segundo plano (no espera a que termine)."""
+        return run_progress(self.obj)
+
+    def stop_run(self):
+        """Para la ejecución en segundo plano, si la hay, y espera a que acabe
+        el paso en curso: antes de reconfigurar o sustituir el estado."""
+        core_lib.Simulator_stop_run(self.obj)
+
 
     def reset_with_model(self, model: int, initial_pc: int = 0):
         print("Llamando al reset de la dll...")
@@ -310,6 +550,25 @@ class Simulator:
         print("Llamando al get_datapath_state de la dll...")
         return core_lib.Simulator_get_datapath_state(self.obj)
 
+    def get_snapshot(self, windows: List[tuple] = ()):
+        """Estado completo en una llamada. `windows` son pares (dirección, longitud)
+        de memoria de datos; devuelve la SnapshotView y los bytes de cada ventana."""
+        if len(windows) > SNAPSHOT_MAX_WINDOWS:
+            raise ValueError(f"Como mucho {SNAPSHOT_MAX_WINDOWS} ventanas de memoria")
+        view = SnapshotView()
+        buffers = []
+        for i, (address, length) in enumerate(windows):
+            buffer = (ctypes.c_uint8 * length)()
+            buffers.append(buffer)
+            view.windows[i].address = address
+            view.windows[i].length = length
+            view.windows[i].buffer = ctypes.cast(buffer, ctypes.POINTER(ctypes.c_uint8))
+        view.window_count = len(windows)
+        if not core_lib.Simulator_get_snapshot(self.obj, ctypes.byref(view)):
+            raise RuntimeError("No se pudo obtener el estado del simulador.")
+        memory = [bytes(buffer)[:view.windows[i].copied] for i, buffer in enumerate(buffers)]
+        return view, memory
+
     def get_d_mem(self) -> list[int]:
         """Obtiene el contenido de la memoria de datos (256 bytes)."""
         buffer = (ctypes.c_uint8 * 256)()
@@ -346,8 +605,27 @@ class Simulator:
         return result
 
     def __del__(self):
-        if hasattr(self, 'obj') and self.obj:
-            core_lib.Simulator_delete(self.obj)
+        if hasattr(self, 'obj') and self.obj and not self.session_id:
+            core_lib.Simulator_pool_release(self.obj)
+
+    def fork(self) -> "Simulator":
+        """Otra instancia que sigue desde este mismo punto (p.ej. para probar
+        otras opciones de riesgos); las memorias se comparten en copia en escritura."""
+        child = Simulator.__new__(Simulator)
+        child.model = self.model
+        child.mem_size = self.mem_size
+        child.session_id = ""
+        child.obj = core_lib.Simulator_fork(self.obj)
+        if not child.obj:
+            raise RuntimeError("No se pudo bifurcar el simulador.")
+        child._set_log_file()
+        return child
+
+    def reconfigure(self, model: int, hazards: bool = True):
+        """Reinicia la instancia con otro modelo sin volver a reservar sus memorias."""
+        if not core_lib.Simulator_reconfigure(self.obj, model, self.mem_size, hazards):
+            raise RuntimeError("No se pudo reconfigurar el simulador.")
+        self.model = model
 
     def set_hazard_options(self, stalls: bool, flushes: bool, forwarding: bool):
         """Configura las opciones de detección de riesgos en el núcleo C++."""
@@ -360,11 +638,29 @@ class Simulator:
 app = FastAPI(title="RISC-V Simulator API")
 from fastapi.middleware.cors import CORSMiddleware
 
-# --- Lock para proteger el acceso concurrente al simulador ---
-# FastAPI maneja las peticiones en hilos separados. Como solo tenemos una
-# instancia del simulador, debemos protegerla para evitar condiciones de carrera.
+# --- Cerrojos ---
+# FastAPI maneja las peticiones en hilos separados. `simulators_lock` solo
+# protege el diccionario de sesiones; cada sesión tiene además su propio
+# cerrojo, así que una sesión ocupada (p.ej. en /run) no bloquea a las demás.
+# ctypes suelta el GIL durante las llamadas a la biblioteca, que se protege
+# a sí misma por instancia.
 simulators_lock = threading.Lock()
 
+# --- Reserva de simuladores ---
+# /session/start toma instancias ya construidas en lugar de crearlas (y las
+# sesiones terminadas las devuelven). SIMULATOR_POOL_PREWARM fija cuántas se
+# preparan al arrancar; 0 lo desactiva.
+core_lib.Simulator_pool_prewarm(int(os.environ.get("SIMULATOR_POOL_PREWARM", "8")), 1 << 32, 3)
+
+# --- Sesiones ---
+# Las sesiones viven en el núcleo (SessionRegistry). Las que llevan
+# SESSION_IDLE_SECONDS sin usarse, o las menos usadas cuando las residentes
+# pasan de SESSION_MEMORY_BUDGET_MB, se hibernan en un estado compacto y se
+# restauran al llegar su siguiente petición.
+core_lib.SessionRegistry_configure(int(os.environ.get("SESSION_MEMORY_BUDGET_MB", "256")) << 20,
+                                   int(os.environ.get("SESSION_IDLE_SECONDS", "600")))
+core_lib.SessionRegistry_set_log_directory(os.environ.get("SIMULATOR_LOG_DIR", "").encode('utf-8'))
+
 # --- Configuración de CORS ---
 # Esto es CRUCIAL para que las aplicaciones web (como Flutter Web)
 # que se ejecutan en un origen diferente (ej. localhost:5000)
@@ -471,10 +767,12 @@ ABI_NAMES = [
 def _get_full_state_data(sim: Simulator, model_name: str) -> SimulatorStateModel:
     """Construye y devuelve el estado completo actual del simulador."""
     print("Reconstruyendo estado completo...")
-    pc = sim.get_pc()
-    status = sim.get_status_register()
-    registers = sim.get_registers()
-    datapath_c_struct = sim.get_datapath_state()
+    # Una sola llamada a la biblioteca para todo el estado.
+    snapshot, _ = sim.get_snapshot()
+    pc = snapshot.pc
+    status = snapshot.status_register
+    registers = list(snapshot.registers)
+    datapath_c_struct = snapshot.datapath
 
     reg_map = {f"x{i} ({ABI_NAMES[i]})": val for i, val in enumerate(registers)}
 
@@ -555,7 +853,8 @@ def _get_full_state_data(sim: Simulator, model_name: str) -> SimulatorStateModel
 
 # --- Gestión de Sesiones y Estado ---
 
-# Usaremos un diccionario para almacenar una instancia de simulador por sesión.
+# Por sesión: el wrapper (sin memoria propia: el simulador está en el
+# SessionRegistry), el nombre del modelo y el cerrojo de la sesión.
 simulators: Dict[str, Dict[str, Union[Simulator, str]]] = {}
 
 class SessionResponse(BaseModel):
@@ -567,12 +866,36 @@ def start_session():
     with simulators_lock:
         session_id = str(uuid.uuid4())
         simulators[session_id] = {
-            "sim": Simulator(model=3),
-            "model_name": "General"
+            "sim": Simulator(model=3, session_id=session_id),
+            "model_name": "General",
+            "lock": threading.Lock()
         }
         print(f"Nueva sesión iniciada: {session_id}")
         return SessionResponse(session_id=session_id)
 
+@app.post("/session/fork", response_model=SessionResponse, summary="Bifurca una sesión")
+def fork_session(session_id: str = Query(..., description="ID de la sesión que se bifurca")):
+    """Crea una sesión nueva que sigue desde el mismo punto que `session_id`
+    (memorias, cachés e historial) y después evoluciona por su cuenta, p.ej.
+    para comparar una variante con y sin cortocircuitos desde el ciclo actual."""
+    with simulators_lock:
+        parent = get_simulator_for_session(session_id)
+    # Con el cerrojo del padre, para no bifurcar a mitad de una petición suya.
+    with parent["lock"]:
+        fork_id = str(uuid.uuid4())
+        try:
+            sim = Simulator(model=parent["sim"].model, session_id=fork_id, fork_of=session_id)
+        except MemoryError as e:
+            raise HTTPException(status_code=500, detail=str(e))
+    with simulators_lock:
+        simulators[fork_id] = {
+            "sim": sim,
+            "model_name": parent["model_name"],
+            "lock": threading.Lock()
+        }
+    print(f"Sesión {fork_id} bifurcada de {session_id}")
+    return SessionResponse(session_id=fork_id)
+
 def get_simulator_for_session(session_id: str) -> Dict[str, Union[Simulator, str]]:
     """Obtiene el simulador para un ID de sesión, o lanza una excepción si no se encuentra."""
     sim_instance = simulators.get(session_id)
@@ -580,11 +903,47 @@ def get_simulator_for_session(session_id: str) -> Dict[str, Union[Simulator, str
         raise HTTPException(status_code=404, detail="Session ID not found. Please start a new session.")
     return sim_instance
 
+@contextmanager
+def locked_session(session_id: str):
+    """Da la sesión con su cerrojo tomado; las demás sesiones siguen libres."""
+    with simulators_lock:
+        sim_instance = get_simulator_for_session(session_id)
+    with sim_instance["lock"]:
+        sim = sim_instance["sim"]
+        # Si estaba hibernada, el núcleo la restaura aquí (en otra instancia).
+        sim.obj = core_lib.SessionRegistry_acquire(session_id.encode('utf-8'))
+        if not sim.obj:
+            raise HTTPException(status_code=500, detail="No se pudo restaurar la sesión.")
+        try:
+            yield sim_instance
+        finally:
+            sim.obj = None
+            core_lib.SessionRegistry_release(session_id.encode('utf-8'))
+
+@contextmanager
+def leased_simulator(session_id: str):
+    """Instancia del núcleo de la sesión sin su cerrojo, solo para consultar o
+    parar la ejecución en segundo plano: con el cerrojo, /run/status y
+    /run/cancel esperarían detrás de cualquier petición que aguarda a que
+    termine la ejecución."""
+    with simulators_lock:
+        get_simulator_for_session(session_id)
+    obj = core_lib.SessionRegistry_acquire(session_id.encode('utf-8'))
+    if not obj:
+        raise HTTPException(status_code=500, detail="No se pudo restaurar la sesión.")
+    try:
+        yield obj
+    finally:
+        core_lib.SessionRegistry_release(session_id.encode('utf-8'))
+
+@app.get("/session/stats", summary="Sesiones residentes, hibernadas y memoria que ocupan")
+def session_stats():
+    return json.loads(core_lib.SessionRegistry_get_stats().decode('utf-8'))
+
 
 @app.get("/state", response_model=SimulatorStateModel, summary="Obtener el estado actual del simulador")
 def get_state_endpoint(session_id: str = Query(..., description="ID de la sesión")) -> SimulatorStateModel:
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim = sim_instance["sim"]
         model_name = sim_instance["model_name"]
         return _get_full_state_data(sim, model_name)
@@ -614,26 +973,18 @@ def reset_simulator(
     - **assembly_code**: Código ensamblador del programa (aún no implementado).
     - **hazards_enabled**: Si es true, activa la detección de riesgos de datos y de control, y los cortocircuitos.
     """
-    with simulators_lock:
-        # Obtenemos la instancia existente para asegurarnos de que la sesión es válida
-        get_simulator_for_session(session_id)
-
+    with locked_session(session_id) as sim_instance:
         model_map = {'SingleCycle': 0,'PipeLined': 1,'MultiCycle': 2, 'General': 3, }
         model_id = model_map[config.model]
         print("Llamando a Simulator_reset...")
 
-        # Al reemplazar la instancia, el __del__ del objeto antiguo se llama, liberando la memoria C++.
-        simulators[session_id] = {
-            "sim": Simulator(model=model_id),
-            "model_name": config.model
-        }
-        sim = simulators[session_id]["sim"]
-
-        # Configuramos las opciones de riesgo en el núcleo C++
-        sim.set_hazard_options(stalls=config.hazards_enabled, 
-                               flushes=config.hazards_enabled, 
-                               forwarding=config.hazards_enabled)
-        print("Creada nueva instancia del simulador...")
+        # La misma instancia se reconfigura en sitio (memorias y cachés se
+        # reutilizan); el diccionario (y su cerrojo) se conserva para quien esté esperando.
+        sim = sim_instance["sim"]
+        sim.stop_run()
+        sim.reconfigure(model_id, hazards=config.hazards_enabled)
+        sim_instance["model_name"] = config.model
+        print("Reconfigurada la instancia del simulador...")
 
         if config.bin_code:
             try:
@@ -655,10 +1006,8 @@ def reset_simulator(
             print(DEFAULT_PROGRAM)
             
         # Ejecuta el primer paso para tener un estado inicial y luego lo devuelve completo
-        simulators[session_id]["sim"].reset_with_model(model_id, config.initial_pc)
+        sim.reset_with_model(model_id, config.initial_pc)
         print();
-        sim_instance = simulators[session_id]
-        sim = sim_instance["sim"]
         model_name = sim_instance["model_name"]
         print("Ejecutado reset (incluye step)...")
         return _get_full_state_data(sim, model_name)
@@ -666,8 +1015,7 @@ def reset_simulator(
 @app.post("/step", response_model=SimulatorStateModel, summary="Ejecutar un ciclo de instrucción")
 def execute_step(session_id: str = Query(..., description="ID de la sesión")) -> SimulatorStateModel:
     """Ejecuta un paso y devuelve el nuevo estado de los registros."""
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim_instance["sim"].step()
         sim = sim_instance["sim"]
         model_name = sim_instance["model_name"]
@@ -676,31 +1024,134 @@ def execute_step(session_id: str = Query(..., description="ID de la sesión")) -
 @app.post("/step_back", response_model=SimulatorStateModel, summary="Ejecutar un ciclo de instrucción")
 def execute_step_back(session_id: str = Query(..., description="ID de la sesión")) -> SimulatorStateModel:
     """Ejecuta un paso y devuelve el nuevo estado de los registros."""
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim_instance["sim"].step_back()
         sim = sim_instance["sim"]
         model_name = sim_instance["model_name"]
         return _get_full_state_data(sim, model_name)    
 
+@app.post("/seek", response_model=SimulatorStateModel, summary="Saltar a un ciclo del historial")
+def execute_seek(
+    session_id: str = Query(..., description="ID de la sesión"),
+    cycle: int = Query(..., ge=0, description="Ciclo al que saltar")
+) -> SimulatorStateModel:
+    """Lleva la simulación al ciclo indicado sin volver a ejecutar lo que ya está en el historial."""
+    with locked_session(session_id) as sim_instance:
+        sim_instance["sim"].seek(cycle)
+        sim = sim_instance["sim"]
+        model_name = sim_instance["model_name"]
+        return _get_full_state_data(sim, model_name)
+
+@app.get("/history", summary="Ciclos disponibles en el historial")
+def get_history(session_id: str = Query(..., description="ID de la sesión")):
+    with locked_session(session_id) as sim_instance:
+        first, last = sim_instance["sim"].get_history_range()
+        return {"first_cycle": first, "last_cycle": last}
+
+@app.get("/state/binary", summary="Estado en binario")
+def get_state_binary(
+    session_id: str = Query(..., description="ID de la sesión"),
+    memory: bool = Query(False, description="Incluir los rangos de memoria escritos desde la última petición")
+):
+    """Estado en el formato de /state/schema, sin pasar por JSON."""
+    with locked_session(session_id) as sim_instance:
+        data = sim_instance["sim"].get_state_binary(STATE_BINARY_MEMORY if memory else 0)
+    return Response(content=data, media_type="application/octet-stream")
+
+@app.get("/state/delta", summary="Cambios del estado desde una versión")
+def get_state_delta(
+    session_id: str = Query(..., description="ID de la sesión"),
+    since: int = Query(0, ge=0, description="Última versión recibida (0 = estado completo)")
+):
+    """Solo las señales, registros y etiquetas de etapa que han cambiado desde `since`.
+    El cliente guarda `version` y la envía en la siguiente petición."""
+    with locked_session(session_id) as sim_instance:
+        delta = sim_instance["sim"].get_state_delta(since)
+    delta["registers"] = {f"x{i} ({ABI_NAMES[i]})": val for i, val in
+                          ((int(k), v) for k, v in delta["registers"].items())}
+    return delta
+
+@app.get("/state/save", summary="Guarda el estado completo del simulador")
+def save_state(
+    session_id: str = Query(..., description="ID de la sesión"),
+    history: bool = Query(False, description="Incluir el historial para poder retroceder después de restaurar")
+):
+    """Bloque binario con memorias, cachés, registros de segmentación y contadores,
+    para restaurarlo después con /state/load."""
+    with locked_session(session_id) as sim_instance:
+        data = sim_instance["sim"].save_state(history)
+    return Response(content=data, media_type="application/octet-stream")
+
+class LoadStateRequest(BaseModel):
+    state: str  # Base64 de lo devuelto por /state/save
+
+@app.post("/state/load", response_model=SimulatorStateModel, summary="Restaura un estado guardado")
+def load_state(
+    session_id: str = Query(..., description="ID de la sesión"),
+    request: LoadStateRequest = Body(...)
+) -> SimulatorStateModel:
+    try:
+        data = base64.b64decode(request.state)
+    except Exception as e:
+        raise HTTPException(status_code=400, detail=f"Error decodificando el estado: {e}")
+    with locked_session(session_id) as sim_instance:
+        sim = sim_instance["sim"]
+        sim.stop_run()
+        try:
+            sim.load_state(data)
+        except ValueError as e:
+            raise HTTPException(status_code=400, detail=str(e))
+        model_names = {0: 'SingleCycle', 1: 'PipeLined', 2: 'MultiCycle', 3: 'General'}
+        model_name = model_names.get(sim.model)
+        if model_name is None:
+            raise HTTPException(status_code=400, detail=f"Modelo desconocido en el estado guardado: {sim.model}")
+        sim_instance["model_name"] = model_name
+        return _get_full_state_data(sim, model_name)
+
+@app.get("/state/schema", summary="Esquema del estado en binario")
+def get_state_schema():
+    return STATE_BINARY_SCHEMA
+
 class RunConfig(BaseModel):
     breakpoints: List[int]
 
-@app.post("/run", response_model=SimulatorStateModel, summary="Ejecutar hasta el siguiente breakpoint")
-def run_until(
+class RunProgressModel(BaseModel):
+    running: bool
+    cancelled: bool
+    failed: bool
+    steps: int
+    pc: int
+
+@app.post("/run", response_model=RunProgressModel, summary="Ejecutar hasta el siguiente breakpoint")
+@app.post("/run/start", response_model=RunProgressModel, summary="Lanza una ejecución en segundo plano")
+def run_start(
     session_id: str = Query(..., description="ID de la sesión"),
     config: RunConfig = Body(...)
-) -> SimulatorStateModel:
+):
     """
     Ejecuta la simulación hasta que el PC alcanza una de las direcciones en la lista de 'breakpoints',
-    se detecta un bucle o se alcanza el número máximo de pasos.
+    se detecta un bucle o se alcanza el número máximo de pasos. La ejecución va en un hilo del
+    núcleo y la petición vuelve enseguida, sin ocupar un worker mientras dura: el avance se
+    consulta con /run/status, se para con /run/cancel y, cuando `running` es false, el estado
+    final se lee con /state (`failed` indica que se detuvo por un error del simulador).
     """
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim = sim_instance["sim"]
-        model_name = sim_instance["model_name"]
-        sim.steps_until(config.breakpoints)
-        return _get_full_state_data(sim, model_name)
+        if not sim.run_async(config.breakpoints):
+            raise HTTPException(status_code=409, detail="Ya hay una ejecución en curso en esta sesión.")
+        return sim.poll()
+
+@app.get("/run/status", response_model=RunProgressModel, summary="Avance de la ejecución en segundo plano")
+def run_status(session_id: str = Query(..., description="ID de la sesión")):
+    with leased_simulator(session_id) as obj:
+        return run_progress(obj)
+
+@app.post("/run/cancel", response_model=RunProgressModel, summary="Para la ejecución en segundo plano")
+def run_cancel(session_id: str = Query(..., description="ID de la sesión")):
+    """La ejecución se para al terminar el paso en curso."""
+    with leased_simulator(session_id) as obj:
+        core_lib.Simulator_cancel(obj)
+        return run_progress(obj)
 
 @app.get("/memory/data", 
          summary="Obtener el contenido de la memoria de datos",
@@ -712,8 +1163,7 @@ def run_until(
          })
 def get_data_memory(session_id: str = Query(..., description="ID de la sesión")):
     """Devuelve los 256 bytes de la memoria de datos del modo didáctico como binario crudo."""
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim = sim_instance["sim"]
         # 1. Obtenemos los datos como un objeto de bytes
         memory_bytes = sim.get_d_mem()
@@ -725,8 +1175,7 @@ def get_data_memory(session_id: str = Query(..., description="ID de la sesión")
 @app.get("/memory/instructions", response_model=List[InstructionMemoryItem], summary="Obtener la memoria de instrucciones desensamblada")
 def get_instruction_memory(session_id: str = Query(..., description="ID de la sesión")):
     """Devuelve el contenido de la memoria de instrucciones, con cada instrucción desensamblada."""
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim = sim_instance["sim"]
         return sim.get_i_mem()
 
@@ -739,8 +1188,7 @@ def assemble_code(
     Toma una cadena de código ensamblador, la compila usando el núcleo C++
     y devuelve el código máquina resultante codificado en Base64.
     """
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim = sim_instance["sim"]
         try:
             machine_code = sim.assemble(assembly_code)
@@ -771,41 +1219,39 @@ def generate_question_endpoint(config: FingerprintModel = Body(...)):
     except ImportError:
         raise HTTPException(status_code=500, detail="No se pudo encontrar el módulo 'generator.py'.")
 
-    # Usamos un lock para asegurar que la generación es atómica, aunque
-    # este endpoint gestiona su propia instancia de simulador.
-    with simulators_lock:
-        try:
-            # 1. Generar el código y ejecutar la simulación (esto no cambia)
-            assembly_code, code_info, initial_pc = generator.generate_test_case(config.fingerprint)
+    # La instancia es propia de esta petición: no hace falta ningún cerrojo.
+    try:
+        # 1. Generar el código y ejecutar la simulación (esto no cambia)
+        assembly_code, code_info, initial_pc = generator.generate_test_case(config.fingerprint)
 
-            # 2. Crear una instancia temporal del simulador
-            sim = Simulator(model=0) # Modelo 0 = SingleCycle
-            
-            # 3. Cargar el programa y establecer el PC (sin llamar a reset_with_model)
-            sim.load_program_from_assembly(assembly_code)
-            # Esta es la clave: evitamos el `step()` automático de `reset_with_model`
-            # que causa el crash. ¡CORRECCIÓN! El reset es necesario.
-            sim.reset_with_model(model=0, initial_pc=initial_pc)
+        # 2. Crear una instancia temporal del simulador
+        sim = Simulator(model=0) # Modelo 0 = SingleCycle
+        
+        # 3. Cargar el programa y establecer el PC (sin llamar a reset_with_model)
+        sim.load_program_from_assembly(assembly_code)
+        # Esta es la clave: evitamos el `step()` automático de `reset_with_model`
+        # que causa el crash. ¡CORRECCIÓN! El reset es necesario.
+        sim.reset_with_model(model=0, initial_pc=initial_pc)
+        
+        # 4. Ejecutar el programa hasta el final
+        sim.steps_until(breakpoints=[]) # Se detendrá por bucle infinito
+
+        # 5. Formatear la pregunta y la respuesta SEGÚN EL TIPO SOLICITADO
+        if config.question_type == 1:
+            # Comportamiento original: preguntar por el estado final completo.
+            qa_pair = generator.format_question_answer(
+                assembly_code=assembly_code,
+                initial_pc=initial_pc,
+                sim=sim,
+                code_info=code_info
+            )
+        elif config.question_type == 2:
+            # Nueva pregunta: Valor de un registro específico.
+            # Reutilizamos el generador para elegir un registro de forma determinista.
+            reg_to_ask_idx = code_info['reg_to_ask']
+            reg_name = f"x{reg_to_ask_idx} ({generator.ABI_NAMES[reg_to_ask_idx]})"
             
-            # 4. Ejecutar el programa hasta el final
-            sim.steps_until(breakpoints=[]) # Se detendrá por bucle infinito
-
-            # 5. Formatear la pregunta y la respuesta SEGÚN EL TIPO SOLICITADO
-            if config.question_type == 1:
-                # Comportamiento original: preguntar por el estado final completo.
-                qa_pair = generator.format_question_answer(
-                    assembly_code=assembly_code,
-                    initial_pc=initial_pc,
-                    sim=sim,
-                    code_info=code_info
-                )
-            elif config.question_type == 2:
-                # Nueva pregunta: Valor de un registro específico.
-                # Reutilizamos el generador para elegir un registro de forma determinista.
-                reg_to_ask_idx = code_info['reg_to_ask']
-                reg_name = f"x{reg_to_ask_idx} ({generator.ABI_NAMES[reg_to_ask_idx]})"
-                
-                question_text = f"""
+            question_text = f"""
 Considerando el estado final del procesador tras ejecutar el siguiente código (iniciando en {hex(initial_pc)}):
 
 ```assembly
@@ -814,73 +1260,73 @@ Considerando el estado final del procesador tras ejecutar el siguiente código (
 
 ¿Cuál es el valor final contenido en el registro **{reg_name}**?
 """
-                final_registers = sim.get_registers()
-                final_value = final_registers[reg_to_ask_idx]
-
-                qa_pair = {
-                    "question": question_text.strip(),
-                    "answer": {
-                        "register_queried": reg_name,
-                        "final_value_decimal": final_value,
-                        "final_value_hex": f"0x{final_value:08x}"
-                    }
+            final_registers = sim.get_registers()
+            final_value = final_registers[reg_to_ask_idx]
+
+            qa_pair = {
+                "question": question_text.strip(),
+                "answer": {
+                    "register_queried": reg_name,
+                    "final_value_decimal": final_value,
+                    "final_value_hex": f"0x{final_value:08x}"
                 }
-            elif config.question_type == 3:
-                # Implementación para "cuáles son los bits tal a tal"
-                reg_to_ask_idx = code_info['reg_to_ask']
-                reg_name = f"x{reg_to_ask_idx} ({generator.ABI_NAMES[reg_to_ask_idx]})"
-                bit_start = code_info['bit_start']
-                bit_end = code_info['bit_end']
-
-                question_text = f"""
+            }
+        elif config.question_type == 3:
+            # Implementación para "cuáles son los bits tal a tal"
+            reg_to_ask_idx = code_info['reg_to_ask']
+            reg_name = f"x{reg_to_ask_idx} ({generator.ABI_NAMES[reg_to_ask_idx]})"
+            bit_start = code_info['bit_start']
+            bit_end = code_info['bit_end']
+
+            question_text = f"""
 Considerando el estado final del procesador tras la ejecución del código anterior, ¿cuál es el valor binario de los bits `{bit_end}:{bit_start}` del registro **{reg_name}**?
 """
-                final_registers = sim.get_registers()
-                final_value = final_registers[reg_to_ask_idx]
+            final_registers = sim.get_registers()
+            final_value = final_registers[reg_to_ask_idx]
 
-                # Lógica para extraer los bits
-                bit_length = bit_end - bit_start + 1
-                mask = (1 << bit_length) - 1
-                extracted_bits_value = (final_value >> bit_start) & mask
-                
-                # Formatear el valor binario con ceros a la izquierda
-                binary_representation = f"{extracted_bits_value:0{bit_length}b}"
-
-                qa_pair = {
-                    "question": question_text.strip(),
-                    "answer": {
-                        "register_queried": reg_name,
-                        "bit_range": f"{bit_end}:{bit_start}",
-                        "value_binary": binary_representation,
-                        "value_decimal": extracted_bits_value
-                    }
+            # Lógica para extraer los bits
+            bit_length = bit_end - bit_start + 1
+            mask = (1 << bit_length) - 1
+            extracted_bits_value = (final_value >> bit_start) & mask
+            
+            # Formatear el valor binario con ceros a la izquierda
+            binary_representation = f"{extracted_bits_value:0{bit_length}b}"
+
+            qa_pair = {
+                "question": question_text.strip(),
+                "answer": {
+                    "register_queried": reg_name,
+                    "bit_range": f"{bit_end}:{bit_start}",
+                    "value_binary": binary_representation,
+                    "value_decimal": extracted_bits_value
                 }
-            elif config.question_type == 4:
-                # Pregunta sobre el valor de una señal de control en la última instrucción
-                signal_to_ask = code_info['signal_to_ask']
+            }
+        elif config.question_type == 4:
+            # Pregunta sobre el valor de una señal de control en la última instrucción
+            signal_to_ask = code_info['signal_to_ask']
 
-                question_text = f"""
+            question_text = f"""
 Siguiendo con el mismo caso, ¿qué valor tomó la señal de control **{signal_to_ask}** durante la ejecución de la última instrucción del programa (`lw`)?
 """
-                # El estado del datapath corresponde al último ciclo, que es el de la instrucción 'lw'
-                datapath_state = sim.get_datapath_state()
-                signal_value = getattr(datapath_state, signal_to_ask).value
-
-                qa_pair = {
-                    "question": question_text.strip(),
-                    "answer": {
-                        "signal_queried": signal_to_ask,
-                        "value": signal_value
-                    }
+            # El estado del datapath corresponde al último ciclo, que es el de la instrucción 'lw'
+            datapath_state = sim.get_datapath_state()
+            signal_value = getattr(datapath_state, signal_to_ask).value
+
+            qa_pair = {
+                "question": question_text.strip(),
+                "answer": {
+                    "signal_queried": signal_to_ask,
+                    "value": signal_value
                 }
-            else:
-                raise HTTPException(status_code=400, detail=f"Invalid question_type: {config.question_type}")
+            }
+        else:
+            raise HTTPException(status_code=400, detail=f"Invalid question_type: {config.question_type}")
 
-            return qa_pair
+        return qa_pair
 
-        except Exception as e:
-            # Capturamos cualquier error durante la generación.
-            raise HTTPException(status_code=500, detail=f"Error generando la pregunta: {e}")
+    except Exception as e:
+        # Capturamos cualquier error durante la generación.
+        raise HTTPException(status_code=500, detail=f"Error generando la pregunta: {e}")
 
 @app.post("/assemble", summary="Ensambla código RISC-V")
 def assemble_code(
@@ -891,8 +1337,7 @@ def assemble_code(
     Toma una cadena de código ensamblador, la compila usando el núcleo C++
     y devuelve el código máquina resultante codificado en Base64.
     """
-    with simulators_lock:
-        sim_instance = get_simulator_for_session(session_id)
+    with locked_session(session_id) as sim_instance:
         sim = sim_instance["sim"]
         try:
             machine_code = sim.assemble(assembly_code)
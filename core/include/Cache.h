@@ -1,30 +1,177 @@
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <vector>
+#include "Coherence.h"
+#include "Config.h"
 #include "CoreExport.h"
+#include "Prefetcher.h"
 
 // Declaración anticipada para evitar dependencia circular de cabeceras.
 class Memory;
+class StateWriter;
+class StateReader;
+
+// Identifica una de las cachés del simulador. El valor numérico es el que usa la API C.
+enum class CacheId {
+    Instruction = 0,
+    Data = 1
+};
 
 struct CacheLine {
     bool valid = false;
     uint32_t tag = 0;
     std::vector<uint8_t> data; // Bloque de datos
 
+    // --- Metadatos de prebúsqueda ---
+    bool prefetched = false;   // Traída por un prebuscador y todavía sin usar
+    int8_t prefetcher = -1;    // Índice del prebuscador que la trajo
+    uint64_t ready_at = 0;     // Ciclo en el que el bloque termina de llegar
+
+    // --- Coherencia (solo con un CoherenceBus conectado) ---
+    CoherenceState state = CoherenceState::Invalid;
+    bool invalidated = false;  // Se perdió por una escritura de otro hart (conserva la etiqueta)
+    uint64_t access_mask = 0;  // Palabras usadas desde que se trajo el bloque
+
     CacheLine(size_t block_size);
 };
 
+// Contadores de accesos de demanda de una caché.
+struct CacheStats {
+    uint64_t reads = 0;
+    uint64_t read_misses = 0;
+    uint64_t writes = 0;
+    uint64_t write_misses = 0;
+    uint64_t stall_cycles = 0; // Ciclos de espera por encima de un acierto
+
+    // --- Caché de víctimas ---
+    uint64_t victim_hits = 0;  // Fallos del array principal resueltos por la caché de víctimas
+
+    // --- Buffer de escritura ---
+    uint64_t write_buffer_coalesced = 0;    // Escrituras fusionadas en una entrada pendiente
+    uint64_t write_buffer_drains = 0;       // Entradas volcadas a memoria
+    uint64_t write_buffer_full_stalls = 0;  // Escrituras que encontraron el buffer lleno
+    uint64_t write_buffer_stall_cycles = 0; // Ciclos esperados por buffer lleno
+
+    // --- Fallos pendientes (MSHR), solo en modo no bloqueante ---
+    uint64_t mshr_primary = 0;      // Fallos que reservaron un MSHR
+    uint64_t mshr_secondary = 0;    // Accesos fusionados con un fallo pendiente del mismo bloque
+    uint64_t outstanding_sum = 0;   // Suma, ciclo a ciclo, de los fallos pendientes
+    uint64_t outstanding_cycles = 0; // Ciclos con al menos un fallo pendiente
+    uint64_t max_outstanding = 0;
+};
+
 // Clase base para una caché.
 // Implementa una caché de mapeo directo con una política de escritura
 // "write-through" y "no-write-allocate".
+//
+// Opcionalmente puede tener:
+// - Un buffer de escritura con fusión por bloque: las escrituras a memoria se
+//   encolan y se vuelcan de una en una, cada MEMORY_LATENCY_CYCLES, a medida
+//   que avanza el reloj. Solo se espera si el buffer está lleno.
+// - Una caché de víctimas totalmente asociativa (LRU) con los bloques
+//   expulsados del array principal.
+//
+// - Registros de fallos pendientes (MSHR): con N > 0 entradas la caché es no
+//   bloqueante. Un fallo devuelve el dato pero el bloque no llega hasta
+//   get_last_latency() ciclos después; el que accede decide si espera. Los
+//   accesos al mismo bloque mientras tanto se fusionan con el fallo pendiente.
+//
+// - Coherencia: conectada a un CoherenceBus la caché pasa a ser write-back y
+//   write-allocate, con un estado MSI/MESI por línea (ver Coherence.h).
+//
+// El tiempo se mide en ciclos: el propietario avanza el reloj con tick() y
+// cada acceso deja su latencia en get_last_latency().
 class SIMULATOR_API Cache {
 public:
     // El destructor virtual es crucial para las clases base.
     virtual ~Cache() = default;
 
-    virtual uint32_t read_word(uint32_t address);
-    virtual void write_word(uint32_t address, uint32_t value);
+    // `pc` es el de la instrucción que accede; lo usan los prebuscadores por
+    // PC. Sin él (p.ej. accesos de la API) no se entrenan.
+    virtual uint32_t read_word(uint32_t address, std::optional<uint32_t> pc = std::nullopt);
+    virtual void write_word(uint32_t address, uint32_t value, std::optional<uint32_t> pc = std::nullopt);
+
+    // Accesos de 1, 2 o 4 bytes (sin extender el signo). Un acceso que cruza
+    // dos bloques se divide en dos accesos.
+    uint32_t read(uint32_t address, unsigned bytes, std::optional<uint32_t> pc = std::nullopt);
+    void write(uint32_t address, uint32_t value, unsigned bytes, std::optional<uint32_t> pc = std::nullopt);
+
+    // Avanza el reloj de la caché hasta `cycle` y vuelca las escrituras que hayan terminado.
+    void tick(uint64_t cycle);
+    uint64_t get_cycle() const { return now; }
+
+    // Latencia (en ciclos) del último acceso de demanda.
+    uint32_t get_last_latency() const { return last_latency; }
+
+    // Invalida todas las líneas y pone a cero contadores y prebuscadores.
+    // Las escrituras pendientes en el buffer se descartan.
+    void reset();
+
+    // --- Buffer de escritura y caché de víctimas (0 entradas = desactivado) ---
+    void set_write_buffer_entries(size_t entries);
+    void set_victim_entries(size_t entries);
+    size_t get_write_buffer_entries() const { return write_buffer_entries; }
+    size_t get_write_buffer_occupancy() const { return write_buffer.size(); }
+    size_t get_victim_entries() const { return victims.size(); }
+
+    // Vuelca a memoria todas las escrituras pendientes, sin coste de ciclos.
+    void flush();
+    // Aplica a `target` (una copia de la memoria) las escrituras pendientes,
+    // sin sacarlas del buffer. Así la copia refleja todo lo ya ejecutado.
+    void apply_pending_writes(Memory& target) const;
+    // Valor de `bytes` bytes en `address` tal como lo ve el programa: la
+    // memoria con las escrituras pendientes del buffer encima. No cuenta
+    // como acceso.
+    uint32_t peek(uint32_t address, unsigned bytes) const;
+    // Invalida las líneas y descarta las escrituras pendientes y los fallos en
+    // curso, sin tocar contadores ni reloj. Se usa al restaurar una
+    // instantánea de la memoria.
+    void invalidate();
+
+    // --- Fallos pendientes (0 entradas = caché bloqueante) ---
+    void set_mshr_entries(size_t entries);
+    size_t get_mshr_entries() const { return mshr_entries; }
+    size_t get_outstanding_misses() const { return mshrs.size(); }
+    // Indica si un acceso de lectura a `address` puede atenderse ya o si
+    // necesitaría un MSHR y están todos ocupados.
+    bool can_accept(uint32_t address) const;
+
+    // Cambia la memoria que hay detrás de la caché. Implica un reset().
+    void set_backing_memory(Memory& main_memory);
+    // Cambia el tamaño de la caché (mismo bloque). Implica un reset().
+    void set_capacity(size_t cache_size);
+
+    // --- Prebuscadores ---
+    void add_prefetcher(std::unique_ptr<Prefetcher> prefetcher);
+    void clear_prefetchers();
+    const std::vector<std::unique_ptr<Prefetcher>>& get_prefetchers() const { return prefetchers; }
+
+    // --- Coherencia ---
+    // Lo llama CoherenceBus::attach; la caché no es dueña del bus.
+    void set_coherence_bus(CoherenceBus* coherence_bus) { bus = coherence_bus; }
+    CoherenceBus* get_coherence_bus() const { return bus; }
+    CoherenceState get_line_state(uint32_t address) const;
+    // Respuesta a una transacción del bus sobre `block`: vuelca la línea si
+    // está modificada y la pasa a S, o la invalida si `invalidate`.
+    SnoopResult snoop(uint32_t block, bool invalidate);
+    // Si la palabra está en una línea modificada, la devuelve en `value`.
+    bool peek_modified(uint32_t address, uint32_t& value) const;
+    // Vuelca las líneas modificadas sin coste de ciclos (quedan limpias).
+    void write_back_all();
+
+    // Contenido, reloj, contadores, buffers y prebuscadores (ver
+    // Simulator::save_state). La caché que lo carga debe tener la misma
+    // geometría; la memoria y el bus no forman parte del estado.
+    void save_state(StateWriter& out) const;
+    void load_state(StateReader& in);
+
+    const CacheStats& get_stats() const { return stats; }
+    size_t get_block_size() const { return block_size; }
+    size_t get_num_lines() const { return num_lines; }
 
 protected:
     // El constructor es protegido para que solo las clases derivadas puedan llamarlo.
@@ -32,11 +179,78 @@ protected:
 
     size_t block_size;
     size_t num_lines;
-    Memory& memory; // Referencia a la memoria principal para fallos de caché
+    Memory* memory; // Memoria principal para fallos de caché
     std::vector<CacheLine> lines;
 
+    uint64_t now = 0;
+    uint32_t last_latency = CACHE_HIT_CYCLES;
+    CacheStats stats;
+
 private:
+    uint32_t offset_bits;
+    uint32_t index_bits;
+
+    uint32_t get_index(uint32_t address) const { return (address >> offset_bits) & static_cast<uint32_t>(num_lines - 1); }
+    uint32_t get_tag(uint32_t address) const { return address >> (offset_bits + index_bits); }
+
     void load_block_from_memory(uint32_t address, uint32_t index, uint32_t tag);
+    uint32_t block_address(uint32_t index) const { return (lines[index].tag << (offset_bits + index_bits)) | (index << offset_bits); }
+
+    // Expulsa la línea `index` (a la caché de víctimas, si la hay) y carga en
+    // ella el bloque de `address`.
+    void replace_line(uint32_t address, uint32_t index, uint32_t tag);
+
+    // Resuelve un acceso de demanda a la línea de `address` (cargándola si
+    // `allocate`) y actualiza la latencia. Devuelve si debe disparar a los
+    // prebuscadores (fallo o primer uso de un bloque prebuscado).
+    bool access(uint32_t address, bool allocate);
+
+    // Marca como inútil una línea prebuscada que se va a sustituir.
+    void retire_line(CacheLine& line);
+    void issue_prefetches(uint32_t address, std::optional<uint32_t> pc, bool miss);
+
+    // Escritura write-back/write-allocate de una caché coherente.
+    void coherent_write(uint32_t address, uint32_t value, unsigned bytes);
+    uint64_t word_bit(uint32_t address) const;
+
+    CoherenceBus* bus = nullptr;
+
+    std::vector<std::unique_ptr<Prefetcher>> prefetchers;
+    std::vector<uint32_t> prefetch_candidates; // Reutilizado entre accesos
+    bool missed = false; // El último acceso de demanda tuvo que ir a memoria
+
+    // --- Caché de víctimas ---
+    struct VictimLine {
+        bool valid = false;
+        uint32_t block = 0; // Dirección de inicio del bloque
+        std::vector<uint8_t> data;
+        uint64_t last_use = 0;
+    };
+    std::vector<VictimLine> victims;
+    uint64_t victim_clock = 0; // Para el reemplazo LRU
+
+    VictimLine* find_victim(uint32_t block);
+
+    // --- Buffer de escritura ---
+    struct WriteBufferEntry {
+        uint32_t block = 0;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> mask; // 1 en los bytes escritos
+    };
+    size_t write_buffer_entries = 0;
+    std::deque<WriteBufferEntry> write_buffer;
+    uint64_t write_buffer_head_done = 0; // Ciclo en el que termina de volcarse la cabeza
+
+    void buffer_write(uint32_t address, uint32_t value, unsigned bytes);
+    void drain_head();
+
+    // --- MSHR ---
+    struct Mshr {
+        uint32_t block = 0;
+        uint64_t ready_at = 0;
+    };
+    size_t mshr_entries = 0;
+    std::vector<Mshr> mshrs;
 };
 
 // Caché especializada para instrucciones.
@@ -49,4 +263,4 @@ public:
 class SIMULATOR_API DataCache : public Cache {
 public:
     DataCache(size_t cache_size, size_t block_size, Memory& main_memory);
-};
\ No newline at end of file
+};
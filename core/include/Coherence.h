@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "Config.h"
+#include "CoreExport.h"
+
+// Declaraciones anticipadas para evitar dependencia circular de cabeceras.
+class Cache;
+class Memory;
+
+// Protocolos de coherencia disponibles. El valor numérico es el que usa la API C.
+enum class CoherenceProtocol {
+    MSI = 0,
+    MESI = 1
+};
+
+// Estado de una línea en una caché coherente.
+enum class CoherenceState : uint8_t {
+    Invalid = 0,
+    Shared = 1,
+    Exclusive = 2, // Solo MESI: copia única y limpia
+    Modified = 3
+};
+
+// Contadores del bus de coherencia.
+// - interventions:    una caché con la línea en M la vuelca para servir a otra.
+// - invalidations:    copias invalidadas por escrituras de otro hart.
+// - coherence_misses: fallos en bloques que se perdieron por una invalidación.
+// - false_sharing:    invalidaciones de una copia que nunca usó la palabra escrita.
+struct CoherenceStats {
+    uint64_t bus_reads = 0;          // BusRd
+    uint64_t bus_read_exclusive = 0; // BusRdX
+    uint64_t bus_upgrades = 0;       // BusUpgr
+    uint64_t interventions = 0;
+    uint64_t invalidations = 0;
+    uint64_t writebacks = 0;
+    uint64_t coherence_misses = 0;
+    uint64_t false_sharing = 0;
+};
+
+// Lo que encuentra una operación del bus en una caché espía.
+struct SnoopResult {
+    CoherenceState previous = CoherenceState::Invalid;
+    uint64_t access_mask = 0; // Palabras del bloque que usó esa caché desde que lo trajo
+};
+
+/**
+ * @class CoherenceBus
+ * @brief Bus con espionaje (snooping) que mantiene coherentes las cachés de datos privadas.
+ *
+ * Las cachés conectadas pasan a ser write-back y write-allocate y cada línea
+ * lleva su estado MSI o MESI. En cada fallo o escritura sobre una copia
+ * compartida la caché pide al bus la transacción correspondiente y el resto
+ * de cachés reacciona: vuelca la línea si la tiene modificada, pasa a S en
+ * un BusRd o se invalida en un BusRdX/BusUpgr. El dato que otra caché vuelca
+ * pasa por la memoria, así que una intervención cuesta como un fallo.
+ *
+ * El detector de falso compartir anota el bloque cuando se invalida una copia
+ * cuyo hart no había tocado la palabra que provoca la invalidación.
+ */
+class SIMULATOR_API CoherenceBus {
+public:
+    explicit CoherenceBus(CoherenceProtocol protocol = CoherenceProtocol::MESI);
+
+    // Conecta una caché. Se desactivan su caché de víctimas, su buffer de
+    // escritura y sus prebuscadores, que no participan en el protocolo.
+    void attach(Cache& cache);
+    const std::vector<Cache*>& get_caches() const { return caches; }
+
+    CoherenceProtocol get_protocol() const { return protocol; }
+
+    // --- Transacciones que pide una caché (`word` es la palabra que se escribe) ---
+    // BusRd: devuelve si otra caché conserva una copia.
+    bool read(Cache& requester, uint32_t block);
+    // BusRdX: fallo de escritura.
+    void read_exclusive(Cache& requester, uint32_t block, uint32_t word);
+    // BusUpgr: escritura sobre una copia en S.
+    void upgrade(Cache& requester, uint32_t block, uint32_t word);
+
+    void count_coherence_miss() { stats.coherence_misses++; }
+    void count_writeback() { stats.writebacks++; }
+
+    // Lee la palabra más reciente de `address`: de la caché que la tenga
+    // modificada o, si ninguna, de la memoria. El llamador comprueba el rango.
+    uint32_t read_word(const Memory& memory, uint32_t address) const;
+
+    // Vuelca a memoria todas las líneas modificadas (quedan en E o S).
+    void write_back_all();
+
+    // Pone a cero contadores e informe (las cachés se reinician por separado).
+    void reset();
+
+    const CoherenceStats& get_stats() const { return stats; }
+    // Bloques con invalidaciones por falso compartir y cuántas de cada uno.
+    const std::map<uint32_t, uint64_t>& get_false_sharing() const { return false_sharing; }
+
+private:
+    void invalidate_others(Cache& requester, uint32_t block, uint32_t word);
+
+    CoherenceProtocol protocol;
+    std::vector<Cache*> caches;
+    CoherenceStats stats;
+    std::map<uint32_t, uint64_t> false_sharing;
+};
@@ -16,6 +16,51 @@
 #define IMEM_SIZE 256
 #define DMEM_SIZE 256
 
+// --- Jerarquía de memoria (modelos con cachés) ---
+// Estas latencias se miden en ciclos de reloj, no en las unidades de retardo de arriba.
+#define CACHE_HIT_CYCLES 1
+#define MEMORY_LATENCY_CYCLES 20
+#define CACHE_BLOCK_SIZE 16
+#define PIPELINE_CACHE_SIZE 64 // Segmentado con cachés: menor que IMEM_SIZE/DMEM_SIZE para que haya fallos de conflicto
+#define STRIDE_TABLE_ENTRIES 64
+#define STREAM_BUFFERS 4
+#define VICTIM_HIT_CYCLES 1 // Ciclos extra de un acierto en la caché de víctimas
+
+// --- DRAM (opcional, sustituye a MEMORY_LATENCY_CYCLES) ---
+#define DRAM_BANKS 8
+#define DRAM_ROW_SIZE 1024   // Bytes por fila (página) de cada banco
+#define DRAM_T_RCD 6         // Activación de fila (ACT -> READ/WRITE)
+#define DRAM_T_CAS 6         // Latencia de columna (READ -> dato)
+#define DRAM_T_RP 6          // Precarga (cierre de fila)
+#define DRAM_T_BURST 4       // Transferencia de un bloque por el bus
+#define DRAM_QUEUE_DEPTH 8   // Peticiones en vuelo en el controlador
+
+// --- Memoria virtual Sv32 (modo General) ---
+#define PAGE_SIZE 4096
+#define ITLB_ENTRIES 8
+#define DTLB_ENTRIES 8
+#define L2_TLB_ENTRIES 64
+#define L2_TLB_HIT_CYCLES 2
+
+// --- Varios harts con memoria compartida (modo General) ---
+#define MAX_HARTS 8
+#define COHERENCE_BUS_CYCLES 4   // Transacción del bus sin datos (p.ej. BusUpgr)
+#define FALSE_SHARING_REPORT 16  // Bloques que se listan en el informe de falso compartir
+
+// --- Historial para step_back ---
+#define HISTORY_BUDGET_BYTES (64u << 20)   // Se descartan los pasos más antiguos por encima
+#define HISTORY_CHECKPOINT_INTERVAL 1024   // Pasos entre dos copias completas del estado
+
+// --- Estado binario con memoria ---
+#define DIRTY_LINES_LIMIT 4096   // Líneas escritas a partir de las que se pide resincronizar
+
+// --- Reserva de simuladores (SimulatorPool) ---
+#define SIMULATOR_POOL_CAPACITY 64   // Instancias libres que se conservan como mucho
+
+// --- Sesiones (SessionRegistry) ---
+#define SESSION_MEMORY_BUDGET_BYTES (256u << 20) // Por encima se hibernan las menos usadas
+#define SESSION_IDLE_SECONDS 600                 // Inactividad tras la que se hiberna una sesión
+
 
 #define DEBUG_INFO 1
 #define LOAD_USE_HAZARD 1
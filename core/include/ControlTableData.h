@@ -55,6 +55,12 @@ static const InstructionInfo control_table_data[] = {
     {"ori", static_cast<uint8_t>(0), true, static_cast<uint8_t>(0), static_cast<uint8_t>(3), false, static_cast<uint8_t>(1), static_cast<uint8_t>(0), 0x707F, 0x6013, 'I', 4, 0x6808},
     {"lui", static_cast<uint8_t>(0), true, static_cast<uint8_t>(0), static_cast<uint8_t>(0), false, static_cast<uint8_t>(1), static_cast<uint8_t>(4), 0x7F, 0x37, 'U', 4, 0x0C08},
     {"jalr", static_cast<uint8_t>(2), true, static_cast<uint8_t>(0), static_cast<uint8_t>(0), false, static_cast<uint8_t>(2), static_cast<uint8_t>(0), 0x707F, 0x67, 'I', 4, 0x1088},
+    {"lb", static_cast<uint8_t>(0), true, static_cast<uint8_t>(0), static_cast<uint8_t>(0), false, static_cast<uint8_t>(0), static_cast<uint8_t>(0), 0x707F, 0x3, 'I', 5, 0x0008},
+    {"lh", static_cast<uint8_t>(0), true, static_cast<uint8_t>(0), static_cast<uint8_t>(0), false, static_cast<uint8_t>(0), static_cast<uint8_t>(0), 0x707F, 0x1003, 'I', 5, 0x0008},
+    {"lbu", static_cast<uint8_t>(0), true, static_cast<uint8_t>(0), static_cast<uint8_t>(0), false, static_cast<uint8_t>(0), static_cast<uint8_t>(0), 0x707F, 0x4003, 'I', 5, 0x0008},
+    {"lhu", static_cast<uint8_t>(0), true, static_cast<uint8_t>(0), static_cast<uint8_t>(0), false, static_cast<uint8_t>(0), static_cast<uint8_t>(0), 0x707F, 0x5003, 'I', 5, 0x0008},
+    {"sb", static_cast<uint8_t>(0), false, static_cast<uint8_t>(0), static_cast<uint8_t>(0), true, 0xFF, static_cast<uint8_t>(1), 0x707F, 0x23, 'S', 4, 0x1904},
+    {"sh", static_cast<uint8_t>(0), false, static_cast<uint8_t>(0), static_cast<uint8_t>(0), true, 0xFF, static_cast<uint8_t>(1), 0x707F, 0x1023, 'S', 4, 0x1904},
 };
 
 } // namespace riscv_sim
@@ -12,7 +12,7 @@ public:
     void set_delay(uint32_t new_delay) { delay = new_delay; }
     uint32_t get_delay() const { return delay; }
     std::vector<InstructionInfo> get_control_table();
-    const InstructionInfo* decode(uint32_t instruction);
+    const InstructionInfo* decode(uint32_t instruction) const;
     uint32_t decode(uint32_t instruction, uint8_t status_register);
     uint32_t decode(uint32_t instruction, bool Z);
 
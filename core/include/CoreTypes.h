@@ -77,6 +77,9 @@ struct MEM_WB_Register {
 
 
 
+// Estado del datapath tal como lo ve la API (Simulator_get_datapath_state,
+// api/main.py). El simulador trabaja con PackedDatapath (Datapath.h) y solo
+// construye esta estructura al devolverla.
 struct DatapathState {
     // --- Ciclo de instrucción ---
     Signal<uint32_t> bus_PC;             // Contenido actual del Program Counter (PC)
@@ -214,4 +217,27 @@ struct DatapathState {
     Signal<uint32_t> bus_ForwardB; // Salida de forward b, si existe (entrada alu b)
     Signal<uint32_t> bus_ForwardM; // Salida de forward b, si existe (entrada alu b)
 
+};
+
+// Ventana de memoria de datos para una SnapshotView: quien llama pone la
+// dirección, la longitud y el buffer; `copied` son los bytes que había.
+struct MemoryWindow {
+    uint32_t address;
+    uint32_t length;
+    uint8_t* buffer;
+    uint32_t copied;
+};
+
+constexpr size_t SNAPSHOT_MAX_WINDOWS = 4;
+
+// Todo lo que necesita /state, en una sola llamada (Simulator_get_snapshot).
+struct SnapshotView {
+    uint32_t pc;
+    uint32_t status_register;
+    uint32_t cycle;
+    uint32_t registers[32];
+    char instruction[256];
+    DatapathState datapath;
+    uint32_t window_count; // Ventanas de `windows` que ha rellenado quien llama
+    MemoryWindow windows[SNAPSHOT_MAX_WINDOWS];
 };
\ No newline at end of file
@@ -0,0 +1,182 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "CoreExport.h"
+#include "CoreTypes.h"
+
+// --- Señales del datapath ---
+// Las mismas que DatapathState, agrupadas por tipo. Cada lista se expande con
+// una macro X(nombre); así se generan los accesos, la conversión a
+// DatapathState y cualquier recorrido de todas las señales.
+#define DATAPATH_U32_SIGNALS(X) \
+    X(bus_PC) X(bus_Instr) X(bus_A) \
+    X(bus_B) X(bus_imm) X(bus_immExt) \
+    X(bus_ALU_A) X(bus_ALU_B) X(bus_ALU_result) \
+    X(bus_Mem_address) X(bus_Mem_write_data) X(bus_Mem_read_data) \
+    X(bus_C) X(bus_PC_plus4) X(bus_PC_dest) \
+    X(bus_PC_next) X(Pipe_IF_ID_NPC) X(Pipe_IF_ID_NPC_out) \
+    X(Pipe_IF_ID_Instr) X(Pipe_IF_ID_Instr_out) X(Pipe_IF_ID_PC) \
+    X(Pipe_IF_ID_PC_out) X(Pipe_ID_EX_NPC) X(Pipe_ID_EX_NPC_out) \
+    X(Pipe_ID_EX_A) X(Pipe_ID_EX_A_out) X(Pipe_ID_EX_B) \
+    X(Pipe_ID_EX_B_out) X(Pipe_ID_EX_Imm) X(Pipe_ID_EX_Imm_out) \
+    X(Pipe_ID_EX_PC) X(Pipe_ID_EX_PC_out) X(Pipe_EX_MEM_NPC) \
+    X(Pipe_EX_MEM_NPC_out) X(Pipe_EX_MEM_ALU_result) X(Pipe_EX_MEM_ALU_result_out) \
+    X(Pipe_EX_MEM_B) X(Pipe_EX_MEM_B_out) X(Pipe_MEM_WB_NPC) \
+    X(Pipe_MEM_WB_NPC_out) X(Pipe_MEM_WB_ALU_result) X(Pipe_MEM_WB_ALU_result_out) \
+    X(Pipe_MEM_WB_RM) X(Pipe_MEM_WB_RM_out) X(bus_ForwardA) \
+    X(bus_ForwardB) X(bus_ForwardM)
+#define DATAPATH_U16_SIGNALS(X) \
+    X(bus_Control) X(Pipe_ID_EX_Control) X(Pipe_ID_EX_Control_out) \
+    X(Pipe_EX_MEM_Control) X(Pipe_EX_MEM_Control_out) X(Pipe_MEM_WB_Control) \
+    X(Pipe_MEM_WB_Control_out)
+#define DATAPATH_U8_SIGNALS(X) \
+    X(bus_opcode) X(bus_funct3) X(bus_funct7) \
+    X(bus_DA) X(bus_DB) X(bus_DC) \
+    X(bus_PCsrc) X(bus_ALUsrc) X(bus_ResSrc) \
+    X(bus_ALUctr) X(bus_ImmSrc) X(bus_BRwr) \
+    X(bus_MemWr) X(Pipe_ID_EX_RD) X(Pipe_ID_EX_RD_out) \
+    X(Pipe_ID_EX_RS1) X(Pipe_ID_EX_RS1_out) X(Pipe_ID_EX_RS2) \
+    X(Pipe_ID_EX_RS2_out) X(Pipe_EX_MEM_RD) X(Pipe_EX_MEM_RD_out) \
+    X(Pipe_MEM_WB_RD) X(Pipe_MEM_WB_RD_out) X(bus_ControlForwardA) \
+    X(bus_ControlForwardB) X(bus_ControlForwardM)
+#define DATAPATH_BOOL_SIGNALS(X) \
+    X(bus_ALU_zero) X(bus_branch_taken) X(bus_stall) \
+    X(bus_flush)
+
+// Número de cada señal: primero las de 32 bits, luego las de 16, 8 y 1.
+enum DatapathSignal : uint8_t {
+#define DATAPATH_SIGNAL_ID(name) SIGNAL_##name,
+    DATAPATH_U32_SIGNALS(DATAPATH_SIGNAL_ID)
+    DATAPATH_U16_SIGNALS(DATAPATH_SIGNAL_ID)
+    DATAPATH_U8_SIGNALS(DATAPATH_SIGNAL_ID)
+    DATAPATH_BOOL_SIGNALS(DATAPATH_SIGNAL_ID)
+#undef DATAPATH_SIGNAL_ID
+    DATAPATH_SIGNAL_COUNT
+};
+
+#define DATAPATH_SIGNAL_ONE(name) + 1
+constexpr size_t DATAPATH_U32_COUNT = 0 DATAPATH_U32_SIGNALS(DATAPATH_SIGNAL_ONE);
+constexpr size_t DATAPATH_U16_COUNT = 0 DATAPATH_U16_SIGNALS(DATAPATH_SIGNAL_ONE);
+constexpr size_t DATAPATH_U8_COUNT = 0 DATAPATH_U8_SIGNALS(DATAPATH_SIGNAL_ONE);
+constexpr size_t DATAPATH_BOOL_COUNT = 0 DATAPATH_BOOL_SIGNALS(DATAPATH_SIGNAL_ONE);
+#undef DATAPATH_SIGNAL_ONE
+constexpr size_t DATAPATH_U16_FIRST = DATAPATH_U32_COUNT;
+constexpr size_t DATAPATH_U8_FIRST = DATAPATH_U16_FIRST + DATAPATH_U16_COUNT;
+constexpr size_t DATAPATH_BOOL_FIRST = DATAPATH_U8_FIRST + DATAPATH_U8_COUNT;
+
+// Nombre de la señal en el JSON de estado (y en el esquema del estado
+// binario): sin el prefijo bus_, salvo en las de riesgos y cortocircuitos.
+SIMULATOR_API const char* datapath_signal_name(DatapathSignal signal);
+// Ancho del valor en bits (1 para las booleanas).
+SIMULATOR_API unsigned datapath_signal_bits(DatapathSignal signal);
+
+// Etapas del segmentado, en el orden de los textos de DatapathState.
+enum PipelineStage : uint8_t { STAGE_IF, STAGE_ID, STAGE_EX, STAGE_MEM, STAGE_WB, STAGE_COUNT };
+
+// Identificador de texto de una etapa que no se guarda: es el desensamblado
+// de la instrucción que tiene la etapa (Pipe_*_instruction).
+constexpr uint32_t TEXT_FROM_INSTRUCTION = 0xFFFFFFFFu;
+
+// Bit de is_active de una señal dentro de la máscara.
+class ActiveBit {
+public:
+    ActiveBit(uint64_t& word, uint64_t mask) : word(word), mask(mask) {}
+    ActiveBit(const ActiveBit&) = default;
+    operator uint8_t() const { return (word & mask) != 0; }
+    ActiveBit& operator=(uint8_t active) {
+        if (active) word |= mask; else word &= ~mask;
+        return *this;
+    }
+    ActiveBit& operator=(const ActiveBit& other) { return *this = static_cast<uint8_t>(other); }
+
+private:
+    uint64_t& word;
+    uint64_t mask;
+};
+
+// Referencia a una señal de un PackedDatapath. Se usa como un Signal<T>:
+// tiene value, ready_at e is_active y se asigna desde un Signal<T> o desde
+// otra señal (copiando su contenido).
+template<typename T>
+struct SignalRef {
+    T& value;
+    uint32_t& ready_at;
+    ActiveBit is_active;
+
+    SignalRef& operator=(const Signal<T>& signal) {
+        value = signal.value;
+        ready_at = signal.ready_at;
+        is_active = signal.is_active;
+        return *this;
+    }
+    SignalRef& operator=(const SignalRef& other) { return *this = static_cast<Signal<T>>(other); }
+    operator Signal<T>() const { return Signal<T>{value, ready_at, is_active}; }
+};
+
+/**
+ * @struct PackedDatapath
+ * @brief Estado del datapath tal como lo guarda el simulador.
+ *
+ * Contiene lo mismo que DatapathState, pero con los valores en un array
+ * denso por tipo, los tiempos en otro y los bits de actividad en una
+ * máscara. Los textos de las instrucciones son identificadores (ver
+ * Simulator::text_id). Ocupa la cuarta parte, así que copiarlo y limpiarlo
+ * en cada paso (y guardarlo en el historial) es mucho más barato.
+ * DatapathState solo se construye en la frontera con la API.
+ */
+struct SIMULATOR_API PackedDatapath {
+    // Como DatapathState{}: valores a 0, listos en el ciclo 1 y activos.
+    PackedDatapath();
+
+#define DATAPATH_ACCESSOR(T, first, array, name) \
+    SignalRef<T> name() { \
+        return SignalRef<T>{array[SIGNAL_##name - first], ready_at[SIGNAL_##name], active_bit(SIGNAL_##name)}; \
+    }
+#define DATAPATH_U32_ACCESSOR(name) DATAPATH_ACCESSOR(uint32_t, 0, u32, name)
+#define DATAPATH_U16_ACCESSOR(name) DATAPATH_ACCESSOR(uint16_t, DATAPATH_U16_FIRST, u16, name)
+#define DATAPATH_U8_ACCESSOR(name) DATAPATH_ACCESSOR(uint8_t, DATAPATH_U8_FIRST, u8, name)
+#define DATAPATH_BOOL_ACCESSOR(name) DATAPATH_ACCESSOR(bool, DATAPATH_BOOL_FIRST, flags, name)
+    DATAPATH_U32_SIGNALS(DATAPATH_U32_ACCESSOR)
+    DATAPATH_U16_SIGNALS(DATAPATH_U16_ACCESSOR)
+    DATAPATH_U8_SIGNALS(DATAPATH_U8_ACCESSOR)
+    DATAPATH_BOOL_SIGNALS(DATAPATH_BOOL_ACCESSOR)
+#undef DATAPATH_U32_ACCESSOR
+#undef DATAPATH_U16_ACCESSOR
+#undef DATAPATH_U8_ACCESSOR
+#undef DATAPATH_BOOL_ACCESSOR
+#undef DATAPATH_ACCESSOR
+
+    bool is_active(DatapathSignal signal) const { return (active[signal / 64] >> (signal % 64)) & 1; }
+    // Valor de cualquier señal, ampliado a 32 bits.
+    uint32_t value(DatapathSignal signal) const;
+
+    // Copia señales, tiempos e instrucciones de las etapas en `out`. Los
+    // textos los rellena quien conoce los identificadores.
+    void to_legacy(DatapathState& out) const;
+
+    uint32_t u32[DATAPATH_U32_COUNT];
+    uint16_t u16[DATAPATH_U16_COUNT];
+    uint8_t u8[DATAPATH_U8_COUNT];
+    bool flags[DATAPATH_BOOL_COUNT];
+    uint32_t ready_at[DATAPATH_SIGNAL_COUNT];
+    uint64_t active[(DATAPATH_SIGNAL_COUNT + 63) / 64];
+
+    uint32_t criticalTime = 0;
+    uint32_t total_micro_cycles = 0;
+
+    uint32_t Pipe_IF_instruction = 0x00000013;
+    uint32_t Pipe_ID_instruction = 0x00000013;
+    uint32_t Pipe_EX_instruction = 0x00000013;
+    uint32_t Pipe_MEM_instruction = 0x00000013;
+    uint32_t Pipe_WB_instruction = 0x00000013;
+
+    // Textos (instruction_cptr y Pipe_*_instruction_cptr). 0 es el texto vacío.
+    uint32_t instruction_text = 0;
+    uint32_t stage_text[STAGE_COUNT] = {};
+    uint32_t padding = 0; // Relleno explícito a ceros: el historial compara bytes
+
+private:
+    ActiveBit active_bit(DatapathSignal signal) {
+        return ActiveBit(active[signal / 64], static_cast<uint64_t>(1) << (signal % 64));
+    }
+};
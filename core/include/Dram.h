@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "Config.h"
+#include "CoreExport.h"
+
+class StateWriter;
+class StateReader;
+
+// Política de gestión del buffer de fila.
+enum class DramPagePolicy {
+    Open = 0,   // La fila queda abierta tras el acceso (aciertos de fila baratos)
+    Closed = 1  // Se precarga tras cada acceso (sin conflictos, sin aciertos)
+};
+
+// Parámetros del modelo. Las latencias están en ciclos de reloj.
+struct DramConfig {
+    size_t banks = DRAM_BANKS;
+    size_t row_size = DRAM_ROW_SIZE;
+    uint32_t t_rcd = DRAM_T_RCD;
+    uint32_t t_cas = DRAM_T_CAS;
+    uint32_t t_rp = DRAM_T_RP;
+    uint32_t t_burst = DRAM_T_BURST;
+    size_t queue_depth = DRAM_QUEUE_DEPTH;
+    DramPagePolicy policy = DramPagePolicy::Open;
+};
+
+struct DramStats {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t row_hits = 0;      // La fila ya estaba abierta
+    uint64_t row_empty = 0;     // Banco sin fila abierta: solo activación
+    uint64_t row_conflicts = 0; // Había otra fila abierta: precarga + activación
+    uint64_t total_latency = 0; // Suma de latencias vistas por las peticiones
+    uint64_t queue_cycles = 0;  // Parte de la latencia esperando en cola o al banco
+};
+
+/**
+ * @class Dram
+ * @brief Modelo de temporización de una DRAM con bancos y buffers de fila.
+ *
+ * Solo modela el tiempo: los datos siguen en Memory. La dirección se reparte
+ * como | fila | banco | columna |, de modo que bloques consecutivos caen en la
+ * misma fila y filas consecutivas en bancos distintos.
+ *
+ * Cada petición espera a que haya hueco en la cola del controlador y a que su
+ * banco quede libre; después paga tRP/tRCD/tCAS según el estado del buffer de
+ * fila y tBURST en el bus de datos, que es compartido por todos los bancos.
+ */
+class SIMULATOR_API Dram {
+public:
+    explicit Dram(const DramConfig& config = DramConfig{});
+
+    // Atiende una petición que llega en el ciclo `now` y devuelve su latencia.
+    uint32_t access(uint32_t address, bool is_write, uint64_t now);
+
+    // Cierra todas las filas y pone a cero los contadores.
+    void reset();
+
+    const DramConfig& get_config() const { return config; }
+    const DramStats& get_stats() const { return stats; }
+
+    // Filas abiertas, colas y contadores (la configuración va aparte).
+    void save_state(StateWriter& out) const;
+    void load_state(StateReader& in);
+
+private:
+    struct Bank {
+        bool open = false;
+        uint32_t row = 0;
+        uint64_t busy_until = 0; // Ciclo en el que acepta la siguiente orden
+    };
+
+    DramConfig config;
+    std::vector<Bank> banks;
+    uint32_t column_bits;
+    uint32_t bank_bits;
+    uint64_t bus_busy_until = 0;
+    std::deque<uint64_t> in_flight; // Ciclo de fin de las peticiones en cola
+    DramStats stats;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "CoreExport.h"
+
+class Memory;
+
+/**
+ * @class MappedFile
+ * @brief Fichero proyectado en memoria.
+ *
+ * La proyección vive mientras quede algún shared_ptr a ella, también los que
+ * guardan las páginas de una Memory que la comparten.
+ */
+class SIMULATOR_API MappedFile {
+public:
+    // Proyecta `path`. Lanza std::runtime_error si no se puede abrir o proyectar.
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    // Proyecta `path` en lectura y escritura compartida (MAP_SHARED): lo que
+    // se escribe llega al fichero. Si el fichero no existe se crea y si mide
+    // menos de `size` bytes se alarga con ceros. Con size = 0 se usa su tamaño.
+    static std::shared_ptr<MappedFile> open_shared(const std::string& path, size_t size = 0);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return bytes; }
+    // Solo en proyecciones abiertas con open_shared.
+    uint8_t* writable_data() const { return writable ? const_cast<uint8_t*>(bytes) : nullptr; }
+    size_t size() const { return length; }
+
+    // Fuerza la escritura en disco de lo modificado (msync/FlushViewOfFile).
+    void sync() const;
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool writable = false;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+// Resultado de cargar una imagen.
+struct LoadedImage {
+    uint32_t entry = 0;       // Dirección de la primera instrucción
+    bool elf = false;         // ELF32 o binario plano
+    size_t shared_pages = 0;  // Páginas que leen directamente de la proyección
+    size_t copied_bytes = 0;  // Bytes copiados (trozos de página)
+};
+
+// Carga en `memory` (que se borra antes) un ELF32 RISC-V little-endian o un
+// binario plano (.bin, que se coloca en la dirección 0 y arranca en ella).
+// De un ELF se cargan los segmentos PT_LOAD en su dirección física; las
+// páginas completas del fichero se comparten con la proyección en lugar de
+// copiarse y la primera escritura en ellas hace una copia propia. El resto
+// de cada segmento (.bss) queda a ceros.
+// Lanza std::invalid_argument si el ELF no es válido o no cabe en la memoria.
+SIMULATOR_API LoadedImage load_image(Memory& memory, const std::shared_ptr<MappedFile>& file);
+
+// Indica si los datos empiezan por la firma de un ELF.
+SIMULATOR_API bool is_elf_image(const uint8_t* data, size_t size);
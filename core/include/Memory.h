@@ -1,39 +1,204 @@
+#pragma once
 #include "Config.h"
+#include <array>
+#include <atomic>
 #include <vector>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 #include "CoreExport.h"
 
+class Dram;
+class MappedFile;
+
+// Memoria física dispersa: páginas de PAGE_SIZE bytes que se reservan en la
+// primera escritura. Leer una página que nunca se escribió devuelve ceros, así
+// que una memoria de 4 GiB solo ocupa las páginas que se han tocado.
+//
+// Las páginas cuelgan de un árbol de tres niveles. Las copias comparten el
+// árbol y las páginas con el original (copia en escritura): copiar cuesta lo
+// mismo que copiar un puntero y la primera escritura en una página compartida
+// duplica solo esa página y los nodos del camino hasta ella. Así las
+// instantáneas del historial son baratas aunque la memoria tenga megabytes en uso.
+// Cada nodo y cada página llevan la marca de la copia que los creó y solo esa
+// copia los escribe en su sitio; copiar da marcas nuevas a las dos copias, así
+// que ninguna vuelve a escribir en lo que ya comparten. (Mirar use_count() no
+// sirve: las copias pueden vivir en simuladores de hilos distintos.)
+//
+// Una página también puede apuntar a datos ajenos de solo lectura (p.ej. un
+// fichero proyectado con mmap): se leen sin copiarlos y la primera escritura
+// hace una copia propia. O a un fichero proyectado en escritura (map_file):
+// entonces lecturas y escrituras van directamente al fichero.
 class SIMULATOR_API Memory {
 public:
-    // Inicializa la memoria con un tamaño dado en bytes.
+    // Inicializa la memoria con un tamaño dado en bytes (como mucho 4 GiB).
     Memory(size_t size_in_bytes);
 
+    // Copias en escritura (ver arriba). Las regiones de map_file no se
+    // copian: como dos proyecciones MAP_SHARED, la copia lee y escribe el
+    // mismo fichero y también lo sincroniza.
+    Memory(const Memory& other);
+    Memory& operator=(const Memory& other);
+    Memory(Memory&& other) noexcept;
+    Memory& operator=(Memory&& other) noexcept;
+
     // Lee 32 bits (una palabra) de una dirección de memoria.
-    uint32_t read_word(uint32_t address,bool cyclic=false);
+    uint32_t read_word(uint32_t address,bool cyclic=false) const;
 
     // Escribe 32 bits (una palabra) en una dirección de memoria.
     void write_word(uint32_t address, uint32_t value,bool cyclic=false);
 
+    // Accesos de 8 y 16 bits (lb/lh/lbu/lhu/sb/sh). Little-endian, sin
+    // requisito de alineamiento. Con `cyclic` la dirección da la vuelta.
+    uint8_t read_byte(uint32_t address, bool cyclic=false) const;
+    uint16_t read_half(uint32_t address, bool cyclic=false) const;
+    void write_byte(uint32_t address, uint8_t value, bool cyclic=false);
+    void write_half(uint32_t address, uint16_t value, bool cyclic=false);
+
+    // Sin comprobación de rango: el llamador garantiza que address + 4 <= size().
+    uint32_t read_word_unchecked(uint32_t address) const { return load_unchecked(address, 4); }
+    void write_word_unchecked(uint32_t address, uint32_t value) { store_unchecked(address, value, 4); }
+
     // Carga un programa (un vector de bytes) en la memoria en una dirección base.
     void load_program(const std::vector<uint8_t>& program, uint32_t base_address);
+    void load_program(const uint8_t* program, size_t size, uint32_t base_address);
+
+    // Hace que la página que empieza en `page_address` (alineada a PAGE_SIZE)
+    // lea directamente de `data`, que debe tener PAGE_SIZE bytes y vivir
+    // mientras lo haga el shared_ptr.
+    void share_page(uint32_t page_address, std::shared_ptr<const uint8_t> data);
+
+    // Respalda [base_address, base_address + size) con el fichero `path`
+    // proyectado con MAP_SHARED: el programa lee los datos sin cargarlos y lo
+    // que escribe queda en el fichero. `base_address` debe estar alineada a
+    // PAGE_SIZE; con size = 0 se usa el tamaño del fichero, que se crea o se
+    // alarga si hace falta. Lo que hubiera en esas páginas se descarta.
+    // clear() deshace la proyección.
+    void map_file(const std::string& path, uint32_t base_address, size_t size = 0);
+    // Lleva a disco lo escrito en las regiones de map_file.
+    void sync_mapped_files() const;
+    bool has_mapped_files() const { return !mapped_files.empty(); }
+    // Indica si `address` está en una región de map_file.
+    bool is_mapped(uint32_t address) const;
 
     // Lee un bloque de memoria. Usado por la caché para manejar fallos.
     void read_block(uint32_t base_address, std::vector<uint8_t>& buffer);
 
+    // Escribe un bloque de memoria. Solo se escriben los bytes con máscara no nula.
+    // Usado por el buffer de escritura de la caché.
+    void write_block(uint32_t base_address, const std::vector<uint8_t>& buffer, const std::vector<uint8_t>& mask);
+    // Escribe el bloque completo (p.ej. la escritura diferida de una línea modificada).
+    void write_block(uint32_t base_address, const std::vector<uint8_t>& buffer);
+
+    // Libera todas las páginas: la memoria vuelve a leerse como ceros.
     void clear();
-    
+
 
     void set_delay(uint32_t new_delay) { delay = new_delay; }
 
     uint32_t get_delay() const { return delay; }
 
-    // Devuelve una referencia constante al vector de datos interno.
-    const std::vector<uint8_t>& get_data() const { return mem; }
+    // Latencia de un acceso en ciclos de reloj (la que ve una caché en un fallo).
+    void set_latency_cycles(uint32_t cycles) { latency_cycles = cycles; }
+    uint32_t get_latency_cycles() const { return latency_cycles; }
+
+    // Modelo de temporización opcional. Las copias de la memoria comparten el
+    // mismo modelo, que describe el hardware y no el contenido.
+    void attach_dram(std::shared_ptr<Dram> model) { dram = std::move(model); }
+    Dram* get_dram() const { return dram.get(); }
+
+    // Ciclos que tarda un acceso a `address` que llega en el ciclo `now`:
+    // los del modelo DRAM si hay uno conectado, o la latencia fija si no.
+    uint32_t access_cycles(uint32_t address, bool is_write, uint64_t now);
+
+    size_t size() const { return size_bytes; }
+
+    // Copia `count` bytes a partir de `base_address` (las páginas sin tocar, como ceros).
+    std::vector<uint8_t> read_bytes(uint32_t base_address, size_t count) const;
+
+    // Páginas propias en uso (las de solo lectura y las proyectadas no
+    // cuentan). Una página que comparten dos copias cuenta en las dos.
+    size_t resident_pages() const { return pages_in_use; }
+    // Bytes de las páginas propias repartidos entre las copias que las
+    // comparten: cada nodo o página que se comparte con n copias cuenta 1/n
+    // aquí, así que sumando todas las copias cada página cuenta una vez.
+    size_t shared_resident_bytes() const;
+
+    // Recorre, en orden de dirección, las páginas con datos (propias, de solo
+    // lectura o proyectadas); las que nunca se escribieron se saltan.
+    // `length` es PAGE_SIZE salvo en una memoria más pequeña que una página.
+    void for_each_page(const std::function<void(uint32_t address, const uint8_t* data, size_t length)>& visit) const;
 
 private:
     uint32_t delay=DELAY_MEMORY;
+    uint32_t latency_cycles=MEMORY_LATENCY_CYCLES;
+    std::shared_ptr<Dram> dram;
 
 private:
-    std::vector<uint8_t> mem;
+    // Nodos del árbol: la raíz apunta a nodos intermedios, estos a hojas y
+    // cada hoja guarda LEAF_PAGES páginas. 128 * 128 * 64 páginas = 4 GiB.
+    static constexpr unsigned LEAF_BITS = 6;
+    static constexpr unsigned MIDDLE_BITS = 7;
+    static constexpr size_t LEAF_PAGES = size_t(1) << LEAF_BITS;
+    static constexpr size_t MIDDLE_LEAVES = size_t(1) << MIDDLE_BITS;
+    // Marca de la copia dueña (ver arriba); 0 no es de nadie.
+    struct Page : std::array<uint8_t, PAGE_SIZE> {
+        uint64_t owner = 0;
+    };
+    template <typename Slot>
+    struct Node : std::vector<Slot> {
+        using std::vector<Slot>::vector;
+        uint64_t owner = 0;
+    };
+    // Una página es propia (`owned`, compartida con otras copias mientras
+    // nadie la escriba), de solo lectura (`shared`), parte de un fichero
+    // proyectado en escritura (`mapped`) o ninguna de ellas (se lee como ceros).
+    struct PageSlot {
+        std::shared_ptr<Page> owned;
+        std::shared_ptr<const uint8_t> shared;
+        std::shared_ptr<uint8_t> mapped;
+    };
+    // Cada nodo se ajusta a la parte de la memoria que cubre: una memoria de
+    // 256 bytes tiene una sola hoja de un solo hueco.
+    using Leaf = Node<PageSlot>;
+    using Middle = Node<std::shared_ptr<Leaf>>;
+    using Root = Node<std::shared_ptr<Middle>>;
+    // Número de páginas, hojas y nodos intermedios de esta memoria.
+    size_t page_count() const { return (size_bytes + PAGE_SIZE - 1) / PAGE_SIZE; }
+    size_t leaf_count() const { return (page_count() + LEAF_PAGES - 1) / LEAF_PAGES; }
+    std::shared_ptr<Root> new_root() const;
+    const PageSlot* find_slot(uint32_t page_number) const;
+    // Hueco de la página `page_number`, con el camino hasta él ya sin compartir.
+    PageSlot& slot_for(uint32_t page_number);
+
+    // Página `page_number` para leer (nullptr si nunca se escribió) o para
+    // escribir (se reserva a ceros si hace falta).
+    const uint8_t* page_for_read(uint32_t page_number) const;
+    uint8_t* page_for_write(uint32_t page_number);
+
+    void check_range(uint64_t address, size_t count, const char* message) const;
+    // Dirección cíclica: máscara si el tamaño es potencia de 2, módulo si no.
+    uint32_t wrap(uint64_t address) const {
+        return static_cast<uint32_t>(size_is_power_of_two ? (address & (size_bytes - 1)) : (address % size_bytes));
+    }
+
+    // Accesos de 1, 2 o 4 bytes. Los "unchecked" no comprueban el rango.
+    uint32_t load(uint32_t address, unsigned bytes, bool cyclic) const;
+    void store(uint32_t address, uint32_t value, unsigned bytes, bool cyclic);
+    uint32_t load_unchecked(uint32_t address, unsigned bytes) const;
+    void store_unchecked(uint32_t address, uint32_t value, unsigned bytes);
+
+    void copy_out(uint32_t address, uint8_t* out, size_t count) const;
+    void copy_in(uint32_t address, const uint8_t* in, size_t count);
+
+    size_t size_bytes;
+    bool size_is_power_of_two;
+    size_t pages_in_use = 0;
+    std::shared_ptr<Root> root; // Los nodos de debajo se crean bajo demanda
+    std::vector<std::shared_ptr<MappedFile>> mapped_files; // Para sync_mapped_files
+    // Marca de esta copia. Copiar la cambia también en el original, que puede
+    // ser const y estar copiándose a la vez desde otro hilo.
+    mutable std::atomic<uint64_t> owner;
 };
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Config.h"
+#include "CoreExport.h"
+
+class Memory;
+class StateWriter;
+class StateReader;
+
+// Tipo de acceso que se traduce; determina el permiso y la causa del fallo.
+enum class AccessType {
+    Fetch = 0,
+    Load = 1,
+    Store = 2
+};
+
+// Causas de excepción (mcause) de los fallos de página.
+enum TrapCause : uint32_t {
+    CAUSE_FETCH_PAGE_FAULT = 12,
+    CAUSE_LOAD_PAGE_FAULT = 13,
+    CAUSE_STORE_PAGE_FAULT = 15
+};
+
+// Bits de una entrada de tabla de páginas (PTE) Sv32.
+enum PteFlags : uint32_t {
+    PTE_V = 1 << 0,
+    PTE_R = 1 << 1,
+    PTE_W = 1 << 2,
+    PTE_X = 1 << 3,
+    PTE_U = 1 << 4,
+    PTE_G = 1 << 5,
+    PTE_A = 1 << 6,
+    PTE_D = 1 << 7
+};
+
+struct MmuConfig {
+    size_t itlb_entries = ITLB_ENTRIES;
+    size_t dtlb_entries = DTLB_ENTRIES;
+    size_t l2_entries = L2_TLB_ENTRIES;   // TLB de segundo nivel compartido
+    uint32_t l2_hit_cycles = L2_TLB_HIT_CYCLES;
+};
+
+struct MmuStats {
+    uint64_t itlb_accesses = 0;
+    uint64_t itlb_misses = 0;
+    uint64_t dtlb_accesses = 0;
+    uint64_t dtlb_misses = 0;
+    uint64_t l2_misses = 0;      // Fallos del TLB compartido (cada uno es un recorrido)
+    uint64_t walk_cycles = 0;    // Ciclos en el recorrido de las tablas
+    uint64_t walk_reads = 0;     // PTE leídas de memoria
+    uint64_t page_faults = 0;
+    uint64_t stall_cycles = 0;   // Total de ciclos añadidos por la traducción
+};
+
+// TLB totalmente asociativo con reemplazo LRU.
+class SIMULATOR_API Tlb {
+public:
+    struct Entry {
+        bool valid = false;
+        bool megapage = false;  // Página de 4 MiB (hoja en el primer nivel)
+        uint32_t vpn = 0;       // VPN[1]:VPN[0]
+        uint32_t ppn = 0;
+        uint32_t flags = 0;
+        uint64_t last_use = 0;
+    };
+
+    explicit Tlb(size_t entries);
+    const Entry* lookup(uint32_t vpn);
+    void insert(const Entry& entry);
+    void flush();
+    size_t size() const { return entries.size(); }
+
+    void save_state(StateWriter& out) const;
+    void load_state(StateReader& in);
+
+private:
+    std::vector<Entry> entries;
+    uint64_t clock = 0;
+};
+
+/**
+ * @class Mmu
+ * @brief Traducción de direcciones Sv32 entre el núcleo y la jerarquía de memoria.
+ *
+ * La traducción está activa cuando satp.MODE = 1. No hay niveles de
+ * privilegio: los bits U y G se ignoran y los bits A/D no se actualizan.
+ * El recorrido de tablas lee las PTE directamente de la memoria física
+ * (sin pasar por las cachés) y su coste es el de Memory::access_cycles.
+ */
+class SIMULATOR_API Mmu {
+public:
+    Mmu(Memory& memory, const MmuConfig& config = MmuConfig{});
+
+    void configure(const MmuConfig& config);
+    const MmuConfig& get_config() const { return config; }
+
+    void set_satp(uint32_t value);
+    uint32_t get_satp() const { return satp; }
+    bool enabled() const { return (satp >> 31) != 0; }
+
+    // Cambia la memoria física en la que se leen las tablas. Vacía los TLB.
+    void set_memory(Memory& physical);
+
+    // Traduce `va`. Devuelve false si hay un fallo de página; en ese caso
+    // get_fault_cause() indica la causa. La latencia extra queda en get_last_latency().
+    bool translate(uint32_t va, AccessType type, uint64_t now, uint32_t& pa);
+    uint32_t get_last_latency() const { return last_latency; }
+    uint32_t get_fault_cause() const { return fault_cause; }
+
+    // Equivalente a sfence.vma: vacía todos los TLB.
+    void flush();
+    // Vacía los TLB y pone a cero los contadores (satp se conserva).
+    void reset();
+
+    const MmuStats& get_stats() const { return stats; }
+
+    // TLB y contadores (satp y la configuración los guarda el simulador).
+    void save_state(StateWriter& out) const;
+    void load_state(StateReader& in);
+
+private:
+    bool walk(uint32_t va, uint64_t now, Tlb::Entry& entry);
+
+    Memory* memory;
+    MmuConfig config;
+    Tlb itlb;
+    Tlb dtlb;
+    Tlb l2tlb;
+    uint32_t satp = 0;
+    uint32_t last_latency = 0;
+    uint32_t fault_cause = 0;
+    MmuStats stats;
+};
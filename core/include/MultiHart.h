@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Coherence.h"
+#include "CoreExport.h"
+#include "Memory.h"
+#include "Simulator.h"
+
+/**
+ * @class MultiHart
+ * @brief Varios harts en modo General que comparten la memoria principal.
+ *
+ * Cada hart es un Simulator con sus propias cachés de instrucciones y datos;
+ * las de datos se conectan a un CoherenceBus. Todos arrancan en la dirección
+ * 0 con a0 = identificador del hart. En cada paso ejecutan una instrucción,
+ * por orden de identificador, así que las ejecuciones son reproducibles.
+ *
+ * Las cachés de instrucciones no participan en la coherencia: el código que
+ * se modifica a sí mismo entre harts no está soportado.
+ */
+class SIMULATOR_API MultiHart {
+public:
+    MultiHart(size_t num_harts, size_t mem_size, CoherenceProtocol protocol = CoherenceProtocol::MESI);
+
+    // Cargan el programa en la memoria compartida y reinician todos los harts.
+    void load_program(const std::vector<uint8_t>& program);
+    void load_program(const char* assembly_code);
+
+    // Reinicia harts, cachés y contadores del bus (la memoria se conserva).
+    void reset();
+
+    // Cada hart ejecuta una instrucción.
+    void step();
+
+    // Avanza hasta que todos los harts quedan parados en un salto a sí mismo
+    // o hasta `max_steps`. Devuelve los pasos ejecutados.
+    size_t run(size_t max_steps);
+
+    size_t size() const { return harts.size(); }
+    Simulator& hart(size_t index);
+
+    // Lectura coherente: ve las escrituras que aún están en alguna caché.
+    uint32_t read_word(uint32_t address);
+
+    Memory& get_memory() { return memory; }
+    const CoherenceBus& get_bus() const { return bus; }
+
+private:
+    Memory memory;
+    CoherenceBus bus;
+    std::vector<std::unique_ptr<Simulator>> harts;
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Config.h"
+#include "CoreExport.h"
+
+class StateWriter;
+class StateReader;
+
+// Tipos de prebuscador disponibles. El valor numérico es el que usa la API C.
+enum class PrefetcherKind {
+    NextLine = 0,     // Siguiente(s) bloque(s) tras un fallo
+    Stride = 1,       // Tabla de strides indexada por PC
+    StreamBuffer = 2  // Flujos secuenciales detectados a partir de fallos
+};
+
+// Contadores de eficacia de un prebuscador.
+// - useful:  bloques prebuscados que se usaron y ya habían llegado (a tiempo).
+// - late:    bloques prebuscados que se usaron antes de llegar (tardíos).
+// - useless: bloques prebuscados que se expulsaron sin haberse usado.
+struct PrefetchStats {
+    uint64_t issued = 0;
+    uint64_t useful = 0;
+    uint64_t late = 0;
+    uint64_t useless = 0;
+};
+
+/**
+ * @class Prefetcher
+ * @brief Clase base de los prebuscadores que se conectan a una Cache.
+ *
+ * La caché notifica cada acceso de demanda y el prebuscador devuelve las
+ * direcciones (de inicio de bloque) que deben traerse. El grado es el número
+ * de bloques que se piden por disparo y la distancia, cuántos bloques por
+ * delante del acceso actual empieza la prebúsqueda.
+ */
+class SIMULATOR_API Prefetcher {
+public:
+    Prefetcher(const char* name, unsigned degree, unsigned distance);
+    virtual ~Prefetcher() = default;
+
+    /**
+     * @brief Notifica un acceso de demanda ya resuelto por la caché.
+     * @param address Dirección accedida.
+     * @param pc PC de la instrucción que accede (vacío si no se conoce).
+     * @param miss Cierto si fue un fallo o el primer uso de un bloque prebuscado.
+     * @param out Vector donde se añaden las direcciones a prebuscar.
+     */
+    virtual void on_access(uint32_t address, std::optional<uint32_t> pc, bool miss, std::vector<uint32_t>& out) = 0;
+
+    // Olvida el estado aprendido y los contadores.
+    virtual void reset();
+
+    virtual PrefetcherKind kind() const = 0;
+    // Contadores y estado aprendido (ver Simulator::save_state).
+    virtual void save_state(StateWriter& out) const;
+    virtual void load_state(StateReader& in);
+
+    void set_block_size(size_t size) { block_size = static_cast<uint32_t>(size); }
+    const std::string& get_name() const { return name; }
+    unsigned get_degree() const { return degree; }
+    unsigned get_distance() const { return distance; }
+
+    PrefetchStats& stats() { return counters; }
+    const PrefetchStats& stats() const { return counters; }
+
+protected:
+    uint32_t block_of(uint32_t address) const { return address & ~(block_size - 1); }
+
+    std::string name;
+    unsigned degree;
+    unsigned distance;
+    uint32_t block_size = CACHE_BLOCK_SIZE;
+
+private:
+    PrefetchStats counters;
+};
+
+// Prebuscador de bloque siguiente: en cada fallo pide los bloques
+// B+distancia ... B+distancia+grado-1.
+class SIMULATOR_API NextLinePrefetcher : public Prefetcher {
+public:
+    NextLinePrefetcher(unsigned degree, unsigned distance);
+    void on_access(uint32_t address, std::optional<uint32_t> pc, bool miss, std::vector<uint32_t>& out) override;
+    PrefetcherKind kind() const override { return PrefetcherKind::NextLine; }
+};
+
+// Prebuscador de stride indexado por PC (tabla de predicción de referencias).
+// Cada entrada guarda la última dirección y el stride de una instrucción de
+// memoria; con confianza suficiente pide dirección + stride*(distancia+i).
+class SIMULATOR_API StridePrefetcher : public Prefetcher {
+public:
+    StridePrefetcher(unsigned degree, unsigned distance, size_t entries = STRIDE_TABLE_ENTRIES);
+    void on_access(uint32_t address, std::optional<uint32_t> pc, bool miss, std::vector<uint32_t>& out) override;
+    void reset() override;
+    PrefetcherKind kind() const override { return PrefetcherKind::Stride; }
+    void save_state(StateWriter& out) const override;
+    void load_state(StateReader& in) override;
+
+private:
+    struct Entry {
+        bool valid = false;
+        uint32_t pc = 0;
+        uint32_t last_address = 0;
+        int32_t stride = 0;
+        uint8_t confidence = 0; // Contador saturado de 2 bits
+    };
+    std::vector<Entry> table;
+};
+
+// Buffers de flujo: cada buffer sigue un flujo secuencial (ascendente o
+// descendente) que se asigna en un fallo y avanza cuando el fallo siguiente
+// coincide con el bloque esperado. Los bloques prebuscados se instalan en la
+// propia caché en lugar de en un FIFO aparte.
+class SIMULATOR_API StreamBufferPrefetcher : public Prefetcher {
+public:
+    StreamBufferPrefetcher(unsigned degree, unsigned distance, size_t buffers = STREAM_BUFFERS);
+    void on_access(uint32_t address, std::optional<uint32_t> pc, bool miss, std::vector<uint32_t>& out) override;
+    void reset() override;
+    PrefetcherKind kind() const override { return PrefetcherKind::StreamBuffer; }
+    void save_state(StateWriter& out) const override;
+    void load_state(StateReader& in) override;
+
+private:
+    struct Stream {
+        bool valid = false;
+        uint32_t next_block = 0; // Siguiente bloque que se espera ver fallar
+        int32_t direction = 1;   // +1 ascendente, -1 descendente
+        uint64_t last_use = 0;
+    };
+    std::vector<Stream> streams;
+    uint32_t last_miss_block = 0;
+    uint64_t use_counter = 0;
+};
+
+// Crea un prebuscador del tipo indicado.
+SIMULATOR_API std::unique_ptr<Prefetcher> make_prefetcher(PrefetcherKind kind, unsigned degree, unsigned distance);
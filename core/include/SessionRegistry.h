@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Config.h"
+#include "CoreExport.h"
+#include "Simulator.h"
+#include "SimulatorPool.h"
+
+// Resumen de las sesiones de un SessionRegistry.
+struct SessionStats {
+    size_t sessions = 0;
+    size_t resident = 0;          // Con su simulador en memoria
+    size_t hibernated = 0;
+    size_t resident_bytes = 0;    // Suma de SimulatorFootprint::total de las residentes
+    size_t hibernated_bytes = 0;  // Lo que ocupan los estados guardados
+    size_t budget_bytes = 0;
+    uint64_t hibernations = 0;
+    uint64_t resumes = 0;
+};
+
+/**
+ * @class SessionRegistry
+ * @brief Sesiones de simulación con un presupuesto de memoria global.
+ *
+ * Cada sesión tiene un simulador (sacado de un SimulatorPool) mientras está
+ * residente. Las que llevan más de `idle_timeout` sin usarse, y las menos
+ * usadas recientemente cuando las residentes superan el presupuesto, se
+ * hibernan: su estado se guarda con Simulator::save_state, historial de
+ * step_back incluido, y el simulador vuelve al pool. El siguiente acquire la
+ * restaura en otra instancia sin que se note.
+ *
+ * Entre acquire y release la sesión está en uso y no se hiberna, y tampoco
+ * mientras su simulador tiene una ejecución en segundo plano (run_async);
+ * el puntero devuelto solo vale hasta el release. La revisión de las sesiones ociosas
+ * se hace al crear y al liberar, como mucho una vez por segundo.
+ * Es seguro llamarlo desde varios hilos. Guardar y restaurar se hace fuera
+ * del cerrojo del registro, con la sesión marcada: solo esperan los acquire
+ * de esa misma sesión.
+ */
+class SIMULATOR_API SessionRegistry {
+public:
+    explicit SessionRegistry(SimulatorPool& pool, size_t budget_bytes = SESSION_MEMORY_BUDGET_BYTES,
+                             std::chrono::seconds idle_timeout = std::chrono::seconds(SESSION_IDLE_SECONDS));
+
+    // Crea la sesión `id` con un simulador recién configurado. Devuelve false
+    // si ya existe. El id forma parte del nombre del log: solo se admiten
+    // [A-Za-z0-9_-]{1,64} (std::invalid_argument si no).
+    bool create(const std::string& id, PipelineModel model, size_t mem_size);
+    // Crea la sesión `id` como bifurcación de `parent_id` (Simulator::fork_to):
+    // sigue desde el mismo punto y después va por su cuenta. Devuelve false
+    // si `id` ya existe o `parent_id` no. El id se valida como en create.
+    bool fork(const std::string& id, const std::string& parent_id);
+    // Simulador de la sesión (restaurado si estaba hibernada), o nullptr si
+    // no existe. Cada acquire necesita su release.
+    Simulator* acquire(const std::string& id);
+    void release(const std::string& id);
+    // Termina la sesión; su simulador vuelve al pool. No se puede terminar
+    // una sesión en uso (devuelve false).
+    bool remove(const std::string& id);
+
+    // Hiberna la sesión ya, si no está en uso.
+    bool hibernate(const std::string& id);
+    // Hiberna las sesiones ociosas y, si hace falta, las menos usadas hasta
+    // volver al presupuesto. Devuelve cuántas ha hibernado.
+    size_t collect();
+
+    void set_budget(size_t bytes);
+    void set_idle_timeout(std::chrono::seconds timeout);
+    // Cada sesión escribe su log en `directory`/simulator-<id>.log (vacío = sin log).
+    void set_log_directory(const std::string& directory);
+
+    SessionStats get_stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Session {
+        std::unique_ptr<Simulator> sim; // nullptr mientras está hibernada
+        std::vector<uint8_t> saved;     // Estado guardado de la hibernación
+        unsigned users = 0;
+        bool switching = false;         // Hibernándose o restaurándose
+        Clock::time_point last_use;
+        size_t footprint = 0;           // Al último release
+    };
+
+    std::string log_path(const std::string& id) const;
+    // Marca la sesión para hibernarla si se puede; hibernate_marked la guarda
+    // después, ya sin el cerrojo, y devuelve cuántas ha hibernado.
+    bool mark_for_hibernation(Session& session);
+    size_t hibernate_marked(const std::vector<Session*>& marked);
+    std::vector<Session*> collect_locked(bool scan_idle);
+    // Devuelve el simulador al pool, con el log cerrado.
+    void return_to_pool(std::unique_ptr<Simulator> sim);
+
+    SimulatorPool& pool;
+    mutable std::mutex mutex;
+    std::condition_variable switched; // Una sesión deja de estar marcada
+    std::unordered_map<std::string, Session> sessions;
+    size_t budget_bytes;
+    std::chrono::seconds idle_timeout;
+    std::string log_directory;
+    size_t resident_bytes = 0;
+    Clock::time_point last_scan;
+    uint64_t hibernations = 0;
+    uint64_t resumes = 0;
+};
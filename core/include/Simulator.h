@@ -1,12 +1,17 @@
+#pragma once
 #include "Config.h"
 #include "Memory.h"
 #include "RegisterFile.h"
 #include "Cache.h"
+#include "Dram.h"
+#include "Mmu.h"
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <string>
 #include <fstream>
+#include <functional>
 #include <vector>
 #include "Mux.h"
 #include "Adder.h"
@@ -16,24 +21,98 @@
 #include "CoreTypes.h"
 #include "CoreExport.h"
 #include "Assembler.h"
+#include "UndoLog.h"
+#include "Datapath.h"
+#include "StateJson.h"
+#include <deque>
+#include <set>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// Estado de temporización del modelo segmentado con cachés.
+// Solo afecta a cuándo avanza cada instrucción, nunca a los resultados.
+struct PipelineTiming {
+    uint64_t reg_ready_at[32] = {}; // Marcador: ciclo a partir del cual cada registro tiene su dato
+    uint32_t freeze = 0;            // Ciclos que la segmentación completa queda congelada
+    bool fetch_pending = false;     // Instrucción leída que espera a que termine su fallo
+    uint8_t padding[3] = {};        // Relleno explícito a ceros: el historial compara bytes
+    uint32_t pending_instruction = 0;
+    uint32_t padding_clock = 0;
+    uint64_t cache_clock = 0;
+};
+
+// Ciclos perdidos por la jerarquía de memoria en el modelo segmentado.
+struct PipelineMemoryStats {
+    uint64_t icache_stall_cycles = 0;     // Congelación por fallos de instrucciones
+    uint64_t store_stall_cycles = 0;      // Congelación por escrituras (write-through)
+    uint64_t load_stall_cycles = 0;       // Congelación por fallos de carga con caché bloqueante
+    uint64_t mshr_stall_cycles = 0;       // Congelación estructural: no quedan MSHR libres
+    uint64_t scoreboard_stall_cycles = 0; // Burbujas en ID esperando una carga pendiente
+};
+
+// Memoria que ocupa una instancia (para SessionRegistry), en bytes.
+struct SimulatorFootprint {
+    size_t memory_bytes = 0;  // Páginas propias de las memorias y de las copias completas
+    size_t history_bytes = 0; // Deltas de step_back y copias completas sin sus páginas
+    size_t cache_bytes = 0;   // Líneas de las cachés y de las de víctimas
+    size_t total() const { return memory_bytes + history_bytes + cache_bytes; }
+};
+
+// Avance de una ejecución en segundo plano (Simulator::run_async). La API
+// de C la devuelve tal cual.
+struct RunProgress {
+    bool running = false;   // Sigue en marcha
+    bool cancelled = false; // Se pidió parar con cancel_run
+    bool failed = false;    // Paró por una excepción (p.ej. un acceso fuera de rango)
+    int32_t steps = 0;      // Pasos dados hasta ahora
+    uint32_t pc = 0;        // PC tras el último paso
+};
+
+// CSR de máquina que implementa el simulador (solo accesibles desde la API).
+enum CsrNumber : uint32_t {
+    CSR_SATP = 0x180,
+    CSR_MTVEC = 0x305,
+    CSR_MEPC = 0x341,
+    CSR_MCAUSE = 0x342,
+    CSR_MTVAL = 0x343
+};
+
+// Registros de la trampa de excepciones.
+struct TrapCsrs {
+    uint32_t mtvec = 0;  // Dirección del manejador
+    uint32_t mepc = 0;   // PC de la instrucción que falló
+    uint32_t mcause = 0;
+    uint32_t mtval = 0;  // Dirección virtual que provocó el fallo
+};
 
 // Estructura para guardar una "instantánea" del estado del simulador.
+// El historial guarda una cada HISTORY_CHECKPOINT_INTERVAL pasos; entre
+// ellas solo guarda lo que cambia en cada paso (ver UndoLog.h).
 struct StateSnapshot {
     uint32_t pc;
     RegisterFile register_file; // Copia completa del banco de registros
-    DatapathState datapath;     // Copia completa del estado del datapath
+    PackedDatapath datapath;    // Copia completa del estado del datapath
     uint32_t current_cycle;
     std::string instructionString;
     Memory d_mem;               // Copia de la memoria de datos
+    PipelineTiming timing;
+    TrapCsrs csrs;
+    // Copia de la memoria principal en modo General (tamaño 0 si no se guarda).
+    // Las copias de Memory comparten las páginas que no cambian, así que
+    // guardarla solo cuesta las páginas que se escriben después.
+    Memory main_mem;
 
     // Constructor explícito para inicializar todos los miembros.
     // Necesario porque Memory no tiene un constructor por defecto.
-    StateSnapshot(uint32_t p, const RegisterFile& rf, const DatapathState& dp, uint32_t cc, const std::string& is, const Memory& dm)
-        : pc(p), register_file(rf), datapath(dp), current_cycle(cc), instructionString(is), d_mem(dm) {}
+    StateSnapshot(uint32_t p, const RegisterFile& rf, const PackedDatapath& dp, uint32_t cc, const std::string& is, const Memory& dm, const PipelineTiming& t = {}, const Memory& mm = Memory(0), const TrapCsrs& cs = {})
+        : pc(p), register_file(rf), datapath(dp), current_cycle(cc), instructionString(is), d_mem(dm), timing(t), csrs(cs), main_mem(mm) {}
 
     // Constructor por defecto para que std::vector pueda manejarlo.
     // Inicializamos d_mem con un tamaño por defecto (256, como en el simulador).
-    StateSnapshot() : d_mem(DMEM_SIZE) {}
+    StateSnapshot() : d_mem(DMEM_SIZE), main_mem(0) {}
 };
 
 static const char* const GPR_NAMES[32] = {
@@ -51,7 +130,20 @@ public:
 
     // Carga un programa en la memoria.
     void load_program(const std::vector<uint8_t>& program, PipelineModel model = PipelineModel::SingleCycle );
+    void load_program(const uint8_t* program, size_t size, PipelineModel model = PipelineModel::SingleCycle);
     void load_program(const char* assembly_code, PipelineModel model = PipelineModel::SingleCycle);
+    // Carga un ELF32 RISC-V o un binario plano proyectándolo con mmap y
+    // devuelve la dirección de entrada (con la que se debe llamar a reset).
+    // En modo General las páginas completas del fichero no se copian. Los
+    // modelos didácticos solo admiten binarios planos, que se copian en i_mem.
+    uint32_t load_file(const std::string& path, PipelineModel model = PipelineModel::General);
+    // Respalda una región de la memoria principal con un fichero proyectado
+    // con MAP_SHARED (ver Memory::map_file). Se llama después de cargar el
+    // programa: la carga de una imagen borra la memoria y la proyección.
+    void map_file(const std::string& path, uint32_t base_address, size_t size = 0);
+    // Vuelca a memoria las escrituras que siguen en la caché de datos y lleva
+    // a disco lo escrito en los ficheros proyectados.
+    void sync_mapped_files();
     std::vector<uint8_t> assemble(const char* assembly_code);
 
     // Ejecuta un solo ciclo de instrucción.
@@ -59,35 +151,205 @@ public:
 
     // Configura las opciones de gestión de riesgos.
     void set_hazard_options(bool stalls, bool flushes, bool forwarding);
+    // Deja la instancia como recién construida con (mem_size, model) y los
+    // riesgos indicados, pero reaprovechando lo ya reservado: memoria,
+    // cachés, historial, ensamblador y log. Es lo que usa SimulatorPool.
+    // No vale para un hart de un MultiHart.
+    void reconfigure(PipelineModel model, size_t mem_size, bool hazards);
 
-    // Retrocede un ciclo en la simulación.
+    // Retrocede un ciclo en la simulación. Los pasos deshechos se conservan:
+    // el siguiente step() los rehace sin volver a ejecutarlos.
     void step_back();
+    // Lleva la simulación al ciclo `cycle`: restaura la copia completa más
+    // cercana y aplica los pasos guardados hasta llegar. Si el ciclo está más
+    // allá de lo grabado, ejecuta los pasos que faltan. No se puede ir antes
+    // del paso más antiguo que se conserva. Ni el contenido ni las
+    // estadísticas de las cachés forman parte del historial.
+    void seek(uint32_t cycle);
+    // El historial descarta los pasos más antiguos cuando ocupa más de
+    // `bytes` (por defecto HISTORY_BUDGET_BYTES).
+    void set_history_budget(size_t bytes);
+    // Pasos que se pueden deshacer y bytes que ocupan (con las copias completas).
+    size_t get_history_depth() const { return history.depth(); }
+    size_t get_history_bytes() const { return history.bytes() + checkpoint_bytes; }
+    // Ciclos a los que se puede ir con seek sin ejecutar.
+    uint32_t get_history_first_cycle() const { return cycle_at(history.oldest()); }
+    uint32_t get_history_last_cycle() const { return cycle_at(history.newest()); }
 
     // Ejecuta la simulación hasta que se cumpla una condición (breakpoint, bucle, etc.).
-    int stepsUntil(const std::vector<uint32_t>& breakpoints);
+    // Si se da `on_step`, se llama después de cada paso con los pasos dados;
+    // si devuelve false la ejecución se para ahí.
+    int stepsUntil(const std::vector<uint32_t>& breakpoints, const std::function<bool(int steps)>& on_step = {});
 
     void reset(PipelineModel model = PipelineModel::SingleCycle, uint32_t _initial_pc=0);
+
+    // --- Concurrencia ---
+    // El simulador no se protege a sí mismo: quien lo comparte entre hilos
+    // toma este cerrojo, exclusivo para cambiarlo y compartido para las
+    // consultas const (la API de C lo hace en cada llamada). Instancias
+    // distintas no comparten estado y pueden usarse a la vez.
+    std::shared_mutex& get_mutex() const { return state_mutex; }
+    // Escribe el log en `path` (vacío = sin log). Por defecto no hay log.
+    // Con `append` se sigue el fichero en lugar de empezarlo de nuevo.
+    void set_log_file(const std::string& path, bool append = false);
+
+    // --- Ejecución en segundo plano ---
+    // run_async lanza stepsUntil en un hilo propio del simulador, que tiene
+    // el cerrojo exclusivo mientras dura, y vuelve enseguida. Devuelve false
+    // si ya hay una en marcha. poll_run no toma el cerrojo, así que se puede
+    // consultar mientras corre; cancel_run la para al terminar el paso en
+    // curso. Si un paso lanza, la ejecución termina con `failed` y el error
+    // va al log. El destructor cancela y espera la que quede.
+    bool run_async(std::vector<uint32_t> breakpoints);
+    RunProgress poll_run() const;
+    void cancel_run();
+    void wait_run();
+    bool run_in_progress() const { return run_active.load(); }
+    ~Simulator();
+
+    // --- Estado guardado (formato de StateSave.h) ---
+    // save_state deja en `out` lo necesario para seguir la simulación en otra
+    // instancia con load_state, que lo restaura sobre esta (reconfigurándola):
+    // registros, memorias, datapath, cachés con su contenido, TLB, DRAM y
+    // contadores. El historial de step_back solo con STATE_SAVE_HISTORY.
+    // No admite memoria compartida entre harts ni ficheros proyectados con
+    // map_file (lanza std::runtime_error). load_state comprueba el estado
+    // entero antes de tocar esta instancia: si no es válido, lanza y la deja
+    // como estaba.
+    void save_state(std::vector<uint8_t>& out, uint32_t flags = 0) const;
+    void load_state(const uint8_t* data, size_t size);
+    // Deja `child` en este mismo punto (historial incluido) para que siga por
+    // su cuenta, p.ej. con otras opciones de riesgos. Las memorias quedan
+    // compartidas en copia en escritura, así que el coste no depende de su
+    // tamaño. Las mismas restricciones que save_state.
+    void fork_to(Simulator& child) const;
+    PipelineModel get_model() const { return model; }
+    SimulatorFootprint get_footprint() const;
     
     // Devuelve el estado actual para la API.
     uint32_t get_pc() const;
     uint32_t get_status_register() const;
     DatapathState get_datapath_state() const;
     std::string get_instruction_string() const;
+    // Escribe el estado en binario (formato de StateBinary.h) y devuelve los
+    // bytes que ocupa. Si no caben en `capacity` no escribe nada. Con
+    // STATE_BINARY_MEMORY añade las líneas de memoria escritas desde la
+    // última petición que las incluyó.
+    size_t get_state_binary(uint8_t* buffer, size_t capacity, uint32_t flags = 0);
+    // Texto de un identificador del estado binario; para TEXT_FROM_INSTRUCTION
+    // es el desensamblado de `instruction`. Después de un reset los
+    // identificadores se reutilizan con otros textos.
+    std::string get_instruction_text(uint32_t id, uint32_t instruction) const;
+    // --- Versiones del estado (para enviar solo lo que cambia) ---
+    // Compara el estado con el de la última versión y, si algo ha cambiado,
+    // crea una versión nueva. Devuelve la versión actual (la primera es 1).
+    uint64_t sync_state_version();
+    // Campos del JSON de estado y registros (bit i = xi) que han cambiado
+    // después de la versión `version`, según el último sync_state_version.
+    StateJsonMask changed_fields_since(uint64_t version) const;
+    uint32_t changed_registers_since(uint64_t version) const;
     
     const RegisterFile& get_registers() const;
+    // Rellena `view` de una vez: pc, registros, datapath, instrucción y las
+    // ventanas de memoria de datos que pida (ver SnapshotView).
+    void get_snapshot(SnapshotView& view) const;
+    // Copia la memoria de datos tal como la ve el programa (la unificada en
+    // modo General, d_mem en los didácticos) y devuelve los bytes copiados.
+    size_t read_data_memory(uint32_t address, uint8_t* out, size_t length) const;
+
+    // --- Jerarquía de memoria (modelo General) ---
+    void add_prefetcher(CacheId cache, PrefetcherKind kind, unsigned degree, unsigned distance);
+    void clear_prefetchers(CacheId cache);
+    void set_write_buffer_entries(CacheId cache, size_t entries);
+    void set_victim_entries(CacheId cache, size_t entries);
+    const Cache& get_cache(CacheId cache) const;
+    // Ciclos de reloj consumidos en el modelo General, incluidas las esperas de memoria.
+    uint64_t get_cache_cycles() const;
+
+    // Hace que el modelo segmentado lea instrucciones y datos a través de las
+    // cachés (sobre i_mem/d_mem). La caché de datos pasa a ser no bloqueante
+    // con `mshr_entries` fallos pendientes como máximo (0 = bloqueante).
+    void set_pipeline_caches(bool enabled, size_t mshr_entries);
+    bool get_pipeline_caches() const { return pipeline_caches; }
+    const PipelineMemoryStats& get_pipeline_memory_stats() const { return pipeline_stats; }
+
+    // --- Memoria virtual Sv32 (modo General) ---
+    void configure_mmu(const MmuConfig& config);
+    const Mmu& get_mmu() const { return mmu; }
+    // Devuelven false si el CSR no existe.
+    bool write_csr(uint32_t number, uint32_t value);
+    bool read_csr(uint32_t number, uint32_t& value) const;
+    // Añade la traducción va -> pa (páginas de 4 KiB) a la tabla de páginas,
+    // creándola si hace falta. Las tablas se reservan al final de la memoria
+    // y, si la traducción no estaba activa, se activa apuntando a ellas.
+    void map_page(uint32_t va, uint32_t pa, uint32_t flags);
+
+    // --- Varios harts con memoria compartida (modo General) ---
+    // El hart pasa a trabajar sobre `shared` en lugar de su memoria propia.
+    void use_shared_memory(Memory& shared);
+    // Las escrituras de este hart en la memoria compartida aparecen también
+    // en las líneas escritas del estado binario de `peer`.
+    void share_memory_writes_with(Simulator& peer) { memory_peers.push_back(&peer); }
+    // Tras cada reset el identificador se copia en a0 (-1 = un solo núcleo).
+    void set_hart_id(int32_t id) { hart_id = id; }
+    int32_t get_hart_id() const { return hart_id; }
+    // Conecta la caché de datos a un bus de coherencia.
+    void attach_coherence_bus(CoherenceBus& bus);
+
+    // Conecta un modelo DRAM detrás de todas las memorias (una sola DRAM física).
+    void attach_dram(const DramConfig& config);
+    void detach_dram();
+    const Dram* get_dram() const { return dram.get(); }
 
     // Devuelve el contenido de la memoria de datos (para modo didáctico).
-    const std::vector<uint8_t>& get_d_mem() const;
-    std::vector<std::pair<uint32_t, std::string>> get_i_mem()  ;
+    std::vector<uint8_t> get_d_mem() const;
+    std::vector<std::pair<uint32_t, std::string>> get_i_mem() const;
 private:
-    uint32_t initial_pc; // Program Counter
+    uint32_t initial_pc=0; // Program Counter
     uint32_t pc; // Program Counter
     uint32_t pc_delay=DELAY_PC; 
     uint32_t criticalTime=0;
     uint32_t status_reg;
-    DatapathState datapath;   // Estado actual del datapath (todas las señales con valor + ready_at)
+    PackedDatapath datapath;  // Estado actual del datapath (todas las señales con valor + ready_at)
+    // Textos de instrucción del datapath, por identificador (ver text_id).
+    // El historial guarda identificadores, así que solo se vacían cuando se
+    // vacía también el historial: en reset y en reconfigure.
+    std::vector<std::string> texts{""};
+    std::unordered_map<std::string, uint32_t> text_ids{{"", 0}};
+    uint32_t text_id(const std::string& text);
+    void clear_texts();
+    std::string stage_text(const PackedDatapath& state, PipelineStage stage) const;
+    // Líneas de STATE_BINARY_DIRTY_LINE bytes escritas desde el último estado
+    // binario con memoria (el bit 32 distingue la memoria principal).
+    // `memory_resync` indica que la memoria ha cambiado por otra vía; mientras
+    // esté pendiente no se apunta nada, porque el cliente la recibirá entera
+    // (o aún no la ha pedido). Pasadas DIRTY_LINES_LIMIT líneas se pide
+    // resincronizar en lugar de seguir acumulándolas.
+    std::set<uint64_t> dirty_lines;
+    bool memory_resync = true;
+    void mark_dirty(bool main, uint32_t address, unsigned bytes);
+    void mark_dirty_lines(bool main, uint32_t address, unsigned bytes);
+    // Harts que comparten la memoria principal: también ven sus escrituras.
+    std::vector<Simulator*> memory_peers;
+    // Estado de la última versión y versión en la que cambió cada campo.
+    uint64_t state_version = 0;
+    PackedDatapath versioned_datapath;
+    uint32_t versioned_registers[32] = {};
+    uint64_t field_versions[STATE_JSON_FIELD_COUNT] = {};
+    uint64_t register_versions[32] = {};
+    void clear_state_versions();
     uint32_t current_cycle;   // Ciclo actual de simulación (tiempo absoluto tipo reloj de pared)
     std::ofstream m_logfile;  // Fichero para el log
+    mutable std::shared_mutex state_mutex;
+    // Ejecución en segundo plano (run_async). El avance se publica en
+    // atómicos para que poll_run no dependa de state_mutex.
+    std::mutex run_mutex;     // Protege run_thread
+    std::thread run_thread;
+    std::atomic<bool> run_active{false};
+    std::atomic<bool> run_cancel{false};
+    std::atomic<bool> run_failed{false};
+    std::atomic<int> run_steps{0};
+    std::atomic<uint32_t> run_pc{0};
     RegisterFile register_file;
     PipelineModel model;
 
@@ -98,12 +360,49 @@ private:
 
     // Componentes para el modo General (con cachés)
     Memory memory; // Memoria principal unificada
+    Memory* main_memory; // `memory` o la compartida entre harts
+    int32_t hart_id=-1;
     InstructionCache i_cache;
     DataCache d_cache;
+    uint64_t cache_clock=0; // Reloj de las cachés: un ciclo por instrucción más las esperas
+    Cache& cache_by_id(CacheId cache);
+    uint64_t memory_stall_cycles() const;
+
+    Mmu mmu;
+    TrapCsrs csrs;
+    bool fetch_faulted=false;
+    uint32_t next_page_table=0; // Última tabla de páginas reservada por map_page
+    bool translate(uint32_t va, AccessType type, uint32_t& pa);
+    void take_trap(uint32_t cause, uint32_t tval);
+    uint32_t alloc_page_table();
+
+    std::shared_ptr<Dram> dram;
 
-    // Componentes para el modo SingleCycle (didáctico)
-    Memory i_mem; // Memoria de instrucciones de 256 bytes
-    Memory d_mem; // Memoria de datos de 256 bytes
+    // Segmentado con cachés
+    bool pipeline_caches=false;
+    PipelineTiming timing;
+    PipelineMemoryStats pipeline_stats;
+    bool timed_pipeline() const { return model == PipelineModel::PipeLined && pipeline_caches; }
+    // Copia de `source` para el historial, con las escrituras que siguen en
+    // el buffer de la caché de datos si esta trabaja sobre `source`.
+    Memory snapshot_memory(const Memory& source) const;
+    // El historial deshace las escrituras en la memoria principal si es
+    // propia: en la de varios harts desharía también las de los demás.
+    bool undoes_main_memory() const {
+        return model == PipelineModel::General && main_memory == &memory;
+    }
+    bool pipeline_frozen();
+    bool skip_frozen_cycle();
+    uint32_t instruction_address(uint32_t address) const { return (address - initial_pc) % i_mem.size(); }
+    uint32_t data_address(uint32_t address) const { return address % d_mem.size(); }
+
+    // Memoria de instrucciones: 256 bytes en los modelos didácticos. En modo
+    // General es del tamaño de la principal y el fetch lee de ella: los
+    // programas escritos para memorias separadas (datos desde la dirección 0)
+    // no pisan su propio código al escribir datos.
+    Memory i_mem;
+    void size_instruction_memory();
+    Memory d_mem; // Memoria de datos de 256 bytes (modelos didácticos)
 
     // --- Unidades funcionales ---
     Mux2 mux_PC;
@@ -134,8 +433,61 @@ private:
     std::string instructionString ="nop";
 
     // --- Historial para rebobinado ---
-    std::vector<StateSnapshot> history;
-    size_t history_pointer;
+    // Cada paso deja un StepDelta en `history`. Los trozos de estado que
+    // cambian se detectan comparando con la copia de antes del paso y las
+    // escrituras en memoria se anotan al hacerlas (record_store). Los deltas
+    // sirven en los dos sentidos, así que seek y step rehacen pasos
+    // aplicándolos. Los pasos se cuentan desde el reset. current_cycle avanza
+    // uno por paso salvo en el segmentado con cachés, donde los ciclos
+    // congelados se suman al paso anterior (ver cycle_at).
+    enum HistoryObject : uint8_t { HISTORY_DATAPATH, HISTORY_REGISTERS, HISTORY_TIMING, HISTORY_CSRS };
+    struct Checkpoint {
+        size_t position; // Paso (desde el reset) en el que se tomó
+        StateSnapshot state;
+        size_t bytes;    // Incluye las páginas que retiene de la memoria
+        bool has_main_memory; // Se puede restaurar (sin ficheros proyectados)
+    };
+    UndoLog history;
+    std::deque<Checkpoint> checkpoints;
+    size_t checkpoint_bytes = 0;
+    size_t history_budget = HISTORY_BUDGET_BYTES;
+    // Estado de antes del paso en curso.
+    StepDelta pending_step;
+    PackedDatapath datapath_before;
+    RegisterFile registers_before;
+    PipelineTiming timing_before;
+    TrapCsrs csrs_before;
+    // Páginas escritas desde la última copia completa: cada una es una página
+    // que esa copia retiene. El bit 32 distingue la memoria principal.
+    std::unordered_set<uint64_t> pages_since_checkpoint;
+
+    void execute_step();
+    void begin_step_record();
+    void end_step_record();
+    // Anota lo que va a sobrescribir una escritura de `bytes` bytes en `address`
+    // de `target`. Con `through_cache`, el valor de antes incluye el buffer de
+    // escritura de la caché de datos.
+    void record_store(Memory& target, uint32_t address, unsigned bytes, bool through_cache);
+    // Engancha las cachés a la memoria que les toca según el modelo.
+    void bind_cache_memories();
+    // load_state sin la instancia intermedia: si el estado no es válido
+    // lanza a medio restaurar.
+    void restore_state(const uint8_t* data, size_t size);
+    uint32_t read_stored(const Memory& target, uint32_t address, unsigned bytes, bool through_cache) const;
+    void clear_history();
+    void trim_history();
+    // Descarta los pasos por rehacer (y sus copias completas): después de
+    // cambiar el estado a mano ya no son el futuro de la simulación.
+    void discard_future();
+    // Aplica un delta hacia delante o hacia atrás.
+    void apply_delta(const StepDelta& delta, bool forward);
+    void restore_checkpoint(const Checkpoint& checkpoint);
+    // Ciclo en la posición `position` del historial. No es un ciclo por
+    // paso: los ciclos congelados del segmentado van dentro del paso anterior.
+    uint32_t cycle_at(size_t position) const {
+        if (position == history.position()) return current_cycle;
+        return position < history.newest() ? history.at(position).cycle_before : history.at(position - 1).cycle_after;
+    }
 
     // --- Tabla de decodificación ---
     // La estructura y la tabla se mueven dentro de la clase para que tengan
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Config.h"
+#include "CoreExport.h"
+#include "Simulator.h"
+
+/**
+ * @class SimulatorPool
+ * @brief Instancias de Simulator ya construidas, listas para una sesión.
+ *
+ * Construir un simulador abre el log, reserva memorias y cachés y prepara el
+ * ensamblador. El pool guarda las instancias que se devuelven y, al pedir
+ * una, la reconfigura (Simulator::reconfigure) en lugar de crear otra. Con
+ * prewarm se construyen por adelantado, p.ej. al arrancar el servidor.
+ * Es seguro llamarlo desde varios hilos.
+ */
+class SIMULATOR_API SimulatorPool {
+public:
+    explicit SimulatorPool(size_t capacity = SIMULATOR_POOL_CAPACITY);
+
+    // Construye instancias hasta tener `count` libres (sin pasar de la capacidad).
+    void prewarm(size_t count, size_t mem_size, PipelineModel model);
+
+    // Una instancia libre reconfigurada, o una nueva si no queda ninguna.
+    // Quien la recibe es su dueño hasta que la devuelve con release.
+    Simulator* acquire(size_t mem_size, PipelineModel model, bool hazards = true);
+
+    // Devuelve una instancia al pool; si ya está lleno, se destruye.
+    void release(Simulator* sim);
+
+    size_t idle() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Simulator>> free_list;
+    size_t capacity;
+};
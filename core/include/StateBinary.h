@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "CoreExport.h"
+
+// --- Estado en binario (Simulator_get_state_binary) ---
+// Formato fijo, little-endian y con versión, pensado para leerse sin
+// analizar nada (struct.unpack_from, numpy.frombuffer, ByteData en Dart).
+// Todos los campos son de 32 bits salvo los indicados.
+//
+//   0   magic 'RVSB'
+//   4   versión (16 bits) y tamaño de la cabecera (16 bits)
+//   8   tamaño total en bytes
+//   12  flags (STATE_BINARY_*)
+//   16  número de señales del datapath (n)
+//   20  desplazamiento de los valores de las señales (n x 32 bits)
+//   24  desplazamiento de los ready_at (n x 32 bits)
+//   28  desplazamiento de los is_active (n x 8 bits, rellenado a 4 bytes)
+//   32  desplazamiento de la sección de memoria (0 si no hay)
+//   36  reservado (ceros) hasta STATE_BINARY_HEADER_SIZE
+//
+// Después de la cabecera, el bloque fijo con los desplazamientos de
+// STATE_BINARY_OFFSET_*: pc, registro de estado, ciclo, modelo, los 32
+// registros, criticalTime, totalMicroCycles, las instrucciones de las cinco
+// etapas y los identificadores de texto de la instrucción y de las etapas
+// (ver Simulator_get_instruction_text). Las señales siguen el orden de
+// DatapathSignal; sus nombres y anchos están en el esquema.
+//
+// Sección de memoria: número de rangos, un campo reservado y, por rango,
+// memoria (0 = datos del modo didáctico, 1 = principal), dirección, longitud
+// en bytes (múltiplo de 4) y los bytes.
+
+constexpr uint32_t STATE_BINARY_MAGIC = 0x42535652; // "RVSB"
+constexpr uint16_t STATE_BINARY_VERSION = 1;
+constexpr uint32_t STATE_BINARY_HEADER_SIZE = 64;
+
+constexpr uint32_t STATE_BINARY_OFFSET_PC = 64;
+constexpr uint32_t STATE_BINARY_OFFSET_STATUS = 68;
+constexpr uint32_t STATE_BINARY_OFFSET_CYCLE = 72;
+constexpr uint32_t STATE_BINARY_OFFSET_MODEL = 76;
+constexpr uint32_t STATE_BINARY_OFFSET_REGISTERS = 80;
+constexpr uint32_t STATE_BINARY_OFFSET_CRITICAL_TIME = 208;
+constexpr uint32_t STATE_BINARY_OFFSET_MICRO_CYCLES = 212;
+constexpr uint32_t STATE_BINARY_OFFSET_STAGE_INSTRUCTIONS = 216;
+constexpr uint32_t STATE_BINARY_OFFSET_INSTRUCTION_TEXT = 236;
+constexpr uint32_t STATE_BINARY_OFFSET_STAGE_TEXTS = 240;
+constexpr uint32_t STATE_BINARY_OFFSET_SIGNALS = 260;
+
+// Flags de la petición y de la cabecera.
+constexpr uint32_t STATE_BINARY_MEMORY = 1u << 0;        // Incluir los rangos de memoria escritos
+// Solo en la cabecera: la memoria ha cambiado entera (reset, carga,
+// rebobinado...) y los rangos no bastan para ponerse al día.
+constexpr uint32_t STATE_BINARY_MEMORY_RESYNC = 1u << 1;
+
+// Granularidad de los rangos de memoria escritos.
+constexpr uint32_t STATE_BINARY_DIRTY_LINE = 64;
+
+// Descripción del formato en JSON: versión, desplazamientos de los campos
+// fijos y nombre y ancho de cada señal.
+SIMULATOR_API const std::string& state_binary_schema();
@@ -0,0 +1,26 @@
+#pragma once
+#include <bitset>
+#include <string>
+#include "CoreExport.h"
+#include "CoreTypes.h"
+#include "Datapath.h"
+
+// Campos del JSON de estado. Los primeros son las señales, con el número de
+// DatapathSignal; detrás van los que no son señales.
+enum StateJsonField : uint8_t {
+    JSON_CRITICAL_TIME = DATAPATH_SIGNAL_COUNT,
+    JSON_MICRO_CYCLES,
+    JSON_INSTRUCTION_TEXT,
+    JSON_STAGE_TEXT,                                  // Pipe_*_instruction_cptr, uno por etapa
+    JSON_STAGE_INSTRUCTION = JSON_STAGE_TEXT + STAGE_COUNT, // Pipe_*_instruction, uno por etapa
+    STATE_JSON_FIELD_COUNT = JSON_STAGE_INSTRUCTION + STAGE_COUNT
+};
+using StateJsonMask = std::bitset<STATE_JSON_FIELD_COUNT>;
+
+// Añade a `out` el JSON del estado del datapath (el de Simulator_get_state_json)
+// sin construir un árbol intermedio: los campos se escriben en orden
+// alfabético, como los ordenaba nlohmann::json, a partir de una tabla con
+// los fragmentos de texto ya preparados. Si `out` conserva su capacidad
+// entre llamadas no se reserva memoria. Con `fields` solo se escriben los
+// campos marcados.
+SIMULATOR_API void append_state_json(const DatapathState& state, std::string& out, const StateJsonMask* fields = nullptr);
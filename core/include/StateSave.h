@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// --- Estado guardado (Simulator::save_state / load_state) ---
+// Todo lo necesario para seguir la simulación en otra instancia, en binario
+// little-endian y con versión. Cabecera:
+//
+//   0   magic 'RVSS'
+//   4   versión
+//   8   tamaño total en bytes
+//   12  número de secciones
+//
+// Después, las secciones: tipo (32 bits), longitud del contenido (32 bits) y
+// el contenido. Quien lee salta las secciones que no conoce, así que añadir
+// una no cambia la versión; cambiar el contenido de una existente, sí.
+// Las memorias solo guardan las páginas con datos.
+//
+// La sección del historial (con STATE_SAVE_HISTORY) guarda los trozos de
+// estado de UndoLog tal cual están en memoria: solo la carga un simulador
+// compilado igual, que lo comprueba con los tamaños de las estructuras. Si
+// no coinciden, el estado se carga sin historial.
+
+constexpr uint32_t STATE_SAVE_MAGIC = 0x53535652; // "RVSS" en little-endian
+constexpr uint32_t STATE_SAVE_VERSION = 2; // 2: en modo General i_mem mide como la principal
+constexpr uint32_t STATE_SAVE_HEADER_SIZE = 16;
+
+enum StateSaveSection : uint32_t {
+    STATE_SECTION_CONFIG = 1,   // Modelo, tamaño de memoria, riesgos, MMU, DRAM, cachés
+    STATE_SECTION_CORE = 2,     // pc, ciclo, registros, CSR, instrucción
+    STATE_SECTION_DATAPATH = 3, // Señales del datapath (PackedDatapath)
+    STATE_SECTION_TEXTS = 4,    // Textos de instrucción por identificador
+    STATE_SECTION_TIMING = 5,   // Segmentado con cachés (PipelineTiming y contadores)
+    STATE_SECTION_MEMORY = 6,   // Una por memoria: identificador, tamaño y páginas
+    STATE_SECTION_CACHE = 7,    // Una por caché: identificador (CacheId) y Cache::save_state
+    STATE_SECTION_MMU = 8,      // TLB y contadores
+    STATE_SECTION_DRAM = 9,     // Bancos, colas y contadores (si hay DRAM)
+    STATE_SECTION_HISTORY = 10, // Pasos y copias completas de step_back
+};
+
+// Memoria de una sección STATE_SECTION_MEMORY.
+enum StateSaveMemory : uint32_t {
+    STATE_MEMORY_MAIN = 0,
+    STATE_MEMORY_INSTRUCTIONS = 1, // i_mem de los modelos didácticos
+    STATE_MEMORY_DATA = 2,         // d_mem de los modelos didácticos
+};
+
+// Flags de Simulator::save_state.
+constexpr uint32_t STATE_SAVE_HISTORY = 1;        // Incluye el historial de step_back
+constexpr uint32_t STATE_SAVE_WITHOUT_MEMORY = 2; // Sin las memorias (Simulator::fork las comparte)
+
+// Escritura little-endian sobre un vector que crece.
+class StateWriter {
+public:
+    explicit StateWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void u8(uint8_t value) { out.push_back(value); }
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+    void bytes(const uint8_t* data, size_t count) { out.insert(out.end(), data, data + count); }
+    void text(const std::string& value) {
+        u32(static_cast<uint32_t>(value.size()));
+        bytes(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    // Abre una sección; end_section escribe su longitud al cerrarla.
+    size_t begin_section(uint32_t type) {
+        u32(type);
+        u32(0);
+        ++sections;
+        return out.size();
+    }
+    void end_section(size_t start) { patch(start - 4, static_cast<uint32_t>(out.size() - start)); }
+
+    void patch(size_t offset, uint32_t value) {
+        for (int i = 0; i < 4; ++i) out[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    uint32_t section_count() const { return sections; }
+
+private:
+    std::vector<uint8_t>& out;
+    uint32_t sections = 0;
+};
+
+// Lectura con comprobación de límites: un estado truncado lanza en lugar
+// de leer fuera del buffer. Quien lee comprueba además que los valores
+// tengan sentido (identificadores, tamaños, enumerados): el estado puede
+// venir de fuera y estar manipulado.
+class StateReader {
+public:
+    StateReader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    uint8_t u8() { need(1); return *p++; }
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(p[i]) << (8 * i);
+        p += 4;
+        return value;
+    }
+    uint64_t u64() {
+        const uint64_t low = u32();
+        return low | (static_cast<uint64_t>(u32()) << 32);
+    }
+    const uint8_t* bytes(size_t count) {
+        need(count);
+        const uint8_t* start = p;
+        p += count;
+        return start;
+    }
+    std::string text() {
+        const uint32_t length = u32();
+        return std::string(reinterpret_cast<const char*>(bytes(length)), length);
+    }
+    // Número de elementos que siguen, de al menos `item_size` bytes cada
+    // uno: si no caben en lo que queda se lanza antes de reservar nada.
+    uint32_t count(size_t item_size) {
+        const uint32_t value = u32();
+        if (value > remaining() / item_size) throw std::runtime_error("Estado guardado truncado");
+        return value;
+    }
+    size_t remaining() const { return static_cast<size_t>(end - p); }
+
+private:
+    void need(size_t count) const {
+        if (remaining() < count) throw std::runtime_error("Estado guardado truncado");
+    }
+    const uint8_t* p;
+    const uint8_t* end;
+};
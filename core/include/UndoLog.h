@@ -0,0 +1,125 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CoreExport.h"
+
+class StateWriter;
+class StateReader;
+
+// Cambio de un trozo (hasta 8 bytes) de una estructura POD del simulador: el
+// datapath, el banco de registros, los tiempos, los CSR... Se guarda el XOR
+// del valor de antes y el de después, así que el mismo trozo sirve para
+// deshacer el paso y para rehacerlo.
+struct ChunkChange {
+    uint32_t offset;
+    uint8_t object; // Qué estructura (la numeración la decide el Simulator)
+    uint8_t size;
+    uint64_t bits;  // antes ^ después
+};
+
+// Escritura de 1, 2 o 4 bytes en memoria. Se guardan los dos valores (y no
+// su XOR) porque una escritura anotada puede no llegar a hacerse si falla:
+// volver a escribir el valor de antes o el de después siempre es correcto.
+struct MemoryWrite {
+    uint32_t address;
+    uint32_t old_value;
+    uint32_t new_value;   // Se lee al terminar el paso
+    uint8_t bytes;
+    bool main_memory;     // Memoria principal (modo General) o memoria de datos didáctica
+    bool through_cache;   // El valor incluye el buffer de escritura de la caché de datos
+};
+
+// Lo necesario para deshacer o rehacer un paso: el pc y el ciclo de antes y
+// de después, los trozos de estado que cambiaron y sus escrituras en memoria.
+struct StepDelta {
+    uint32_t pc_before = 0;
+    uint32_t pc_after = 0;
+    uint32_t cycle_before = 0;
+    uint32_t cycle_after = 0;
+    bool instruction_changed = false;
+    std::string instruction_before; // Solo si cambió
+    std::string instruction_after;
+    std::vector<ChunkChange> chunks;
+    std::vector<MemoryWrite> writes;
+
+    // Bytes que ocupa (para el presupuesto del historial).
+    size_t cost() const;
+};
+
+// Añade a `out` los trozos de `after` que difieren de `before`.
+SIMULATOR_API void diff_chunks(const void* before, const void* after, size_t size, uint8_t object, std::vector<ChunkChange>& out);
+// Aplica a `target` (el objeto `object`) los trozos de `chunks`: si estaba
+// como antes del paso queda como después, y al revés.
+SIMULATOR_API void apply_chunks(void* target, uint8_t object, const std::vector<ChunkChange>& chunks);
+
+/**
+ * @class UndoLog
+ * @brief Historial de pasos: un StepDelta por paso y un cursor.
+ *
+ * Los pasos se numeran desde el reset; la posición p es el estado después
+ * de p pasos. Los deltas anteriores al cursor se pueden deshacer y los
+ * posteriores (los que se deshicieron) rehacer sin volver a ejecutarlos.
+ * `oldest()` sube cuando se descartan los más antiguos para no pasar del
+ * presupuesto.
+ *
+ * Los deltas no cambian una vez guardados, así que las copias del historial
+ * (p.ej. la de un fork) los comparten en lugar de duplicarlos. La excepción
+ * es el último, que extend_newest amplía: si está compartido, se duplica
+ * antes de tocarlo.
+ */
+class SIMULATOR_API UndoLog {
+public:
+    UndoLog() = default;
+    UndoLog(const UndoLog& other);
+    UndoLog& operator=(const UndoLog& other);
+
+    void clear();
+    // Añade el paso recién ejecutado en la posición actual. Los pasos por
+    // rehacer ya no valen y se descartan.
+    void push(StepDelta&& delta);
+    // Mueven el cursor y devuelven el delta que hay que aplicar. El llamador
+    // comprueba antes can_undo()/can_redo().
+    const StepDelta& undo();
+    const StepDelta& redo();
+    bool can_undo() const { return cursor > 0; }
+    bool can_redo() const { return cursor < deltas.size(); }
+    // Delta que lleva de la posición `position` a la siguiente.
+    const StepDelta& at(size_t position) const { return *deltas[position - base]; }
+    // Coloca el cursor en `position` (el llamador ya ha aplicado los deltas).
+    void move_to(size_t position) { cursor = position - base; }
+
+    // Suma al último paso (el cursor tiene que estar al final) unos ciclos
+    // que solo cambiaron `chunks` y dejaron el ciclo en `cycle_after`.
+    void extend_newest(const std::vector<ChunkChange>& chunks, uint32_t cycle_after);
+
+    // Descartan el paso más antiguo o los pasos por rehacer.
+    void evict_oldest();
+    void discard_future();
+
+    size_t depth() const { return cursor; }
+    size_t oldest() const { return base; }
+    size_t position() const { return base + cursor; }
+    size_t newest() const { return base + deltas.size(); }
+    size_t bytes() const { return total_bytes; }
+
+    // Los trozos son desplazamientos dentro de las estructuras del simulador:
+    // solo valen para un simulador compilado igual. load_state rechaza los
+    // que se salen de `object_sizes` (tamaño de cada estructura, por número).
+    void save_state(StateWriter& out) const;
+    void load_state(StateReader& in, const uint32_t* object_sizes, size_t object_count);
+
+private:
+    std::deque<std::shared_ptr<StepDelta>> deltas;
+    size_t base = 0;
+    size_t cursor = 0;
+    size_t total_bytes = 0;
+    // Los deltas de las posiciones anteriores a esta pueden estar también en
+    // otra copia del historial. Se fija en las dos al copiar (la original
+    // puede ser const y estar copiándose desde otro hilo, de ahí el atómico).
+    mutable std::atomic<size_t> shared_end{0};
+};
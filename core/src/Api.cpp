@@ -1,4 +1,12 @@
 #include "Simulator.h"
+#include "MultiHart.h"
+#include "SimulatorPool.h"
+#include "SessionRegistry.h"
+#include "StateBinary.h"
+#include "StateJson.h"
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 // Incluimos el macro de exportación para que las funciones sean visibles en la DLL.
 #include "CoreExport.h"
@@ -17,125 +25,89 @@ struct InstructionEntry {
 
     const char *jsonFromState(DatapathState &state)
     {
+        // El buffer conserva su capacidad entre llamadas (ver StateJson.h).
         thread_local static std::string json_str;
-        json j = {
-            {"PC", {{"value", state.bus_PC.value}, {"ready_at", state.bus_PC.ready_at}, {"is_active", state.bus_PC.is_active}}},
-            {"Instr", {{"value", state.bus_Instr.value}, {"ready_at", state.bus_Instr.ready_at}, {"is_active", state.bus_Instr.is_active}}},
-            {"opcode", {{"value", state.bus_opcode.value}, {"ready_at", state.bus_opcode.ready_at}, {"is_active", state.bus_opcode.is_active}}},
-            {"funct3", {{"value", state.bus_funct3.value}, {"ready_at", state.bus_funct3.ready_at}, {"is_active", state.bus_funct3.is_active}}},
-            {"funct7", {{"value", state.bus_funct7.value}, {"ready_at", state.bus_funct7.ready_at}, {"is_active", state.bus_funct7.is_active}}},
-            {"DA", {{"value", state.bus_DA.value}, {"ready_at", state.bus_DA.ready_at}, {"is_active", state.bus_DA.is_active}}},
-            {"DB", {{"value", state.bus_DB.value}, {"ready_at", state.bus_DB.ready_at}, {"is_active", state.bus_DB.is_active}}},
-            {"DC", {{"value", state.bus_DC.value}, {"ready_at", state.bus_DC.ready_at}, {"is_active", state.bus_DC.is_active}}},
-            {"A", {{"value", state.bus_A.value}, {"ready_at", state.bus_A.ready_at}, {"is_active", state.bus_A.is_active}}},
-            {"B", {{"value", state.bus_B.value}, {"ready_at", state.bus_B.ready_at}, {"is_active", state.bus_B.is_active}}},
-            {"imm", {{"value", state.bus_imm.value}, {"ready_at", state.bus_imm.ready_at}, {"is_active", state.bus_imm.is_active}}},
-            {"immExt", {{"value", state.bus_immExt.value}, {"ready_at", state.bus_immExt.ready_at}, {"is_active", state.bus_immExt.is_active}}},
-            {"ALU_A", {{"value", state.bus_ALU_A.value}, {"ready_at", state.bus_ALU_A.ready_at}, {"is_active", state.bus_ALU_A.is_active}}},
-            {"ALU_B", {{"value", state.bus_ALU_B.value}, {"ready_at", state.bus_ALU_B.ready_at}, {"is_active", state.bus_ALU_B.is_active}}},
-            {"ALU_result", {{"value", state.bus_ALU_result.value}, {"ready_at", state.bus_ALU_result.ready_at}, {"is_active", state.bus_ALU_result.is_active}}},
-            {"ALU_zero", {{"value", state.bus_ALU_zero.value}, {"ready_at", state.bus_ALU_zero.ready_at}, {"is_active", state.bus_ALU_zero.is_active}}},
-            {"Control", {{"value", state.bus_Control.value}, {"ready_at", state.bus_Control.ready_at}, {"is_active", state.bus_Control.is_active}}},
-            {"PCsrc", {{"value", state.bus_PCsrc.value}, {"ready_at", state.bus_PCsrc.ready_at}, {"is_active", state.bus_PCsrc.is_active}}},
-            {"ALUsrc", {{"value", state.bus_ALUsrc.value}, {"ready_at", state.bus_ALUsrc.ready_at}, {"is_active", state.bus_ALUsrc.is_active}}},
-            {"ResSrc", {{"value", state.bus_ResSrc.value}, {"ready_at", state.bus_ResSrc.ready_at}, {"is_active", state.bus_ResSrc.is_active}}},
-            {"ImmSrc", {{"value", state.bus_ImmSrc.value}, {"ready_at", state.bus_ImmSrc.ready_at}, {"is_active", state.bus_ImmSrc.is_active}}},
-            {"ALUctr", {{"value", state.bus_ALUctr.value}, {"ready_at", state.bus_ALUctr.ready_at}, {"is_active", state.bus_ALUctr.is_active}}},
-            {"BRwr", {{"value", state.bus_BRwr.value}, {"ready_at", state.bus_BRwr.ready_at}, {"is_active", state.bus_BRwr.is_active}}},
-            {"MemWr", {{"value", state.bus_MemWr.value}, {"ready_at", state.bus_MemWr.ready_at}, {"is_active", state.bus_MemWr.is_active}}},
-            {"Mem_address", {{"value", state.bus_Mem_address.value}, {"ready_at", state.bus_Mem_address.ready_at}, {"is_active", state.bus_Mem_address.is_active}}},
-            {"Mem_write_data", {{"value", state.bus_Mem_write_data.value}, {"ready_at", state.bus_Mem_write_data.ready_at}, {"is_active", state.bus_Mem_write_data.is_active}}},
-            {"Mem_read_data", {{"value", state.bus_Mem_read_data.value}, {"ready_at", state.bus_Mem_read_data.ready_at}, {"is_active", state.bus_Mem_read_data.is_active}}},
-            {"C", {{"value", state.bus_C.value}, {"ready_at", state.bus_C.ready_at}, {"is_active", state.bus_C.is_active}}},
-            {"PC_plus4", {{"value", state.bus_PC_plus4.value}, {"ready_at", state.bus_PC_plus4.ready_at}, {"is_active", state.bus_PC_plus4.is_active}}},
-            {"PC_dest", {{"value", state.bus_PC_dest.value}, {"ready_at", state.bus_PC_dest.ready_at}, {"is_active", state.bus_PC_dest.is_active}}},
-            {"PC_next", {{"value", state.bus_PC_next.value}, {"ready_at", state.bus_PC_next.ready_at}, {"is_active", state.bus_PC_next.is_active}}},
-            {"branch_taken", {{"value", state.bus_branch_taken.value}, {"ready_at", state.bus_branch_taken.ready_at}, {"is_active", state.bus_branch_taken.is_active}}},
-            {"criticalTime", state.criticalTime},
-            {"totalMicroCycles",state.total_micro_cycles},
-            {"instruction_cptr",state.instruction_cptr},
-
-            {"Pipe_IF_instruction_cptr",state.Pipe_IF_instruction_cptr},
-            {"Pipe_ID_instruction_cptr",state.Pipe_ID_instruction_cptr},
-            {"Pipe_EX_instruction_cptr",state.Pipe_EX_instruction_cptr},
-            {"Pipe_MEM_instruction_cptr",state.Pipe_MEM_instruction_cptr},
-            {"Pipe_WB_instruction_cptr",state.Pipe_WB_instruction_cptr},
-            
-            {"Pipe_IF_instruction",state.Pipe_IF_instruction},
-            {"Pipe_ID_instruction",state.Pipe_ID_instruction},
-            {"Pipe_EX_instruction",state.Pipe_EX_instruction},
-            {"Pipe_MEM_instruction",state.Pipe_MEM_instruction},
-            {"Pipe_WB_instruction",state.Pipe_WB_instruction},
-            
-            // --- Pipeline Registers ---  Ojo al orden. Debe ser igual en main.py
-            {"Pipe_IF_ID_NPC", {{"value", state.Pipe_IF_ID_NPC.value}, {"ready_at", state.Pipe_IF_ID_NPC.ready_at}, {"is_active", state.Pipe_IF_ID_NPC.is_active}}},
-            {"Pipe_IF_ID_NPC_out", {{"value", state.Pipe_IF_ID_NPC_out.value}, {"ready_at", state.Pipe_IF_ID_NPC_out.ready_at}, {"is_active", state.Pipe_IF_ID_NPC_out.is_active}}},
-            {"Pipe_IF_ID_Instr", {{"value", state.Pipe_IF_ID_Instr.value}, {"ready_at", state.Pipe_IF_ID_Instr.ready_at}, {"is_active", state.Pipe_IF_ID_Instr.is_active}}},
-            {"Pipe_IF_ID_Instr_out", {{"value", state.Pipe_IF_ID_Instr_out.value}, {"ready_at", state.Pipe_IF_ID_Instr_out.ready_at}, {"is_active", state.Pipe_IF_ID_Instr_out.is_active}}},
-            {"Pipe_IF_ID_PC", {{"value", state.Pipe_IF_ID_PC.value}, {"ready_at", state.Pipe_IF_ID_PC.ready_at}, {"is_active", state.Pipe_IF_ID_PC.is_active}}},
-            {"Pipe_IF_ID_PC_out", {{"value", state.Pipe_IF_ID_PC_out.value}, {"ready_at", state.Pipe_IF_ID_PC_out.ready_at}, {"is_active", state.Pipe_IF_ID_PC_out.is_active}}},
-
-            {"Pipe_ID_EX_Control", {{"value", state.Pipe_ID_EX_Control.value}, {"ready_at", state.Pipe_ID_EX_Control.ready_at}, {"is_active", state.Pipe_ID_EX_Control.is_active}}},
-            {"Pipe_ID_EX_Control_out", {{"value", state.Pipe_ID_EX_Control_out.value}, {"ready_at", state.Pipe_ID_EX_Control_out.ready_at}, {"is_active", state.Pipe_ID_EX_Control_out.is_active}}},
-            {"Pipe_ID_EX_NPC", {{"value", state.Pipe_ID_EX_NPC.value}, {"ready_at", state.Pipe_ID_EX_NPC.ready_at}, {"is_active", state.Pipe_ID_EX_NPC.is_active}}},
-            {"Pipe_ID_EX_NPC_out", {{"value", state.Pipe_ID_EX_NPC_out.value}, {"ready_at", state.Pipe_ID_EX_NPC_out.ready_at}, {"is_active", state.Pipe_ID_EX_NPC_out.is_active}}},
-            {"Pipe_ID_EX_A", {{"value", state.Pipe_ID_EX_A.value}, {"ready_at", state.Pipe_ID_EX_A.ready_at}, {"is_active", state.Pipe_ID_EX_A.is_active}}},
-            {"Pipe_ID_EX_A_out", {{"value", state.Pipe_ID_EX_A_out.value}, {"ready_at", state.Pipe_ID_EX_A_out.ready_at}, {"is_active", state.Pipe_ID_EX_A_out.is_active}}},
-            {"Pipe_ID_EX_B", {{"value", state.Pipe_ID_EX_B.value}, {"ready_at", state.Pipe_ID_EX_B.ready_at}, {"is_active", state.Pipe_ID_EX_B.is_active}}},
-            {"Pipe_ID_EX_B_out", {{"value", state.Pipe_ID_EX_B_out.value}, {"ready_at", state.Pipe_ID_EX_B_out.ready_at}, {"is_active", state.Pipe_ID_EX_B_out.is_active}}},
-            {"Pipe_ID_EX_RD", {{"value", state.Pipe_ID_EX_RD.value}, {"ready_at", state.Pipe_ID_EX_RD.ready_at}, {"is_active", state.Pipe_ID_EX_RD.is_active}}},
-            {"Pipe_ID_EX_RD_out", {{"value", state.Pipe_ID_EX_RD_out.value}, {"ready_at", state.Pipe_ID_EX_RD_out.ready_at}, {"is_active", state.Pipe_ID_EX_RD_out.is_active}}},
-            {"Pipe_ID_EX_RS1", {{"value", state.Pipe_ID_EX_RS1.value}, {"ready_at", state.Pipe_ID_EX_RS1.ready_at}, {"is_active", state.Pipe_ID_EX_RS1.is_active}}},
-            {"Pipe_ID_EX_RS1_out", {{"value", state.Pipe_ID_EX_RS1_out.value}, {"ready_at", state.Pipe_ID_EX_RS1_out.ready_at}, {"is_active", state.Pipe_ID_EX_RS1_out.is_active}}},
-            {"Pipe_ID_EX_RS2", {{"value", state.Pipe_ID_EX_RS2.value}, {"ready_at", state.Pipe_ID_EX_RS2.ready_at}, {"is_active", state.Pipe_ID_EX_RS2.is_active}}},
-            {"Pipe_ID_EX_RS2_out", {{"value", state.Pipe_ID_EX_RS2_out.value}, {"ready_at", state.Pipe_ID_EX_RS2_out.ready_at}, {"is_active", state.Pipe_ID_EX_RS2_out.is_active}}},
-            {"Pipe_ID_EX_Imm", {{"value", state.Pipe_ID_EX_Imm.value}, {"ready_at", state.Pipe_ID_EX_Imm.ready_at}, {"is_active", state.Pipe_ID_EX_Imm.is_active}}},
-            {"Pipe_ID_EX_Imm_out", {{"value", state.Pipe_ID_EX_Imm_out.value}, {"ready_at", state.Pipe_ID_EX_Imm_out.ready_at}, {"is_active", state.Pipe_ID_EX_Imm_out.is_active}}},
-            {"Pipe_ID_EX_PC", {{"value", state.Pipe_ID_EX_PC.value}, {"ready_at", state.Pipe_ID_EX_PC.ready_at}, {"is_active", state.Pipe_ID_EX_PC.is_active}}},
-            {"Pipe_ID_EX_PC_out", {{"value", state.Pipe_ID_EX_PC_out.value}, {"ready_at", state.Pipe_ID_EX_PC_out.ready_at}, {"is_active", state.Pipe_ID_EX_PC_out.is_active}}},
-
-            {"Pipe_EX_MEM_Control", {{"value", state.Pipe_EX_MEM_Control.value}, {"ready_at", state.Pipe_EX_MEM_Control.ready_at}, {"is_active", state.Pipe_EX_MEM_Control.is_active}}},
-            {"Pipe_EX_MEM_Control_out", {{"value", state.Pipe_EX_MEM_Control_out.value}, {"ready_at", state.Pipe_EX_MEM_Control_out.ready_at}, {"is_active", state.Pipe_EX_MEM_Control_out.is_active}}},
-            {"Pipe_EX_MEM_NPC", {{"value", state.Pipe_EX_MEM_NPC.value}, {"ready_at", state.Pipe_EX_MEM_NPC.ready_at}, {"is_active", state.Pipe_EX_MEM_NPC.is_active}}},
-            {"Pipe_EX_MEM_NPC_out", {{"value", state.Pipe_EX_MEM_NPC_out.value}, {"ready_at", state.Pipe_EX_MEM_NPC_out.ready_at}, {"is_active", state.Pipe_EX_MEM_NPC_out.is_active}}},
-            {"Pipe_EX_MEM_ALU_result", {{"value", state.Pipe_EX_MEM_ALU_result.value}, {"ready_at", state.Pipe_EX_MEM_ALU_result.ready_at}, {"is_active", state.Pipe_EX_MEM_ALU_result.is_active}}},
-            {"Pipe_EX_MEM_ALU_result_out", {{"value", state.Pipe_EX_MEM_ALU_result_out.value}, {"ready_at", state.Pipe_EX_MEM_ALU_result_out.ready_at}, {"is_active", state.Pipe_EX_MEM_ALU_result_out.is_active}}},
-            {"Pipe_EX_MEM_B", {{"value", state.Pipe_EX_MEM_B.value}, {"ready_at", state.Pipe_EX_MEM_B.ready_at}, {"is_active", state.Pipe_EX_MEM_B.is_active}}},
-            {"Pipe_EX_MEM_B_out", {{"value", state.Pipe_EX_MEM_B_out.value}, {"ready_at", state.Pipe_EX_MEM_B_out.ready_at}, {"is_active", state.Pipe_EX_MEM_B_out.is_active}}},
-            {"Pipe_EX_MEM_RD", {{"value", state.Pipe_EX_MEM_RD.value}, {"ready_at", state.Pipe_EX_MEM_RD.ready_at}, {"is_active", state.Pipe_EX_MEM_RD.is_active}}},
-            {"Pipe_EX_MEM_RD_out", {{"value", state.Pipe_EX_MEM_RD_out.value}, {"ready_at", state.Pipe_EX_MEM_RD_out.ready_at}, {"is_active", state.Pipe_EX_MEM_RD_out.is_active}}},
-
-            {"Pipe_MEM_WB_Control", {{"value", state.Pipe_MEM_WB_Control.value}, {"ready_at", state.Pipe_MEM_WB_Control.ready_at}, {"is_active", state.Pipe_MEM_WB_Control.is_active}}},
-            {"Pipe_MEM_WB_Control_out", {{"value", state.Pipe_MEM_WB_Control_out.value}, {"ready_at", state.Pipe_MEM_WB_Control_out.ready_at}, {"is_active", state.Pipe_MEM_WB_Control_out.is_active}}},
-            {"Pipe_MEM_WB_NPC", {{"value", state.Pipe_MEM_WB_NPC.value}, {"ready_at", state.Pipe_MEM_WB_NPC.ready_at}, {"is_active", state.Pipe_MEM_WB_NPC.is_active}}},
-            {"Pipe_MEM_WB_NPC_out", {{"value", state.Pipe_MEM_WB_NPC_out.value}, {"ready_at", state.Pipe_MEM_WB_NPC_out.ready_at}, {"is_active", state.Pipe_MEM_WB_NPC_out.is_active}}},
-            {"Pipe_MEM_WB_ALU_result", {{"value", state.Pipe_MEM_WB_ALU_result.value}, {"ready_at", state.Pipe_MEM_WB_ALU_result.ready_at}, {"is_active", state.Pipe_MEM_WB_ALU_result.is_active}}},
-            {"Pipe_MEM_WB_ALU_result_out", {{"value", state.Pipe_MEM_WB_ALU_result_out.value}, {"ready_at", state.Pipe_MEM_WB_ALU_result_out.ready_at}, {"is_active", state.Pipe_MEM_WB_ALU_result_out.is_active}}},
-            {"Pipe_MEM_WB_RM", {{"value", state.Pipe_MEM_WB_RM.value}, {"ready_at", state.Pipe_MEM_WB_RM.ready_at}, {"is_active", state.Pipe_MEM_WB_RM.is_active}}},
-            {"Pipe_MEM_WB_RM_out", {{"value", state.Pipe_MEM_WB_RM_out.value}, {"ready_at", state.Pipe_MEM_WB_RM_out.ready_at}, {"is_active", state.Pipe_MEM_WB_RM_out.is_active}}},
-            {"Pipe_MEM_WB_RD", {{"value", state.Pipe_MEM_WB_RD.value}, {"ready_at", state.Pipe_MEM_WB_RD.ready_at}, {"is_active", state.Pipe_MEM_WB_RD.is_active}}},
-            {"Pipe_MEM_WB_RD_out", {{"value", state.Pipe_MEM_WB_RD_out.value}, {"ready_at", state.Pipe_MEM_WB_RD_out.ready_at}, {"is_active", state.Pipe_MEM_WB_RD_out.is_active}}},
-
-            // --- Señales de Riesgo ---
-            {"bus_stall", {{"value", state.bus_stall.value}, {"ready_at", state.bus_stall.ready_at}, {"is_active", state.bus_stall.is_active}}},
-            {"bus_flush", {{"value", state.bus_flush.value}, {"ready_at", state.bus_flush.ready_at}, {"is_active", state.bus_flush.is_active}}},
-
-            // --- Señales para Cortocircuitos (Forwarding) ---
-            {"bus_ControlForwardA", {{"value", state.bus_ControlForwardA.value}, {"ready_at", state.bus_ControlForwardA.ready_at}, {"is_active", state.bus_ControlForwardA.is_active}}},
-            {"bus_ControlForwardB", {{"value", state.bus_ControlForwardB.value}, {"ready_at", state.bus_ControlForwardB.ready_at}, {"is_active", state.bus_ControlForwardB.is_active}}},
-            {"bus_ControlForwardM", {{"value", state.bus_ControlForwardM.value}, {"ready_at", state.bus_ControlForwardM.ready_at}, {"is_active", state.bus_ControlForwardM.is_active}}},
-            {"bus_ForwardA", {{"value", state.bus_ForwardA.value}, {"ready_at", state.bus_ForwardA.ready_at}, {"is_active", state.bus_ForwardA.is_active}}},
-            {"bus_ForwardB", {{"value", state.bus_ForwardB.value}, {"ready_at", state.bus_ForwardB.ready_at}, {"is_active", state.bus_ForwardB.is_active}}},
-            {"bus_ForwardM", {{"value", state.bus_ForwardM.value}, {"ready_at", state.bus_ForwardM.ready_at}, {"is_active", state.bus_ForwardM.is_active}}},
-
+        json_str.clear();
+        append_state_json(state, json_str);
+        return json_str.c_str();
+    }
 
+    // Estadísticas de una caché y de sus prebuscadores.
+    // - accuracy: fracción de prebúsquedas que llegaron a usarse.
+    // - coverage: fracción de fallos de lectura que eliminó el prebuscador.
+    json jsonFromCache(const Cache& cache)
+    {
+        const CacheStats& stats = cache.get_stats();
+        json prefetchers = json::array();
+        for (const auto& prefetcher : cache.get_prefetchers()) {
+            const PrefetchStats& p = prefetcher->stats();
+            const uint64_t used = p.useful + p.late;
+            prefetchers.push_back({
+                {"name", prefetcher->get_name()},
+                {"degree", prefetcher->get_degree()},
+                {"distance", prefetcher->get_distance()},
+                {"issued", p.issued},
+                {"useful", p.useful},
+                {"late", p.late},
+                {"useless", p.useless},
+                {"accuracy", p.issued ? static_cast<double>(used) / p.issued : 0.0},
+                {"coverage", (used + stats.read_misses) ? static_cast<double>(used) / (used + stats.read_misses) : 0.0},
+            });
+        }
+        return {
+            {"reads", stats.reads},
+            {"read_misses", stats.read_misses},
+            {"writes", stats.writes},
+            {"write_misses", stats.write_misses},
+            {"stall_cycles", stats.stall_cycles},
+            {"prefetchers", prefetchers},
+            {"victim_cache", {
+                {"entries", cache.get_victim_entries()},
+                {"hits", stats.victim_hits},
+            }},
+            {"mshr", {
+                {"entries", cache.get_mshr_entries()},
+                {"outstanding", cache.get_outstanding_misses()},
+                {"primary", stats.mshr_primary},
+                {"secondary", stats.mshr_secondary},
+                {"max_outstanding", stats.max_outstanding},
+                // Paralelismo de memoria: fallos pendientes de media mientras hay alguno.
+                {"mlp", stats.outstanding_cycles ? static_cast<double>(stats.outstanding_sum) / stats.outstanding_cycles : 0.0},
+            }},
+            {"write_buffer", {
+                {"entries", cache.get_write_buffer_entries()},
+                {"occupancy", cache.get_write_buffer_occupancy()},
+                {"coalesced", stats.write_buffer_coalesced},
+                {"drains", stats.write_buffer_drains},
+                {"full_stalls", stats.write_buffer_full_stalls},
+                {"stall_cycles", stats.write_buffer_stall_cycles},
+            }},
         };
+    }
 
-        json_str = j.dump();
-        json_str = j.dump();
-        return json_str.c_str();
+namespace {
+    // Cerrojos del estado de un simulador (ver Simulator::get_mutex): el
+    // exclusivo para lo que lo cambia y el compartido para las consultas.
+    // Así dos sesiones avanzan a la vez y las consultas de una no se esperan.
+    using WriteLock = std::unique_lock<std::shared_mutex>;
+    using ReadLock = std::shared_lock<std::shared_mutex>;
+
+    WriteLock lock_for_write(void* sim_ptr) { return WriteLock(static_cast<Simulator*>(sim_ptr)->get_mutex()); }
+    ReadLock lock_for_read(void* sim_ptr) { return ReadLock(static_cast<Simulator*>(sim_ptr)->get_mutex()); }
+
+    // Instancias devueltas por las sesiones, listas para reutilizarse.
+    SimulatorPool& simulator_pool() {
+        static SimulatorPool pool(SIMULATOR_POOL_CAPACITY);
+        return pool;
     }
 
+    // Sesiones de la API, con sus simuladores sacados del pool.
+    SessionRegistry& session_registry() {
+        static SessionRegistry registry(simulator_pool());
+        return registry;
+    }
+}
+
 // Interfaz C-style para que Python (ctypes) pueda llamar a nuestro código C++.
 // Usamos extern "C" para evitar que el compilador de C++ modifique los nombres de las funciones.
 extern "C" {
@@ -151,14 +123,91 @@ extern "C" {
         delete static_cast<Simulator*>(sim_ptr);
     }
 
+    // Deja la instancia como recién construida con otro modelo, sin liberar
+    // sus memorias ni cachés. Es lo que usa /reset.
+    SIMULATOR_API bool Simulator_reconfigure(void* sim_ptr, int model_type, size_t mem_size, bool hazards) {
+        if (!sim_ptr) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->reconfigure(static_cast<PipelineModel>(model_type), mem_size, hazards);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Construye por adelantado hasta `count` instancias libres.
+    SIMULATOR_API void Simulator_pool_prewarm(size_t count, size_t mem_size, int model_type) {
+        try {
+            simulator_pool().prewarm(count, mem_size, static_cast<PipelineModel>(model_type));
+        } catch (const std::exception&) {
+        }
+    }
+
+    // Como Simulator_new, pero reutiliza una instancia del pool si la hay.
+    // Se devuelve con Simulator_pool_release (o se libera con Simulator_delete).
+    SIMULATOR_API void* Simulator_pool_acquire(size_t mem_size, int model_type, bool hazards) {
+        try {
+            return simulator_pool().acquire(mem_size, static_cast<PipelineModel>(model_type), hazards);
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    SIMULATOR_API void Simulator_pool_release(void* sim_ptr) {
+        simulator_pool().release(static_cast<Simulator*>(sim_ptr));
+    }
+
+    // Cambia el fichero de log de esta instancia; con una ruta vacía (o nula)
+    // deja de escribir log. Cada sesión debe tener el suyo.
+    SIMULATOR_API void Simulator_set_log_file(void* sim_ptr, const char* path) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->set_log_file(path ? path : "");
+    }
+
     SIMULATOR_API void Simulator_load_program(void* sim_ptr, const uint8_t* program_data, size_t data_size, int mode_int) {
         if (!sim_ptr) return;
-        const std::vector<uint8_t> program(program_data, program_data + data_size);
-        static_cast<Simulator*>(sim_ptr)->load_program(program,static_cast<PipelineModel>(mode_int));
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->load_program(program_data, data_size, static_cast<PipelineModel>(mode_int));
+    }
+
+    // Carga un ELF32 o un .bin con mmap. Escribe la dirección de entrada en
+    // `entry_out` (puede ser nulo); el llamador hace después el reset con ella.
+    SIMULATOR_API bool Simulator_load_file(void* sim_ptr, const char* path, int mode_int, uint32_t* entry_out) {
+        if (!sim_ptr || !path) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        try {
+            const uint32_t entry = static_cast<Simulator*>(sim_ptr)->load_file(path, static_cast<PipelineModel>(mode_int));
+            if (entry_out) *entry_out = entry;
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Respalda [base, base + size) de la memoria principal con el fichero `path`
+    // (MAP_SHARED). size = 0 usa el tamaño del fichero.
+    SIMULATOR_API bool Simulator_map_file(void* sim_ptr, const char* path, uint32_t base_address, size_t size) {
+        if (!sim_ptr || !path) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->map_file(path, base_address, size);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    SIMULATOR_API void Simulator_sync_mapped_files(void* sim_ptr) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->sync_mapped_files();
     }
 
     SIMULATOR_API void Simulator_load_program_from_assembly(void* sim_ptr, const char* assembly_code, int mode_int) {
         if (!sim_ptr || !assembly_code) return;
+        WriteLock lock = lock_for_write(sim_ptr);
         // Llama a la sobrecarga de load_program que acepta código ensamblador.
         static_cast<Simulator*>(sim_ptr)->load_program(assembly_code, static_cast<PipelineModel>(mode_int));
     }
@@ -167,6 +216,7 @@ extern "C" {
         if (!sim_ptr || !assembly_code) {
             return 0;
         }
+        WriteLock lock = lock_for_write(sim_ptr);
 
         Simulator* simulator = static_cast<Simulator*>(sim_ptr);
         std::vector<uint8_t> machine_code = simulator->assemble(assembly_code);
@@ -187,6 +237,7 @@ extern "C" {
     // Nueva función para que la UI pueda especificar el modo al resetear.
     SIMULATOR_API const char* Simulator_reset_with_model(void* sim_ptr, int mode_int, uint32_t initial_pc) {
         if (!sim_ptr) return "{}";
+        WriteLock lock = lock_for_write(sim_ptr);
         static_cast<Simulator*>(sim_ptr)->reset(static_cast<PipelineModel>(mode_int), initial_pc);
         DatapathState state = static_cast<Simulator*>(sim_ptr)->get_datapath_state();
         return jsonFromState(state);
@@ -194,6 +245,7 @@ extern "C" {
 
     SIMULATOR_API void Simulator_set_hazard_options(void* sim_ptr, bool stalls, bool flushes, bool forwarding) {
         if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
         // Llama al nuevo método en la instancia del simulador.
         static_cast<Simulator*>(sim_ptr)->set_hazard_options(stalls, flushes, forwarding);
     }
@@ -201,6 +253,7 @@ extern "C" {
 
     SIMULATOR_API const char*  Simulator_step(void* sim_ptr) {
         if (!sim_ptr) return "{}";
+        WriteLock lock = lock_for_write(sim_ptr);
         static_cast<Simulator*>(sim_ptr)->step();
         DatapathState state = static_cast<Simulator*>(sim_ptr)->get_datapath_state();
         return jsonFromState(state); // fastapi no lo usa; prefiere llamar a state después
@@ -208,13 +261,33 @@ extern "C" {
 
     SIMULATOR_API const char* Simulator_step_back(void* sim_ptr) {
         if (!sim_ptr) return "{}";
+        WriteLock lock = lock_for_write(sim_ptr);
         static_cast<Simulator*>(sim_ptr)->step_back();
         DatapathState state = static_cast<Simulator*>(sim_ptr)->get_datapath_state();
         return jsonFromState(state);
     }
 
+    // Salta al ciclo `cycle` usando el historial (ver Simulator::seek).
+    SIMULATOR_API const char* Simulator_seek(void* sim_ptr, uint32_t cycle) {
+        if (!sim_ptr) return "{}";
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->seek(cycle);
+        DatapathState state = static_cast<Simulator*>(sim_ptr)->get_datapath_state();
+        return jsonFromState(state);
+    }
+
+    // Primer y último ciclo a los que se puede saltar sin ejecutar.
+    SIMULATOR_API void Simulator_get_history_range(void* sim_ptr, uint32_t* first_cycle, uint32_t* last_cycle) {
+        if (!sim_ptr) return;
+        ReadLock lock = lock_for_read(sim_ptr);
+        const Simulator* sim = static_cast<Simulator*>(sim_ptr);
+        if (first_cycle) *first_cycle = sim->get_history_first_cycle();
+        if (last_cycle) *last_cycle = sim->get_history_last_cycle();
+    }
+
     SIMULATOR_API const char* Simulator_steps_until(void* sim_ptr, const uint32_t* breakpoints_ptr, size_t num_breakpoints) {
         if (!sim_ptr) return "{}";
+        WriteLock lock = lock_for_write(sim_ptr);
 
         // Convertimos el array C-style a un std::vector para pasarlo al núcleo.
         std::vector<uint32_t> breakpoints;
@@ -230,31 +303,211 @@ extern "C" {
         return jsonFromState(state);
     }
 
+    // Como Simulator_steps_until, pero en un hilo del núcleo: vuelve enseguida
+    // (false si ya hay una ejecución en marcha o no se pudo lanzar). Mientras
+    // dura, las demás llamadas sobre esta instancia esperan a que termine.
+    SIMULATOR_API bool Simulator_run_async(void* sim_ptr, const uint32_t* breakpoints_ptr, size_t num_breakpoints) {
+        if (!sim_ptr) return false;
+        std::vector<uint32_t> breakpoints;
+        if (breakpoints_ptr != nullptr && num_breakpoints > 0) {
+            breakpoints.assign(breakpoints_ptr, breakpoints_ptr + num_breakpoints);
+        }
+        try {
+            return static_cast<Simulator*>(sim_ptr)->run_async(std::move(breakpoints));
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Avance de la ejecución en segundo plano; no espera al cerrojo.
+    // Devuelve true mientras sigue en marcha.
+    SIMULATOR_API bool Simulator_poll(void* sim_ptr, RunProgress* progress_out) {
+        if (!sim_ptr) return false;
+        const RunProgress progress = static_cast<Simulator*>(sim_ptr)->poll_run();
+        if (progress_out) *progress_out = progress;
+        return progress.running;
+    }
+
+    // Pide que pare la ejecución en segundo plano tras el paso en curso.
+    SIMULATOR_API void Simulator_cancel(void* sim_ptr) {
+        if (!sim_ptr) return;
+        static_cast<Simulator*>(sim_ptr)->cancel_run();
+    }
+
+    // Para la ejecución en segundo plano y espera a que el hilo termine; sin
+    // ejecución en marcha vuelve enseguida. Para antes de sustituir el estado.
+    SIMULATOR_API void Simulator_stop_run(void* sim_ptr) {
+        if (!sim_ptr) return;
+        Simulator* sim = static_cast<Simulator*>(sim_ptr);
+        sim->cancel_run();
+        sim->wait_run();
+    }
+
     SIMULATOR_API uint32_t Simulator_get_pc(void* sim_ptr) {
         if (!sim_ptr) return 0;
+        ReadLock lock = lock_for_read(sim_ptr);
         return static_cast<Simulator*>(sim_ptr)->get_pc();
     }
 
     SIMULATOR_API DatapathState Simulator_get_datapath_state(void* sim_ptr) {
         if (!sim_ptr) return {};
+        ReadLock lock = lock_for_read(sim_ptr);
         return static_cast<Simulator*>(sim_ptr)->get_datapath_state();
     }
 
     SIMULATOR_API const char* Simulator_get_state_json(void* sim_ptr) {
         if (!sim_ptr) return "{}";
+        ReadLock lock = lock_for_read(sim_ptr);
 
         DatapathState state = static_cast<Simulator*>(sim_ptr)->get_datapath_state();
 
         return jsonFromState(state);
     }
 
+    // Estado en binario (ver StateBinary.h). Devuelve los bytes necesarios;
+    // si `capacity` no llega no escribe nada y hay que repetir la llamada.
+    SIMULATOR_API size_t Simulator_get_state_binary(void* sim_ptr, uint8_t* buffer, size_t capacity) {
+        if (!sim_ptr) return 0;
+        ReadLock lock = lock_for_read(sim_ptr);
+        return static_cast<Simulator*>(sim_ptr)->get_state_binary(buffer, capacity);
+    }
+
+    // Igual, con flags STATE_BINARY_* (p.ej. los rangos de memoria escritos).
+    SIMULATOR_API size_t Simulator_get_state_binary_ex(void* sim_ptr, uint8_t* buffer, size_t capacity, uint32_t flags) {
+        if (!sim_ptr) return 0;
+        // Con la memoria se olvidan las líneas ya enviadas: eso es una escritura.
+        if (flags & STATE_BINARY_MEMORY) {
+            WriteLock lock = lock_for_write(sim_ptr);
+            return static_cast<Simulator*>(sim_ptr)->get_state_binary(buffer, capacity, flags);
+        }
+        ReadLock lock = lock_for_read(sim_ptr);
+        return static_cast<Simulator*>(sim_ptr)->get_state_binary(buffer, capacity, flags);
+    }
+
+    // Descripción en JSON del formato binario (desplazamientos y señales).
+    SIMULATOR_API const char* Simulator_get_state_schema() {
+        return state_binary_schema().c_str();
+    }
+
+    // Texto de un identificador de instrucción del estado binario.
+    SIMULATOR_API const char* Simulator_get_instruction_text(void* sim_ptr, uint32_t text_id, uint32_t instruction) {
+        if (!sim_ptr) return "";
+        ReadLock lock = lock_for_read(sim_ptr);
+        thread_local static std::string text;
+        text = static_cast<Simulator*>(sim_ptr)->get_instruction_text(text_id, instruction);
+        return text.c_str();
+    }
+
+    // Cambios desde la versión `since_version` (0 = todo):
+    // {"version", "full", "pc", "status_register", "registers": {"5": valor...},
+    //  "state": {los campos cambiados, con el formato de Simulator_get_state_json}}.
+    // Una versión que el simulador no ha dado aún también devuelve todo.
+    SIMULATOR_API const char* Simulator_get_state_delta(void* sim_ptr, uint64_t since_version) {
+        if (!sim_ptr) return "{}";
+        WriteLock lock = lock_for_write(sim_ptr);
+        Simulator* sim = static_cast<Simulator*>(sim_ptr);
+        thread_local static std::string json_str;
+        const uint64_t version = sim->sync_state_version();
+        const bool full = since_version == 0 || since_version > version;
+        const StateJsonMask fields = full ? StateJsonMask().set() : sim->changed_fields_since(since_version);
+        const uint32_t registers = full ? 0xFFFFFFFFu : sim->changed_registers_since(since_version);
+
+        json_str.clear();
+        json_str += "{\"version\":" + std::to_string(version);
+        json_str += full ? ",\"full\":true" : ",\"full\":false";
+        json_str += ",\"pc\":" + std::to_string(sim->get_pc());
+        json_str += ",\"status_register\":" + std::to_string(sim->get_status_register());
+        json_str += ",\"registers\":{";
+        const RegisterFile& regs = sim->get_registers();
+        const char* separator = "";
+        for (uint8_t i = 0; i < 32; ++i) {
+            if (!(registers & (1u << i))) continue;
+            json_str += separator;
+            json_str += "\"" + std::to_string(i) + "\":" + std::to_string(regs.readA(i));
+            separator = ",";
+        }
+        json_str += "},\"state\":";
+        if (fields.any()) {
+            DatapathState state = sim->get_datapath_state();
+            append_state_json(state, json_str, &fields);
+        } else {
+            json_str += "{}";
+        }
+        json_str += "}";
+        return json_str.c_str();
+    }
+
+    // Todo el estado de /state en una llamada. Quien llama reserva `view` y,
+    // si quiere memoria, rellena window_count y las ventanas.
+    SIMULATOR_API bool Simulator_get_snapshot(void* sim_ptr, SnapshotView* view) {
+        if (!sim_ptr || !view) return false;
+        ReadLock lock = lock_for_read(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->get_snapshot(*view);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Estado completo en un bloque binario (StateSave.h). El puntero vale
+    // hasta la siguiente llamada desde el mismo hilo.
+    SIMULATOR_API const uint8_t* Simulator_save_state(void* sim_ptr, uint32_t flags, size_t* size_out) {
+        if (!sim_ptr || !size_out) return nullptr;
+        thread_local static std::vector<uint8_t> blob;
+        ReadLock lock = lock_for_read(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->save_state(blob, flags);
+            *size_out = blob.size();
+            return blob.data();
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    SIMULATOR_API bool Simulator_load_state(void* sim_ptr, const uint8_t* data, size_t size) {
+        if (!sim_ptr || !data) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->load_state(data, size);
+            return true;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Instancia nueva (del pool) que sigue desde el mismo punto que `sim_ptr`,
+    // con las memorias compartidas en copia en escritura. Se libera con
+    // Simulator_pool_release o Simulator_delete.
+    SIMULATOR_API void* Simulator_fork(void* sim_ptr) {
+        if (!sim_ptr) return nullptr;
+        Simulator* child = nullptr;
+        try {
+            child = simulator_pool().acquire(DMEM_SIZE, PipelineModel::SingleCycle);
+            ReadLock lock = lock_for_read(sim_ptr);
+            static_cast<Simulator*>(sim_ptr)->fork_to(*child);
+            return child;
+        } catch (const std::exception&) {
+            if (child) simulator_pool().release(child);
+            return nullptr;
+        }
+    }
+
+    SIMULATOR_API int Simulator_get_model(void* sim_ptr) {
+        if (!sim_ptr) return -1;
+        ReadLock lock = lock_for_read(sim_ptr);
+        return static_cast<int>(static_cast<Simulator*>(sim_ptr)->get_model());
+    }
+
     SIMULATOR_API uint32_t Simulator_get_status_register(void* sim_ptr) {
         if (!sim_ptr) return 0;
+        ReadLock lock = lock_for_read(sim_ptr);
         return static_cast<Simulator*>(sim_ptr)->get_status_register();
     }
 
     SIMULATOR_API void Simulator_get_all_registers(void* sim_ptr, uint32_t* buffer_out) {
         if (!sim_ptr || !buffer_out) return;
+        ReadLock lock = lock_for_read(sim_ptr);
         const RegisterFile& regs = static_cast<Simulator*>(sim_ptr)->get_registers();
         for (uint8_t i = 0; i < 32; ++i) {
             buffer_out[i] = regs.readA(i);
@@ -265,6 +518,7 @@ extern "C" {
         if (!sim_ptr) {
             return "";
         }
+        ReadLock lock = lock_for_read(sim_ptr);
         // Usamos 'thread_local' para asegurar que cada hilo (thread) de ejecución
         // tenga su propia copia de la cadena. Esto evita "condiciones de carrera"
         // (race conditions) en un entorno multihilo como un servidor web,
@@ -277,6 +531,7 @@ extern "C" {
 
     SIMULATOR_API void Simulator_get_d_mem(void* sim_ptr, uint8_t* buffer_out, size_t buffer_size) {
         if (!sim_ptr || !buffer_out) return;
+        ReadLock lock = lock_for_read(sim_ptr);
 
         const auto& d_mem_data = static_cast<Simulator*>(sim_ptr)->get_d_mem();
         
@@ -292,6 +547,7 @@ extern "C" {
         if (!sim_ptr) {
             return 0;
         }
+        ReadLock lock = lock_for_read(sim_ptr);
 
         Simulator* simulator = static_cast<Simulator*>(sim_ptr);
         const auto& i_mem_data = simulator->get_i_mem();
@@ -319,6 +575,373 @@ extern "C" {
         return i_mem_data.size();
     }
 
+    // --- Jerarquía de memoria (modo General) ---
+    // cache_id: 0=instrucciones, 1=datos. kind: 0=next_line, 1=stride, 2=stream_buffer.
+    // Devuelve false si los parámetros no son válidos.
+    SIMULATOR_API bool Simulator_add_prefetcher(void* sim_ptr, int cache_id, int kind, unsigned degree, unsigned distance) {
+        if (!sim_ptr) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->add_prefetcher(static_cast<CacheId>(cache_id), static_cast<PrefetcherKind>(kind), degree, distance);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
 
+    SIMULATOR_API void Simulator_clear_prefetchers(void* sim_ptr, int cache_id) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->clear_prefetchers(static_cast<CacheId>(cache_id));
+    }
+
+    // entries = 0 desactiva el buffer de escritura (escritura síncrona en memoria).
+    SIMULATOR_API void Simulator_set_write_buffer(void* sim_ptr, int cache_id, size_t entries) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->set_write_buffer_entries(static_cast<CacheId>(cache_id), entries);
+    }
+
+    // entries = 0 desactiva la caché de víctimas.
+    SIMULATOR_API void Simulator_set_victim_cache(void* sim_ptr, int cache_id, size_t entries) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->set_victim_entries(static_cast<CacheId>(cache_id), entries);
+    }
+
+    // Activa las cachés en el modelo segmentado. mshr_entries = 0 deja la caché de datos bloqueante.
+    SIMULATOR_API void Simulator_set_pipeline_caches(void* sim_ptr, bool enabled, size_t mshr_entries) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->set_pipeline_caches(enabled, mshr_entries);
+    }
+
+    // --- Memoria virtual Sv32 (modo General) ---
+    SIMULATOR_API bool Simulator_configure_mmu(void* sim_ptr, size_t itlb_entries, size_t dtlb_entries, size_t l2_entries, uint32_t l2_hit_cycles) {
+        if (!sim_ptr) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        MmuConfig config;
+        config.itlb_entries = itlb_entries;
+        config.dtlb_entries = dtlb_entries;
+        config.l2_entries = l2_entries;
+        config.l2_hit_cycles = l2_hit_cycles;
+        try {
+            static_cast<Simulator*>(sim_ptr)->configure_mmu(config);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    // csr: número estándar (satp=0x180, mtvec=0x305, mepc=0x341, mcause=0x342, mtval=0x343).
+    SIMULATOR_API bool Simulator_set_csr(void* sim_ptr, uint32_t csr, uint32_t value) {
+        if (!sim_ptr) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        return static_cast<Simulator*>(sim_ptr)->write_csr(csr, value);
+    }
+
+    SIMULATOR_API uint32_t Simulator_get_csr(void* sim_ptr, uint32_t csr) {
+        if (!sim_ptr) return 0;
+        ReadLock lock = lock_for_read(sim_ptr);
+        uint32_t value = 0;
+        static_cast<Simulator*>(sim_ptr)->read_csr(csr, value);
+        return value;
+    }
+
+    // flags: bits R/W/X/U de la PTE (ver PteFlags en Mmu.h).
+    SIMULATOR_API bool Simulator_map_page(void* sim_ptr, uint32_t va, uint32_t pa, uint32_t flags) {
+        if (!sim_ptr) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        try {
+            static_cast<Simulator*>(sim_ptr)->map_page(va, pa, flags);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    SIMULATOR_API const char* Simulator_get_mmu_stats(void* sim_ptr) {
+        if (!sim_ptr) return "{}";
+        ReadLock lock = lock_for_read(sim_ptr);
+        const Mmu& mmu = static_cast<Simulator*>(sim_ptr)->get_mmu();
+        const MmuStats& stats = mmu.get_stats();
+        thread_local static std::string json_str;
+        json j = {
+            {"enabled", mmu.enabled()},
+            {"satp", mmu.get_satp()},
+            {"itlb_accesses", stats.itlb_accesses},
+            {"itlb_misses", stats.itlb_misses},
+            {"dtlb_accesses", stats.dtlb_accesses},
+            {"dtlb_misses", stats.dtlb_misses},
+            {"l2_misses", stats.l2_misses},
+            {"walk_cycles", stats.walk_cycles},
+            {"walk_reads", stats.walk_reads},
+            {"page_faults", stats.page_faults},
+            {"stall_cycles", stats.stall_cycles},
+        };
+        json_str = j.dump();
+        return json_str.c_str();
+    }
+
+    // Conecta un modelo DRAM detrás de la memoria. policy: 0=página abierta, 1=página cerrada.
+    // Devuelve false si la configuración no es válida.
+    SIMULATOR_API bool Simulator_attach_dram(void* sim_ptr, size_t banks, size_t row_size, uint32_t t_rcd, uint32_t t_cas,
+                                             uint32_t t_rp, uint32_t t_burst, size_t queue_depth, int policy) {
+        if (!sim_ptr) return false;
+        WriteLock lock = lock_for_write(sim_ptr);
+        DramConfig config;
+        config.banks = banks;
+        config.row_size = row_size;
+        config.t_rcd = t_rcd;
+        config.t_cas = t_cas;
+        config.t_rp = t_rp;
+        config.t_burst = t_burst;
+        config.queue_depth = queue_depth;
+        config.policy = static_cast<DramPagePolicy>(policy);
+        try {
+            static_cast<Simulator*>(sim_ptr)->attach_dram(config);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    // Vuelve a la latencia fija de memoria.
+    SIMULATOR_API void Simulator_detach_dram(void* sim_ptr) {
+        if (!sim_ptr) return;
+        WriteLock lock = lock_for_write(sim_ptr);
+        static_cast<Simulator*>(sim_ptr)->detach_dram();
+    }
+
+    SIMULATOR_API const char* Simulator_get_dram_stats(void* sim_ptr) {
+        if (!sim_ptr) return "{}";
+        ReadLock lock = lock_for_read(sim_ptr);
+        const Dram* dram = static_cast<Simulator*>(sim_ptr)->get_dram();
+        if (!dram) return "{\"attached\":false}";
+        const DramConfig& config = dram->get_config();
+        const DramStats& stats = dram->get_stats();
+        const uint64_t accesses = stats.reads + stats.writes;
+        thread_local static std::string json_str;
+        json j = {
+            {"attached", true},
+            {"banks", config.banks},
+            {"row_size", config.row_size},
+            {"policy", config.policy == DramPagePolicy::Open ? "open" : "closed"},
+            {"reads", stats.reads},
+            {"writes", stats.writes},
+            {"row_hits", stats.row_hits},
+            {"row_empty", stats.row_empty},
+            {"row_conflicts", stats.row_conflicts},
+            {"row_hit_rate", accesses ? static_cast<double>(stats.row_hits) / accesses : 0.0},
+            {"avg_latency", accesses ? static_cast<double>(stats.total_latency) / accesses : 0.0},
+            {"avg_queue_cycles", accesses ? static_cast<double>(stats.queue_cycles) / accesses : 0.0},
+        };
+        json_str = j.dump();
+        return json_str.c_str();
+    }
+
+    SIMULATOR_API const char* Simulator_get_cache_stats(void* sim_ptr) {
+        if (!sim_ptr) return "{}";
+        ReadLock lock = lock_for_read(sim_ptr);
+        const Simulator* simulator = static_cast<Simulator*>(sim_ptr);
+        thread_local static std::string json_str;
+        const PipelineMemoryStats& pipeline = simulator->get_pipeline_memory_stats();
+        json j = {
+            {"cycles", simulator->get_cache_cycles()},
+            {"icache", jsonFromCache(simulator->get_cache(CacheId::Instruction))},
+            {"dcache", jsonFromCache(simulator->get_cache(CacheId::Data))},
+            {"pipeline", {
+                {"enabled", simulator->get_pipeline_caches()},
+                {"icache_stall_cycles", pipeline.icache_stall_cycles},
+                {"store_stall_cycles", pipeline.store_stall_cycles},
+                {"load_stall_cycles", pipeline.load_stall_cycles},
+                {"mshr_stall_cycles", pipeline.mshr_stall_cycles},
+                {"scoreboard_stall_cycles", pipeline.scoreboard_stall_cycles},
+            }},
+        };
+        json_str = j.dump();
+        return json_str.c_str();
+    }
+
+
+
+    // --- Varios harts con memoria compartida y cachés coherentes ---
+
+    // protocol: 0=MSI, 1=MESI. Devuelve nullptr si la configuración no es válida.
+    SIMULATOR_API void* MultiHart_new(size_t num_harts, size_t mem_size, int protocol) {
+        if (protocol != static_cast<int>(CoherenceProtocol::MSI) && protocol != static_cast<int>(CoherenceProtocol::MESI)) {
+            return nullptr;
+        }
+        try {
+            return new MultiHart(num_harts, mem_size, static_cast<CoherenceProtocol>(protocol));
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    SIMULATOR_API void MultiHart_delete(void* multi_ptr) {
+        delete static_cast<MultiHart*>(multi_ptr);
+    }
+
+    SIMULATOR_API void MultiHart_load_program_from_assembly(void* multi_ptr, const char* assembly_code) {
+        if (!multi_ptr || !assembly_code) return;
+        static_cast<MultiHart*>(multi_ptr)->load_program(assembly_code);
+    }
+
+    SIMULATOR_API void MultiHart_reset(void* multi_ptr) {
+        if (!multi_ptr) return;
+        static_cast<MultiHart*>(multi_ptr)->reset();
+    }
+
+    SIMULATOR_API void MultiHart_step(void* multi_ptr) {
+        if (!multi_ptr) return;
+        static_cast<MultiHart*>(multi_ptr)->step();
+    }
+
+    SIMULATOR_API size_t MultiHart_run(void* multi_ptr, size_t max_steps) {
+        if (!multi_ptr) return 0;
+        return static_cast<MultiHart*>(multi_ptr)->run(max_steps);
+    }
+
+    // Devuelve el hart como un simulador para usarlo con las funciones Simulator_*
+    // (estado, registros...). Pertenece al MultiHart: no se debe liberar.
+    SIMULATOR_API void* MultiHart_get_hart(void* multi_ptr, size_t index) {
+        if (!multi_ptr) return nullptr;
+        try {
+            return &static_cast<MultiHart*>(multi_ptr)->hart(index);
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    // Lectura coherente de una palabra de la memoria compartida.
+    SIMULATOR_API bool MultiHart_read_word(void* multi_ptr, uint32_t address, uint32_t* value) {
+        if (!multi_ptr || !value) return false;
+        try {
+            *value = static_cast<MultiHart*>(multi_ptr)->read_word(address);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    SIMULATOR_API const char* MultiHart_get_coherence_stats(void* multi_ptr) {
+        if (!multi_ptr) return "{}";
+        MultiHart* multi = static_cast<MultiHart*>(multi_ptr);
+        const CoherenceBus& bus = multi->get_bus();
+        const CoherenceStats& stats = bus.get_stats();
+        thread_local static std::string json_str;
+
+        // Los bloques con más invalidaciones por falso compartir, primero.
+        std::vector<std::pair<uint32_t, uint64_t>> blocks(bus.get_false_sharing().begin(), bus.get_false_sharing().end());
+        std::stable_sort(blocks.begin(), blocks.end(),
+                         [](const auto& a, const auto& b) { return a.second > b.second; });
+        if (blocks.size() > FALSE_SHARING_REPORT) blocks.resize(FALSE_SHARING_REPORT);
+        json false_sharing = json::array();
+        for (const auto& [block, events] : blocks) {
+            false_sharing.push_back({{"address", block}, {"events", events}});
+        }
+
+        json harts = json::array();
+        for (size_t i = 0; i < multi->size(); ++i) {
+            const Simulator& hart = multi->hart(i);
+            harts.push_back({
+                {"pc", hart.get_pc()},
+                {"cycles", hart.get_cache_cycles()},
+                {"dcache", jsonFromCache(hart.get_cache(CacheId::Data))},
+            });
+        }
+
+        json j = {
+            {"protocol", bus.get_protocol() == CoherenceProtocol::MSI ? "msi" : "mesi"},
+            {"bus_reads", stats.bus_reads},
+            {"bus_read_exclusive", stats.bus_read_exclusive},
+            {"bus_upgrades", stats.bus_upgrades},
+            {"interventions", stats.interventions},
+            {"invalidations", stats.invalidations},
+            {"writebacks", stats.writebacks},
+            {"coherence_misses", stats.coherence_misses},
+            {"false_sharing_events", stats.false_sharing},
+            {"false_sharing", false_sharing},
+            {"harts", harts},
+        };
+        json_str = j.dump();
+        return json_str.c_str();
+    }
+
+    // --- Sesiones (SessionRegistry) ---
+
+    SIMULATOR_API bool SessionRegistry_create(const char* session_id, int model_type, size_t mem_size) {
+        if (!session_id) return false;
+        try {
+            return session_registry().create(session_id, static_cast<PipelineModel>(model_type), mem_size);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    SIMULATOR_API bool SessionRegistry_fork(const char* session_id, const char* parent_id) {
+        if (!session_id || !parent_id) return false;
+        try {
+            return session_registry().fork(session_id, parent_id);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    // Simulador de la sesión para usarlo con las funciones Simulator_*, o
+    // nullptr si no existe (o no se pudo restaurar). Vale hasta el release.
+    SIMULATOR_API void* SessionRegistry_acquire(const char* session_id) {
+        if (!session_id) return nullptr;
+        try {
+            return session_registry().acquire(session_id);
+        } catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    SIMULATOR_API void SessionRegistry_release(const char* session_id) {
+        if (session_id) session_registry().release(session_id);
+    }
+
+    SIMULATOR_API bool SessionRegistry_remove(const char* session_id) {
+        return session_id && session_registry().remove(session_id);
+    }
+
+    SIMULATOR_API bool SessionRegistry_hibernate(const char* session_id) {
+        return session_id && session_registry().hibernate(session_id);
+    }
+
+    SIMULATOR_API size_t SessionRegistry_collect() {
+        return session_registry().collect();
+    }
+
+    // Presupuesto de memoria de las sesiones residentes y segundos de
+    // inactividad tras los que se hibernan.
+    SIMULATOR_API void SessionRegistry_configure(size_t budget_bytes, uint32_t idle_seconds) {
+        session_registry().set_budget(budget_bytes);
+        session_registry().set_idle_timeout(std::chrono::seconds(idle_seconds));
+    }
+
+    SIMULATOR_API void SessionRegistry_set_log_directory(const char* directory) {
+        session_registry().set_log_directory(directory ? directory : "");
+    }
+
+    SIMULATOR_API const char* SessionRegistry_get_stats() {
+        const SessionStats stats = session_registry().get_stats();
+        thread_local static std::string json_str;
+        json j = {
+            {"sessions", stats.sessions},
+            {"resident", stats.resident},
+            {"hibernated", stats.hibernated},
+            {"resident_bytes", stats.resident_bytes},
+            {"hibernated_bytes", stats.hibernated_bytes},
+            {"budget_bytes", stats.budget_bytes},
+            {"hibernations", stats.hibernations},
+            {"resumes", stats.resumes},
+        };
+        json_str = j.dump();
+        return json_str.c_str();
+    }
 
-}
\ No newline at end of file
+}
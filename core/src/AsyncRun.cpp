@@ -0,0 +1,75 @@
+#include "Simulator.h"
+#include <mutex>
+#include <shared_mutex>
+
+// Ejecución en segundo plano: cada run_async lanza un hilo que toma el
+// cerrojo exclusivo del simulador, como cualquier llamada de la API, y
+// ejecuta stepsUntil publicando el avance tras cada paso. Quien la espera no
+// ocupa ningún hilo mientras tanto.
+
+bool Simulator::run_async(std::vector<uint32_t> breakpoints) {
+    std::lock_guard<std::mutex> lock(run_mutex);
+    if (run_active.load()) return false;
+    if (run_thread.joinable()) run_thread.join(); // La anterior ya terminó
+    run_cancel = false;
+    run_failed = false;
+    run_steps = 0;
+    run_active = true;
+    try {
+        run_thread = std::thread([this, breakpoints = std::move(breakpoints)]() {
+            std::unique_lock<std::shared_mutex> state(state_mutex);
+            run_pc = pc;
+            try {
+                int steps = 0;
+                if (!run_cancel.load()) {
+                    steps = stepsUntil(breakpoints, [this](int done) {
+                        run_steps = done;
+                        run_pc = pc;
+                        return !run_cancel.load();
+                    });
+                }
+                // El último paso (breakpoint o bucle) no pasa por el callback.
+                run_steps = steps;
+            } catch (const std::exception& e) {
+                // Fuera del hilo nadie la recogería (sería std::terminate): queda
+                // en el avance, con los pasos del último callback, y en el log.
+                run_failed = true;
+                if (m_logfile.is_open()) m_logfile << "Ejecución en segundo plano interrumpida: " << e.what() << std::endl;
+            } catch (...) {
+                run_failed = true;
+            }
+            run_pc = pc;
+            state.unlock();
+            run_active = false;
+        });
+    } catch (...) {
+        run_active = false;
+        throw;
+    }
+    return true;
+}
+
+RunProgress Simulator::poll_run() const {
+    RunProgress progress;
+    // run_active se lee primero: si ya es false, los pasos y el PC son los finales.
+    progress.running = run_active.load();
+    progress.cancelled = run_cancel.load();
+    progress.failed = run_failed.load();
+    progress.steps = run_steps.load();
+    progress.pc = run_pc.load();
+    return progress;
+}
+
+void Simulator::cancel_run() {
+    if (run_active.load()) run_cancel = true;
+}
+
+void Simulator::wait_run() {
+    std::lock_guard<std::mutex> lock(run_mutex);
+    if (run_thread.joinable()) run_thread.join();
+}
+
+Simulator::~Simulator() {
+    cancel_run();
+    wait_run();
+}
@@ -1,22 +1,24 @@
 #include "Cache.h"
 #include "Memory.h" // Se necesita la definición completa para usar sus métodos
+#include "StateSave.h"
 #include <stdexcept>
-#include <cmath> // Para log2
+#include <algorithm>
 
 // --- Implementación de CacheLine ---
 CacheLine::CacheLine(size_t block_size) : data(block_size, 0) {}
 
 
-// --- Funciones de ayuda para la descomposición de direcciones ---
+// --- Funciones de ayuda ---
 // Se mantienen internas a este fichero.
 namespace {
-    uint32_t get_tag(uint32_t address, uint32_t offset_bits, uint32_t index_bits) {
-        return address >> (offset_bits + index_bits);
+    bool is_power_of_two(size_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
     }
 
-    uint32_t get_index(uint32_t address, uint32_t offset_bits, uint32_t num_lines) {
-        // Usar (num_lines - 1) como máscara funciona porque num_lines es una potencia de 2.
-        return (address >> offset_bits) & (num_lines - 1);
+    uint32_t log2_exact(size_t value) {
+        uint32_t bits = 0;
+        while ((static_cast<size_t>(1) << bits) < value) ++bits;
+        return bits;
     }
 }
 
@@ -24,80 +26,608 @@ namespace {
 // --- Implementación de la Clase Base Cache ---
 
 Cache::Cache(size_t cache_size, size_t block_size, Memory& main_memory)
-    : block_size(block_size), memory(main_memory) {
+    : block_size(block_size), memory(&main_memory) {
+    set_capacity(cache_size);
+}
+
+void Cache::set_capacity(size_t cache_size) {
     if (cache_size == 0 || block_size == 0 || (cache_size % block_size) != 0) {
         throw std::invalid_argument("El tamaño de la caché debe ser un múltiplo no nulo del tamaño del bloque.");
     }
+    if (!is_power_of_two(block_size)) {
+        throw std::invalid_argument("El tamaño del bloque debe ser una potencia de 2.");
+    }
     num_lines = cache_size / block_size;
     // El esquema de indexación simple requiere que el número de líneas sea una potencia de 2.
-    if ((num_lines & (num_lines - 1)) != 0 && num_lines != 0) {
+    if (!is_power_of_two(num_lines)) {
         throw std::invalid_argument("El número de líneas de la caché debe ser una potencia de 2.");
     }
+    offset_bits = log2_exact(block_size);
+    index_bits = log2_exact(num_lines);
 
+    lines.clear();
     lines.reserve(num_lines);
     for(size_t i = 0; i < num_lines; ++i) {
         lines.emplace_back(block_size);
     }
+    reset();
+}
+
+void Cache::reset() {
+    for (auto& line : lines) {
+        line.valid = false;
+        line.prefetched = false;
+        line.prefetcher = -1;
+        line.ready_at = 0;
+        line.state = CoherenceState::Invalid;
+        line.invalidated = false;
+        line.access_mask = 0;
+    }
+    for (auto& victim : victims) victim.valid = false;
+    write_buffer.clear();
+    write_buffer_head_done = 0;
+    mshrs.clear();
+    victim_clock = 0;
+    stats = {};
+    now = 0;
+    last_latency = CACHE_HIT_CYCLES;
+    for (auto& prefetcher : prefetchers) prefetcher->reset();
+}
+
+void Cache::tick(uint64_t cycle) {
+    // Paralelismo de memoria: todos los fallos pendientes empezaron antes de
+    // `now`, así que los ciclos ocupados son los del que termina más tarde.
+    if (cycle > now && !mshrs.empty()) {
+        uint64_t busy = 0;
+        for (const auto& mshr : mshrs) {
+            const uint64_t end = std::min(mshr.ready_at, cycle);
+            if (end <= now) continue;
+            stats.outstanding_sum += end - now;
+            busy = std::max(busy, end - now);
+        }
+        stats.outstanding_cycles += busy;
+    }
+    now = cycle;
+    mshrs.erase(std::remove_if(mshrs.begin(), mshrs.end(),
+                               [this](const Mshr& mshr) { return mshr.ready_at <= now; }),
+                mshrs.end());
+
+    // El buffer se vuelca en segundo plano: una entrada por latencia de memoria.
+    while (!write_buffer.empty() && write_buffer_head_done <= now) {
+        drain_head();
+    }
+}
+
+void Cache::set_write_buffer_entries(size_t entries) {
+    flush();
+    write_buffer_entries = entries;
+}
+
+void Cache::set_victim_entries(size_t entries) {
+    victims.assign(entries, VictimLine{});
+    for (auto& victim : victims) victim.data.assign(block_size, 0);
+}
+
+void Cache::set_mshr_entries(size_t entries) {
+    mshr_entries = entries;
+    mshrs.clear();
+}
+
+bool Cache::can_accept(uint32_t address) const {
+    if (mshr_entries == 0 || mshrs.size() < mshr_entries) return true;
+    const uint32_t block = address & ~(static_cast<uint32_t>(block_size) - 1);
+    for (const auto& mshr : mshrs) {
+        if (mshr.block == block) return true; // Se fusionaría
+    }
+    const CacheLine& line = lines[get_index(address)];
+    return line.valid && line.tag == get_tag(address);
+}
+
+void Cache::set_backing_memory(Memory& main_memory) {
+    memory = &main_memory;
+    reset();
+}
+
+void Cache::flush() {
+    while (!write_buffer.empty()) drain_head();
+}
+
+void Cache::apply_pending_writes(Memory& target) const {
+    for (const WriteBufferEntry& entry : write_buffer) target.write_block(entry.block, entry.data, entry.mask);
+}
+
+uint32_t Cache::peek(uint32_t address, unsigned bytes) const {
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+        const uint32_t byte_address = address + i;
+        const uint32_t block = byte_address & ~(static_cast<uint32_t>(block_size) - 1);
+        uint32_t byte = memory->read_byte(byte_address);
+        // La entrada más reciente del bloque es la última de la cola.
+        for (const WriteBufferEntry& entry : write_buffer) {
+            if (entry.block == block && entry.mask[byte_address - block]) byte = entry.data[byte_address - block];
+        }
+        value |= byte << (8 * i);
+    }
+    return value;
+}
+
+void Cache::invalidate() {
+    for (auto& line : lines) {
+        line.valid = false;
+        line.prefetched = false;
+        line.prefetcher = -1;
+        line.state = CoherenceState::Invalid;
+        line.invalidated = false;
+        line.access_mask = 0;
+    }
+    for (auto& victim : victims) victim.valid = false;
+    write_buffer.clear();
+    mshrs.clear();
+}
+
+void Cache::drain_head() {
+    const WriteBufferEntry& head = write_buffer.front();
+    memory->write_block(head.block, head.data, head.mask);
+    write_buffer.pop_front();
+    stats.write_buffer_drains++;
+    // La siguiente entrada empieza a volcarse cuando termina la anterior.
+    if (!write_buffer.empty()) {
+        const uint64_t start = write_buffer_head_done;
+        write_buffer_head_done = start + memory->access_cycles(write_buffer.front().block, true, start);
+    }
+}
+
+void Cache::add_prefetcher(std::unique_ptr<Prefetcher> prefetcher) {
+    if (!prefetcher) return;
+    prefetcher->set_block_size(block_size);
+    prefetchers.push_back(std::move(prefetcher));
+}
+
+void Cache::clear_prefetchers() {
+    // Las líneas prebuscadas pendientes dejan de atribuirse a nadie.
+    for (auto& line : lines) {
+        line.prefetched = false;
+        line.prefetcher = -1;
+    }
+    prefetchers.clear();
 }
 
 void Cache::load_block_from_memory(uint32_t address, uint32_t index, uint32_t tag) {
     // Calcula la dirección de inicio del bloque en la memoria principal.
     uint32_t block_start_address = address & ~(static_cast<uint32_t>(block_size) - 1);
-    
+
     // Lee el bloque completo desde la memoria al buffer de datos de la línea de caché.
-    memory.read_block(block_start_address, lines[index].data);
-    
+    memory->read_block(block_start_address, lines[index].data);
+
+    // Las escrituras aún en el buffer son más recientes que la memoria.
+    for (const auto& entry : write_buffer) {
+        if (entry.block != block_start_address) continue;
+        for (size_t i = 0; i < block_size; ++i) {
+            if (entry.mask[i]) lines[index].data[i] = entry.data[i];
+        }
+    }
+
     // Actualiza los metadatos de la línea de caché.
     lines[index].valid = true;
     lines[index].tag = tag;
+    lines[index].prefetched = false;
+    lines[index].prefetcher = -1;
+    lines[index].ready_at = now;
+    lines[index].state = CoherenceState::Shared; // El llamador fija el estado definitivo
+    lines[index].invalidated = false;
+    lines[index].access_mask = 0;
+}
+
+Cache::VictimLine* Cache::find_victim(uint32_t block) {
+    for (auto& victim : victims) {
+        if (victim.valid && victim.block == block) return &victim;
+    }
+    return nullptr;
 }
 
-uint32_t Cache::read_word(uint32_t address) {
-    // Descompone la dirección en tag, índice y offset.
-    const uint32_t offset_bits = static_cast<uint32_t>(log2(block_size));
-    const uint32_t index_bits = static_cast<uint32_t>(log2(num_lines));
+void Cache::replace_line(uint32_t address, uint32_t index, uint32_t tag) {
+    CacheLine& line = lines[index];
+    retire_line(line);
 
-    const uint32_t index = get_index(address, offset_bits, num_lines);
-    const uint32_t tag = get_tag(address, offset_bits, index_bits);
-    const uint32_t offset = address & (static_cast<uint32_t>(block_size) - 1);
+    if (bus) {
+        // Write-back: una línea modificada se vuelca al expulsarla. Se supone
+        // un buffer de expulsión, así que no añade latencia al fallo.
+        if (line.valid && line.state == CoherenceState::Modified) {
+            memory->write_block(block_address(index), line.data);
+            bus->count_writeback();
+        }
+    } else if (line.valid && !victims.empty()) {
+        // Se guarda en la entrada libre o en la menos usada recientemente.
+        VictimLine* slot = &victims[0];
+        for (auto& victim : victims) {
+            if (!victim.valid) { slot = &victim; break; }
+            if (victim.last_use < slot->last_use) slot = &victim;
+        }
+        slot->valid = true;
+        slot->block = block_address(index);
+        slot->data = line.data;
+        slot->last_use = ++victim_clock;
+    }
+
+    load_block_from_memory(address, index, tag);
+}
+
+void Cache::retire_line(CacheLine& line) {
+    if (line.valid && line.prefetched && line.prefetcher >= 0 &&
+        static_cast<size_t>(line.prefetcher) < prefetchers.size()) {
+        prefetchers[line.prefetcher]->stats().useless++;
+    }
+    line.prefetched = false;
+    line.prefetcher = -1;
+}
+
+bool Cache::access(uint32_t address, bool allocate) {
+    const uint32_t index = get_index(address);
+    const uint32_t tag = get_tag(address);
+    CacheLine& line = lines[index];
 
-    // Comprueba si hay un acierto de caché (cache hit).
-    if (!lines[index].valid || lines[index].tag != tag) {
-        // Fallo de caché (cache miss): Carga el bloque necesario desde la memoria principal.
-        load_block_from_memory(address, index, tag);
+    last_latency = CACHE_HIT_CYCLES;
+    missed = false;
+    bool trigger = false;
+
+    if (line.valid && line.tag == tag) {
+        // Acierto. Si el bloque lo trajo un prebuscador, es su primer uso:
+        // se contabiliza como útil o tardío según haya llegado ya o no.
+        if (line.prefetched) {
+            if (line.prefetcher >= 0 && static_cast<size_t>(line.prefetcher) < prefetchers.size()) {
+                PrefetchStats& counters = prefetchers[line.prefetcher]->stats();
+                if (line.ready_at > now) {
+                    counters.late++;
+                } else {
+                    counters.useful++;
+                }
+            }
+            if (line.ready_at > now) {
+                last_latency += static_cast<uint32_t>(line.ready_at - now);
+            }
+            line.prefetched = false;
+            line.prefetcher = -1;
+            trigger = true; // Prebúsqueda "etiquetada": el primer uso vuelve a disparar
+        } else if (line.ready_at > now) {
+            // El bloque aún está llegando: fallo secundario, se espera al mismo relleno.
+            last_latency += static_cast<uint32_t>(line.ready_at - now);
+            if (mshr_entries > 0) stats.mshr_secondary++;
+        }
+        return trigger;
     }
 
-    // Acierto de caché: Ensambla la palabra desde los datos de la línea de caché (little-endian).
+    trigger = true;
+    if (!allocate) return trigger;
+
+    const uint32_t block = address & ~(static_cast<uint32_t>(block_size) - 1);
+    bool shared = false;
+    if (bus) {
+        // Fallo de coherencia: la etiqueta sigue ahí, pero otro hart la invalidó.
+        if (line.invalidated && line.tag == tag) bus->count_coherence_miss();
+        shared = bus->read(*this, block);
+    } else if (VictimLine* victim = find_victim(block)) {
+        // Acierto en la caché de víctimas: se intercambia con la línea del array.
+        stats.victim_hits++;
+        retire_line(line);
+        std::vector<uint8_t> data = std::move(victim->data);
+        if (line.valid) {
+            victim->block = block_address(index);
+            victim->data = std::move(line.data);
+            victim->last_use = ++victim_clock;
+        } else {
+            victim->valid = false;
+            victim->data.assign(block_size, 0);
+        }
+        line.data = std::move(data);
+        line.valid = true;
+        line.tag = tag;
+        line.ready_at = now;
+        last_latency += VICTIM_HIT_CYCLES;
+        return trigger;
+    }
+
+    // Fallo de caché (cache miss): Carga el bloque necesario desde la memoria principal.
+    replace_line(address, index, tag);
+    const uint32_t fill_cycles = memory->access_cycles(block, false, now);
+    last_latency += fill_cycles;
+    line.ready_at = now + fill_cycles;
+    missed = true;
+    if (bus) {
+        const bool exclusive = !shared && bus->get_protocol() == CoherenceProtocol::MESI;
+        line.state = exclusive ? CoherenceState::Exclusive : CoherenceState::Shared;
+    }
+
+    if (mshr_entries > 0) {
+        // Sin MSHR libre el llamador debería haber esperado (can_accept); aun
+        // así se atiende para no perder el dato.
+        bool merged = false;
+        for (const auto& mshr : mshrs) {
+            if (mshr.block == block) { merged = true; break; }
+        }
+        if (merged) {
+            stats.mshr_secondary++;
+        } else {
+            mshrs.push_back(Mshr{block, line.ready_at});
+            stats.mshr_primary++;
+            stats.max_outstanding = std::max<uint64_t>(stats.max_outstanding, mshrs.size());
+        }
+    }
+    return trigger;
+}
+
+void Cache::issue_prefetches(uint32_t address, std::optional<uint32_t> pc, bool miss) {
+    // Los bloques prebuscados no pasan por el bus: con coherencia no se prebusca.
+    if (bus) return;
+    for (size_t p = 0; p < prefetchers.size(); ++p) {
+        prefetch_candidates.clear();
+        prefetchers[p]->on_access(address, pc, miss, prefetch_candidates);
+
+        for (uint32_t block : prefetch_candidates) {
+            // No se prebusca fuera de la memoria física.
+            if (static_cast<uint64_t>(block) + block_size > memory->size()) continue;
+
+            const uint32_t index = get_index(block);
+            const uint32_t tag = get_tag(block);
+            CacheLine& line = lines[index];
+            if (line.valid && line.tag == tag) continue; // Ya está en la caché
+            if (find_victim(block)) continue;
+
+            replace_line(block, index, tag);
+            line.prefetched = true;
+            line.prefetcher = static_cast<int8_t>(p);
+            line.ready_at = now + memory->access_cycles(block, false, now);
+            prefetchers[p]->stats().issued++;
+        }
+    }
+}
+
+uint32_t Cache::read_word(uint32_t address, std::optional<uint32_t> pc) {
+    return read(address, 4, pc);
+}
+
+uint32_t Cache::read(uint32_t address, unsigned bytes, std::optional<uint32_t> pc) {
+    const uint32_t offset = address & (static_cast<uint32_t>(block_size) - 1);
+    if (offset + bytes > block_size) {
+        // Acceso desalineado que cruza bloques: dos accesos, latencias sumadas.
+        const unsigned low_bytes = static_cast<unsigned>(block_size - offset);
+        const uint32_t low = read(address, low_bytes, pc);
+        const uint32_t low_latency = last_latency;
+        const uint32_t high = read(address + low_bytes, bytes - low_bytes, pc);
+        last_latency += low_latency;
+        return low | (high << (8 * low_bytes));
+    }
+
+    stats.reads++;
+    const uint32_t index = get_index(address);
+
+    const bool trigger = access(address, true);
+    if (missed) stats.read_misses++;
+    stats.stall_cycles += last_latency - CACHE_HIT_CYCLES;
+
+    // Ensambla el dato desde los datos de la línea de caché (little-endian).
+    CacheLine& line = lines[index];
+    line.access_mask |= word_bit(address);
     uint32_t word = 0;
-    word |= static_cast<uint32_t>(lines[index].data[offset + 0]) << 0;
-    word |= static_cast<uint32_t>(lines[index].data[offset + 1]) << 8;
-    word |= static_cast<uint32_t>(lines[index].data[offset + 2]) << 16;
-    word |= static_cast<uint32_t>(lines[index].data[offset + 3]) << 24;
+    for (unsigned i = 0; i < bytes; ++i) {
+        word |= static_cast<uint32_t>(line.data[offset + i]) << (8 * i);
+    }
+
+    // Solo las lecturas entrenan a los prebuscadores. Se disparan después de
+    // leer la palabra porque una prebúsqueda puede sustituir esta misma línea.
+    issue_prefetches(address, pc, trigger);
     return word;
 }
 
-void Cache::write_word(uint32_t address, uint32_t value) {
-    // Política Write-Through: siempre escribe el dato en la memoria principal.
-    memory.write_word(address, value);
+void Cache::buffer_write(uint32_t address, uint32_t value, unsigned bytes) {
+    const uint32_t block = address & ~(static_cast<uint32_t>(block_size) - 1);
+    const uint32_t offset = address - block;
+    if (offset + bytes > block_size) {
+        // Cada entrada guarda un solo bloque: lo que cruza va a dos entradas.
+        const unsigned low_bytes = static_cast<unsigned>(block_size - offset);
+        buffer_write(address, value, low_bytes);
+        buffer_write(address + low_bytes, value >> (8 * low_bytes), bytes - low_bytes);
+        return;
+    }
+
+    // Fusión: si ya hay una entrada pendiente para el bloque, se reutiliza.
+    WriteBufferEntry* entry = nullptr;
+    for (auto& pending : write_buffer) {
+        if (pending.block == block) { entry = &pending; break; }
+    }
+
+    if (entry) {
+        stats.write_buffer_coalesced++;
+    } else {
+        if (write_buffer.size() >= write_buffer_entries) {
+            // Buffer lleno: hay que esperar a que termine de volcarse la cabeza.
+            const uint64_t wait = write_buffer_head_done > now ? write_buffer_head_done - now : 0;
+            stats.write_buffer_full_stalls++;
+            stats.write_buffer_stall_cycles += wait;
+            last_latency += static_cast<uint32_t>(wait);
+            drain_head();
+        }
+        if (write_buffer.empty()) {
+            const uint64_t start = now + last_latency - CACHE_HIT_CYCLES;
+            write_buffer_head_done = start + memory->access_cycles(block, true, start);
+        }
+        write_buffer.push_back(WriteBufferEntry{block, std::vector<uint8_t>(block_size, 0), std::vector<uint8_t>(block_size, 0)});
+        entry = &write_buffer.back();
+    }
+
+    for (unsigned i = 0; i < bytes; ++i) {
+        entry->data[offset + i] = (value >> (8 * i)) & 0xFF;
+        entry->mask[offset + i] = 1;
+    }
+}
+
+void Cache::write_word(uint32_t address, uint32_t value, std::optional<uint32_t> pc) {
+    write(address, value, 4, pc);
+}
+
+void Cache::write(uint32_t address, uint32_t value, unsigned bytes, std::optional<uint32_t> pc) {
+    const uint32_t block_offset = address & (static_cast<uint32_t>(block_size) - 1);
+    if (block_offset + bytes > block_size) {
+        const unsigned low_bytes = static_cast<unsigned>(block_size - block_offset);
+        write(address, value, low_bytes, pc);
+        const uint32_t low_latency = last_latency;
+        write(address + low_bytes, value >> (8 * low_bytes), bytes - low_bytes, pc);
+        last_latency += low_latency;
+        return;
+    }
+    if (bus) {
+        coherent_write(address, value, bytes);
+        return;
+    }
+    stats.writes++;
+    last_latency = CACHE_HIT_CYCLES;
+
+    // Política Write-Through: el dato siempre acaba en la memoria principal,
+    // directamente o a través del buffer de escritura.
+    if (write_buffer_entries > 0) {
+        if (static_cast<uint64_t>(address) + bytes > memory->size()) {
+            throw std::out_of_range("Memory write access out of bounds");
+        }
+        buffer_write(address, value, bytes);
+    } else {
+        switch (bytes) {
+            case 1: memory->write_byte(address, static_cast<uint8_t>(value)); break;
+            case 2: memory->write_half(address, static_cast<uint16_t>(value)); break;
+            default: memory->write_word(address, value); break;
+        }
+        // La escritura síncrona en memoria domina la latencia del store.
+        last_latency += memory->access_cycles(address, true, now);
+    }
 
     // Ahora, manejamos la caché. Con una política No-Write-Allocate, solo
     // nos importa si hay un acierto de escritura (write hit) para mantener la consistencia.
-    const uint32_t offset_bits = static_cast<uint32_t>(log2(block_size));
-    const uint32_t index_bits = static_cast<uint32_t>(log2(num_lines));
-
-    const uint32_t index = get_index(address, offset_bits, num_lines);
-    const uint32_t tag = get_tag(address, offset_bits, index_bits);
+    const uint32_t index = get_index(address);
+    const uint32_t tag = get_tag(address);
     const uint32_t offset = address & (static_cast<uint32_t>(block_size) - 1);
 
-    // Comprueba si hay un acierto de caché (write hit).
+    std::vector<uint8_t>* data = nullptr;
     if (lines[index].valid && lines[index].tag == tag) {
         // Write Hit: Actualiza el dato en la línea de caché.
-        lines[index].data[offset + 0] = (value >> 0) & 0xFF;
-        lines[index].data[offset + 1] = (value >> 8) & 0xFF;
-        lines[index].data[offset + 2] = (value >> 16) & 0xFF;
-        lines[index].data[offset + 3] = (value >> 24) & 0xFF;
+        const uint32_t latency = last_latency;
+        access(address, false);
+        last_latency = latency;
+        data = &lines[index].data;
+    } else {
+        // Si es un fallo (write miss), no se reserva línea (No-Write-Allocate),
+        // pero la copia de la caché de víctimas debe seguir siendo coherente.
+        stats.write_misses++;
+        if (VictimLine* victim = find_victim(address & ~(static_cast<uint32_t>(block_size) - 1))) {
+            data = &victim->data;
+        }
+    }
+    if (data) {
+        for (unsigned i = 0; i < bytes; ++i) {
+            (*data)[offset + i] = (value >> (8 * i)) & 0xFF;
+        }
+    }
+
+    stats.stall_cycles += last_latency - CACHE_HIT_CYCLES;
+}
+
+// --- Coherencia ---
+
+uint64_t Cache::word_bit(uint32_t address) const {
+    const uint32_t word = (address & (static_cast<uint32_t>(block_size) - 1)) / 4;
+    return word < 64 ? (static_cast<uint64_t>(1) << word) : 0;
+}
+
+void Cache::coherent_write(uint32_t address, uint32_t value, unsigned bytes) {
+    stats.writes++;
+    last_latency = CACHE_HIT_CYCLES;
+
+    if (static_cast<uint64_t>(address) + bytes > memory->size()) {
+        throw std::out_of_range("Memory write access out of bounds");
+    }
+
+    const uint32_t index = get_index(address);
+    const uint32_t tag = get_tag(address);
+    const uint32_t block = address & ~(static_cast<uint32_t>(block_size) - 1);
+    const uint32_t offset = address - block;
+    const uint32_t word = offset / 4;
+    CacheLine& line = lines[index];
+
+    if (line.valid && line.tag == tag) {
+        if (line.ready_at > now) {
+            last_latency += static_cast<uint32_t>(line.ready_at - now);
+        }
+        // E -> M es silencioso; S -> M necesita invalidar las demás copias.
+        if (line.state == CoherenceState::Shared) {
+            bus->upgrade(*this, block, word);
+            last_latency += COHERENCE_BUS_CYCLES;
+        }
+    } else {
+        // Write-allocate: se trae el bloque en exclusiva (BusRdX).
+        stats.write_misses++;
+        if (line.invalidated && line.tag == tag) bus->count_coherence_miss();
+        bus->read_exclusive(*this, block, word);
+        replace_line(address, index, tag);
+        const uint32_t fill_cycles = memory->access_cycles(block, false, now);
+        last_latency += fill_cycles;
+        line.ready_at = now + fill_cycles;
+    }
+
+    line.state = CoherenceState::Modified;
+    line.access_mask |= word_bit(address);
+    for (unsigned i = 0; i < bytes; ++i) {
+        line.data[offset + i] = (value >> (8 * i)) & 0xFF;
+    }
+
+    stats.stall_cycles += last_latency - CACHE_HIT_CYCLES;
+}
+
+CoherenceState Cache::get_line_state(uint32_t address) const {
+    const CacheLine& line = lines[get_index(address)];
+    if (!line.valid || line.tag != get_tag(address)) return CoherenceState::Invalid;
+    return line.state;
+}
+
+SnoopResult Cache::snoop(uint32_t block, bool invalidate) {
+    const uint32_t index = get_index(block);
+    CacheLine& line = lines[index];
+    if (!line.valid || line.tag != get_tag(block)) return SnoopResult{};
+
+    const SnoopResult result{line.state, line.access_mask};
+    if (line.state == CoherenceState::Modified) {
+        memory->write_block(block, line.data);
+    }
+    if (invalidate) {
+        line.valid = false;
+        line.invalidated = true;
+        line.state = CoherenceState::Invalid;
+        line.prefetched = false;
+        line.prefetcher = -1;
+    } else {
+        line.state = CoherenceState::Shared;
+    }
+    return result;
+}
+
+bool Cache::peek_modified(uint32_t address, uint32_t& value) const {
+    const CacheLine& line = lines[get_index(address)];
+    if (!line.valid || line.tag != get_tag(address) || line.state != CoherenceState::Modified) return false;
+    const uint32_t offset = address & (static_cast<uint32_t>(block_size) - 1);
+    value = 0;
+    for (uint32_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(line.data[offset + i]) << (8 * i);
+    }
+    return true;
+}
+
+void Cache::write_back_all() {
+    for (size_t index = 0; index < lines.size(); ++index) {
+        CacheLine& line = lines[index];
+        if (!line.valid || line.state != CoherenceState::Modified) continue;
+        memory->write_block(block_address(static_cast<uint32_t>(index)), line.data);
+        // Limpia: MESI la conserva en exclusiva si no hay más copias, y con
+        // una copia modificada no puede haberlas.
+        line.state = (bus && bus->get_protocol() == CoherenceProtocol::MESI) ? CoherenceState::Exclusive
+                                                                              : CoherenceState::Shared;
+        if (bus) bus->count_writeback();
     }
-    // Si es un fallo (write miss), no hacemos nada en la caché (No-Write-Allocate).
 }
 
 // --- Implementación de las clases derivadas ---
@@ -107,3 +637,146 @@ InstructionCache::InstructionCache(size_t cache_size, size_t block_size, Memory&
 
 DataCache::DataCache(size_t cache_size, size_t block_size, Memory& main_memory)
     : Cache(cache_size, block_size, main_memory) {}
+
+
+// --- Estado guardado ---
+
+namespace {
+    void read_block_bytes(StateReader& in, std::vector<uint8_t>& data, size_t size) {
+        const uint8_t* bytes = in.bytes(size);
+        data.assign(bytes, bytes + size);
+    }
+}
+
+void Cache::save_state(StateWriter& out) const {
+    out.u32(static_cast<uint32_t>(num_lines));
+    out.u32(static_cast<uint32_t>(block_size));
+    for (const CacheLine& line : lines) {
+        out.u8(line.valid);
+        out.u32(line.tag);
+        out.bytes(line.data.data(), block_size);
+        out.u8(line.prefetched);
+        out.u8(static_cast<uint8_t>(line.prefetcher));
+        out.u64(line.ready_at);
+        out.u8(static_cast<uint8_t>(line.state));
+        out.u8(line.invalidated);
+        out.u64(line.access_mask);
+    }
+    out.u64(now);
+    out.u32(last_latency);
+    out.u8(missed);
+    for (uint64_t counter : {stats.reads, stats.read_misses, stats.writes, stats.write_misses, stats.stall_cycles,
+                             stats.victim_hits, stats.write_buffer_coalesced, stats.write_buffer_drains,
+                             stats.write_buffer_full_stalls, stats.write_buffer_stall_cycles, stats.mshr_primary,
+                             stats.mshr_secondary, stats.outstanding_sum, stats.outstanding_cycles, stats.max_outstanding}) {
+        out.u64(counter);
+    }
+
+    out.u32(static_cast<uint32_t>(victims.size()));
+    for (const VictimLine& victim : victims) {
+        out.u8(victim.valid);
+        out.u32(victim.block);
+        out.bytes(victim.data.data(), block_size);
+        out.u64(victim.last_use);
+    }
+    out.u64(victim_clock);
+
+    out.u32(static_cast<uint32_t>(write_buffer_entries));
+    out.u32(static_cast<uint32_t>(write_buffer.size()));
+    for (const WriteBufferEntry& entry : write_buffer) {
+        out.u32(entry.block);
+        out.bytes(entry.data.data(), block_size);
+        out.bytes(entry.mask.data(), block_size);
+    }
+    out.u64(write_buffer_head_done);
+
+    out.u32(static_cast<uint32_t>(mshr_entries));
+    out.u32(static_cast<uint32_t>(mshrs.size()));
+    for (const Mshr& mshr : mshrs) {
+        out.u32(mshr.block);
+        out.u64(mshr.ready_at);
+    }
+
+    out.u32(static_cast<uint32_t>(prefetchers.size()));
+    for (const auto& prefetcher : prefetchers) {
+        out.u32(static_cast<uint32_t>(prefetcher->kind()));
+        out.u32(prefetcher->get_degree());
+        out.u32(prefetcher->get_distance());
+        prefetcher->save_state(out);
+    }
+}
+
+void Cache::load_state(StateReader& in) {
+    if (in.u32() != num_lines || in.u32() != block_size) {
+        throw std::runtime_error("El estado guardado es de una caché con otra geometría");
+    }
+    for (CacheLine& line : lines) {
+        line.valid = in.u8() != 0;
+        line.tag = in.u32();
+        read_block_bytes(in, line.data, block_size);
+        line.prefetched = in.u8() != 0;
+        line.prefetcher = static_cast<int8_t>(in.u8());
+        line.ready_at = in.u64();
+        const uint8_t state = in.u8();
+        if (state > static_cast<uint8_t>(CoherenceState::Modified)) {
+            throw std::runtime_error("Estado de coherencia desconocido en el estado guardado");
+        }
+        line.state = static_cast<CoherenceState>(state);
+        line.invalidated = in.u8() != 0;
+        line.access_mask = in.u64();
+    }
+    now = in.u64();
+    last_latency = in.u32();
+    missed = in.u8() != 0;
+    for (uint64_t* counter : {&stats.reads, &stats.read_misses, &stats.writes, &stats.write_misses, &stats.stall_cycles,
+                              &stats.victim_hits, &stats.write_buffer_coalesced, &stats.write_buffer_drains,
+                              &stats.write_buffer_full_stalls, &stats.write_buffer_stall_cycles, &stats.mshr_primary,
+                              &stats.mshr_secondary, &stats.outstanding_sum, &stats.outstanding_cycles, &stats.max_outstanding}) {
+        *counter = in.u64();
+    }
+
+    victims.assign(in.count(1 + 4 + block_size + 8), VictimLine{});
+    for (VictimLine& victim : victims) {
+        victim.valid = in.u8() != 0;
+        victim.block = in.u32();
+        read_block_bytes(in, victim.data, block_size);
+        victim.last_use = in.u64();
+    }
+    victim_clock = in.u64();
+
+    write_buffer_entries = in.u32();
+    write_buffer.assign(in.count(4 + 2 * block_size), WriteBufferEntry{});
+    if (write_buffer.size() > write_buffer_entries) {
+        throw std::runtime_error("El buffer de escritura guardado no cabe en sus entradas");
+    }
+    for (WriteBufferEntry& entry : write_buffer) {
+        entry.block = in.u32();
+        read_block_bytes(in, entry.data, block_size);
+        read_block_bytes(in, entry.mask, block_size);
+    }
+    write_buffer_head_done = in.u64();
+
+    mshr_entries = in.u32();
+    mshrs.assign(in.count(4 + 8), Mshr{});
+    for (Mshr& mshr : mshrs) {
+        mshr.block = in.u32();
+        mshr.ready_at = in.u64();
+    }
+
+    prefetchers.clear();
+    const uint32_t count = in.count(3 * 4);
+    for (uint32_t i = 0; i < count; ++i) {
+        const PrefetcherKind kind = static_cast<PrefetcherKind>(in.u32());
+        const unsigned degree = in.u32();
+        const unsigned distance = in.u32();
+        std::unique_ptr<Prefetcher> prefetcher = make_prefetcher(kind, degree, distance);
+        prefetcher->load_state(in);
+        add_prefetcher(std::move(prefetcher));
+    }
+    // Cada línea prebuscada apunta a uno de los prebuscadores (o a ninguno).
+    for (const CacheLine& line : lines) {
+        if (line.prefetcher < -1 || line.prefetcher >= static_cast<int>(prefetchers.size())) {
+            throw std::runtime_error("Línea de caché con un prebuscador que no existe");
+        }
+    }
+}
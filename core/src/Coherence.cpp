@@ -0,0 +1,78 @@
+#include "Coherence.h"
+#include "Cache.h"
+#include "Memory.h"
+#include <algorithm>
+
+CoherenceBus::CoherenceBus(CoherenceProtocol protocol) : protocol(protocol) {}
+
+void CoherenceBus::attach(Cache& cache) {
+    if (std::find(caches.begin(), caches.end(), &cache) != caches.end()) return;
+    cache.set_write_buffer_entries(0);
+    cache.set_victim_entries(0);
+    cache.clear_prefetchers();
+    cache.reset();
+    cache.set_coherence_bus(this);
+    caches.push_back(&cache);
+}
+
+bool CoherenceBus::read(Cache& requester, uint32_t block) {
+    stats.bus_reads++;
+    bool shared = false;
+    for (Cache* cache : caches) {
+        if (cache == &requester) continue;
+        const SnoopResult result = cache->snoop(block, false);
+        if (result.previous == CoherenceState::Invalid) continue;
+        shared = true;
+        if (result.previous == CoherenceState::Modified) {
+            stats.interventions++;
+            stats.writebacks++;
+        }
+    }
+    return shared;
+}
+
+void CoherenceBus::read_exclusive(Cache& requester, uint32_t block, uint32_t word) {
+    stats.bus_read_exclusive++;
+    invalidate_others(requester, block, word);
+}
+
+void CoherenceBus::upgrade(Cache& requester, uint32_t block, uint32_t word) {
+    stats.bus_upgrades++;
+    invalidate_others(requester, block, word);
+}
+
+void CoherenceBus::invalidate_others(Cache& requester, uint32_t block, uint32_t word) {
+    const uint64_t bit = word < 64 ? (static_cast<uint64_t>(1) << word) : 0;
+    for (Cache* cache : caches) {
+        if (cache == &requester) continue;
+        const SnoopResult result = cache->snoop(block, true);
+        if (result.previous == CoherenceState::Invalid) continue;
+        stats.invalidations++;
+        if (result.previous == CoherenceState::Modified) {
+            stats.interventions++;
+            stats.writebacks++;
+        }
+        // Falso compartir: el otro hart usaba el bloque, pero no esta palabra.
+        if (result.access_mask != 0 && (result.access_mask & bit) == 0) {
+            stats.false_sharing++;
+            false_sharing[block]++;
+        }
+    }
+}
+
+uint32_t CoherenceBus::read_word(const Memory& memory, uint32_t address) const {
+    uint32_t value = 0;
+    for (const Cache* cache : caches) {
+        if (cache->peek_modified(address, value)) return value;
+    }
+    return memory.read_word_unchecked(address);
+}
+
+void CoherenceBus::write_back_all() {
+    for (Cache* cache : caches) cache->write_back_all();
+}
+
+void CoherenceBus::reset() {
+    stats = {};
+    false_sharing.clear();
+}
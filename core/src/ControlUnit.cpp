@@ -27,7 +27,7 @@ uint32_t ControlUnit::decode(uint32_t instruction, bool Z)
 
 
 //ToDo
-const InstructionInfo* ControlUnit::decode(uint32_t instruction) {
+const InstructionInfo* ControlUnit::decode(uint32_t instruction) const {
     for (const auto& info : control_table) {
         if ((instruction & info.mask) == info.value) {
             return &info;
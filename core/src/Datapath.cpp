@@ -0,0 +1,84 @@
+#include "Datapath.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+    // Nombres de las señales en el orden de DatapathSignal.
+    struct SignalNames {
+        const char* names[DATAPATH_SIGNAL_COUNT];
+        SignalNames() {
+            static const char* const declared[DATAPATH_SIGNAL_COUNT] = {
+#define DATAPATH_SIGNAL_STRING(name) #name,
+                DATAPATH_U32_SIGNALS(DATAPATH_SIGNAL_STRING)
+                DATAPATH_U16_SIGNALS(DATAPATH_SIGNAL_STRING)
+                DATAPATH_U8_SIGNALS(DATAPATH_SIGNAL_STRING)
+                DATAPATH_BOOL_SIGNALS(DATAPATH_SIGNAL_STRING)
+#undef DATAPATH_SIGNAL_STRING
+            };
+            for (size_t i = 0; i < DATAPATH_SIGNAL_COUNT; ++i) {
+                const char* name = declared[i];
+                // Las de riesgos y cortocircuitos conservan el prefijo en el JSON.
+                const bool keeps_prefix = std::strcmp(name, "bus_stall") == 0 || std::strcmp(name, "bus_flush") == 0 ||
+                                          std::strncmp(name, "bus_ControlForward", 18) == 0 ||
+                                          std::strncmp(name, "bus_Forward", 11) == 0;
+                names[i] = (!keeps_prefix && std::strncmp(name, "bus_", 4) == 0) ? name + 4 : name;
+            }
+        }
+    };
+}
+
+const char* datapath_signal_name(DatapathSignal signal) {
+    static const SignalNames table;
+    return signal < DATAPATH_SIGNAL_COUNT ? table.names[signal] : "";
+}
+
+unsigned datapath_signal_bits(DatapathSignal signal) {
+    if (signal < DATAPATH_U16_FIRST) return 32;
+    if (signal < DATAPATH_U8_FIRST) return 16;
+    if (signal < DATAPATH_BOOL_FIRST) return 8;
+    return 1;
+}
+
+PackedDatapath::PackedDatapath() : u32{}, u16{}, u8{}, flags{} {
+    std::fill(std::begin(ready_at), std::end(ready_at), 1u);
+    std::fill(std::begin(active), std::end(active), 0);
+    for (size_t signal = 0; signal < DATAPATH_SIGNAL_COUNT; ++signal) {
+        active[signal / 64] |= static_cast<uint64_t>(1) << (signal % 64);
+    }
+}
+
+uint32_t PackedDatapath::value(DatapathSignal signal) const {
+    if (signal < DATAPATH_U16_FIRST) return u32[signal];
+    if (signal < DATAPATH_U8_FIRST) return u16[signal - DATAPATH_U16_FIRST];
+    if (signal < DATAPATH_BOOL_FIRST) return u8[signal - DATAPATH_U8_FIRST];
+    return flags[signal - DATAPATH_BOOL_FIRST];
+}
+
+void PackedDatapath::to_legacy(DatapathState& out) const {
+#define DATAPATH_TO_LEGACY(first, array, name) \
+    out.name.value = array[SIGNAL_##name - first]; \
+    out.name.ready_at = ready_at[SIGNAL_##name]; \
+    out.name.is_active = is_active(SIGNAL_##name);
+#define DATAPATH_U32_TO_LEGACY(name) DATAPATH_TO_LEGACY(0, u32, name)
+#define DATAPATH_U16_TO_LEGACY(name) DATAPATH_TO_LEGACY(DATAPATH_U16_FIRST, u16, name)
+#define DATAPATH_U8_TO_LEGACY(name) DATAPATH_TO_LEGACY(DATAPATH_U8_FIRST, u8, name)
+#define DATAPATH_BOOL_TO_LEGACY(name) DATAPATH_TO_LEGACY(DATAPATH_BOOL_FIRST, flags, name)
+    DATAPATH_U32_SIGNALS(DATAPATH_U32_TO_LEGACY)
+    DATAPATH_U16_SIGNALS(DATAPATH_U16_TO_LEGACY)
+    DATAPATH_U8_SIGNALS(DATAPATH_U8_TO_LEGACY)
+    DATAPATH_BOOL_SIGNALS(DATAPATH_BOOL_TO_LEGACY)
+#undef DATAPATH_U32_TO_LEGACY
+#undef DATAPATH_U16_TO_LEGACY
+#undef DATAPATH_U8_TO_LEGACY
+#undef DATAPATH_BOOL_TO_LEGACY
+#undef DATAPATH_TO_LEGACY
+
+    out.criticalTime = criticalTime;
+    out.total_micro_cycles = total_micro_cycles;
+    out.Pipe_IF_instruction = Pipe_IF_instruction;
+    out.Pipe_ID_instruction = Pipe_ID_instruction;
+    out.Pipe_EX_instruction = Pipe_EX_instruction;
+    out.Pipe_MEM_instruction = Pipe_MEM_instruction;
+    out.Pipe_WB_instruction = Pipe_WB_instruction;
+}
@@ -0,0 +1,120 @@
+#include "Dram.h"
+#include "StateSave.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    bool is_power_of_two(size_t value) {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    uint32_t log2_exact(size_t value) {
+        uint32_t bits = 0;
+        while ((static_cast<size_t>(1) << bits) < value) ++bits;
+        return bits;
+    }
+}
+
+Dram::Dram(const DramConfig& config) : config(config) {
+    if (!is_power_of_two(config.banks) || !is_power_of_two(config.row_size)) {
+        throw std::invalid_argument("El número de bancos y el tamaño de fila de la DRAM deben ser potencias de 2.");
+    }
+    if (config.queue_depth == 0) {
+        throw std::invalid_argument("La cola del controlador DRAM necesita al menos una entrada.");
+    }
+    column_bits = log2_exact(config.row_size);
+    bank_bits = log2_exact(config.banks);
+    banks.resize(config.banks);
+}
+
+void Dram::reset() {
+    for (auto& bank : banks) bank = Bank{};
+    bus_busy_until = 0;
+    in_flight.clear();
+    stats = {};
+}
+
+uint32_t Dram::access(uint32_t address, bool is_write, uint64_t now) {
+    if (is_write) stats.writes++; else stats.reads++;
+
+    // Cola del controlador: si está llena, se espera a que salga la más antigua.
+    while (!in_flight.empty() && in_flight.front() <= now) in_flight.pop_front();
+    uint64_t start = now;
+    if (in_flight.size() >= config.queue_depth) {
+        start = in_flight.front();
+        in_flight.pop_front();
+    }
+
+    const uint32_t bank_index = (address >> column_bits) & static_cast<uint32_t>(config.banks - 1);
+    const uint32_t row = address >> (column_bits + bank_bits);
+    Bank& bank = banks[bank_index];
+    start = std::max(start, bank.busy_until);
+
+    // Órdenes al banco según el estado del buffer de fila.
+    uint32_t command_cycles = config.t_cas;
+    if (bank.open && bank.row == row) {
+        stats.row_hits++;
+    } else if (!bank.open) {
+        stats.row_empty++;
+        command_cycles += config.t_rcd;
+    } else {
+        stats.row_conflicts++;
+        command_cycles += config.t_rp + config.t_rcd;
+    }
+
+    // El dato sale por el bus compartido en cuanto el bus queda libre.
+    const uint64_t data_start = std::max(start + command_cycles, bus_busy_until);
+    const uint64_t finish = data_start + config.t_burst;
+    bus_busy_until = finish;
+
+    if (config.policy == DramPagePolicy::Open) {
+        bank.open = true;
+        bank.row = row;
+        bank.busy_until = start + command_cycles;
+    } else {
+        // Precarga automática: el banco queda ocupado mientras se cierra la fila.
+        bank.open = false;
+        bank.busy_until = start + command_cycles + config.t_rp;
+    }
+
+    in_flight.push_back(finish);
+    std::sort(in_flight.begin(), in_flight.end());
+
+    const uint64_t latency = finish - now;
+    stats.total_latency += latency;
+    stats.queue_cycles += start - now;
+    return static_cast<uint32_t>(latency);
+}
+
+void Dram::save_state(StateWriter& out) const {
+    out.u32(static_cast<uint32_t>(banks.size()));
+    for (const Bank& bank : banks) {
+        out.u8(bank.open);
+        out.u32(bank.row);
+        out.u64(bank.busy_until);
+    }
+    out.u64(bus_busy_until);
+    out.u32(static_cast<uint32_t>(in_flight.size()));
+    for (uint64_t done : in_flight) out.u64(done);
+    for (uint64_t counter : {stats.reads, stats.writes, stats.row_hits, stats.row_empty, stats.row_conflicts,
+                             stats.total_latency, stats.queue_cycles}) {
+        out.u64(counter);
+    }
+}
+
+void Dram::load_state(StateReader& in) {
+    if (in.u32() != banks.size()) throw std::runtime_error("El estado guardado es de una DRAM con otros bancos");
+    for (Bank& bank : banks) {
+        bank.open = in.u8() != 0;
+        bank.row = in.u32();
+        bank.busy_until = in.u64();
+    }
+    bus_busy_until = in.u64();
+    in_flight.assign(in.count(8), 0);
+    if (in_flight.size() > config.queue_depth) throw std::runtime_error("El estado guardado tiene más peticiones que la cola DRAM");
+    for (uint64_t& done : in_flight) done = in.u64();
+    for (uint64_t* counter : {&stats.reads, &stats.writes, &stats.row_hits, &stats.row_empty, &stats.row_conflicts,
+                              &stats.total_latency, &stats.queue_cycles}) {
+        *counter = in.u64();
+    }
+}
@@ -0,0 +1,215 @@
+#include "Loader.h"
+#include "Config.h"
+#include "Memory.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Constantes de ELF32 que usa el cargador.
+    constexpr uint8_t ELFCLASS32 = 1;
+    constexpr uint8_t ELFDATA2LSB = 1;
+    constexpr uint16_t EM_RISCV = 243;
+    constexpr uint32_t PT_LOAD = 1;
+    constexpr size_t ELF_HEADER_SIZE = 52;
+    constexpr size_t PROGRAM_HEADER_SIZE = 32;
+
+    uint16_t read16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+    uint32_t read32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    // Coloca `count` bytes del fichero (desde `offset`) en `address`: las
+    // páginas completas se comparten y los trozos se copian.
+    void place(Memory& memory, const std::shared_ptr<MappedFile>& file, size_t offset,
+               uint32_t address, size_t count, LoadedImage& image) {
+        if (static_cast<uint64_t>(address) + count > memory.size()) {
+            throw std::invalid_argument("La imagen no cabe en la memoria.");
+        }
+        const uint8_t* source = file->data() + offset;
+        while (count > 0) {
+            const uint32_t in_page = address % PAGE_SIZE;
+            const size_t chunk = std::min<size_t>(count, PAGE_SIZE - in_page);
+            if (chunk == PAGE_SIZE) {
+                // El constructor de aliasing mantiene viva la proyección mientras
+                // la página esté en uso.
+                memory.share_page(address, std::shared_ptr<const uint8_t>(file, source));
+                image.shared_pages++;
+            } else {
+                memory.load_program(source, chunk, address);
+                image.copied_bytes += chunk;
+            }
+            address += static_cast<uint32_t>(chunk);
+            source += chunk;
+            count -= chunk;
+        }
+    }
+
+    LoadedImage load_elf(Memory& memory, const std::shared_ptr<MappedFile>& file) {
+        const uint8_t* data = file->data();
+        const size_t size = file->size();
+        if (size < ELF_HEADER_SIZE || data[4] != ELFCLASS32 || data[5] != ELFDATA2LSB) {
+            throw std::invalid_argument("Solo se admiten ficheros ELF32 little-endian.");
+        }
+        if (read16(data + 18) != EM_RISCV) {
+            throw std::invalid_argument("El ELF no es de RISC-V.");
+        }
+        LoadedImage image;
+        image.elf = true;
+        image.entry = read32(data + 24);
+        const uint32_t phoff = read32(data + 28);
+        const uint16_t phentsize = read16(data + 42);
+        const uint16_t phnum = read16(data + 44);
+        if (phnum > 0 && (phentsize < PROGRAM_HEADER_SIZE ||
+                          static_cast<uint64_t>(phoff) + static_cast<uint64_t>(phnum) * phentsize > size)) {
+            throw std::invalid_argument("Tabla de cabeceras de programa fuera del fichero.");
+        }
+        for (uint16_t i = 0; i < phnum; ++i) {
+            const uint8_t* ph = data + phoff + static_cast<size_t>(i) * phentsize;
+            if (read32(ph) != PT_LOAD) continue;
+            const uint32_t offset = read32(ph + 4);
+            const uint32_t paddr = read32(ph + 12);
+            const uint32_t filesz = read32(ph + 16);
+            const uint32_t memsz = read32(ph + 20);
+            if (static_cast<uint64_t>(offset) + filesz > size || filesz > memsz) {
+                throw std::invalid_argument("Segmento PT_LOAD fuera del fichero.");
+            }
+            if (static_cast<uint64_t>(paddr) + memsz > memory.size()) {
+                throw std::invalid_argument("La imagen no cabe en la memoria.");
+            }
+            // La parte de memsz que no está en el fichero (.bss) ya es cero.
+            place(memory, file, offset, paddr, filesz, image);
+        }
+        return image;
+    }
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("No se puede abrir " + path);
+    file->file_handle = handle;
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(handle, &length)) throw std::runtime_error("No se puede leer el tamaño de " + path);
+    file->length = static_cast<size_t>(length.QuadPart);
+    if (file->length == 0) return file;
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) throw std::runtime_error("No se puede proyectar " + path);
+    file->mapping_handle = mapping;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) throw std::runtime_error("No se puede proyectar " + path);
+    file->bytes = static_cast<const uint8_t*>(view);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("No se puede abrir " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("No se puede leer el tamaño de " + path);
+    }
+    file->length = static_cast<size_t>(info.st_size);
+    if (file->length > 0) {
+        void* view = mmap(nullptr, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("No se puede proyectar " + path);
+        }
+        file->bytes = static_cast<const uint8_t*>(view);
+    }
+    // La proyección no necesita el descriptor abierto.
+    ::close(fd);
+#endif
+    return file;
+}
+
+std::shared_ptr<MappedFile> MappedFile::open_shared(const std::string& path, size_t size) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->writable = true;
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) throw std::runtime_error("No se puede abrir " + path);
+    file->file_handle = handle;
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(handle, &length)) throw std::runtime_error("No se puede leer el tamaño de " + path);
+    // CreateFileMapping alarga el fichero si la proyección es mayor.
+    file->length = std::max(static_cast<size_t>(length.QuadPart), size);
+    if (file->length == 0) return file;
+    const uint64_t mapping_size = file->length;
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, static_cast<DWORD>(mapping_size >> 32), static_cast<DWORD>(mapping_size), nullptr);
+    if (!mapping) throw std::runtime_error("No se puede proyectar " + path);
+    file->mapping_handle = mapping;
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!view) throw std::runtime_error("No se puede proyectar " + path);
+    file->bytes = static_cast<const uint8_t*>(view);
+#else
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) throw std::runtime_error("No se puede abrir " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("No se puede leer el tamaño de " + path);
+    }
+    file->length = static_cast<size_t>(info.st_size);
+    if (size > file->length) {
+        // Sin alargarlo, acceder más allá del final del fichero provoca SIGBUS.
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("No se puede alargar " + path);
+        }
+        file->length = size;
+    }
+    if (file->length > 0) {
+        void* view = mmap(nullptr, file->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (view == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("No se puede proyectar " + path);
+        }
+        file->bytes = static_cast<const uint8_t*>(view);
+    }
+    ::close(fd);
+#endif
+    return file;
+}
+
+void MappedFile::sync() const {
+    if (!writable || !bytes) return;
+#ifdef _WIN32
+    FlushViewOfFile(bytes, 0);
+#else
+    msync(const_cast<uint8_t*>(bytes), length, MS_SYNC);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mapping_handle) CloseHandle(mapping_handle);
+    if (file_handle) CloseHandle(file_handle);
+#else
+    if (bytes) munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+}
+
+bool is_elf_image(const uint8_t* data, size_t size) {
+    return size >= 4 && data[0] == 0x7F && data[1] == 'E' && data[2] == 'L' && data[3] == 'F';
+}
+
+LoadedImage load_image(Memory& memory, const std::shared_ptr<MappedFile>& file) {
+    memory.clear();
+    if (is_elf_image(file->data(), file->size())) return load_elf(memory, file);
+    LoadedImage image;
+    place(memory, file, 0, 0, file->size(), image);
+    return image;
+}
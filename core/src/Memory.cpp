@@ -1,58 +1,406 @@
 #include "Memory.h"
+#include "Dram.h"
+#include "Loader.h"
 #include <stdexcept>
 #include <algorithm>
+#include <cstring>
 
-// Inicializa la memoria con un tamaño dado y la llena de ceros.
-Memory::Memory(size_t size_in_bytes) : mem(size_in_bytes, 0) {}
+namespace {
+    // Little-endian, como en RISC-V estándar. En un anfitrión little-endian la
+    // palabra se lee o escribe con un único acceso de 32 bits.
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+    constexpr bool HOST_LITTLE_ENDIAN = true;
+#else
+    constexpr bool HOST_LITTLE_ENDIAN = false;
+#endif
+
+    uint32_t load_le(const uint8_t* bytes, unsigned count) {
+        if (HOST_LITTLE_ENDIAN && count == 4) {
+            uint32_t word;
+            std::memcpy(&word, bytes, 4);
+            return word;
+        }
+        uint32_t value = 0;
+        for (unsigned i = 0; i < count; ++i) value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+        return value;
+    }
+
+    void store_le(uint8_t* bytes, uint32_t value, unsigned count) {
+        if (HOST_LITTLE_ENDIAN && count == 4) {
+            std::memcpy(bytes, &value, 4);
+            return;
+        }
+        for (unsigned i = 0; i < count; ++i) bytes[i] = static_cast<uint8_t>((value >> (8 * i)) & 0xFF);
+    }
+
+    // Marcas de dueño (ver Memory.h): únicas en todo el proceso.
+    uint64_t new_owner() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Inicializa la memoria con un tamaño dado. No se reserva nada hasta la
+// primera escritura: todas las páginas se leen como ceros.
+Memory::Memory(size_t size_in_bytes)
+    : size_bytes(size_in_bytes), size_is_power_of_two(size_in_bytes != 0 && (size_in_bytes & (size_in_bytes - 1)) == 0),
+      owner(new_owner()) {
+    if (static_cast<uint64_t>(size_in_bytes) > (static_cast<uint64_t>(1) << 32)) {
+        throw std::invalid_argument("La memoria no puede superar el espacio de direcciones de 32 bits.");
+    }
+    root = new_root();
+}
+
+Memory::Memory(const Memory& other)
+    : delay(other.delay), latency_cycles(other.latency_cycles), dram(other.dram),
+      size_bytes(other.size_bytes), size_is_power_of_two(other.size_is_power_of_two), pages_in_use(other.pages_in_use),
+      root(other.root), mapped_files(other.mapped_files), owner(new_owner()) {
+    // El árbol y las páginas quedan compartidos; se duplican al escribirlos.
+    // Las páginas proyectadas siguen apuntando al fichero.
+    other.owner = new_owner();
+}
+
+Memory::Memory(Memory&& other) noexcept
+    : delay(other.delay), latency_cycles(other.latency_cycles), dram(std::move(other.dram)),
+      size_bytes(other.size_bytes), size_is_power_of_two(other.size_is_power_of_two), pages_in_use(other.pages_in_use),
+      root(std::move(other.root)), mapped_files(std::move(other.mapped_files)), owner(other.owner.load()) {
+    other.owner = new_owner();
+}
+
+Memory& Memory::operator=(Memory&& other) noexcept {
+    if (this != &other) {
+        delay = other.delay;
+        latency_cycles = other.latency_cycles;
+        dram = std::move(other.dram);
+        size_bytes = other.size_bytes;
+        size_is_power_of_two = other.size_is_power_of_two;
+        pages_in_use = other.pages_in_use;
+        root = std::move(other.root);
+        mapped_files = std::move(other.mapped_files);
+        owner = other.owner.load();
+        other.owner = new_owner();
+    }
+    return *this;
+}
+
+Memory& Memory::operator=(const Memory& other) {
+    if (this != &other) {
+        Memory copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+std::shared_ptr<Memory::Root> Memory::new_root() const {
+    auto created = std::make_shared<Root>((leaf_count() + MIDDLE_LEAVES - 1) / MIDDLE_LEAVES);
+    created->owner = owner;
+    return created;
+}
 
 void Memory::clear() {
-    std::fill(mem.begin(), mem.end(), 0);
+    // Un árbol nuevo: las copias que compartían el anterior no se enteran.
+    root = new_root();
+    pages_in_use = 0;
+    mapped_files.clear();
 }
 
-// Lee 32 bits (una palabra) de una dirección de memoria.
+const Memory::PageSlot* Memory::find_slot(uint32_t page_number) const {
+    const uint32_t leaf_index = page_number >> LEAF_BITS;
+    if (!root) return nullptr;
+    const auto& middle = (*root)[leaf_index >> MIDDLE_BITS];
+    if (!middle) return nullptr;
+    const auto& leaf = (*middle)[leaf_index & (MIDDLE_LEAVES - 1)];
+    if (!leaf) return nullptr;
+    return &(*leaf)[page_number & (LEAF_PAGES - 1)];
+}
+
+void Memory::for_each_page(const std::function<void(uint32_t, const uint8_t*, size_t)>& visit) const {
+    if (!root) return;
+    for (size_t m = 0; m < root->size(); ++m) {
+        const auto& middle = (*root)[m];
+        if (!middle) continue;
+        for (size_t l = 0; l < middle->size(); ++l) {
+            const auto& leaf = (*middle)[l];
+            if (!leaf) continue;
+            for (size_t p = 0; p < leaf->size(); ++p) {
+                const uint32_t page_number = static_cast<uint32_t>(((m * MIDDLE_LEAVES + l) << LEAF_BITS) + p);
+                const uint8_t* data = page_for_read(page_number);
+                if (!data) continue;
+                const uint64_t address = static_cast<uint64_t>(page_number) * PAGE_SIZE;
+                visit(static_cast<uint32_t>(address), data, std::min<uint64_t>(PAGE_SIZE, size_bytes - address));
+            }
+        }
+    }
+}
+
+size_t Memory::shared_resident_bytes() const {
+    // Cada nivel del camino reparte lo que hay debajo entre sus dueños.
+    double bytes = 0;
+    if (!root) return 0;
+    const double root_share = 1.0 / root.use_count();
+    for (const auto& middle : *root) {
+        if (!middle) continue;
+        const double middle_share = root_share / middle.use_count();
+        for (const auto& leaf : *middle) {
+            if (!leaf) continue;
+            const double leaf_share = middle_share / leaf.use_count();
+            for (const PageSlot& slot : *leaf) {
+                if (slot.owned) bytes += leaf_share * PAGE_SIZE / slot.owned.use_count();
+            }
+        }
+    }
+    return static_cast<size_t>(bytes);
+}
+
+const uint8_t* Memory::page_for_read(uint32_t page_number) const {
+    const PageSlot* slot = find_slot(page_number);
+    if (!slot) return nullptr;
+    if (slot->owned) return slot->owned->data();
+    if (slot->mapped) return slot->mapped.get();
+    return slot->shared.get();
+}
 
-uint32_t Memory::read_word(uint32_t address, bool cyclic) {
-    if (!cyclic &&(address + 3 >= mem.size())) {
-        throw std::out_of_range("Memory read access out of bounds");
+namespace {
+    // Deja `node` listo para que lo escriba la copia `owner`: lo crea con
+    // `size` elementos si no existe o lo duplica si es de otra copia.
+    template <typename Node>
+    Node& own(std::shared_ptr<Node>& node, size_t size, uint64_t owner) {
+        if (!node) {
+            node = std::make_shared<Node>(size);
+        } else if (node->owner != owner) {
+            node = std::make_shared<Node>(*node);
+        } else {
+            return *node;
+        }
+        node->owner = owner;
+        return *node;
     }
-    else 
-        address=address%mem.size();
+}
+
+Memory::PageSlot& Memory::slot_for(uint32_t page_number) {
+    const uint32_t leaf_index = page_number >> LEAF_BITS;
+    const uint32_t middle_index = leaf_index >> MIDDLE_BITS;
+    const uint64_t self = owner;
+    Root& top = own(root, (leaf_count() + MIDDLE_LEAVES - 1) / MIDDLE_LEAVES, self);
+    Middle& middle = own(top[middle_index], std::min(MIDDLE_LEAVES, leaf_count() - static_cast<size_t>(middle_index) * MIDDLE_LEAVES), self);
+    Leaf& leaf = own(middle[leaf_index & (MIDDLE_LEAVES - 1)], std::min(LEAF_PAGES, page_count() - static_cast<size_t>(leaf_index) * LEAF_PAGES), self);
+    return leaf[page_number & (LEAF_PAGES - 1)];
+}
+
+uint8_t* Memory::page_for_write(uint32_t page_number) {
+    PageSlot& slot = slot_for(page_number);
+    if (slot.mapped) return slot.mapped.get();
+    if (slot.owned && slot.owned->owner != owner) {
+        // Copia en escritura: la página sigue siendo de la otra copia.
+        slot.owned = std::make_shared<Page>(*slot.owned);
+        slot.owned->owner = owner;
+    }
+    if (!slot.owned) {
+        slot.owned = std::make_shared<Page>(); // Inicializada a ceros
+        slot.owned->owner = owner;
+        if (slot.shared) {
+            // Primera escritura en una página compartida: copia propia.
+            std::copy(slot.shared.get(), slot.shared.get() + PAGE_SIZE, slot.owned->begin());
+            slot.shared.reset();
+        }
+        pages_in_use++;
+    }
+    return slot.owned->data();
+}
+
+void Memory::share_page(uint32_t page_address, std::shared_ptr<const uint8_t> data) {
+    if (page_address % PAGE_SIZE != 0) {
+        throw std::invalid_argument("La página compartida debe estar alineada a PAGE_SIZE.");
+    }
+    check_range(page_address, PAGE_SIZE, "Shared page out of bounds");
+    PageSlot& slot = slot_for(page_address / PAGE_SIZE);
+    if (slot.owned) pages_in_use--;
+    slot.owned.reset();
+    slot.mapped.reset();
+    slot.shared = std::move(data);
+}
+
+void Memory::map_file(const std::string& path, uint32_t base_address, size_t size) {
+    if (base_address % PAGE_SIZE != 0) {
+        throw std::invalid_argument("La región proyectada debe empezar en un límite de página.");
+    }
+    const std::shared_ptr<MappedFile> file = MappedFile::open_shared(path, size);
+    if (size == 0) size = file->size();
+    // La última página puede quedar a medias en el fichero: el sistema la
+    // completa con ceros, que no llegan al disco.
+    const size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    check_range(base_address, pages * PAGE_SIZE, "Mapped region out of bounds");
+    for (size_t i = 0; i < pages; ++i) {
+        PageSlot& slot = slot_for(base_address / PAGE_SIZE + static_cast<uint32_t>(i));
+        if (slot.owned) pages_in_use--;
+        slot.owned.reset();
+        slot.shared.reset();
+        slot.mapped = std::shared_ptr<uint8_t>(file, file->writable_data() + i * PAGE_SIZE);
+    }
+    if (pages > 0) mapped_files.push_back(file);
+}
 
-    // Asumimos little-endian, como en RISC-V estándar.
-    uint32_t word = 0;
-    word |= static_cast<uint32_t>(mem[address + 0]) << 0;
-    word |= static_cast<uint32_t>(mem[address + 1]) << 8;
-    word |= static_cast<uint32_t>(mem[address + 2]) << 16;
-    word |= static_cast<uint32_t>(mem[address + 3]) << 24;
-    return word;
+bool Memory::is_mapped(uint32_t address) const {
+    if (mapped_files.empty() || address >= size_bytes) return false;
+    const PageSlot* slot = find_slot(address / PAGE_SIZE);
+    return slot && slot->mapped;
+}
+
+void Memory::sync_mapped_files() const {
+    for (const auto& file : mapped_files) file->sync();
+}
+
+void Memory::check_range(uint64_t address, size_t count, const char* message) const {
+    if (address + count > size_bytes) {
+        throw std::out_of_range(message);
+    }
+}
+
+// Copias por tramos de página. El llamador ya ha comprobado el rango.
+void Memory::copy_out(uint32_t address, uint8_t* out, size_t count) const {
+    while (count > 0) {
+        const uint32_t offset = address % PAGE_SIZE;
+        const size_t chunk = std::min<size_t>(count, PAGE_SIZE - offset);
+        if (const uint8_t* page = page_for_read(address / PAGE_SIZE)) {
+            std::copy(page + offset, page + offset + chunk, out);
+        } else {
+            std::fill(out, out + chunk, 0);
+        }
+        address += static_cast<uint32_t>(chunk);
+        out += chunk;
+        count -= chunk;
+    }
+}
+
+void Memory::copy_in(uint32_t address, const uint8_t* in, size_t count) {
+    while (count > 0) {
+        const uint32_t offset = address % PAGE_SIZE;
+        const size_t chunk = std::min<size_t>(count, PAGE_SIZE - offset);
+        std::copy(in, in + chunk, page_for_write(address / PAGE_SIZE) + offset);
+        address += static_cast<uint32_t>(chunk);
+        in += chunk;
+        count -= chunk;
+    }
+}
+
+uint32_t Memory::load_unchecked(uint32_t address, unsigned bytes) const {
+    const uint32_t offset = address % PAGE_SIZE;
+    if (offset + bytes <= PAGE_SIZE) {
+        // Caso habitual: el dato no cruza páginas.
+        const uint8_t* page = page_for_read(address / PAGE_SIZE);
+        return page ? load_le(page + offset, bytes) : 0;
+    }
+    uint8_t buffer[4];
+    copy_out(address, buffer, bytes);
+    return load_le(buffer, bytes);
+}
+
+void Memory::store_unchecked(uint32_t address, uint32_t value, unsigned bytes) {
+    const uint32_t offset = address % PAGE_SIZE;
+    if (offset + bytes <= PAGE_SIZE) {
+        store_le(page_for_write(address / PAGE_SIZE) + offset, value, bytes);
+        return;
+    }
+    uint8_t buffer[4];
+    store_le(buffer, value, bytes);
+    copy_in(address, buffer, bytes);
+}
+
+uint32_t Memory::load(uint32_t address, unsigned bytes, bool cyclic) const {
+    if (cyclic && size_bytes > 0) {
+        // Direccionamiento cíclico (memorias didácticas).
+        address = wrap(address);
+        if (address + bytes > size_bytes) {
+            // El dato da la vuelta al final de la memoria: byte a byte.
+            uint32_t value = 0;
+            for (unsigned i = 0; i < bytes; ++i) {
+                value |= load_unchecked(wrap(static_cast<uint64_t>(address) + i), 1) << (8 * i);
+            }
+            return value;
+        }
+    } else {
+        check_range(address, bytes, "Memory read access out of bounds");
+    }
+    return load_unchecked(address, bytes);
+}
+
+void Memory::store(uint32_t address, uint32_t value, unsigned bytes, bool cyclic) {
+    if (cyclic && size_bytes > 0) {
+        address = wrap(address);
+        if (address + bytes > size_bytes) {
+            for (unsigned i = 0; i < bytes; ++i) {
+                store_unchecked(wrap(static_cast<uint64_t>(address) + i), (value >> (8 * i)) & 0xFF, 1);
+            }
+            return;
+        }
+    } else {
+        check_range(address, bytes, "Memory write access out of bounds");
+    }
+    store_unchecked(address, value, bytes);
+}
+
+// Lee 32 bits (una palabra) de una dirección de memoria.
+uint32_t Memory::read_word(uint32_t address, bool cyclic) const {
+    return load(address, 4, cyclic);
 }
 
 // Escribe 32 bits (una palabra) en una dirección de memoria.
 void Memory::write_word(uint32_t address, uint32_t value, bool cyclic) {
-    if (!cyclic && (address + 3 >= mem.size())) {
-        throw std::out_of_range("Memory write access out of bounds");
-    }
-    else 
-        address=address%mem.size();
+    store(address, value, 4, cyclic);
+}
+
+uint8_t Memory::read_byte(uint32_t address, bool cyclic) const {
+    return static_cast<uint8_t>(load(address, 1, cyclic));
+}
+
+uint16_t Memory::read_half(uint32_t address, bool cyclic) const {
+    return static_cast<uint16_t>(load(address, 2, cyclic));
+}
+
+void Memory::write_byte(uint32_t address, uint8_t value, bool cyclic) {
+    store(address, value, 1, cyclic);
+}
 
-    mem[address + 0] = (value >> 0) & 0xFF;
-    mem[address + 1] = (value >> 8) & 0xFF;
-    mem[address + 2] = (value >> 16) & 0xFF;
-    mem[address + 3] = (value >> 24) & 0xFF;
+void Memory::write_half(uint32_t address, uint16_t value, bool cyclic) {
+    store(address, value, 2, cyclic);
 }
 
 // Carga un programa (un vector de bytes) en la memoria en una dirección base.
 void Memory::load_program(const std::vector<uint8_t>& program, uint32_t base_address) {
-    if (base_address + program.size() > mem.size()) {
-        throw std::out_of_range("Program does not fit in memory");
-    }
-    std::copy(program.begin(), program.end(), mem.begin() + base_address);
+    load_program(program.data(), program.size(), base_address);
+}
+
+void Memory::load_program(const uint8_t* program, size_t size, uint32_t base_address) {
+    check_range(base_address, size, "Program does not fit in memory");
+    copy_in(base_address, program, size);
 }
 
 // Lee un bloque de memoria y lo copia en el buffer proporcionado.
 void Memory::read_block(uint32_t base_address, std::vector<uint8_t>& buffer) {
-    if (base_address + buffer.size() > mem.size()) {
-        throw std::out_of_range("Memory block read access out of bounds");
+    check_range(base_address, buffer.size(), "Memory block read access out of bounds");
+    copy_out(base_address, buffer.data(), buffer.size());
+}
+// Escribe los bytes marcados en la máscara a partir de la dirección base.
+void Memory::write_block(uint32_t base_address, const std::vector<uint8_t>& buffer, const std::vector<uint8_t>& mask) {
+    check_range(base_address, buffer.size(), "Memory block write access out of bounds");
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        if (mask[i]) store_unchecked(base_address + static_cast<uint32_t>(i), buffer[i], 1);
     }
-    std::copy(mem.begin() + base_address, mem.begin() + base_address + buffer.size(), buffer.begin());
-}
\ No newline at end of file
+}
+
+void Memory::write_block(uint32_t base_address, const std::vector<uint8_t>& buffer) {
+    check_range(base_address, buffer.size(), "Memory block write access out of bounds");
+    copy_in(base_address, buffer.data(), buffer.size());
+}
+
+std::vector<uint8_t> Memory::read_bytes(uint32_t base_address, size_t count) const {
+    check_range(base_address, count, "Memory read access out of bounds");
+    std::vector<uint8_t> bytes(count);
+    copy_out(base_address, bytes.data(), count);
+    return bytes;
+}
+
+uint32_t Memory::access_cycles(uint32_t address, bool is_write, uint64_t now) {
+    if (dram) return dram->access(address, is_write, now);
+    return latency_cycles;
+}
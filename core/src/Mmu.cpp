@@ -0,0 +1,210 @@
+#include "Mmu.h"
+#include "Memory.h"
+#include "StateSave.h"
+#include <stdexcept>
+
+// --- TLB ---
+
+Tlb::Tlb(size_t entries) : entries(entries) {}
+
+const Tlb::Entry* Tlb::lookup(uint32_t vpn) {
+    for (auto& entry : entries) {
+        if (!entry.valid) continue;
+        // Una megapágina solo compara VPN[1].
+        const bool match = entry.megapage ? (entry.vpn >> 10) == (vpn >> 10) : entry.vpn == vpn;
+        if (match) {
+            entry.last_use = ++clock;
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void Tlb::insert(const Entry& entry) {
+    if (entries.empty()) return;
+    Entry* slot = &entries[0];
+    for (auto& candidate : entries) {
+        if (!candidate.valid) { slot = &candidate; break; }
+        if (candidate.last_use < slot->last_use) slot = &candidate;
+    }
+    *slot = entry;
+    slot->valid = true;
+    slot->last_use = ++clock;
+}
+
+void Tlb::flush() {
+    for (auto& entry : entries) entry.valid = false;
+    clock = 0;
+}
+
+void Tlb::save_state(StateWriter& out) const {
+    out.u32(static_cast<uint32_t>(entries.size()));
+    for (const Entry& entry : entries) {
+        out.u8(entry.valid);
+        out.u8(entry.megapage);
+        out.u32(entry.vpn);
+        out.u32(entry.ppn);
+        out.u32(entry.flags);
+        out.u64(entry.last_use);
+    }
+    out.u64(clock);
+}
+
+void Tlb::load_state(StateReader& in) {
+    if (in.u32() != entries.size()) throw std::runtime_error("El estado guardado es de un TLB de otro tamaño");
+    for (Entry& entry : entries) {
+        entry.valid = in.u8() != 0;
+        entry.megapage = in.u8() != 0;
+        entry.vpn = in.u32();
+        entry.ppn = in.u32();
+        entry.flags = in.u32();
+        entry.last_use = in.u64();
+    }
+    clock = in.u64();
+}
+
+// --- MMU ---
+
+Mmu::Mmu(Memory& memory, const MmuConfig& config)
+    : memory(&memory), config(config), itlb(config.itlb_entries), dtlb(config.dtlb_entries), l2tlb(config.l2_entries) {}
+
+void Mmu::configure(const MmuConfig& new_config) {
+    if (new_config.itlb_entries == 0 || new_config.dtlb_entries == 0) {
+        throw std::invalid_argument("Los TLB de primer nivel necesitan al menos una entrada.");
+    }
+    config = new_config;
+    itlb = Tlb(config.itlb_entries);
+    dtlb = Tlb(config.dtlb_entries);
+    l2tlb = Tlb(config.l2_entries);
+}
+
+void Mmu::set_satp(uint32_t value) {
+    satp = value;
+    flush(); // Cambiar de espacio de direcciones invalida las traducciones
+}
+
+void Mmu::set_memory(Memory& physical) {
+    memory = &physical;
+    flush();
+}
+
+void Mmu::flush() {
+    itlb.flush();
+    dtlb.flush();
+    l2tlb.flush();
+}
+
+void Mmu::reset() {
+    flush();
+    stats = {};
+    last_latency = 0;
+    fault_cause = 0;
+}
+
+// Recorrido de dos niveles de la tabla de páginas (especificación privilegiada, 4.3.2).
+bool Mmu::walk(uint32_t va, uint64_t now, Tlb::Entry& entry) {
+    uint32_t table = (satp & 0x3FFFFF) * PAGE_SIZE;
+    const uint32_t vpn[2] = { (va >> 12) & 0x3FF, (va >> 22) & 0x3FF };
+
+    for (int level = 1; level >= 0; --level) {
+        const uint32_t pte_address = table + vpn[level] * 4;
+        if (static_cast<uint64_t>(pte_address) + 4 > memory->size()) return false;
+
+        const uint32_t cycles = memory->access_cycles(pte_address, false, now + last_latency);
+        last_latency += cycles;
+        stats.walk_cycles += cycles;
+        stats.walk_reads++;
+
+        const uint32_t pte = memory->read_word_unchecked(pte_address);
+        if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) return false;
+
+        const uint32_t ppn = pte >> 10;
+        if (pte & (PTE_R | PTE_X)) {
+            // Hoja. En el primer nivel es una megapágina y debe estar alineada.
+            if (level == 1 && (ppn & 0x3FF) != 0) return false;
+            entry.megapage = (level == 1);
+            entry.vpn = va >> 12;
+            entry.ppn = ppn;
+            entry.flags = pte & 0xFF;
+            return true;
+        }
+        table = ppn * PAGE_SIZE;
+    }
+    return false; // Puntero a tabla en el último nivel
+}
+
+bool Mmu::translate(uint32_t va, AccessType type, uint64_t now, uint32_t& pa) {
+    last_latency = 0;
+    if (!enabled()) {
+        pa = va;
+        return true;
+    }
+
+    const uint32_t vpn = va >> 12;
+    Tlb& l1 = (type == AccessType::Fetch) ? itlb : dtlb;
+    if (type == AccessType::Fetch) stats.itlb_accesses++; else stats.dtlb_accesses++;
+
+    Tlb::Entry entry;
+    if (const Tlb::Entry* hit = l1.lookup(vpn)) {
+        entry = *hit;
+    } else {
+        if (type == AccessType::Fetch) stats.itlb_misses++; else stats.dtlb_misses++;
+        last_latency += config.l2_hit_cycles;
+        if (const Tlb::Entry* hit2 = l2tlb.lookup(vpn)) {
+            entry = *hit2;
+        } else {
+            stats.l2_misses++;
+            if (!walk(va, now, entry)) {
+                fault_cause = (type == AccessType::Fetch) ? CAUSE_FETCH_PAGE_FAULT
+                            : (type == AccessType::Load) ? CAUSE_LOAD_PAGE_FAULT : CAUSE_STORE_PAGE_FAULT;
+                stats.page_faults++;
+                stats.stall_cycles += last_latency;
+                return false;
+            }
+            l2tlb.insert(entry);
+        }
+        l1.insert(entry);
+    }
+    stats.stall_cycles += last_latency;
+
+    // Comprobación de permisos con la entrada ya en el TLB.
+    const uint32_t needed = (type == AccessType::Fetch) ? PTE_X : (type == AccessType::Load) ? PTE_R : PTE_W;
+    if (!(entry.flags & needed)) {
+        fault_cause = (type == AccessType::Fetch) ? CAUSE_FETCH_PAGE_FAULT
+                    : (type == AccessType::Load) ? CAUSE_LOAD_PAGE_FAULT : CAUSE_STORE_PAGE_FAULT;
+        stats.page_faults++;
+        return false;
+    }
+
+    // Las direcciones físicas Sv32 tienen 34 bits; la memoria simulada es de 32.
+    if (entry.megapage) {
+        pa = (entry.ppn << 12) | (va & 0x3FFFFF);
+    } else {
+        pa = (entry.ppn << 12) | (va & 0xFFF);
+    }
+    return true;
+}
+
+void Mmu::save_state(StateWriter& out) const {
+    itlb.save_state(out);
+    dtlb.save_state(out);
+    l2tlb.save_state(out);
+    out.u32(last_latency);
+    out.u32(fault_cause);
+    for (uint64_t counter : {stats.itlb_accesses, stats.itlb_misses, stats.dtlb_accesses, stats.dtlb_misses, stats.l2_misses,
+                             stats.walk_cycles, stats.walk_reads, stats.page_faults, stats.stall_cycles}) {
+        out.u64(counter);
+    }
+}
+
+void Mmu::load_state(StateReader& in) {
+    itlb.load_state(in);
+    dtlb.load_state(in);
+    l2tlb.load_state(in);
+    last_latency = in.u32();
+    fault_cause = in.u32();
+    for (uint64_t* counter : {&stats.itlb_accesses, &stats.itlb_misses, &stats.dtlb_accesses, &stats.dtlb_misses, &stats.l2_misses,
+                              &stats.walk_cycles, &stats.walk_reads, &stats.page_faults, &stats.stall_cycles}) {
+        *counter = in.u64();
+    }
+}
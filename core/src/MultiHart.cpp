@@ -0,0 +1,73 @@
+#include "MultiHart.h"
+#include <stdexcept>
+
+MultiHart::MultiHart(size_t num_harts, size_t mem_size, CoherenceProtocol protocol)
+    : memory(mem_size), bus(protocol) {
+    if (num_harts == 0 || num_harts > MAX_HARTS) {
+        throw std::invalid_argument("El número de harts debe estar entre 1 y MAX_HARTS.");
+    }
+    harts.reserve(num_harts);
+    for (size_t id = 0; id < num_harts; ++id) {
+        // La memoria propia de cada hart no se usa: trabajan sobre la compartida.
+        auto hart = std::make_unique<Simulator>(0, PipelineModel::General);
+        hart->set_hart_id(static_cast<int32_t>(id));
+        hart->use_shared_memory(memory);
+        hart->attach_coherence_bus(bus);
+        harts.push_back(std::move(hart));
+    }
+    for (auto& writer : harts) {
+        for (auto& reader : harts) {
+            if (writer != reader) writer->share_memory_writes_with(*reader);
+        }
+    }
+    reset();
+}
+
+void MultiHart::load_program(const std::vector<uint8_t>& program) {
+    // Cada hart lee el código de su memoria de instrucciones; la compartida
+    // empieza vacía, solo para datos.
+    memory.clear();
+    for (auto& hart : harts) hart->load_program(program, PipelineModel::General);
+    reset();
+}
+
+void MultiHart::load_program(const char* assembly_code) {
+    load_program(harts.front()->assemble(assembly_code));
+}
+
+void MultiHart::reset() {
+    bus.reset();
+    for (auto& hart : harts) hart->reset(PipelineModel::General, 0);
+}
+
+void MultiHart::step() {
+    for (auto& hart : harts) hart->step();
+}
+
+size_t MultiHart::run(size_t max_steps) {
+    std::vector<uint32_t> before(harts.size());
+    for (size_t steps = 0; steps < max_steps; ++steps) {
+        for (size_t i = 0; i < harts.size(); ++i) before[i] = harts[i]->get_pc();
+        step();
+        bool parked = true;
+        for (size_t i = 0; i < harts.size(); ++i) {
+            if (harts[i]->get_pc() != before[i]) { parked = false; break; }
+        }
+        if (parked) return steps + 1;
+    }
+    return max_steps;
+}
+
+Simulator& MultiHart::hart(size_t index) {
+    if (index >= harts.size()) {
+        throw std::out_of_range("Identificador de hart fuera de rango");
+    }
+    return *harts[index];
+}
+
+uint32_t MultiHart::read_word(uint32_t address) {
+    if (static_cast<uint64_t>(address) + 4 > memory.size()) {
+        throw std::out_of_range("Memory read access out of bounds");
+    }
+    return bus.read_word(memory, address);
+}
@@ -0,0 +1,208 @@
+#include "Prefetcher.h"
+#include "StateSave.h"
+#include <stdexcept>
+
+// --- Implementación de la clase base ---
+
+Prefetcher::Prefetcher(const char* name, unsigned degree, unsigned distance)
+    : name(name), degree(degree), distance(distance) {
+    if (degree == 0) {
+        throw std::invalid_argument("El grado del prebuscador debe ser al menos 1.");
+    }
+}
+
+void Prefetcher::reset() {
+    counters = {};
+}
+
+void Prefetcher::save_state(StateWriter& out) const {
+    out.u64(counters.issued);
+    out.u64(counters.useful);
+    out.u64(counters.late);
+    out.u64(counters.useless);
+}
+
+void Prefetcher::load_state(StateReader& in) {
+    counters.issued = in.u64();
+    counters.useful = in.u64();
+    counters.late = in.u64();
+    counters.useless = in.u64();
+}
+
+// --- Bloque siguiente ---
+
+NextLinePrefetcher::NextLinePrefetcher(unsigned degree, unsigned distance)
+    : Prefetcher("next_line", degree, distance == 0 ? 1 : distance) {}
+
+void NextLinePrefetcher::on_access(uint32_t address, std::optional<uint32_t> /*pc*/, bool miss, std::vector<uint32_t>& out) {
+    if (!miss) return;
+    const uint32_t block = block_of(address);
+    for (unsigned i = 0; i < degree; ++i) {
+        out.push_back(block + (distance + i) * block_size);
+    }
+}
+
+// --- Stride indexado por PC ---
+
+StridePrefetcher::StridePrefetcher(unsigned degree, unsigned distance, size_t entries)
+    : Prefetcher("stride", degree, distance == 0 ? 1 : distance), table(entries) {
+    if (entries == 0 || (entries & (entries - 1)) != 0) {
+        throw std::invalid_argument("El número de entradas de la tabla de strides debe ser una potencia de 2.");
+    }
+}
+
+void StridePrefetcher::reset() {
+    Prefetcher::reset();
+    for (auto& entry : table) entry = Entry{};
+}
+
+void StridePrefetcher::save_state(StateWriter& out) const {
+    Prefetcher::save_state(out);
+    out.u32(static_cast<uint32_t>(table.size()));
+    for (const Entry& entry : table) {
+        out.u8(entry.valid);
+        out.u32(entry.pc);
+        out.u32(entry.last_address);
+        out.u32(static_cast<uint32_t>(entry.stride));
+        out.u8(entry.confidence);
+    }
+}
+
+void StridePrefetcher::load_state(StateReader& in) {
+    Prefetcher::load_state(in);
+    if (in.u32() != table.size()) throw std::runtime_error("Tabla de strides de otro tamaño");
+    for (Entry& entry : table) {
+        entry.valid = in.u8() != 0;
+        entry.pc = in.u32();
+        entry.last_address = in.u32();
+        entry.stride = static_cast<int32_t>(in.u32());
+        entry.confidence = in.u8();
+    }
+}
+
+void StridePrefetcher::on_access(uint32_t address, std::optional<uint32_t> access_pc, bool /*miss*/, std::vector<uint32_t>& out) {
+    // Sin PC no se puede indexar la tabla (p.ej. accesos de la API). El PC 0
+    // sí es válido: los programas se cargan ahí por defecto.
+    if (!access_pc) return;
+    const uint32_t pc = *access_pc;
+
+    Entry& entry = table[(pc >> 2) & (table.size() - 1)];
+    if (!entry.valid || entry.pc != pc) {
+        entry = Entry{true, pc, address, 0, 0};
+        return;
+    }
+
+    const int32_t stride = static_cast<int32_t>(address - entry.last_address);
+    if (stride == entry.stride && stride != 0) {
+        if (entry.confidence < 3) entry.confidence++;
+    } else {
+        if (entry.confidence > 0) entry.confidence--;
+        if (entry.confidence == 0) entry.stride = stride;
+    }
+    entry.last_address = address;
+
+    if (entry.confidence < 2) return;
+
+    // Con strides menores que un bloque, varias prebúsquedas caerían en el
+    // mismo bloque; se descartan los duplicados consecutivos.
+    uint32_t last_block = block_of(address);
+    for (unsigned i = 0; i < degree; ++i) {
+        const uint32_t target = address + static_cast<uint32_t>(entry.stride * static_cast<int32_t>(distance + i));
+        const uint32_t block = block_of(target);
+        if (block != last_block) {
+            out.push_back(block);
+            last_block = block;
+        }
+    }
+}
+
+// --- Buffers de flujo ---
+
+StreamBufferPrefetcher::StreamBufferPrefetcher(unsigned degree, unsigned distance, size_t buffers)
+    : Prefetcher("stream_buffer", degree, distance == 0 ? 1 : distance), streams(buffers) {
+    if (buffers == 0) {
+        throw std::invalid_argument("Se necesita al menos un buffer de flujo.");
+    }
+}
+
+void StreamBufferPrefetcher::reset() {
+    Prefetcher::reset();
+    for (auto& stream : streams) stream = Stream{};
+    last_miss_block = 0;
+    use_counter = 0;
+}
+
+void StreamBufferPrefetcher::save_state(StateWriter& out) const {
+    Prefetcher::save_state(out);
+    out.u32(static_cast<uint32_t>(streams.size()));
+    for (const Stream& stream : streams) {
+        out.u8(stream.valid);
+        out.u32(stream.next_block);
+        out.u32(static_cast<uint32_t>(stream.direction));
+        out.u64(stream.last_use);
+    }
+    out.u32(last_miss_block);
+    out.u64(use_counter);
+}
+
+void StreamBufferPrefetcher::load_state(StateReader& in) {
+    Prefetcher::load_state(in);
+    if (in.u32() != streams.size()) throw std::runtime_error("Buffers de flujo de otro número");
+    for (Stream& stream : streams) {
+        stream.valid = in.u8() != 0;
+        stream.next_block = in.u32();
+        stream.direction = static_cast<int32_t>(in.u32());
+        stream.last_use = in.u64();
+    }
+    last_miss_block = in.u32();
+    use_counter = in.u64();
+}
+
+void StreamBufferPrefetcher::on_access(uint32_t address, std::optional<uint32_t> /*pc*/, bool miss, std::vector<uint32_t>& out) {
+    if (!miss) return;
+    const uint32_t block = block_of(address);
+
+    // ¿Continúa algún flujo activo?
+    Stream* stream = nullptr;
+    for (auto& candidate : streams) {
+        if (candidate.valid && candidate.next_block == block) {
+            stream = &candidate;
+            break;
+        }
+    }
+
+    if (!stream) {
+        // Asignamos el buffer menos usado recientemente. La dirección del flujo
+        // se deduce del fallo anterior.
+        stream = &streams[0];
+        for (auto& candidate : streams) {
+            if (!candidate.valid) { stream = &candidate; break; }
+            if (candidate.last_use < stream->last_use) stream = &candidate;
+        }
+        stream->valid = true;
+        stream->direction = (block + block_size == last_miss_block) ? -1 : 1;
+    }
+
+    const int32_t step = stream->direction * static_cast<int32_t>(block_size);
+    stream->next_block = block + static_cast<uint32_t>(step);
+    stream->last_use = ++use_counter;
+    last_miss_block = block;
+
+    for (unsigned i = 0; i < degree; ++i) {
+        out.push_back(block + static_cast<uint32_t>(step * static_cast<int32_t>(distance + i)));
+    }
+}
+
+// --- Factoría ---
+
+std::unique_ptr<Prefetcher> make_prefetcher(PrefetcherKind kind, unsigned degree, unsigned distance) {
+    switch (kind) {
+        case PrefetcherKind::NextLine:
+            return std::make_unique<NextLinePrefetcher>(degree, distance);
+        case PrefetcherKind::Stride:
+            return std::make_unique<StridePrefetcher>(degree, distance);
+        case PrefetcherKind::StreamBuffer:
+            return std::make_unique<StreamBufferPrefetcher>(degree, distance);
+    }
+    throw std::invalid_argument("Tipo de prebuscador desconocido.");
+}
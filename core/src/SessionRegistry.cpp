@@ -0,0 +1,302 @@
+#include "SessionRegistry.h"
+#include "StateSave.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // El id acaba en el nombre del log: solo [A-Za-z0-9_-], de 1 a 64.
+    void check_session_id(const std::string& id) {
+        const bool valid = !id.empty() && id.size() <= 64 &&
+            std::all_of(id.begin(), id.end(), [](char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+            });
+        if (!valid) throw std::invalid_argument("Identificador de sesión no válido: " + id);
+    }
+}
+
+SessionRegistry::SessionRegistry(SimulatorPool& pool, size_t budget_bytes, std::chrono::seconds idle_timeout)
+    : pool(pool), budget_bytes(budget_bytes), idle_timeout(idle_timeout), last_scan(Clock::now()) {}
+
+std::string SessionRegistry::log_path(const std::string& id) const {
+    return log_directory.empty() ? std::string() : log_directory + "/simulator-" + id + ".log";
+}
+
+void SessionRegistry::return_to_pool(std::unique_ptr<Simulator> sim) {
+    sim->set_log_file("");
+    pool.release(sim.release());
+}
+
+bool SessionRegistry::create(const std::string& id, PipelineModel model, size_t mem_size) {
+    check_session_id(id);
+    std::vector<Session*> marked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sessions.count(id)) return false;
+        Session session;
+        session.sim.reset(pool.acquire(mem_size, model));
+        session.sim->set_log_file(log_path(id));
+        session.last_use = Clock::now();
+        session.footprint = session.sim->get_footprint().total();
+        resident_bytes += session.footprint;
+        sessions.emplace(id, std::move(session));
+        marked = collect_locked(Clock::now() - last_scan >= std::chrono::seconds(1));
+    }
+    hibernate_marked(marked);
+    return true;
+}
+
+bool SessionRegistry::fork(const std::string& id, const std::string& parent_id) {
+    check_session_id(id);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sessions.count(id)) return false;
+    }
+    // El padre se usa como en cualquier petición: sin el cerrojo del
+    // registro, que no debe esperar a que otro hilo suelte el simulador.
+    Simulator* parent = acquire(parent_id);
+    if (!parent) return false;
+    std::unique_ptr<Simulator> child;
+    try {
+        child.reset(pool.acquire(DMEM_SIZE, PipelineModel::SingleCycle));
+        std::shared_lock<std::shared_mutex> parent_lock(parent->get_mutex());
+        parent->fork_to(*child);
+    } catch (...) {
+        if (child) return_to_pool(std::move(child));
+        release(parent_id);
+        throw;
+    }
+    release(parent_id);
+
+    std::vector<Session*> marked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sessions.count(id)) {
+            return_to_pool(std::move(child));
+            return false;
+        }
+        Session session;
+        session.sim = std::move(child);
+        session.sim->set_log_file(log_path(id));
+        session.last_use = Clock::now();
+        session.footprint = session.sim->get_footprint().total();
+        resident_bytes += session.footprint;
+        sessions.emplace(id, std::move(session));
+        marked = collect_locked(Clock::now() - last_scan >= std::chrono::seconds(1));
+    }
+    hibernate_marked(marked);
+    return true;
+}
+
+Simulator* SessionRegistry::acquire(const std::string& id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found = sessions.find(id);
+    // Otro hilo la está hibernando o restaurando: se espera a que termine.
+    while (found != sessions.end() && found->second.switching) {
+        switched.wait(lock);
+        found = sessions.find(id);
+    }
+    if (found == sessions.end()) return nullptr;
+    Session& session = found->second;
+    session.users++;
+    session.last_use = Clock::now();
+    if (session.sim) return session.sim.get();
+
+    // Se restaura sin el cerrojo del registro. Marcada y en uso, nadie más
+    // toca la sesión mientras tanto.
+    session.switching = true;
+    const std::string path = log_path(id);
+    lock.unlock();
+    std::unique_ptr<Simulator> sim;
+    try {
+        // load_state reconfigura la instancia con el modelo y la memoria guardados.
+        sim.reset(pool.acquire(DMEM_SIZE, PipelineModel::SingleCycle));
+        sim->load_state(session.saved.data(), session.saved.size());
+    } catch (...) {
+        if (sim) return_to_pool(std::move(sim));
+        lock.lock();
+        session.switching = false;
+        session.users--;
+        lock.unlock();
+        switched.notify_all();
+        throw;
+    }
+    sim->set_log_file(path, true);
+
+    lock.lock();
+    session.sim = std::move(sim);
+    session.saved.clear();
+    session.saved.shrink_to_fit();
+    session.footprint = session.sim->get_footprint().total();
+    resident_bytes += session.footprint;
+    resumes++;
+    session.switching = false;
+    Simulator* restored = session.sim.get();
+    lock.unlock();
+    switched.notify_all();
+    return restored;
+}
+
+void SessionRegistry::release(const std::string& id) {
+    std::vector<Session*> marked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = sessions.find(id);
+        if (found == sessions.end() || found->second.users == 0) return;
+        Session& session = found->second;
+        session.last_use = Clock::now();
+        if (--session.users > 0) return;
+        // Ya nadie la usa: se puede medir sin competir con otro hilo, salvo con
+        // una ejecución en segundo plano, que se medirá en el siguiente release.
+        if (!session.sim->run_in_progress()) {
+            resident_bytes -= session.footprint;
+            session.footprint = session.sim->get_footprint().total();
+            resident_bytes += session.footprint;
+        }
+        marked = collect_locked(Clock::now() - last_scan >= std::chrono::seconds(1));
+    }
+    hibernate_marked(marked);
+}
+
+bool SessionRegistry::remove(const std::string& id) {
+    std::unique_ptr<Simulator> sim;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = sessions.find(id);
+        if (found == sessions.end() || found->second.users > 0 || found->second.switching) return false;
+        if (found->second.sim) resident_bytes -= found->second.footprint;
+        sim = std::move(found->second.sim);
+        sessions.erase(found);
+    }
+    // Devolverlo al pool cancela y espera su ejecución en segundo plano, si
+    // la hay: fuera del cerrojo, para no parar al resto de sesiones.
+    if (sim) return_to_pool(std::move(sim));
+    return true;
+}
+
+bool SessionRegistry::hibernate(const std::string& id) {
+    std::vector<Session*> marked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = sessions.find(id);
+        if (found == sessions.end() || !mark_for_hibernation(found->second)) return false;
+        marked.push_back(&found->second);
+    }
+    return hibernate_marked(marked) == 1;
+}
+
+bool SessionRegistry::mark_for_hibernation(Session& session) {
+    if (!session.sim || session.users > 0 || session.switching || session.sim->run_in_progress()) return false;
+    session.switching = true;
+    return true;
+}
+
+size_t SessionRegistry::hibernate_marked(const std::vector<Session*>& marked) {
+    size_t count = 0;
+    for (Session* session : marked) {
+        // Marcada y sin usuarios, la sesión no cambia mientras se guarda.
+        std::vector<uint8_t> saved;
+        bool hibernated = true;
+        try {
+            session->sim->save_state(saved, STATE_SAVE_HISTORY);
+        } catch (const std::exception&) {
+            hibernated = false; // Memoria compartida o proyectada: se queda residente
+        }
+        std::unique_ptr<Simulator> sim;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            session->switching = false;
+            if (hibernated) {
+                session->saved = std::move(saved);
+                resident_bytes -= session->footprint;
+                session->footprint = 0;
+                sim = std::move(session->sim);
+                hibernations++;
+                count++;
+            }
+        }
+        switched.notify_all();
+        if (sim) return_to_pool(std::move(sim));
+    }
+    return count;
+}
+
+size_t SessionRegistry::collect() {
+    std::vector<Session*> marked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        marked = collect_locked(true);
+    }
+    return hibernate_marked(marked);
+}
+
+std::vector<SessionRegistry::Session*> SessionRegistry::collect_locked(bool scan_idle) {
+    const Clock::time_point now = Clock::now();
+    std::vector<Session*> marked;
+    // Lo que quedará residente cuando se hibernen las marcadas.
+    size_t remaining = resident_bytes;
+    auto mark = [&](Session& session) {
+        if (!mark_for_hibernation(session)) return;
+        marked.push_back(&session);
+        remaining -= session.footprint;
+    };
+    if (scan_idle) {
+        last_scan = now;
+        for (auto& entry : sessions) {
+            Session& session = entry.second;
+            if (session.users == 0 && now - session.last_use >= idle_timeout) mark(session);
+        }
+    }
+    if (remaining <= budget_bytes) return marked;
+
+    // Por encima del presupuesto: primero las que llevan más tiempo sin usarse.
+    std::vector<Session*> candidates;
+    for (auto& entry : sessions) {
+        if (entry.second.sim && entry.second.users == 0 && !entry.second.switching) candidates.push_back(&entry.second);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Session* a, const Session* b) { return a->last_use < b->last_use; });
+    for (Session* session : candidates) {
+        if (remaining <= budget_bytes) break;
+        mark(*session);
+    }
+    return marked;
+}
+
+void SessionRegistry::set_budget(size_t bytes) {
+    std::vector<Session*> marked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget_bytes = bytes;
+        marked = collect_locked(false);
+    }
+    hibernate_marked(marked);
+}
+
+void SessionRegistry::set_idle_timeout(std::chrono::seconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle_timeout = timeout;
+}
+
+void SessionRegistry::set_log_directory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    log_directory = directory;
+}
+
+SessionStats SessionRegistry::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    SessionStats stats;
+    stats.sessions = sessions.size();
+    for (const auto& entry : sessions) {
+        if (entry.second.sim) {
+            stats.resident++;
+        } else {
+            stats.hibernated++;
+            stats.hibernated_bytes += entry.second.saved.size();
+        }
+    }
+    stats.resident_bytes = resident_bytes;
+    stats.budget_bytes = budget_bytes;
+    stats.hibernations = hibernations;
+    stats.resumes = resumes;
+    return stats;
+}
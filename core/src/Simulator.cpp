@@ -1,38 +1,41 @@
 #include "Simulator.h"
 #include <iostream> // Para depuración, se puede quitar después
 #include <stdexcept>
+#include <type_traits>
 #include <algorithm> // Para std::max
 #include <sstream>
 #include <vector>
 #include "ControlTableData.h" // Para el namespace ControlWord
+#include "Loader.h"
+#include "StateBinary.h"
 
 // Límite para la ejecución automática para evitar bucles infinitos no detectados.
 #define MAX_STEPS 1000
 
 
-void copy_pipeline_registers_to_out(DatapathState& datapath) {
-    datapath.Pipe_IF_ID_Instr_out=datapath.Pipe_IF_ID_Instr;
-    datapath.Pipe_IF_ID_NPC_out=datapath.Pipe_IF_ID_NPC;
-    datapath.Pipe_IF_ID_PC_out=datapath.Pipe_IF_ID_PC;
-    datapath.Pipe_ID_EX_Control_out=datapath.Pipe_ID_EX_Control;
-    datapath.Pipe_ID_EX_NPC_out=datapath.Pipe_ID_EX_NPC;
-    datapath.Pipe_ID_EX_PC_out=datapath.Pipe_ID_EX_PC;
-    datapath.Pipe_ID_EX_A_out=datapath.Pipe_ID_EX_A;
-    datapath.Pipe_ID_EX_B_out=datapath.Pipe_ID_EX_B;
-    datapath.Pipe_ID_EX_RD_out=datapath.Pipe_ID_EX_RD;
-    datapath.Pipe_ID_EX_RS1_out=datapath.Pipe_ID_EX_RS1;
-    datapath.Pipe_ID_EX_RS2_out=datapath.Pipe_ID_EX_RS2;
-    datapath.Pipe_ID_EX_Imm_out=datapath.Pipe_ID_EX_Imm;
-    datapath.Pipe_EX_MEM_Control_out=datapath.Pipe_EX_MEM_Control;
-    datapath.Pipe_EX_MEM_NPC_out=datapath.Pipe_EX_MEM_NPC;
-    datapath.Pipe_EX_MEM_ALU_result_out=datapath.Pipe_EX_MEM_ALU_result;
-    datapath.Pipe_EX_MEM_B_out=datapath.Pipe_EX_MEM_B;
-    datapath.Pipe_EX_MEM_RD_out=datapath.Pipe_EX_MEM_RD;
-    datapath.Pipe_MEM_WB_Control_out=datapath.Pipe_MEM_WB_Control;
-    datapath.Pipe_MEM_WB_NPC_out=datapath.Pipe_MEM_WB_NPC;
-    datapath.Pipe_MEM_WB_ALU_result_out=datapath.Pipe_MEM_WB_ALU_result;
-    datapath.Pipe_MEM_WB_RM_out=datapath.Pipe_MEM_WB_RM;
-    datapath.Pipe_MEM_WB_RD_out=datapath.Pipe_MEM_WB_RD;
+void copy_pipeline_registers_to_out(PackedDatapath& datapath) {
+    datapath.Pipe_IF_ID_Instr_out()=datapath.Pipe_IF_ID_Instr();
+    datapath.Pipe_IF_ID_NPC_out()=datapath.Pipe_IF_ID_NPC();
+    datapath.Pipe_IF_ID_PC_out()=datapath.Pipe_IF_ID_PC();
+    datapath.Pipe_ID_EX_Control_out()=datapath.Pipe_ID_EX_Control();
+    datapath.Pipe_ID_EX_NPC_out()=datapath.Pipe_ID_EX_NPC();
+    datapath.Pipe_ID_EX_PC_out()=datapath.Pipe_ID_EX_PC();
+    datapath.Pipe_ID_EX_A_out()=datapath.Pipe_ID_EX_A();
+    datapath.Pipe_ID_EX_B_out()=datapath.Pipe_ID_EX_B();
+    datapath.Pipe_ID_EX_RD_out()=datapath.Pipe_ID_EX_RD();
+    datapath.Pipe_ID_EX_RS1_out()=datapath.Pipe_ID_EX_RS1();
+    datapath.Pipe_ID_EX_RS2_out()=datapath.Pipe_ID_EX_RS2();
+    datapath.Pipe_ID_EX_Imm_out()=datapath.Pipe_ID_EX_Imm();
+    datapath.Pipe_EX_MEM_Control_out()=datapath.Pipe_EX_MEM_Control();
+    datapath.Pipe_EX_MEM_NPC_out()=datapath.Pipe_EX_MEM_NPC();
+    datapath.Pipe_EX_MEM_ALU_result_out()=datapath.Pipe_EX_MEM_ALU_result();
+    datapath.Pipe_EX_MEM_B_out()=datapath.Pipe_EX_MEM_B();
+    datapath.Pipe_EX_MEM_RD_out()=datapath.Pipe_EX_MEM_RD();
+    datapath.Pipe_MEM_WB_Control_out()=datapath.Pipe_MEM_WB_Control();
+    datapath.Pipe_MEM_WB_NPC_out()=datapath.Pipe_MEM_WB_NPC();
+    datapath.Pipe_MEM_WB_ALU_result_out()=datapath.Pipe_MEM_WB_ALU_result();
+    datapath.Pipe_MEM_WB_RM_out()=datapath.Pipe_MEM_WB_RM();
+    datapath.Pipe_MEM_WB_RD_out()=datapath.Pipe_MEM_WB_RD();
     }
 
 // Función de ayuda para extender el signo de un valor a 32 bits.
@@ -48,6 +51,42 @@ static int32_t sign_extend32(uint32_t value, unsigned bits) {
     }
 }
 
+// Ancho en bytes de un acceso a memoria según funct3: 1 (lb/lbu/sb), 2 (lh/lhu/sh) o 4 (lw/sw).
+static unsigned access_bytes(uint32_t instruction) {
+    return 1u << ((instruction >> 12) & 0x3);
+}
+
+// Extiende el dato leído: con signo para lb/lh, con ceros para lbu/lhu (funct3[2] = 1).
+static uint32_t extend_load(uint32_t value, uint32_t instruction) {
+    const unsigned bits = 8 * access_bytes(instruction);
+    if (bits == 32) return value;
+    if ((instruction >> 14) & 0x1) return value & ((1u << bits) - 1u);
+    return static_cast<uint32_t>(sign_extend32(value, bits));
+}
+
+// Las cargas son las únicas instrucciones que escriben en el registro el dato de memoria.
+static bool is_load(const InstructionInfo* info) {
+    return info && !info->MemWr && info->ResSrc == 0;
+}
+
+// Accesos a las memorias didácticas del ancho de la instrucción. Las lecturas
+// usan direccionamiento cíclico; las escrituras fuera de rango fallan.
+static uint32_t load_from(Memory& memory, uint32_t address, uint32_t instruction) {
+    switch (access_bytes(instruction)) {
+        case 1: return extend_load(memory.read_byte(address, true), instruction);
+        case 2: return extend_load(memory.read_half(address, true), instruction);
+        default: return memory.read_word(address, true);
+    }
+}
+
+static void store_to(Memory& memory, uint32_t address, uint32_t value, uint32_t instruction) {
+    switch (access_bytes(instruction)) {
+        case 1: memory.write_byte(address, static_cast<uint8_t>(value)); break;
+        case 2: memory.write_half(address, static_cast<uint16_t>(value)); break;
+        default: memory.write_word(address, value); break;
+    }
+}
+
 // Versión corregida y más robusta
 std::string Simulator::disassemble(uint32_t instruction, const InstructionInfo* info) const {
     if (!info) return "not implemented";
@@ -126,28 +165,88 @@ Simulator::Simulator(size_t mem_size, PipelineModel model)
     register_file(),
     model(model),
     memory(mem_size),
-    i_cache(IMEM_SIZE, 16, memory),//No usado
-    d_cache(DMEM_SIZE, 16, memory),//No usado
-    i_mem(IMEM_SIZE), // Memoria de instrucciones para modo didáctico
+    main_memory(&memory),
+    i_cache(IMEM_SIZE, CACHE_BLOCK_SIZE, memory), // Solo en modo General
+    d_cache(DMEM_SIZE, CACHE_BLOCK_SIZE, memory), // Solo en modo General
+    mmu(memory), // Solo en modo General
+    i_mem(model == PipelineModel::General ? mem_size : IMEM_SIZE), // Ver Simulator.h
     d_mem(DMEM_SIZE),  // Memoria de datos para modo didáctico
     handle_load_use_hazard(true), // Habilitado por defecto
     handle_branch_flush(true),    // Habilitado por defecto
     handle_forwarding(true),      // Habilitado por defecto
-    history_pointer(0),
     assembler(&m_logfile), // Pasamos el logfile al ensamblador
     datapath{}
 {
-      // Abrir el fichero de log. Se sobreescribirá en cada nueva ejecución.
-      m_logfile.open("simulator.log", std::ios::out | std::ios::trunc);
-      m_logfile << "--- Log del Simulador RISC-V ---" << std::endl;
+    // Sin log hasta set_log_file: un fichero común lo truncarían y
+    // mezclarían todas las instancias (pool, sesiones, harts).
+    bind_cache_memories();
+}
 
-      // Reservar espacio para el historial para evitar realojamientos frecuentes
-      history.reserve(1024);
-      m_logfile << "--- Historia reservada ---" << std::endl;
+void Simulator::set_log_file(const std::string& path, bool append) {
+    if (m_logfile.is_open()) m_logfile.close();
+    m_logfile.clear();
+    if (path.empty()) return;
+    m_logfile.open(path, std::ios::out | (append ? std::ios::app : std::ios::trunc));
+    if (!append) m_logfile << "--- Log del Simulador RISC-V ---" << std::endl;
+}
+
+void Simulator::reconfigure(PipelineModel _model, size_t mem_size, bool hazards) {
+    model = _model;
+    pc = 0;
+    initial_pc = 0;
+    current_cycle = 0;
+    status_reg = 0;
+    register_file.reset();
+    datapath = {};
+    instructionString = "nop";
+    set_hazard_options(hazards, hazards, hazards);
+
+    // Memorias: la principal se vacía (o cambia de tamaño) en el mismo objeto,
+    // así que cachés y MMU siguen apuntando a ella.
+    if (memory.size() == mem_size) {
+        memory.clear();
+    } else {
+        memory = Memory(mem_size);
+    }
+    if (main_memory != &memory) use_shared_memory(memory);
+    i_mem.clear();
+    size_instruction_memory();
+    d_mem.clear();
+    detach_dram();
+
+    // Cachés, MMU y segmentado con cachés, con su configuración por defecto.
+    bind_cache_memories();
+    for (Cache* cache : {static_cast<Cache*>(&i_cache), static_cast<Cache*>(&d_cache)}) {
+        cache->clear_prefetchers();
+        cache->set_write_buffer_entries(0);
+        cache->set_victim_entries(0);
+        cache->set_mshr_entries(0);
+        cache->reset();
+    }
+    cache_clock = 0;
+    mmu.configure(MmuConfig{});
+    mmu.set_satp(0);
+    mmu.reset();
+    csrs = {};
+    fetch_faulted = false;
+    next_page_table = 0;
+    hart_id = -1;
+    pipeline_caches = false;
+    timing = {};
+    pipeline_stats = {};
+
+    clear_history();
+    clear_texts();
+    clear_state_versions();
+    history_budget = HISTORY_BUDGET_BYTES;
+    dirty_lines.clear();
+    memory_resync = true;
+    if (m_logfile.is_open()) m_logfile << "\n--- Simulador reconfigurado ---" << std::endl;
 }
 
 // Nueva función para configurar las opciones de riesgo
 void Simulator::set_hazard_options(bool stalls, bool flushes, bool forwarding) {
+    discard_future();
     handle_load_use_hazard = stalls;
     handle_branch_flush = flushes;
     handle_forwarding = forwarding;
@@ -172,44 +271,277 @@ void Simulator::load_program(const char* assembly_code, PipelineModel model) {
 
 // Carga un programa en la memoria del simulador.
 void Simulator::load_program(const std::vector<uint8_t>& program, PipelineModel model) {
+    load_program(program.data(), program.size(), model);
+}
+
+void Simulator::load_program(const uint8_t* program, size_t size, PipelineModel model) {
+    memory_resync = true;
     // La carga depende del modo de pipeline.
-    if (program.empty()) {
+    if (size == 0) {
         m_logfile << "\n--- Advertencia: Se cargó un programa vacío. Limpiando memoria. ---" << std::endl;
+        i_mem.clear();
         if (model != PipelineModel::General) {
-            i_mem.clear();
             d_mem.clear();
         } else {
-            memory.clear(); // Limpiamos la memoria general también
+            main_memory->clear(); // Limpiamos la memoria general también
         }
         return; // Salimos para evitar errores de acceso.
     }
 
     if (model == PipelineModel::General) {
+        // El código va a la memoria de instrucciones y los datos empiezan en
+        // la principal, como en los modelos didácticos.
         m_logfile << "\n--- Programa cargado en memoria (modo general)" << program[0] << " ---" << std::endl;
-        memory.load_program(program, 0);
+        size_instruction_memory();
+        i_mem.clear();
+        i_mem.load_program(program, size, 0);
     } else {
         // En modo didáctico, el programa se carga en la memoria de instrucciones.
         // La memoria de datos permanece vacía inicialmente.
         i_mem.clear();
         d_mem.clear();
-        i_mem.load_program(program, 0);
+        i_mem.load_program(program, size, 0);
         m_logfile << "\n--- Programa cargado en memoria (modo didactico) " << program[0] << " ---" << std::endl;
     }
+    // El contenido de las cachés ya no corresponde a la memoria.
+    i_cache.reset();
+    d_cache.reset();
+}
+
+uint32_t Simulator::load_file(const std::string& path, PipelineModel model) {
+    const std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (model != PipelineModel::General) {
+        if (is_elf_image(file->data(), file->size())) {
+            throw std::invalid_argument("Los modelos didácticos solo cargan binarios planos.");
+        }
+        load_program(file->data(), file->size(), model);
+        return 0;
+    }
+    const LoadedImage image = load_image(*main_memory, file);
+    // Una imagen trae código y datos en el mismo espacio: el fetch ve la
+    // imagen tal como se cargó (copia en escritura, las páginas se comparten).
+    i_mem = *main_memory;
+    memory_resync = true;
+    m_logfile << "\n--- Imagen " << path << " cargada: entrada 0x" << std::hex << image.entry << std::dec
+              << ", " << image.shared_pages << " páginas compartidas, " << image.copied_bytes << " bytes copiados ---" << std::endl;
+    i_cache.reset();
+    d_cache.reset();
+    return image.entry;
+}
+
+void Simulator::map_file(const std::string& path, uint32_t base_address, size_t size) {
+    // Lo pendiente en la caché iría a parar a la región ya proyectada.
+    d_cache.flush();
+    d_cache.write_back_all();
+    main_memory->map_file(path, base_address, size);
+    memory_resync = true;
+    i_cache.reset();
+    d_cache.reset();
+    // Las copias completas no tienen la región proyectada.
+    clear_history();
+}
+
+void Simulator::sync_mapped_files() {
+    d_cache.flush();
+    d_cache.write_back_all();
+    main_memory->sync_mapped_files();
 }
 
 // Ejecuta un ciclo completo: fetch, decode, execute.
 void Simulator::step() {
-    // Si hemos retrocedido y ahora avanzamos, se crea una nueva línea de tiempo.
-    // Se borra el historial "futuro" que ya no es válido.
-    if (history_pointer < history.size()) {
-        history.resize(history_pointer);
+    if (history.can_redo()) {
+        // Paso ya ejecutado antes de un step_back: se rehace con su delta.
+        apply_delta(history.redo(), true);
+        return;
+    }
+    if (timed_pipeline() && history.can_undo()) {
+        // La congelación se mira antes de anotar el paso: un ciclo congelado
+        // no ejecuta nada y se suma al paso anterior, en vez de dejar una
+        // entrada que step_back desharía sin que cambie el pc ni el datapath.
+        timing.cache_clock = cache_clock;
+        timing_before = timing;
+        i_cache.tick(cache_clock);
+        d_cache.tick(cache_clock);
+        if (skip_frozen_cycle()) {
+            timing.cache_clock = cache_clock;
+            std::vector<ChunkChange> chunks;
+            diff_chunks(&timing_before, &timing, sizeof(PipelineTiming), HISTORY_TIMING, chunks);
+            history.extend_newest(chunks, current_cycle);
+            // Una copia completa tomada en esta posición ya no es su estado.
+            if (!checkpoints.empty() && checkpoints.back().position == history.position()) {
+                checkpoint_bytes -= checkpoints.back().bytes;
+                checkpoints.pop_back();
+                pages_since_checkpoint.clear();
+            }
+            return;
+        }
+    }
+    begin_step_record();
+    execute_step();
+    end_step_record();
+}
+
+// El historial compara y parchea estas estructuras byte a byte (diff_chunks y
+// apply_chunks). Tienen que copiarse con memcpy y no tener relleno implícito:
+// sus bytes no están definidos y el mismo estado daría trozos distintos.
+static_assert(std::is_trivially_copyable_v<PackedDatapath> && std::has_unique_object_representations_v<PackedDatapath>,
+              "PackedDatapath no se puede comparar byte a byte");
+static_assert(std::is_trivially_copyable_v<RegisterFile> && std::has_unique_object_representations_v<RegisterFile>,
+              "RegisterFile no se puede comparar byte a byte");
+static_assert(std::is_trivially_copyable_v<PipelineTiming> && std::has_unique_object_representations_v<PipelineTiming>,
+              "PipelineTiming no se puede comparar byte a byte");
+static_assert(std::is_trivially_copyable_v<TrapCsrs> && std::has_unique_object_representations_v<TrapCsrs>,
+              "TrapCsrs no se puede comparar byte a byte");
+
+void Simulator::begin_step_record() {
+    timing.cache_clock = cache_clock;
+    const size_t position = history.position();
+    if (position % HISTORY_CHECKPOINT_INTERVAL == 0 && (checkpoints.empty() || checkpoints.back().position != position)) {
+        // Copia completa: las memorias se comparten hasta que se escriben.
+        // Con regiones proyectadas no se guarda la memoria principal: la
+        // copia seguiría apuntando al fichero y no lo podría restaurar.
+        const bool has_main_memory = !undoes_main_memory() || !main_memory->has_mapped_files();
+        StateSnapshot state(pc, register_file, datapath, current_cycle, instructionString, snapshot_memory(d_mem), timing,
+                            undoes_main_memory() && has_main_memory ? snapshot_memory(*main_memory) : Memory(0), csrs);
+        const size_t bytes = sizeof(Checkpoint) + instructionString.capacity();
+        checkpoints.push_back(Checkpoint{position, std::move(state), bytes, has_main_memory});
+        checkpoint_bytes += bytes;
+        pages_since_checkpoint.clear();
+    }
+    pending_step = StepDelta{};
+    pending_step.pc_before = pc;
+    pending_step.cycle_before = current_cycle;
+    pending_step.instruction_before = instructionString;
+    datapath_before = datapath;
+    registers_before = register_file;
+    timing_before = timing;
+    csrs_before = csrs;
+}
+
+void Simulator::end_step_record() {
+    timing.cache_clock = cache_clock;
+    diff_chunks(&datapath_before, &datapath, sizeof(PackedDatapath), HISTORY_DATAPATH, pending_step.chunks);
+    diff_chunks(&registers_before, &register_file, sizeof(RegisterFile), HISTORY_REGISTERS, pending_step.chunks);
+    diff_chunks(&timing_before, &timing, sizeof(PipelineTiming), HISTORY_TIMING, pending_step.chunks);
+    diff_chunks(&csrs_before, &csrs, sizeof(TrapCsrs), HISTORY_CSRS, pending_step.chunks);
+    pending_step.chunks.shrink_to_fit();
+    for (MemoryWrite& write : pending_step.writes) {
+        // Con varias escrituras al mismo sitio todas ven el valor final, que
+        // es el que deja rehacerlas en orden.
+        write.new_value = read_stored(write.main_memory ? *main_memory : d_mem, write.address, write.bytes, write.through_cache);
+    }
+    pending_step.pc_after = pc;
+    pending_step.cycle_after = current_cycle;
+    pending_step.instruction_changed = pending_step.instruction_before != instructionString;
+    if (pending_step.instruction_changed) {
+        pending_step.instruction_after = instructionString;
+    } else {
+        pending_step.instruction_before.clear();
+    }
+    history.push(std::move(pending_step));
+    trim_history();
+}
+
+void Simulator::mark_dirty(bool main, uint32_t address, unsigned bytes) {
+    if (main) {
+        for (Simulator* peer : memory_peers) peer->mark_dirty_lines(true, address, bytes);
     }
+    mark_dirty_lines(main, address, bytes);
+}
 
-    // Guardar el estado actual ANTES de ejecutar el ciclo.
-    history.emplace_back(pc, register_file, datapath, current_cycle, instructionString, d_mem);
-    history_pointer++;
+void Simulator::mark_dirty_lines(bool main, uint32_t address, unsigned bytes) {
+    if (memory_resync) return;
+    const uint64_t tag = (static_cast<uint64_t>(main) << 32);
+    for (uint32_t line = address / STATE_BINARY_DIRTY_LINE; line <= (address + bytes - 1) / STATE_BINARY_DIRTY_LINE; ++line) {
+        dirty_lines.insert(tag | line);
+    }
+    if (dirty_lines.size() > DIRTY_LINES_LIMIT) {
+        dirty_lines.clear();
+        memory_resync = true;
+    }
+}
+
+void Simulator::record_store(Memory& target, uint32_t address, unsigned bytes, bool through_cache) {
+    const bool main = &target == main_memory;
+    const uint64_t tag = (static_cast<uint64_t>(main) << 32);
+    mark_dirty(main, address, bytes);
+    if (main && !undoes_main_memory()) return;
+    // Lo escrito en un fichero proyectado no se deshace: el fichero está
+    // fuera del simulador y las copias completas tampoco lo restauran.
+    if (target.is_mapped(address) || target.is_mapped(address + bytes - 1)) return;
+    const uint32_t old_value = read_stored(target, address, bytes, through_cache);
+    pending_step.writes.push_back(MemoryWrite{address, old_value, old_value, static_cast<uint8_t>(bytes), main, through_cache});
+    // La primera escritura en una página tras la copia completa la duplica.
+    for (uint32_t page = address / PAGE_SIZE; page <= (address + bytes - 1) / PAGE_SIZE; ++page) {
+        if (!checkpoints.empty() && pages_since_checkpoint.insert(tag | page).second) {
+            checkpoints.back().bytes += PAGE_SIZE;
+            checkpoint_bytes += PAGE_SIZE;
+        }
+    }
+}
+
+uint32_t Simulator::read_stored(const Memory& target, uint32_t address, unsigned bytes, bool through_cache) const {
+    if (through_cache) return d_cache.peek(address, bytes);
+    switch (bytes) {
+        case 1: return target.read_byte(address);
+        case 2: return target.read_half(address);
+        default: return target.read_word(address);
+    }
+}
+
+void Simulator::clear_history() {
+    history.clear();
+    checkpoints.clear();
+    checkpoint_bytes = 0;
+    pages_since_checkpoint.clear();
+}
+
+void Simulator::set_history_budget(size_t bytes) {
+    history_budget = bytes;
+    trim_history();
+}
+
+void Simulator::trim_history() {
+    while (history.bytes() + checkpoint_bytes > history_budget && history.newest() > history.oldest()) {
+        if (!history.can_undo()) {
+            // Solo quedan pasos por rehacer.
+            discard_future();
+            break;
+        }
+        history.evict_oldest();
+        // Una copia completa anterior al paso más antiguo ya no sirve.
+        while (!checkpoints.empty() && checkpoints.front().position < history.oldest()) {
+            checkpoint_bytes -= checkpoints.front().bytes;
+            checkpoints.pop_front();
+        }
+    }
+}
+
+void Simulator::execute_step() {
+    // En modo General las cachés siguen su propio reloj, que avanza un ciclo
+    // por instrucción más las esperas de los fallos. En el segmentado con
+    // cachés avanza un ciclo por paso.
+    const uint64_t stalls_before = memory_stall_cycles();
+    if (model == PipelineModel::General || timed_pipeline()) {
+        i_cache.tick(cache_clock);
+        d_cache.tick(cache_clock);
+    }
+
+    if (skip_frozen_cycle()) return;
 
     uint32_t instruction = fetch();
+    if (fetch_faulted) {
+        // Fallo de página en la búsqueda: la instrucción no se ejecuta.
+        fetch_faulted = false;
+        current_cycle++;
+        cache_clock += CACHE_HIT_CYCLES + (memory_stall_cycles() - stalls_before);
+        return;
+    }
+    if (timed_pipeline() && timing.fetch_pending) {
+        current_cycle++;
+        cache_clock++;
+        return;
+    }
     if (m_logfile.is_open()) {
         m_logfile << "\n--- Ciclo " << current_cycle << " ---" << std::endl;
         m_logfile << "PC: 0x" << std::hex << pc << std::dec << std::endl;
@@ -218,16 +550,21 @@ void Simulator::step() {
     }
     current_cycle++; // Avanzamos el ciclo de instruccion//reloj
     decode_and_execute(instruction);
+    if (model == PipelineModel::General) {
+        cache_clock += CACHE_HIT_CYCLES + (memory_stall_cycles() - stalls_before);
+    } else if (timed_pipeline()) {
+        cache_clock++;
+    }
     if (m_logfile.is_open()) {
         m_logfile << "Instruccion ejecutada: 0x" << std::hex << instruction << std::dec << std::endl;
-        m_logfile << "Control: 0x" << std::hex << datapath.bus_Control.value << std::dec << std::endl;
+        m_logfile << "Control: 0x" << std::hex << datapath.bus_Control().value << std::dec << std::endl;
 
     }
 }
 
 // Ejecuta la simulación hasta que se alcanza un breakpoint, se detecta un bucle
 // o se llega al número máximo de pasos.
-int Simulator::stepsUntil(const std::vector<uint32_t>& breakpoints) {
+int Simulator::stepsUntil(const std::vector<uint32_t>& breakpoints, const std::function<bool(int steps)>& on_step) {
     for (int i = 0; i < MAX_STEPS; ++i) {
         uint32_t pc_before_step = pc;
 
@@ -249,7 +586,7 @@ int Simulator::stepsUntil(const std::vector<uint32_t>& breakpoints) {
         if (model == PipelineModel::PipeLined) {
             // En pipeline, un bucle infinito se detecta si la señal de salto está activa
             // y el PC de destino del salto es la misma dirección de la instrucción de salto.
-            if (datapath.bus_branch_taken.value && datapath.bus_PC_dest.value == datapath.Pipe_ID_EX_PC_out.value) {
+            if (datapath.bus_branch_taken().value && datapath.bus_PC_dest().value == datapath.Pipe_ID_EX_PC_out().value) {
                  m_logfile << "--- Bucle infinito (salto a sí mismo) detectado en pipeline en 0x" << std::hex << pc_before_step << " ---" << std::endl;
                  return i + 1;
             }
@@ -260,9 +597,15 @@ int Simulator::stepsUntil(const std::vector<uint32_t>& breakpoints) {
                 return i + 1;
             }
         }
+
+        // 3. Quien llama puede pararla (p.ej. porque el cliente la cancela).
+        if (on_step && !on_step(i + 1)) {
+            m_logfile << "--- Ejecución detenida tras " << std::dec << i + 1 << " pasos ---" << std::endl;
+            return i + 1;
+        }
     }
 
-    // 3. Si salimos del bucle, es porque se ha alcanzado el número máximo de pasos.
+    // 4. Si salimos del bucle, es porque se ha alcanzado el número máximo de pasos.
     m_logfile << "--- Se alcanzó el máximo de " << MAX_STEPS << " pasos. Deteniendo ejecución. ---" << std::endl;
     return MAX_STEPS;
 }
@@ -271,20 +614,35 @@ int Simulator::stepsUntil(const std::vector<uint32_t>& breakpoints) {
 void Simulator::reset(PipelineModel _model, uint32_t _initial_pc) {
     // Actualizamos el modelo del simulador con el que nos pasan.
     model = _model;
-    initial_pc=IMEM_SIZE*(_initial_pc/IMEM_SIZE); 
+    // El modo General arranca en la dirección exacta (p.ej. la entrada de un
+    // ELF); los didácticos, al principio del bloque de i_mem.
+    initial_pc = model == PipelineModel::General ? (_initial_pc & ~3u) : IMEM_SIZE*(_initial_pc/IMEM_SIZE);
     pc = initial_pc;
     current_cycle = 0;
     status_reg = 0;
     register_file.reset();
+    if (hart_id >= 0) register_file.write(10, static_cast<uint32_t>(hart_id)); // a0 = hartid
     datapath = {};
     instructionString = "";
+    memory_resync = true;
     // Después de resetear, ejecutamos el primer ciclo para que la UI muestre
     // el estado inicial con la primera instrucción (la de PC=0) ya procesada.
     d_mem.clear();
+    bind_cache_memories();
+    cache_clock = 0;
+    timing = {};
+    pipeline_stats = {};
+    if (dram) dram->reset();
+    mmu.reset();
+    // satp y mtvec son configuración y se conservan.
+    csrs.mepc = 0;
+    csrs.mcause = 0;
+    csrs.mtval = 0;
+    fetch_faulted = false;
     //step();
     // Limpiar el historial
-    history.clear();
-    history_pointer = 0;
+    clear_history();
+    clear_texts();
 
     if (m_logfile.is_open()) {
         m_logfile << "Model:" << (int) model << std::endl;
@@ -294,65 +652,65 @@ void Simulator::reset(PipelineModel _model, uint32_t _initial_pc) {
     }
     if(model == PipelineModel::PipeLined) {
 
-        datapath.Pipe_IF_ID_Instr.is_active=false;
-        datapath.Pipe_IF_ID_NPC.is_active=false;
-        datapath.Pipe_IF_ID_PC.is_active=false;
+        datapath.Pipe_IF_ID_Instr().is_active=false;
+        datapath.Pipe_IF_ID_NPC().is_active=false;
+        datapath.Pipe_IF_ID_PC().is_active=false;
         
-        datapath.bus_DA.is_active=false;
-        datapath.bus_DB.is_active=false;
-        datapath.bus_DC.is_active=false;
-        datapath.bus_Instr.is_active=false;
-
-        datapath.Pipe_ID_EX_A.is_active=false;
-        datapath.Pipe_ID_EX_B.is_active=false;  
-        datapath.Pipe_ID_EX_Imm.is_active=false;
-        datapath.Pipe_ID_EX_RD.is_active=false;
-        datapath.Pipe_ID_EX_RS1.is_active=false;
-        datapath.Pipe_ID_EX_RS2.is_active=false;
-        datapath.Pipe_ID_EX_NPC.is_active=false;
-        datapath.Pipe_ID_EX_PC.is_active=false;
-        datapath.Pipe_ID_EX_Control.is_active=false;
-
-        datapath.Pipe_EX_MEM_Control.is_active=false;
-        datapath.Pipe_EX_MEM_ALU_result.is_active=false;
-        datapath.Pipe_EX_MEM_B.is_active=false;
-        datapath.Pipe_EX_MEM_NPC.is_active=false;
-        datapath.Pipe_EX_MEM_RD.is_active=false;
-
-        datapath.Pipe_MEM_WB_ALU_result.is_active=false;
-        datapath.Pipe_MEM_WB_NPC.is_active=false;
-        datapath.Pipe_MEM_WB_RD.is_active=false;
-        datapath.Pipe_MEM_WB_Control.is_active=false;
-        datapath.Pipe_MEM_WB_RM.is_active=false;
+        datapath.bus_DA().is_active=false;
+        datapath.bus_DB().is_active=false;
+        datapath.bus_DC().is_active=false;
+        datapath.bus_Instr().is_active=false;
+
+        datapath.Pipe_ID_EX_A().is_active=false;
+        datapath.Pipe_ID_EX_B().is_active=false;  
+        datapath.Pipe_ID_EX_Imm().is_active=false;
+        datapath.Pipe_ID_EX_RD().is_active=false;
+        datapath.Pipe_ID_EX_RS1().is_active=false;
+        datapath.Pipe_ID_EX_RS2().is_active=false;
+        datapath.Pipe_ID_EX_NPC().is_active=false;
+        datapath.Pipe_ID_EX_PC().is_active=false;
+        datapath.Pipe_ID_EX_Control().is_active=false;
+
+        datapath.Pipe_EX_MEM_Control().is_active=false;
+        datapath.Pipe_EX_MEM_ALU_result().is_active=false;
+        datapath.Pipe_EX_MEM_B().is_active=false;
+        datapath.Pipe_EX_MEM_NPC().is_active=false;
+        datapath.Pipe_EX_MEM_RD().is_active=false;
+
+        datapath.Pipe_MEM_WB_ALU_result().is_active=false;
+        datapath.Pipe_MEM_WB_NPC().is_active=false;
+        datapath.Pipe_MEM_WB_RD().is_active=false;
+        datapath.Pipe_MEM_WB_Control().is_active=false;
+        datapath.Pipe_MEM_WB_RM().is_active=false;
 
         //No todo es necesario, pero por si acaso...
-        datapath.bus_ALU_B.is_active = false;
-        datapath.bus_ALU_A.is_active = false;
-        datapath.bus_ALU_result.is_active = false;
-        datapath.bus_ALU_zero.is_active = false;
-        datapath.bus_imm.is_active = false;
-        datapath.bus_C.is_active = false;
-        datapath.bus_Mem_address.is_active = false;
-        datapath.bus_Mem_write_data.is_active = false;
+        datapath.bus_ALU_B().is_active = false;
+        datapath.bus_ALU_A().is_active = false;
+        datapath.bus_ALU_result().is_active = false;
+        datapath.bus_ALU_zero().is_active = false;
+        datapath.bus_imm().is_active = false;
+        datapath.bus_C().is_active = false;
+        datapath.bus_Mem_address().is_active = false;
+        datapath.bus_Mem_write_data().is_active = false;
         
-        datapath.bus_Instr.is_active = false;
-        datapath.bus_branch_taken.is_active=false;
-        datapath.bus_PC_dest.is_active=false;
-
-        datapath.bus_ImmSrc.is_active=false;
-        datapath.bus_PCsrc.is_active=false;
-        datapath.bus_ALUctr.is_active=false;
-        datapath.bus_MemWr.is_active=false;
-        datapath.bus_ResSrc.is_active=false;
-        datapath.bus_BRwr.is_active=false;
-        datapath.bus_ALUsrc.is_active=false;
-
-        datapath.bus_ControlForwardA={0, 1, false};
-        datapath.bus_ControlForwardB={0, 1, false};
-        datapath.bus_ControlForwardM={0, 1, false};
-        datapath.bus_ForwardA.is_active=false;
-        datapath.bus_ForwardB.is_active=false;
-        datapath.bus_ForwardM.is_active=false;
+        datapath.bus_Instr().is_active = false;
+        datapath.bus_branch_taken().is_active=false;
+        datapath.bus_PC_dest().is_active=false;
+
+        datapath.bus_ImmSrc().is_active=false;
+        datapath.bus_PCsrc().is_active=false;
+        datapath.bus_ALUctr().is_active=false;
+        datapath.bus_MemWr().is_active=false;
+        datapath.bus_ResSrc().is_active=false;
+        datapath.bus_BRwr().is_active=false;
+        datapath.bus_ALUsrc().is_active=false;
+
+        datapath.bus_ControlForwardA()={0, 1, false};
+        datapath.bus_ControlForwardB()={0, 1, false};
+        datapath.bus_ControlForwardM()={0, 1, false};
+        datapath.bus_ForwardA().is_active=false;
+        datapath.bus_ForwardB().is_active=false;
+        datapath.bus_ForwardM().is_active=false;
 
         
 
@@ -363,22 +721,114 @@ void Simulator::reset(PipelineModel _model, uint32_t _initial_pc) {
 
 // Retrocede un ciclo en la simulación.
 void Simulator::step_back() {
-    if (history_pointer == 0) {
-        // No se puede retroceder más allá del estado inicial.
+    if (!history.can_undo()) {
+        // No se puede retroceder más allá del estado inicial (o del paso más antiguo que se conserva).
         return;
     }
+    apply_delta(history.undo(), false);
+}
+
+void Simulator::seek(uint32_t cycle) {
+    // Última posición grabada que no pasa de `cycle` (o la más antigua).
+    size_t low = history.oldest();
+    size_t high = history.newest();
+    while (low < high) {
+        const size_t middle = (low + high + 1) / 2;
+        if (cycle_at(middle) <= cycle) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    const size_t current = history.position();
+    const size_t recorded = low;
+
+    // Se empieza desde la copia completa más cercana si hay que aplicar menos
+    // deltas que desde la posición actual.
+    const size_t walk = current > recorded ? current - recorded : recorded - current;
+    for (auto checkpoint = checkpoints.rbegin(); checkpoint != checkpoints.rend(); ++checkpoint) {
+        if (checkpoint->position > recorded || !checkpoint->has_main_memory) continue;
+        if (recorded - checkpoint->position < walk) restore_checkpoint(*checkpoint);
+        break;
+    }
+    while (history.position() > recorded) apply_delta(history.undo(), false);
+    while (history.position() < recorded) apply_delta(history.redo(), true);
+
+    // Más allá de lo grabado hay que ejecutar, como mucho MAX_STEPS pasos.
+    if (recorded < history.newest()) return;
+    for (int i = 0; i < MAX_STEPS && current_cycle < cycle; ++i) step();
+}
+
+void Simulator::apply_delta(const StepDelta& delta, bool forward) {
+    if (!delta.writes.empty()) {
+        // Primero se vuelca lo pendiente, para que la memoria sea la que ve el
+        // programa. Hacia atrás se deshacen de la última a la primera.
+        d_cache.flush();
+        const size_t count = delta.writes.size();
+        for (size_t i = 0; i < count; ++i) {
+            const MemoryWrite& write = delta.writes[forward ? i : count - 1 - i];
+            Memory& target = write.main_memory ? *main_memory : d_mem;
+            const uint32_t value = forward ? write.new_value : write.old_value;
+            mark_dirty(write.main_memory, write.address, write.bytes);
+            switch (write.bytes) {
+                case 1: target.write_byte(write.address, static_cast<uint8_t>(value)); break;
+                case 2: target.write_half(write.address, static_cast<uint16_t>(value)); break;
+                default: target.write_word(write.address, value); break;
+            }
+        }
+        // Las cachés pueden tener datos de otro momento de la ejecución.
+        i_cache.invalidate();
+        d_cache.invalidate();
+    }
+
+    pc = forward ? delta.pc_after : delta.pc_before;
+    current_cycle = forward ? delta.cycle_after : delta.cycle_before;
+    if (delta.instruction_changed) instructionString = forward ? delta.instruction_after : delta.instruction_before;
+    apply_chunks(&datapath, HISTORY_DATAPATH, delta.chunks);
+    apply_chunks(&register_file, HISTORY_REGISTERS, delta.chunks);
+    apply_chunks(&timing, HISTORY_TIMING, delta.chunks);
+    apply_chunks(&csrs, HISTORY_CSRS, delta.chunks);
+    cache_clock = timing.cache_clock;
+}
+
+void Simulator::restore_checkpoint(const Checkpoint& checkpoint) {
+    const StateSnapshot& state = checkpoint.state;
+    pc = state.pc;
+    register_file = state.register_file;
+    datapath = state.datapath;
+    current_cycle = state.current_cycle;
+    instructionString = state.instructionString;
+    timing = state.timing;
+    csrs = state.csrs;
+    cache_clock = timing.cache_clock;
+    // Las copias ya incluyen lo que estaba en el buffer de escritura.
+    d_mem = state.d_mem;
+    d_mem.attach_dram(dram);
+    if (undoes_main_memory()) {
+        *main_memory = state.main_mem;
+        main_memory->attach_dram(dram);
+    }
+    memory_resync = true;
+    i_cache.invalidate();
+    d_cache.invalidate();
+    history.move_to(checkpoint.position);
+}
 
-    // Mover el puntero al estado anterior.
-    history_pointer--;
+void Simulator::discard_future() {
+    history.discard_future();
+    while (!checkpoints.empty() && checkpoints.back().position > history.position()) {
+        checkpoint_bytes -= checkpoints.back().bytes;
+        checkpoints.pop_back();
+        pages_since_checkpoint.clear();
+    }
+}
 
-    // Restaurar el estado desde la instantánea.
-    const auto& snapshot = history[history_pointer];
-    pc = snapshot.pc;
-    register_file = snapshot.register_file; // Restaura la copia completa
-    datapath = snapshot.datapath;
-    current_cycle = snapshot.current_cycle;
-    instructionString = snapshot.instructionString;
-    d_mem = snapshot.d_mem; // Restaurar la memoria de datos
+Memory Simulator::snapshot_memory(const Memory& source) const {
+    Memory copy(source);
+    const bool cached = model == PipelineModel::General ? &source == main_memory
+                                                        : (timed_pipeline() && &source == &d_mem);
+    if (cached) d_cache.apply_pending_writes(copy);
+    return copy;
 }
 
 // Devuelve el valor actual del Program Counter.
@@ -392,8 +842,54 @@ uint32_t Simulator::get_status_register() const {
 }
 
 DatapathState Simulator::get_datapath_state() const {
-    
-    return this->datapath;
+    DatapathState state{};
+    datapath.to_legacy(state);
+    auto copy_text = [](char* dest, const std::string& src) {
+        strncpy(dest, src.c_str(), sizeof(state.instruction_cptr) - 1);
+        dest[sizeof(state.instruction_cptr) - 1] = '\0';
+    };
+    copy_text(state.instruction_cptr, datapath.instruction_text < texts.size() ? texts[datapath.instruction_text] : std::string());
+    copy_text(state.Pipe_IF_instruction_cptr, stage_text(datapath, STAGE_IF));
+    copy_text(state.Pipe_ID_instruction_cptr, stage_text(datapath, STAGE_ID));
+    copy_text(state.Pipe_EX_instruction_cptr, stage_text(datapath, STAGE_EX));
+    copy_text(state.Pipe_MEM_instruction_cptr, stage_text(datapath, STAGE_MEM));
+    copy_text(state.Pipe_WB_instruction_cptr, stage_text(datapath, STAGE_WB));
+    return state;
+}
+
+uint32_t Simulator::text_id(const std::string& text) {
+    auto found = text_ids.find(text);
+    if (found != text_ids.end()) return found->second;
+    const uint32_t id = static_cast<uint32_t>(texts.size());
+    texts.push_back(text);
+    text_ids.emplace(text, id);
+    return id;
+}
+
+void Simulator::clear_texts() {
+    texts.assign(1, "");
+    text_ids.clear();
+    text_ids.emplace("", 0);
+    // Los identificadores se reutilizan con otros textos: la próxima versión
+    // del estado tiene que darlos por cambiados aunque el número coincida.
+    constexpr uint32_t STALE_TEXT = TEXT_FROM_INSTRUCTION - 1;
+    versioned_datapath.instruction_text = STALE_TEXT;
+    std::fill(std::begin(versioned_datapath.stage_text), std::end(versioned_datapath.stage_text), STALE_TEXT);
+}
+
+// Como recién construido: la próxima versión es la 1 y lleva todo el estado.
+void Simulator::clear_state_versions() {
+    state_version = 0;
+    versioned_datapath = {};
+    std::fill(std::begin(versioned_registers), std::end(versioned_registers), 0u);
+    std::fill(std::begin(field_versions), std::end(field_versions), 0u);
+    std::fill(std::begin(register_versions), std::end(register_versions), 0u);
+}
+
+std::string Simulator::stage_text(const PackedDatapath& state, PipelineStage stage) const {
+    const uint32_t words[STAGE_COUNT] = {state.Pipe_IF_instruction, state.Pipe_ID_instruction, state.Pipe_EX_instruction,
+                                         state.Pipe_MEM_instruction, state.Pipe_WB_instruction};
+    return get_instruction_text(state.stage_text[stage], words[stage]);
 }
 
 std::string Simulator::get_instruction_string() const {
@@ -406,13 +902,255 @@ const RegisterFile& Simulator::get_registers() const {
     return register_file;
 }
 
-// Devuelve el contenido de la memoria de datos (para modo didáctico).
-const std::vector<uint8_t>& Simulator::get_d_mem() const {
-    return d_mem.get_data();
+// Las cachés trabajan sobre la memoria unificada en modo General y sobre
+// las memorias didácticas en el segmentado con cachés. Estas miden lo mismo
+// que una caché de General, así que ahí las cachés se reducen a
+// PIPELINE_CACHE_SIZE: si no, tras los fallos en frío todo serían aciertos.
+void Simulator::bind_cache_memories() {
+    if (model == PipelineModel::General) {
+        i_cache.set_capacity(IMEM_SIZE);
+        d_cache.set_capacity(DMEM_SIZE);
+        i_cache.set_backing_memory(i_mem);
+        d_cache.set_backing_memory(*main_memory);
+    } else {
+        i_cache.set_capacity(PIPELINE_CACHE_SIZE);
+        d_cache.set_capacity(PIPELINE_CACHE_SIZE);
+        i_cache.set_backing_memory(i_mem);
+        d_cache.set_backing_memory(d_mem);
+    }
+}
+
+Cache& Simulator::cache_by_id(CacheId cache) {
+    if (cache == CacheId::Instruction) return i_cache;
+    return d_cache;
+}
+
+void Simulator::add_prefetcher(CacheId cache, PrefetcherKind kind, unsigned degree, unsigned distance) {
+    discard_future();
+    cache_by_id(cache).add_prefetcher(make_prefetcher(kind, degree, distance));
+}
+
+void Simulator::clear_prefetchers(CacheId cache) {
+    discard_future();
+    cache_by_id(cache).clear_prefetchers();
+}
+
+void Simulator::set_write_buffer_entries(CacheId cache, size_t entries) {
+    discard_future();
+    cache_by_id(cache).set_write_buffer_entries(entries);
+}
+
+void Simulator::set_victim_entries(CacheId cache, size_t entries) {
+    discard_future();
+    cache_by_id(cache).set_victim_entries(entries);
+}
+
+const Cache& Simulator::get_cache(CacheId cache) const {
+    if (cache == CacheId::Instruction) return i_cache;
+    return d_cache;
+}
+
+uint64_t Simulator::get_cache_cycles() const {
+    return cache_clock;
+}
+
+SimulatorFootprint Simulator::get_footprint() const {
+    SimulatorFootprint footprint;
+    // Las páginas que comparten las memorias, las copias completas del
+    // historial y las de otro simulador (fork_to) cuentan una sola vez.
+    footprint.memory_bytes = memory.shared_resident_bytes() + i_mem.shared_resident_bytes() + d_mem.shared_resident_bytes();
+    footprint.history_bytes = history.bytes();
+    for (const Checkpoint& checkpoint : checkpoints) {
+        footprint.memory_bytes += checkpoint.state.d_mem.shared_resident_bytes() + checkpoint.state.main_mem.shared_resident_bytes();
+        footprint.history_bytes += sizeof(Checkpoint) + checkpoint.state.instructionString.capacity();
+    }
+    for (const Cache* cache : {static_cast<const Cache*>(&i_cache), static_cast<const Cache*>(&d_cache)}) {
+        footprint.cache_bytes += (cache->get_num_lines() + cache->get_victim_entries()) * cache->get_block_size();
+    }
+    return footprint;
+}
+
+uint64_t Simulator::memory_stall_cycles() const {
+    return i_cache.get_stats().stall_cycles + d_cache.get_stats().stall_cycles + mmu.get_stats().stall_cycles;
+}
+
+void Simulator::configure_mmu(const MmuConfig& config) {
+    discard_future();
+    mmu.configure(config);
+}
+
+bool Simulator::write_csr(uint32_t number, uint32_t value) {
+    discard_future();
+    switch (number) {
+        case CSR_SATP:   mmu.set_satp(value); return true;
+        case CSR_MTVEC:  csrs.mtvec = value; return true;
+        case CSR_MEPC:   csrs.mepc = value; return true;
+        case CSR_MCAUSE: csrs.mcause = value; return true;
+        case CSR_MTVAL:  csrs.mtval = value; return true;
+    }
+    return false;
+}
+
+bool Simulator::read_csr(uint32_t number, uint32_t& value) const {
+    switch (number) {
+        case CSR_SATP:   value = mmu.get_satp(); return true;
+        case CSR_MTVEC:  value = csrs.mtvec; return true;
+        case CSR_MEPC:   value = csrs.mepc; return true;
+        case CSR_MCAUSE: value = csrs.mcause; return true;
+        case CSR_MTVAL:  value = csrs.mtval; return true;
+    }
+    return false;
+}
+
+uint32_t Simulator::alloc_page_table() {
+    if (next_page_table == 0) {
+        // Con 4 GiB la última página no tiene dirección de fin representable.
+        const uint64_t top = std::min<uint64_t>(main_memory->size(), 0xFFFFF000u);
+        next_page_table = static_cast<uint32_t>(top & ~static_cast<uint64_t>(PAGE_SIZE - 1));
+    }
+    if (next_page_table < 2 * PAGE_SIZE) {
+        throw std::out_of_range("No queda memoria para tablas de páginas");
+    }
+    next_page_table -= PAGE_SIZE;
+    for (uint32_t offset = 0; offset < PAGE_SIZE; offset += 4) {
+        main_memory->write_word(next_page_table + offset, 0);
+    }
+    return next_page_table;
+}
+
+void Simulator::map_page(uint32_t va, uint32_t pa, uint32_t flags) {
+    discard_future();
+    memory_resync = true;
+    if (!mmu.enabled()) {
+        const uint32_t root = alloc_page_table();
+        mmu.set_satp((1u << 31) | (root / PAGE_SIZE));
+    }
+    const uint32_t root = (mmu.get_satp() & 0x3FFFFF) * PAGE_SIZE;
+
+    // Primer nivel: se crea la tabla de segundo nivel si no existe.
+    const uint32_t l1_address = root + ((va >> 22) & 0x3FF) * 4;
+    uint32_t l1 = main_memory->read_word(l1_address);
+    if (!(l1 & PTE_V)) {
+        const uint32_t table = alloc_page_table();
+        l1 = ((table / PAGE_SIZE) << 10) | PTE_V;
+        main_memory->write_word(l1_address, l1);
+    } else if (l1 & (PTE_R | PTE_X)) {
+        throw std::invalid_argument("La dirección ya está cubierta por una megapágina");
+    }
+
+    const uint32_t table = (l1 >> 10) * PAGE_SIZE;
+    main_memory->write_word(table + ((va >> 12) & 0x3FF) * 4, ((pa / PAGE_SIZE) << 10) | (flags & 0xFF) | PTE_V);
+    mmu.flush();
+}
+
+bool Simulator::translate(uint32_t va, AccessType type, uint32_t& pa) {
+    pa = va;
+    if (!mmu.enabled()) return true;
+    if (mmu.translate(va, type, cache_clock, pa)) return true;
+    take_trap(mmu.get_fault_cause(), va);
+    return false;
+}
+
+// Excepción síncrona: se guarda el contexto y se salta al manejador.
+void Simulator::take_trap(uint32_t cause, uint32_t tval) {
+    csrs.mepc = pc;
+    csrs.mcause = cause;
+    csrs.mtval = tval;
+    if (m_logfile.is_open()) {
+        m_logfile << "Trap: causa " << std::dec << cause << " en PC 0x" << std::hex << pc
+                  << ", mtval 0x" << tval << std::dec << std::endl;
+    }
+    pc = csrs.mtvec;
+}
+
+void Simulator::use_shared_memory(Memory& shared) {
+    main_memory = &shared;
+    memory_resync = true;
+    mmu.set_memory(shared);
+    next_page_table = 0;
+    size_instruction_memory();
+    if (model == PipelineModel::General) d_cache.set_backing_memory(shared);
+}
+
+void Simulator::size_instruction_memory() {
+    const size_t size = model == PipelineModel::General ? main_memory->size() : IMEM_SIZE;
+    if (i_mem.size() == size) return;
+    i_mem = Memory(size);
+    i_mem.attach_dram(dram);
+    i_cache.set_backing_memory(i_mem);
+}
+
+void Simulator::attach_coherence_bus(CoherenceBus& bus) {
+    bus.attach(d_cache);
+}
+
+void Simulator::attach_dram(const DramConfig& config) {
+    discard_future();
+    dram = std::make_shared<Dram>(config);
+    main_memory->attach_dram(dram);
+    i_mem.attach_dram(dram);
+    d_mem.attach_dram(dram);
+}
+
+void Simulator::detach_dram() {
+    discard_future();
+    dram.reset();
+    main_memory->attach_dram(nullptr);
+    i_mem.attach_dram(nullptr);
+    d_mem.attach_dram(nullptr);
+}
+
+void Simulator::set_pipeline_caches(bool enabled, size_t mshr_entries) {
+    discard_future();
+    pipeline_caches = enabled;
+    d_cache.set_mshr_entries(enabled ? mshr_entries : 0);
+    timing = {};
+}
+
+// Devuelve el contenido de la memoria de datos. En modo General, los
+// primeros DMEM_SIZE bytes de la principal tal como los ve el programa
+// (con lo pendiente en el buffer de escritura).
+std::vector<uint8_t> Simulator::get_d_mem() const {
+    if (model == PipelineModel::General) {
+        std::vector<uint8_t> bytes(std::min<size_t>(DMEM_SIZE, main_memory->size()));
+        read_data_memory(0, bytes.data(), bytes.size());
+        return bytes;
+    }
+    return d_mem.read_bytes(0, d_mem.size());
+}
+
+void Simulator::get_snapshot(SnapshotView& view) const {
+    view.pc = pc;
+    view.status_register = status_reg;
+    view.cycle = current_cycle;
+    for (uint8_t r = 0; r < 32; ++r) view.registers[r] = register_file.readA(r);
+    strncpy(view.instruction, instructionString.c_str(), sizeof(view.instruction) - 1);
+    view.instruction[sizeof(view.instruction) - 1] = '\0';
+    view.datapath = get_datapath_state();
+    const size_t windows = std::min<size_t>(view.window_count, SNAPSHOT_MAX_WINDOWS);
+    for (size_t i = 0; i < windows; ++i) {
+        MemoryWindow& window = view.windows[i];
+        window.copied = window.buffer ? static_cast<uint32_t>(read_data_memory(window.address, window.buffer, window.length)) : 0;
+    }
+}
+
+size_t Simulator::read_data_memory(uint32_t address, uint8_t* out, size_t length) const {
+    const Memory& target = model == PipelineModel::General ? *main_memory : d_mem;
+    if (address >= target.size()) return 0;
+    length = std::min<size_t>(length, target.size() - address);
+    const bool cached = model == PipelineModel::General || timed_pipeline();
+    if (cached) {
+        // Con buffer de escritura, lo pendiente manda sobre la memoria.
+        for (size_t i = 0; i < length; ++i) out[i] = static_cast<uint8_t>(read_stored(target, address + i, 1, true));
+    } else {
+        const std::vector<uint8_t> bytes = target.read_bytes(address, length);
+        std::copy(bytes.begin(), bytes.end(), out);
+    }
+    return length;
 }
 
 // Devuelve el contenido de la memoria de instrucciones desensamblado.
-std::vector<std::pair<uint32_t, std::string>> Simulator::get_i_mem()  {
+std::vector<std::pair<uint32_t, std::string>> Simulator::get_i_mem() const {
     std::vector<std::pair<uint32_t, std::string>> disassembled_memory;
     
     // Iteramos sobre la memoria de instrucciones en incrementos de 4 bytes (una palabra).
@@ -447,7 +1185,28 @@ std::vector<std::pair<uint32_t, std::string>> Simulator::get_i_mem()  {
 uint32_t Simulator::fetch() {
     // Lee una palabra de 32 bits (4 bytes) desde la caché de instrucciones.
     if (model == PipelineModel::General) {
-        return i_cache.read_word(pc);
+        uint32_t address;
+        if (!translate(pc, AccessType::Fetch, address)) {
+            fetch_faulted = true;
+            return 0x00000013; // nop
+        }
+        return i_cache.read_word(address, pc);
+    } else if (timed_pipeline()) {
+        // Si la lectura anterior falló, la instrucción ya está leída.
+        if (timing.fetch_pending) {
+            timing.fetch_pending = false;
+            return timing.pending_instruction;
+        }
+        uint32_t instruction = i_cache.read_word(instruction_address(pc), pc);
+        const uint32_t extra = i_cache.get_last_latency() - CACHE_HIT_CYCLES;
+        if (extra > 0) {
+            // La segmentación se congela hasta que llegue el bloque.
+            timing.fetch_pending = true;
+            timing.pending_instruction = instruction;
+            timing.freeze = extra - 1;
+            pipeline_stats.icache_stall_cycles += extra;
+        }
+        return instruction;
     } else {
         // En modo didáctico, lee directamente de la memoria de instrucciones. La memoria sólo tiene 256 bytes, pero puede ser de un segmento distinto de cero
             m_logfile << "Model:" << (int) model << std::endl;
@@ -526,31 +1285,61 @@ void Simulator::decode_and_execute(uint32_t instruction)
     }
 }
 
+// Ciclo perdido entero: la segmentación está congelada esperando a memoria.
+bool Simulator::skip_frozen_cycle() {
+    if (!timed_pipeline() || !pipeline_frozen()) return false;
+    current_cycle++;
+    cache_clock++;
+    return true;
+}
+
+// Decide, antes de ejecutar un ciclo del segmentado con cachés, si la
+// segmentación completa debe quedarse quieta.
+bool Simulator::pipeline_frozen() {
+    if (timing.freeze > 0) {
+        timing.freeze--;
+        return true;
+    }
+
+    // Riesgo estructural: la carga que entra en MEM este ciclo falla y no
+    // queda ningún MSHR libre.
+    if (datapath.Pipe_EX_MEM_Control().is_active) {
+        uint16_t mem_control = datapath.Pipe_EX_MEM_Control().value;
+        bool is_load = controlSignal(mem_control, "MemWr") == 0 && controlSignal(mem_control, "ResSrc") == 0 &&
+                       controlSignal(mem_control, "BRwr") == 1;
+        if (is_load && !d_cache.can_accept(data_address(datapath.Pipe_EX_MEM_ALU_result().value))) {
+            pipeline_stats.mshr_stall_cycles++;
+            return true;
+        }
+    }
+    return false;
+}
+
 void Simulator::simulate_single_cycle(uint32_t instruction) {
     // --- INICIO DEL CICLO (t=0) ---
     // La única señal estable al inicio del ciclo es el PC.
     // Le ponemos 1 ps para ver su aparición
-    datapath.bus_PC = { pc, DELAY_PC };
+    datapath.bus_PC() = { pc, DELAY_PC };
     uint32_t pc_plus_4 = adder4.add(pc);
-    datapath.bus_PC_plus4 = { pc_plus_4,datapath.bus_PC.ready_at+ adder4.get_delay() };
+    datapath.bus_PC_plus4() = { pc_plus_4,datapath.bus_PC().ready_at+ adder4.get_delay() };
 
 
     // --- FASE 1: FETCH (Búsqueda de instrucción) ---
     // La memoria de instrucciones (i_mem) necesita el PC. Su salida (la instrucción)
     // estará lista después de su retardo de propagación.
-    uint32_t tmptime=datapath.bus_PC.ready_at + i_mem.get_delay();
-    datapath.bus_Instr={instruction,tmptime};
-    datapath.bus_imm = datapath.bus_Instr;
+    uint32_t tmptime=datapath.bus_PC().ready_at + i_mem.get_delay();
+    datapath.bus_Instr()={instruction,tmptime};
+    datapath.bus_imm() = datapath.bus_Instr();
     
     uint32_t rs1_addr = (instruction >> 15) & 0x1F;
     uint32_t rs2_addr = (instruction >> 20) & 0x1F;
     uint32_t rd_addr  = (instruction >> 7)  & 0x1F;
-    datapath.bus_DA = {(uint8_t)rs1_addr,tmptime};
-    datapath.bus_DB = {(uint8_t)rs2_addr,tmptime};
-    datapath.bus_DC = {(uint8_t)rd_addr,tmptime};
-    datapath.bus_opcode={(uint8_t)(instruction & 0x7F),tmptime};
-    datapath.bus_funct3={(uint8_t)((instruction >> 12) & 0x07),tmptime};
-    datapath.bus_funct7={(uint8_t)((instruction >> 25) & 0x7F),tmptime};
+    datapath.bus_DA() = {(uint8_t)rs1_addr,tmptime};
+    datapath.bus_DB() = {(uint8_t)rs2_addr,tmptime};
+    datapath.bus_DC() = {(uint8_t)rd_addr,tmptime};
+    datapath.bus_opcode()={(uint8_t)(instruction & 0x7F),tmptime};
+    datapath.bus_funct3()={(uint8_t)((instruction >> 12) & 0x07),tmptime};
+    datapath.bus_funct7()={(uint8_t)((instruction >> 25) & 0x7F),tmptime};
 
     
 
@@ -583,7 +1372,7 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
         }
    //datapath.instruction=instructionString;
     datapath.total_micro_cycles = info->cycles;
-    strcpy(datapath.instruction_cptr,instructionString.c_str());
+    datapath.instruction_text = text_id(instructionString);
     }
     catch(const std::exception& e){
         m_logfile << "Error al formatear la instrucción: " << e.what() << std::endl;
@@ -593,7 +1382,7 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
 
     uint32_t controlDelay=tmptime+control_unit.get_delay();
     try{
-    datapath.bus_Control = {controlWord(info),controlDelay};
+    datapath.bus_Control() = {controlWord(info),controlDelay};
     if (m_logfile.is_open()) {
         m_logfile << "Info: instr=" << info->instr << ", PCsrc=" << static_cast<int>(info->PCsrc)
                   << ", BRwr=" << static_cast<int>(info->BRwr) << ", ALUsrc=" << static_cast<int>(info->ALUsrc)
@@ -602,7 +1391,7 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
                   << ", type=" << info->type 
                   << "Control word:" << std::hex << controlWord(info) << std::endl;
     }
-    datapath.bus_PCsrc = {info->PCsrc,tmptime,true}; //El tiempo se cambia después
+    datapath.bus_PCsrc() = {info->PCsrc,tmptime,true}; //El tiempo se cambia después
 
 }
     catch(const std::exception& e){
@@ -614,19 +1403,19 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
 
     uint32_t rs1_val = register_file.readA(rs1_addr);
     uint32_t rs2_val = register_file.readB(rs2_addr);
-    tmptime=datapath.bus_Instr.ready_at + register_file.get_delay();
-    datapath.bus_A = {rs1_val,tmptime};
+    tmptime=datapath.bus_Instr().ready_at + register_file.get_delay();
+    datapath.bus_A() = {rs1_val,tmptime};
 
     // Para LUI, el primer operando de la ALU debe ser 0, no el valor de rs1.
     // Para AUIPC, sería el PC. Aquí lo simplificamos para LUI.
     const uint32_t alu_op_a = (info->type == 'U') ? 0 : rs1_val;
-    datapath.bus_ALU_A = {alu_op_a, tmptime};
+    datapath.bus_ALU_A() = {alu_op_a, tmptime};
 
-    datapath.bus_B = {rs2_val,tmptime};
+    datapath.bus_B() = {rs2_val,tmptime};
     uint32_t imm_ext = sign_extender.extender(instruction, info->ImmSrc);
-    uint32_t tmptime2=datapath.bus_Control.ready_at + sign_extender.get_delay();
-    datapath.bus_immExt = {imm_ext,tmptime2};
-    datapath.bus_Mem_write_data=datapath.bus_B;
+    uint32_t tmptime2=datapath.bus_Control().ready_at + sign_extender.get_delay();
+    datapath.bus_immExt() = {imm_ext,tmptime2};
+    datapath.bus_Mem_write_data()=datapath.bus_B();
     m_logfile <<  "Lectura de registros ok" << std::endl; 
     
 
@@ -635,22 +1424,22 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
         // 3. EJECUCIÓN (ALU)
     // Mux para la entrada B de la ALU
     uint32_t alu_op_b =mux_B.select(imm_ext,rs2_val,info->ALUsrc)   ;
-    uint32_t tmptime3=std::max(std::max(datapath.bus_B.ready_at,datapath.bus_immExt.ready_at),datapath.bus_Control.ready_at) + mux_B.get_delay();
-    datapath.bus_ALU_B = {alu_op_b,tmptime3};
+    uint32_t tmptime3=std::max(std::max(datapath.bus_B().ready_at,datapath.bus_immExt().ready_at),datapath.bus_Control().ready_at) + mux_B.get_delay();
+    datapath.bus_ALU_B() = {alu_op_b,tmptime3};
 
     
     uint32_t alu_result = alu.calc(alu_op_a, alu_op_b, info->ALUctr);
     bool alu_zero = (alu_result == 0);
-    uint32_t tmptime4=std::max(std::max(datapath.bus_ALU_A.ready_at,datapath.bus_ALU_B.ready_at),datapath.bus_Control.ready_at) + alu.get_delay();
-    datapath.bus_ALU_result    = {alu_result,tmptime4};
-    datapath.bus_ALU_zero      = {alu_zero,tmptime4};
-    datapath.bus_Mem_address    = datapath.bus_ALU_result;
+    uint32_t tmptime4=std::max(std::max(datapath.bus_ALU_A().ready_at,datapath.bus_ALU_B().ready_at),datapath.bus_Control().ready_at) + alu.get_delay();
+    datapath.bus_ALU_result()    = {alu_result,tmptime4};
+    datapath.bus_ALU_zero()      = {alu_zero,tmptime4};
+    datapath.bus_Mem_address()    = datapath.bus_ALU_result();
 
 
 
     
     uint32_t pc_plus_imm = adder.add(pc, imm_ext);
-    datapath.bus_PC_dest       = {pc_plus_imm, datapath.bus_immExt.ready_at+ adder.get_delay()};
+    datapath.bus_PC_dest()       = {pc_plus_imm, datapath.bus_immExt().ready_at+ adder.get_delay()};
 
 
     m_logfile <<  "ALU ok" << std::endl; 
@@ -660,9 +1449,15 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
     uint32_t mem_read_data = INDETERMINADO;
 
 
-    if(info->instr=="lw")
+    if (is_load(info))
     try{
-    mem_read_data = d_mem.read_word(alu_result,true);
+    // En modo General los datos pasan por la caché de datos sobre la memoria unificada.
+    if (model == PipelineModel::General) {
+        uint32_t address;
+        if (!translate(alu_result, AccessType::Load, address)) return; // Fallo de página: no se completa
+        mem_read_data = extend_load(d_cache.read(address, access_bytes(instruction), pc), instruction);
+    } else
+        mem_read_data = load_from(d_mem, alu_result, instruction);
     }
     catch(const std::exception& e)
     {
@@ -670,9 +1465,17 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
     mem_read_data=alu_result;
     }
 
-    if (info->MemWr == 1) { // SW
+    if (info->MemWr == 1) { // SW, SH, SB
     try{
-        d_mem.write_word(alu_result, rs2_val);
+        if (model == PipelineModel::General) {
+            uint32_t address;
+            if (!translate(alu_result, AccessType::Store, address)) return; // Fallo de página: no se completa
+            record_store(*main_memory, address, access_bytes(instruction), true);
+            d_cache.write(address, rs2_val, access_bytes(instruction), pc);
+        } else {
+            record_store(d_mem, alu_result, access_bytes(instruction), false);
+            store_to(d_mem, alu_result, rs2_val, instruction);
+        }
     }
     catch(const std::exception& e)
     {
@@ -681,14 +1484,14 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
 
     }
 
-    datapath.bus_Mem_read_data = {mem_read_data, tmptime4+ d_mem.get_delay()};//tmptime4 es la salida de la alu con dirección efectiva
+    datapath.bus_Mem_read_data() = {mem_read_data, tmptime4+ d_mem.get_delay()};//tmptime4 es la salida de la alu con dirección efectiva
     m_logfile <<  "MEM ok" << std::endl; 
 
     // 5. ESCRITURA (WRITE-BACK)
     // Mux para el resultado final
     uint32_t  final_result=mux_C.select(mem_read_data,alu_result,pc_plus_4,INDETERMINADO,info->ResSrc);
-    criticalTime=std::max(std::max(std::max(datapath.bus_ALU_result.ready_at,datapath.bus_Mem_read_data.ready_at),datapath.bus_Control.ready_at),datapath.bus_PC_plus4.ready_at)+mux_C.get_delay();
-    datapath.bus_C = {final_result,criticalTime};
+    criticalTime=std::max(std::max(std::max(datapath.bus_ALU_result().ready_at,datapath.bus_Mem_read_data().ready_at),datapath.bus_Control().ready_at),datapath.bus_PC_plus4().ready_at)+mux_C.get_delay();
+    datapath.bus_C() = {final_result,criticalTime};
     datapath.criticalTime=criticalTime+register_file.get_write_delay();
         if (m_logfile.is_open()) {
             m_logfile << "Resultado ALU: "+std::to_string(alu_result) << std::endl;
@@ -715,64 +1518,64 @@ void Simulator::simulate_single_cycle(uint32_t instruction) {
         take_branch = true;
     }
 
-    uint32_t tmptime5 = std::max(datapath.bus_ALU_zero.ready_at,datapath.bus_Control.ready_at)+DELAY_Z_AND; //Tiempo en llegar la sñal que controla el mux
+    uint32_t tmptime5 = std::max(datapath.bus_ALU_zero().ready_at,datapath.bus_Control().ready_at)+DELAY_Z_AND; //Tiempo en llegar la sñal que controla el mux
     
-    datapath.bus_branch_taken = {take_branch, tmptime5};
-    datapath.bus_PCsrc.ready_at = tmptime5;
+    datapath.bus_branch_taken() = {take_branch, tmptime5};
+    datapath.bus_PCsrc().ready_at = tmptime5;
 
     // La dirección de destino para JALR es el resultado de la ALU, no PC + imm.
     uint32_t jump_target = (info->instr == "jalr") ? alu_result : pc_plus_imm;
 
-    tmptime5 = std::max(std::max(datapath.bus_PC_plus4.ready_at,datapath.bus_PC_dest.ready_at),tmptime5) + mux_PC.get_delay();
+    tmptime5 = std::max(std::max(datapath.bus_PC_plus4().ready_at,datapath.bus_PC_dest().ready_at),tmptime5) + mux_PC.get_delay();
 
     uint32_t next_pc = take_branch ? jump_target : pc_plus_4;
 
-    datapath.bus_PC_next = {next_pc,tmptime5};
+    datapath.bus_PC_next() = {next_pc,tmptime5};
     // Aquí desactivamos las rutas que no se usan para la instrucción actual.
     // Por defecto, todos los is_active son 'true' desde la definición de la struct Signal.
-    if(info->PCsrc!=0)datapath.bus_PC_plus4.is_active=false;
+    if(info->PCsrc!=0)datapath.bus_PC_plus4().is_active=false;
 
     if (info->instr == "addi") {
-        datapath.bus_PC_dest.is_active = false;       // El sumador de saltos no se usa.
-        datapath.bus_Mem_read_data.is_active = false; // No se lee de la memoria de datos.
-        datapath.bus_B.is_active = false;             // La segunda lectura de registros (rs2) no se usa.
-    } else if (info->instr == "lw") { // Load Word
-        datapath.bus_PC_dest.is_active = false;       // El sumador de saltos no se usa.
-        datapath.bus_B.is_active = false;             // La segunda lectura de registros no se usa para la ALU.
-    } else if (info->instr == "sw") { // Store Word
-        datapath.bus_PC_dest.is_active = false;       // El sumador de saltos no se usa.
-        datapath.bus_Mem_read_data.is_active = false; // No se lee de memoria, se escribe.
-        datapath.bus_C.is_active = false;             // No hay resultado que escribir en los registros (write-back).
+        datapath.bus_PC_dest().is_active = false;       // El sumador de saltos no se usa.
+        datapath.bus_Mem_read_data().is_active = false; // No se lee de la memoria de datos.
+        datapath.bus_B().is_active = false;             // La segunda lectura de registros (rs2) no se usa.
+    } else if (is_load(info)) { // Cargas (lw, lh, lb, lhu, lbu)
+        datapath.bus_PC_dest().is_active = false;       // El sumador de saltos no se usa.
+        datapath.bus_B().is_active = false;             // La segunda lectura de registros no se usa para la ALU.
+    } else if (info->MemWr) { // Almacenamientos (sw, sh, sb)
+        datapath.bus_PC_dest().is_active = false;       // El sumador de saltos no se usa.
+        datapath.bus_Mem_read_data().is_active = false; // No se lee de memoria, se escribe.
+        datapath.bus_C().is_active = false;             // No hay resultado que escribir en los registros (write-back).
     } else if (info->type == 'U') { // LUI
-        datapath.bus_Mem_read_data.is_active = false; // No se accede a la memoria de datos.
-        datapath.bus_PC_dest.is_active = false;       // El sumador de saltos no se usa.
+        datapath.bus_Mem_read_data().is_active = false; // No se accede a la memoria de datos.
+        datapath.bus_PC_dest().is_active = false;       // El sumador de saltos no se usa.
     } else if (info->type == 'R') { // LUI
-        datapath.bus_Mem_read_data.is_active = false; // No se accede a la memoria de datos.
-        datapath.bus_PC_dest.is_active = false;       // El sumador de saltos no se usa.
+        datapath.bus_Mem_read_data().is_active = false; // No se accede a la memoria de datos.
+        datapath.bus_PC_dest().is_active = false;       // El sumador de saltos no se usa.
     } else if (info->type == 'B') { // Branches (BEQ, etc.)
-        datapath.bus_Mem_read_data.is_active = false; // No se accede a la memoria de datos.
-        datapath.bus_PC_plus4.is_active=true;
+        datapath.bus_Mem_read_data().is_active = false; // No se accede a la memoria de datos.
+        datapath.bus_PC_plus4().is_active=true;
 
-        datapath.bus_C.is_active = false;             // No hay resultado que escribir en los registros.
+        datapath.bus_C().is_active = false;             // No hay resultado que escribir en los registros.
     } else if (info->type == 'J' || info->instr == "jalr") { // Jumps
         // Para JAL, el sumador de saltos (PC + imm) SÍ está activo.
         // Lo que no se usa es el resultado de la ALU principal ni la memoria de datos.
-        datapath.bus_ALU_result.is_active = false;
-        datapath.bus_Mem_address.is_active = false;
-        datapath.bus_Mem_read_data.is_active = false;
-        datapath.bus_PC_plus4.is_active=true;
+        datapath.bus_ALU_result().is_active = false;
+        datapath.bus_Mem_address().is_active = false;
+        datapath.bus_Mem_read_data().is_active = false;
+        datapath.bus_PC_plus4().is_active=true;
     }
 
 
 
 
-    datapath.bus_PCsrc = {info->PCsrc, controlDelay};
-    datapath.bus_ALUsrc = {info->ALUsrc, controlDelay};
-    datapath.bus_ResSrc = {info->ResSrc, controlDelay};
-    datapath.bus_ImmSrc = {info->ImmSrc, controlDelay};
-    datapath.bus_ALUctr = {info->ALUctr, controlDelay};
-    datapath.bus_BRwr = {info->BRwr, controlDelay};
-    datapath.bus_MemWr = {info->MemWr, controlDelay};
+    datapath.bus_PCsrc() = {info->PCsrc, controlDelay};
+    datapath.bus_ALUsrc() = {info->ALUsrc, controlDelay};
+    datapath.bus_ResSrc() = {info->ResSrc, controlDelay};
+    datapath.bus_ImmSrc() = {info->ImmSrc, controlDelay};
+    datapath.bus_ALUctr() = {info->ALUctr, controlDelay};
+    datapath.bus_BRwr() = {info->BRwr, controlDelay};
+    datapath.bus_MemWr() = {info->MemWr, controlDelay};
 
 
 
@@ -792,7 +1595,7 @@ void Simulator::simulate_multi_cycle(uint32_t instruction) {
     if (!info) info=control_unit.decode(0x00000013); // Si no se reconoce la instrucción, usamos NOP como fallback.
 
     instructionString = disassemble(instruction, info);
-    strcpy(datapath.instruction_cptr, instructionString.c_str());
+    datapath.instruction_text = text_id(instructionString);
     datapath.total_micro_cycles = info->cycles;
 
     // --- Valores que se propagan a través de los ciclos ---
@@ -806,36 +1609,36 @@ void Simulator::simulate_multi_cycle(uint32_t instruction) {
 
     // --- MICRO-CICLO 0: IF (Instruction Fetch) ---
     // El PC se usa para leer la memoria de instrucciones.
-    datapath.bus_PC = { pc, 0 };
-    datapath.bus_Instr = { instruction, 0 };
-    datapath.bus_PC_plus4 = { pc_plus_4, 0 };
-
-    datapath.bus_DA = { (uint8_t)rs1_addr, 1 };
-    datapath.bus_DB = { (uint8_t)rs2_addr, 1 };
-    datapath.bus_DC = { (uint8_t)rd_addr, 1 };
-    datapath.bus_opcode = { (uint8_t)(instruction & 0x7F), 1 };
-    datapath.bus_funct3 = { (uint8_t)((instruction >> 12) & 0x07), 1 };
-    datapath.bus_funct7 = { (uint8_t)((instruction >> 25) & 0x7F), 1 };
-    datapath.bus_imm = { instruction, 1 };
+    datapath.bus_PC() = { pc, 0 };
+    datapath.bus_Instr() = { instruction, 0 };
+    datapath.bus_PC_plus4() = { pc_plus_4, 0 };
+
+    datapath.bus_DA() = { (uint8_t)rs1_addr, 1 };
+    datapath.bus_DB() = { (uint8_t)rs2_addr, 1 };
+    datapath.bus_DC() = { (uint8_t)rd_addr, 1 };
+    datapath.bus_opcode() = { (uint8_t)(instruction & 0x7F), 1 };
+    datapath.bus_funct3() = { (uint8_t)((instruction >> 12) & 0x07), 1 };
+    datapath.bus_funct7() = { (uint8_t)((instruction >> 25) & 0x7F), 1 };
+    datapath.bus_imm() = { instruction, 1 };
     
 
     // --- MICRO-CICLO 1: ID (Instruction Decode & Register Fetch) ---
     // Se decodifica la instrucción y se leen los registros.
     
-    datapath.bus_A = { rs1_val, 1 };
-    datapath.bus_B = { rs2_val, 1 };
-    datapath.bus_immExt = { imm_ext, 1 };
-    datapath.bus_Control = { controlWord(info), 1, true };
+    datapath.bus_A() = { rs1_val, 1 };
+    datapath.bus_B() = { rs2_val, 1 };
+    datapath.bus_immExt() = { imm_ext, 1 };
+    datapath.bus_Control() = { controlWord(info), 1, true };
 
     // Las señales de control individuales también están listas en este ciclo.
 
-    datapath.bus_PCsrc = {info->PCsrc, 1};
-    datapath.bus_ALUsrc = {info->ALUsrc, 1};
-    datapath.bus_ResSrc = {info->ResSrc, 1};
-    datapath.bus_ImmSrc = {info->ImmSrc, 1};
-    datapath.bus_ALUctr = {info->ALUctr, 1};
-    datapath.bus_BRwr = {info->BRwr, 1};
-    datapath.bus_MemWr = {info->MemWr, 1};
+    datapath.bus_PCsrc() = {info->PCsrc, 1};
+    datapath.bus_ALUsrc() = {info->ALUsrc, 1};
+    datapath.bus_ResSrc() = {info->ResSrc, 1};
+    datapath.bus_ImmSrc() = {info->ImmSrc, 1};
+    datapath.bus_ALUctr() = {info->ALUctr, 1};
+    datapath.bus_BRwr() = {info->BRwr, 1};
+    datapath.bus_MemWr() = {info->MemWr, 1};
 
     // --- MICRO-CICLO 2: EX (Execute) ---
     // La ALU realiza la operación.
@@ -845,11 +1648,11 @@ void Simulator::simulate_multi_cycle(uint32_t instruction) {
     const bool alu_zero = (alu_result == 0);
     const uint32_t pc_plus_imm = pc + imm_ext;
 
-    datapath.bus_ALU_A = { alu_op_a, 1 };
-    datapath.bus_ALU_B = { alu_op_b, 2 };
-    datapath.bus_ALU_result = { alu_result, 2 };
-    datapath.bus_ALU_zero = { alu_zero, 2 };
-    datapath.bus_PC_dest = { pc_plus_imm, 2 };
+    datapath.bus_ALU_A() = { alu_op_a, 1 };
+    datapath.bus_ALU_B() = { alu_op_b, 2 };
+    datapath.bus_ALU_result() = { alu_result, 2 };
+    datapath.bus_ALU_zero() = { alu_zero, 2 };
+    datapath.bus_PC_dest() = { pc_plus_imm, 2 };
 
     // --- Lógica variable para los ciclos 3 y 4 ---
     uint32_t mem_read_data = INDETERMINADO;
@@ -857,53 +1660,54 @@ void Simulator::simulate_multi_cycle(uint32_t instruction) {
     uint32_t next_pc;
 
     // Por defecto, las rutas de memoria y escritura no están activas.
-    datapath.bus_Mem_address.is_active = false;
-    datapath.bus_Mem_write_data.is_active = false;
-    datapath.bus_Mem_read_data.is_active = false;
-    datapath.bus_C.is_active = false;
+    datapath.bus_Mem_address().is_active = false;
+    datapath.bus_Mem_write_data().is_active = false;
+    datapath.bus_Mem_read_data().is_active = false;
+    datapath.bus_C().is_active = false;
 
     if (info->type == 'R' || info->instr == "addi") { // R-Type o ADDI (4 ciclos)
         // Ciclo 3: WB
         final_result = alu_result;
-        datapath.bus_C = { final_result, 3 };
-        datapath.bus_C.is_active = true;
+        datapath.bus_C() = { final_result, 3 };
+        datapath.bus_C().is_active = true;
         if (info->BRwr == 1) register_file.write(rd_addr, final_result);
         next_pc = pc_plus_4;
 
-    } else if (info->instr == "lw") { // LW (5 ciclos)
+    } else if (is_load(info)) { // LW, LH, LB, LHU, LBU (5 ciclos)
         // Ciclo 3: MEM
-        datapath.bus_Mem_address = { alu_result, 3, true };
-        mem_read_data = d_mem.read_word(alu_result,true);
-        datapath.bus_Mem_read_data = { mem_read_data, 3, true };
+        datapath.bus_Mem_address() = { alu_result, 3, true };
+        mem_read_data = load_from(d_mem, alu_result, instruction);
+        datapath.bus_Mem_read_data() = { mem_read_data, 3, true };
         // Ciclo 4: WB
         final_result = mem_read_data;
-        datapath.bus_C = { final_result, 4 };
-        datapath.bus_C.is_active = true;
+        datapath.bus_C() = { final_result, 4 };
+        datapath.bus_C().is_active = true;
         if (info->BRwr == 1) register_file.write(rd_addr, final_result);
         next_pc = pc_plus_4;
 
-    } else if (info->instr == "sw") { // SW (4 ciclos)
+    } else if (info->MemWr) { // SW, SH, SB (4 ciclos)
         // Ciclo 3: MEM
-        datapath.bus_Mem_address = { alu_result, 3, true };
-        datapath.bus_Mem_write_data = { rs2_val, 3, true };
-        datapath.bus_C = { INDETERMINADO,999, false };
-        d_mem.write_word(alu_result, rs2_val);
+        datapath.bus_Mem_address() = { alu_result, 3, true };
+        datapath.bus_Mem_write_data() = { rs2_val, 3, true };
+        datapath.bus_C() = { INDETERMINADO,999, false };
+        record_store(d_mem, alu_result, access_bytes(instruction), false);
+        store_to(d_mem, alu_result, rs2_val, instruction);
         next_pc = pc_plus_4;
 
     } else if (info->type == 'B') { // BEQ (3 ciclos)
         // Ciclo 2: EX/Branch completion
         bool take_branch =info->instr == "beq" && (alu_result == 0) || info->instr == "bne" && (alu_result != 0);
-        datapath.bus_branch_taken = { take_branch, 2 };
+        datapath.bus_branch_taken() = { take_branch, 2 };
         next_pc = take_branch ? pc_plus_imm : pc_plus_4;
 
     } else { // Jumps, etc. (Tratamiento genérico, se puede refinar)
         // Asumimos 4 ciclos por defecto para JAL, etc.
         final_result = mux_C.select(alu_result, mem_read_data, pc_plus_4, 0, info->ResSrc);
-        datapath.bus_C = { final_result, 3 };
-        datapath.bus_C.is_active = info->BRwr;
+        datapath.bus_C() = { final_result, 3 };
+        datapath.bus_C().is_active = info->BRwr;
         if (info->BRwr == 1) register_file.write(rd_addr, final_result);
         bool is_jump = (info->PCsrc == 1 || info->PCsrc == 2);
-        datapath.bus_branch_taken = { is_jump, 2 };
+        datapath.bus_branch_taken() = { is_jump, 2 };
         // Para JALR, el destino es el resultado de la ALU. Para JAL, es PC + imm.
         uint32_t jump_target = (info->PCsrc == 2) ? alu_result : pc_plus_imm;
         next_pc = is_jump ? jump_target : pc_plus_4;
@@ -911,7 +1715,7 @@ void Simulator::simulate_multi_cycle(uint32_t instruction) {
     }
 
     // El PC se actualiza al final del último microciclo de la instrucción anterior.
-    datapath.bus_PC_next = { next_pc, (uint32_t)(info->cycles - 1) };
+    datapath.bus_PC_next() = { next_pc, (uint32_t)(info->cycles - 1) };
 
     // Actualizamos el PC para el siguiente ciclo de instrucción.
     pc = next_pc;
@@ -920,52 +1724,48 @@ void Simulator::simulate_multi_cycle(uint32_t instruction) {
     // Estos buses simulan la salida de los registros de segmentación en el ciclo *siguiente*
     // a donde se calculan sus entradas.
 
-    strcpy(datapath.Pipe_IF_instruction_cptr, instructionString.c_str());
-    strcpy(datapath.Pipe_ID_instruction_cptr, instructionString.c_str());
-    strcpy(datapath.Pipe_EX_instruction_cptr, instructionString.c_str());
-    strcpy(datapath.Pipe_MEM_instruction_cptr, instructionString.c_str());
-    strcpy(datapath.Pipe_WB_instruction_cptr, instructionString.c_str());
+    std::fill(std::begin(datapath.stage_text), std::end(datapath.stage_text), datapath.instruction_text);
 
 
 
     // IF/ID (listo en ciclo 1)
-    datapath.Pipe_IF_ID_Instr = { instruction,1 };
-    //datapath.Pipe_IF_ID_NPC = { pc_plus_4, 1 };
-    //datapath.Pipe_IF_ID_PC = { pc, 1 };
+    datapath.Pipe_IF_ID_Instr() = { instruction,1 };
+    //datapath.Pipe_IF_ID_NPC() = { pc_plus_4, 1 };
+    //datapath.Pipe_IF_ID_PC() = { pc, 1 };
 
-    // ID/EX (listo en ciclo 2)    datapath.Pipe_ID_EX_Control = { controlWord(info), 2 };
+    // ID/EX (listo en ciclo 2)    datapath.Pipe_ID_EX_Control() = { controlWord(info), 2 };
 
-    //datapath.Pipe_ID_EX_Control = { controlWord(info), 2 };
-    //datapath.Pipe_ID_EX_NPC = { pc_plus_4, 1 };
-    datapath.Pipe_ID_EX_A = { alu_op_a, 2 }; // alu_op_a es rs1_val (o 0 para LUI)
-    datapath.Pipe_ID_EX_B = { rs2_val, 2 };
-    //datapath.Pipe_ID_EX_RD = { (uint8_t)rd_addr, 1 };
-    datapath.Pipe_ID_EX_Imm = { imm_ext, 2 };
-    //datapath.Pipe_ID_EX_PC = { pc, 1 };
+    //datapath.Pipe_ID_EX_Control() = { controlWord(info), 2 };
+    //datapath.Pipe_ID_EX_NPC() = { pc_plus_4, 1 };
+    datapath.Pipe_ID_EX_A() = { alu_op_a, 2 }; // alu_op_a es rs1_val (o 0 para LUI)
+    datapath.Pipe_ID_EX_B() = { rs2_val, 2 };
+    //datapath.Pipe_ID_EX_RD() = { (uint8_t)rd_addr, 1 };
+    datapath.Pipe_ID_EX_Imm() = { imm_ext, 2 };
+    //datapath.Pipe_ID_EX_PC() = { pc, 1 };
 
     // EX/MEM (listo en ciclo 3)
-    bool esSW=info->instr == "sw";
+    bool esSW=info->MemWr;
     bool noesJ=info->type != 'J';
 
-    //datapath.Pipe_EX_MEM_Control = { controlWord(info), 3 };
-    //datapath.Pipe_EX_MEM_NPC = { pc_plus_4, 2,noesJ };
-    datapath.Pipe_EX_MEM_ALU_result = { alu_result, 3 };
-    datapath.Pipe_EX_MEM_B = { rs2_val, 3 ,esSW};
-    //datapath.Pipe_EX_MEM_RD = { (uint8_t)rd_addr, 2,!esSW}; // RD solo se usa en LW/R-Type, no en SW};
+    //datapath.Pipe_EX_MEM_Control() = { controlWord(info), 3 };
+    //datapath.Pipe_EX_MEM_NPC() = { pc_plus_4, 2,noesJ };
+    datapath.Pipe_EX_MEM_ALU_result() = { alu_result, 3 };
+    datapath.Pipe_EX_MEM_B() = { rs2_val, 3 ,esSW};
+    //datapath.Pipe_EX_MEM_RD() = { (uint8_t)rd_addr, 2,!esSW}; // RD solo se usa en LW/R-Type, no en SW};
 
     // MEM/WB (listo en ciclo 4 para LW, 3 para R-Type)
     // El bus C ya tiene el tiempo correcto, así que lo copiamos.
-    uint8_t cuando=(uint8_t) ((info->instr != "lw")?3:4);
+    uint8_t cuando=(uint8_t) (!is_load(info)?3:4);
 
-    bool noesSW=info->instr != "sw";
-    bool noesLW=info->instr != "lw";
+    bool noesSW=!info->MemWr;
+    bool noesLW=!is_load(info);
     bool noesB=info->type != 'B';
 
-    datapath.Pipe_MEM_WB_Control = { controlWord(info), cuando };
-    datapath.Pipe_MEM_WB_NPC = { pc_plus_4,cuando, noesJ };
-    datapath.Pipe_MEM_WB_ALU_result = {alu_result,cuando,noesSW&&noesLW&&noesB};
-    datapath.Pipe_MEM_WB_RM = { (uint32_t)mem_read_data,cuando ,!noesLW};
-    datapath.Pipe_MEM_WB_RD = { (uint8_t)rd_addr,cuando ,noesSW};
+    datapath.Pipe_MEM_WB_Control() = { controlWord(info), cuando };
+    datapath.Pipe_MEM_WB_NPC() = { pc_plus_4,cuando, noesJ };
+    datapath.Pipe_MEM_WB_ALU_result() = {alu_result,cuando,noesSW&&noesLW&&noesB};
+    datapath.Pipe_MEM_WB_RM() = { (uint32_t)mem_read_data,cuando ,!noesLW};
+    datapath.Pipe_MEM_WB_RD() = { (uint8_t)rd_addr,cuando ,noesSW};
 
     // El tiempo crítico no es tan relevante en multiciclo, pero lo ponemos al final.
     datapath.criticalTime = info->cycles;
@@ -996,16 +1796,16 @@ void Simulator::simulate_pipeline(uint32_t instruction) {
     uint32_t prev_if_instr  = datapath.Pipe_IF_instruction;
 
     const InstructionInfo* fetched_info = control_unit.decode(instruction);
-    const InstructionInfo* decoded_info = control_unit.decode(datapath.Pipe_IF_ID_Instr_out.value);
+    const InstructionInfo* decoded_info = control_unit.decode(datapath.Pipe_IF_ID_Instr_out().value);
 
 
 
     instructionString = fetched_info ? disassemble(instruction, fetched_info) : "c.unimp";
 
-    bool is_valid_instr_WB = datapath.Pipe_MEM_WB_NPC_out.is_active;
-    bool is_valid_instr_MEM = datapath.Pipe_EX_MEM_NPC_out.is_active;
-    bool is_valid_instr_EX = datapath.Pipe_ID_EX_NPC_out.is_active;
-    bool is_valid_instr_ID = decoded_info != nullptr && datapath.Pipe_IF_ID_Instr_out.is_active;
+    bool is_valid_instr_WB = datapath.Pipe_MEM_WB_NPC_out().is_active;
+    bool is_valid_instr_MEM = datapath.Pipe_EX_MEM_NPC_out().is_active;
+    bool is_valid_instr_EX = datapath.Pipe_ID_EX_NPC_out().is_active;
+    bool is_valid_instr_ID = decoded_info != nullptr && datapath.Pipe_IF_ID_Instr_out().is_active;
     bool is_valid_instr_IF = fetched_info != nullptr;
 
     /**
@@ -1040,29 +1840,29 @@ void Simulator::simulate_pipeline(uint32_t instruction) {
     
     try{
     if (is_valid_instr_WB) {
-        uint8_t wb_rd = datapath.Pipe_MEM_WB_RD_out.value;
-        uint16_t wb_control = datapath.Pipe_MEM_WB_Control_out.value;
+        uint8_t wb_rd = datapath.Pipe_MEM_WB_RD_out().value;
+        uint16_t wb_control = datapath.Pipe_MEM_WB_Control_out().value;
         uint8_t ResSrc = controlSignal(wb_control, "ResSrc");
         BRwr = controlSignal(wb_control, "BRwr"); // BRwr is used as RegWrite
 
-        datapath.bus_ResSrc = { ResSrc, 1, is_valid_instr_WB };
-        datapath.bus_BRwr = { BRwr, 1, is_valid_instr_WB };
+        datapath.bus_ResSrc() = { ResSrc, 1, is_valid_instr_WB };
+        datapath.bus_BRwr() = { BRwr, 1, is_valid_instr_WB };
 
         // MUX C: Selects the final result to be written.
-        uint32_t result = mux_C.select(datapath.Pipe_MEM_WB_RM_out.value,       // Data from memory (for loads)
-                                       datapath.Pipe_MEM_WB_ALU_result_out.value, // Result from ALU
-                                       datapath.Pipe_MEM_WB_NPC_out.value,      // PC+4 (for JAL)
+        uint32_t result = mux_C.select(datapath.Pipe_MEM_WB_RM_out().value,       // Data from memory (for loads)
+                                       datapath.Pipe_MEM_WB_ALU_result_out().value, // Result from ALU
+                                       datapath.Pipe_MEM_WB_NPC_out().value,      // PC+4 (for JAL)
                                        INDETERMINADO,
                                        ResSrc);
 
         if (BRwr && wb_rd != 0) { // If RegWrite is enabled and destination is not x0
             oldDestinationRegister=register_file.readA(wb_rd);
             register_file.write(wb_rd, result);
-            datapath.bus_C = { result, 1,true };
+            datapath.bus_C() = { result, 1,true };
 
         }
         else {
-            datapath.bus_C = { INDETERMINADO, 1, false }; // No write-back
+            datapath.bus_C() = { INDETERMINADO, 1, false }; // No write-back
         }
 
 
@@ -1080,10 +1880,10 @@ void Simulator::simulate_pipeline(uint32_t instruction) {
 
     if(m_logfile.is_open()&&DEBUG_INFO){
         m_logfile << "WB Stage test: " << std::endl
-                  << "Pipe0: " << datapath.Pipe_MEM_WB_RD.is_active << "\t" << (int)datapath.Pipe_MEM_WB_RD.value << std::endl
-                  << "Pipe1: " << datapath.Pipe_MEM_WB_RM.is_active << "\t" << (int)datapath.Pipe_MEM_WB_RM.value << std::endl
-                  << "Pipe2: " << datapath.Pipe_MEM_WB_NPC.is_active << "\t" << (int)datapath.Pipe_MEM_WB_NPC.value << std::endl
-                  << "Pipe3: " << datapath.Pipe_MEM_WB_ALU_result.is_active << "\t" << (int)datapath.Pipe_MEM_WB_ALU_result.value << std::endl
+                  << "Pipe0: " << datapath.Pipe_MEM_WB_RD().is_active << "\t" << (int)datapath.Pipe_MEM_WB_RD().value << std::endl
+                  << "Pipe1: " << datapath.Pipe_MEM_WB_RM().is_active << "\t" << (int)datapath.Pipe_MEM_WB_RM().value << std::endl
+                  << "Pipe2: " << datapath.Pipe_MEM_WB_NPC().is_active << "\t" << (int)datapath.Pipe_MEM_WB_NPC().value << std::endl
+                  << "Pipe3: " << datapath.Pipe_MEM_WB_ALU_result().is_active << "\t" << (int)datapath.Pipe_MEM_WB_ALU_result().value << std::endl
                   << std::endl;
     }
 
@@ -1094,56 +1894,84 @@ void Simulator::simulate_pipeline(uint32_t instruction) {
     // Data comes from the EX/MEM pipeline register.
     uint32_t mem_read_data = INDETERMINADO;
     bool isLWorSW=false;
-    uint32_t data_to_store = datapath.Pipe_EX_MEM_B_out.value; // Valor por defecto para SW.
-    datapath.bus_ControlForwardM = {0, 1, false}; // BUGFIX: Reiniciamos el bus de control de forwarding MEM->MEM en cada ciclo.
+    uint32_t data_to_store = datapath.Pipe_EX_MEM_B_out().value; // Valor por defecto para SW.
+    datapath.bus_ControlForwardM() = {0, 1, false}; // BUGFIX: Reiniciamos el bus de control de forwarding MEM->MEM en cada ciclo.
     if(m_logfile.is_open()&&DEBUG_INFO) m_logfile << "Se desactiva por defecto el forward m m " << std::endl;
 
-    if (handle_forwarding && is_valid_instr_MEM && controlSignal(datapath.Pipe_EX_MEM_Control_out.value, "MemWr")) {
+    if (handle_forwarding && is_valid_instr_MEM && controlSignal(datapath.Pipe_EX_MEM_Control_out().value, "MemWr")) {
         // --- LÓGICA DE FORWARDING MEM -> MEM ---
         // Detecta si una instrucción SW en la etapa MEM necesita el resultado de una LW en la etapa WB.
         
         // Registro fuente (rs2) de la instrucción SW en la etapa MEM.
         // El valor de rs2 se propagó en el bus B y ahora está en Pipe_EX_MEM_B.
         // La dirección del registro rs2 se propagó en el bus RD de ID/EX y EX/MEM.
-        uint8_t mem_rs2_addr = datapath.Pipe_EX_MEM_RD_out.value; // Reutilizamos RD para rs2 en SW
+        uint8_t mem_rs2_addr = datapath.Pipe_EX_MEM_RD_out().value; // Reutilizamos RD para rs2 en SW
 
         // Registro destino (rd) de la instrucción en la etapa WB.
-        uint8_t wb_rd = datapath.Pipe_MEM_WB_RD_out.value;
-        bool wb_is_load = datapath.Pipe_MEM_WB_Control_out.is_active && controlSignal(datapath.Pipe_MEM_WB_Control_out.value, "ResSrc") == 0; // ResSrc=0 es LW
+        uint8_t wb_rd = datapath.Pipe_MEM_WB_RD_out().value;
+        bool wb_is_load = datapath.Pipe_MEM_WB_Control_out().is_active && controlSignal(datapath.Pipe_MEM_WB_Control_out().value, "ResSrc") == 0; // ResSrc=0 es LW
 
         if (wb_is_load && wb_rd != 0 && wb_rd == mem_rs2_addr) {
-            data_to_store = datapath.Pipe_MEM_WB_RM_out.value; // Cortocircuito desde el dato leído en la etapa anterior.
-            datapath.bus_ControlForwardM = {1, 1, true}; // Activamos el forwarding.
+            data_to_store = datapath.Pipe_MEM_WB_RM_out().value; // Cortocircuito desde el dato leído en la etapa anterior.
+            datapath.bus_ControlForwardM() = {1, 1, true}; // Activamos el forwarding.
             if(m_logfile.is_open()&&DEBUG_INFO) m_logfile << "Se activó el forward m m " << std::endl;
 
         }
     }
 
     try{
-    if (datapath.Pipe_EX_MEM_Control_out.is_active) {
-        uint16_t mem_control = datapath.Pipe_EX_MEM_Control_out.value;
-        uint32_t alu_result = datapath.Pipe_EX_MEM_ALU_result_out.value;
+    if (datapath.Pipe_EX_MEM_Control_out().is_active) {
+        uint16_t mem_control = datapath.Pipe_EX_MEM_Control_out().value;
+        uint32_t alu_result = datapath.Pipe_EX_MEM_ALU_result_out().value;
         uint8_t MemWr = controlSignal(mem_control, "MemWr");
-        datapath.bus_MemWr = { MemWr, 1, datapath.Pipe_EX_MEM_Control_out.is_active };
+        datapath.bus_MemWr() = { MemWr, 1, datapath.Pipe_EX_MEM_Control_out().is_active };
 
 
+        const uint32_t mem_pc = datapath.Pipe_EX_MEM_NPC_out().value - 4;
+        // El ancho del acceso sale del funct3 de la instrucción que está en MEM
+        // (las etiquetas de etapa se desplazan al final del ciclo).
+        const uint32_t mem_instr = prev_ex_instr;
         if (MemWr == 1) { // Store instruction (e.g., SW)
-            d_mem.write_word(alu_result, data_to_store);
+            if (pipeline_caches) {
+                // Write-through: la segmentación espera a que la escritura se acepte.
+                record_store(d_mem, data_address(alu_result), access_bytes(mem_instr), true);
+                d_cache.write(data_address(alu_result), data_to_store, access_bytes(mem_instr), mem_pc);
+                const uint32_t extra = d_cache.get_last_latency() - CACHE_HIT_CYCLES;
+                timing.freeze += extra;
+                pipeline_stats.store_stall_cycles += extra;
+            } else {
+                record_store(d_mem, alu_result, access_bytes(mem_instr), false);
+                store_to(d_mem, alu_result, data_to_store, mem_instr);
+            }
             isLWorSW=true;
         } else if (controlSignal(mem_control, "ResSrc") == 0) { // Load instruction (e.g., LW)
-            mem_read_data = d_mem.read_word(alu_result,true);
+            if (pipeline_caches && controlSignal(mem_control, "BRwr") == 1) {
+                // Con MSHR la caché no bloquea: el dato se obtiene ya, pero el
+                // registro destino no estará listo hasta que llegue el bloque.
+                mem_read_data = extend_load(d_cache.read(data_address(alu_result), access_bytes(mem_instr), mem_pc), mem_instr);
+                const uint32_t extra = d_cache.get_last_latency() - CACHE_HIT_CYCLES;
+                uint8_t load_rd = datapath.Pipe_EX_MEM_RD_out().value;
+                if (d_cache.get_mshr_entries() == 0) {
+                    // Caché bloqueante: la segmentación espera al bloque.
+                    timing.freeze += extra;
+                    pipeline_stats.load_stall_cycles += extra;
+                } else if (load_rd != 0) {
+                    timing.reg_ready_at[load_rd] = cache_clock + extra;
+                }
+            } else
+            mem_read_data = load_from(d_mem, alu_result, mem_instr);
             isLWorSW=true;
         }
     }
-    datapath.bus_Mem_read_data = { mem_read_data, 1, isLWorSW };
-    datapath.bus_ForwardM = { data_to_store, 1, datapath.bus_ControlForwardM.is_active };
+    datapath.bus_Mem_read_data() = { mem_read_data, 1, isLWorSW };
+    datapath.bus_ForwardM() = { data_to_store, 1, datapath.bus_ControlForwardM().is_active };
 
     // Pass data to the next stage's register (MEM/WB)
-    datapath.Pipe_MEM_WB_Control      = datapath.Pipe_EX_MEM_Control_out;
-    datapath.Pipe_MEM_WB_NPC          = datapath.Pipe_EX_MEM_NPC_out;
-    datapath.Pipe_MEM_WB_ALU_result   = datapath.Pipe_EX_MEM_ALU_result_out;
-    datapath.Pipe_MEM_WB_RD           = datapath.Pipe_EX_MEM_RD_out;
-    datapath.Pipe_MEM_WB_RM           = {mem_read_data, 1, is_valid_instr_MEM};
+    datapath.Pipe_MEM_WB_Control()      = datapath.Pipe_EX_MEM_Control_out();
+    datapath.Pipe_MEM_WB_NPC()          = datapath.Pipe_EX_MEM_NPC_out();
+    datapath.Pipe_MEM_WB_ALU_result()   = datapath.Pipe_EX_MEM_ALU_result_out();
+    datapath.Pipe_MEM_WB_RD()           = datapath.Pipe_EX_MEM_RD_out();
+    datapath.Pipe_MEM_WB_RM()           = {mem_read_data, 1, is_valid_instr_MEM};
 
 }
 catch(const std::exception& e){
@@ -1152,10 +1980,10 @@ catch(const std::exception& e){
 
     if(m_logfile.is_open()&&DEBUG_INFO){
         m_logfile << "MEM Stage: " << std::endl
-                    << "Pipe0: " << datapath.Pipe_EX_MEM_RD.is_active << "\t" << (int)datapath.Pipe_EX_MEM_RD.value << std::endl
-                    << "Pipe1: " << datapath.Pipe_EX_MEM_B.is_active << "\t" << (int)datapath.Pipe_EX_MEM_B.value << std::endl
-                    << "Pipe2: " << datapath.Pipe_EX_MEM_ALU_result.is_active << "\t" << (int)datapath.Pipe_EX_MEM_ALU_result.value << std::endl
-                    << "Pipe3: " << datapath.Pipe_EX_MEM_NPC.is_active << "\t" << (int)datapath.Pipe_EX_MEM_NPC.value << std::endl
+                    << "Pipe0: " << datapath.Pipe_EX_MEM_RD().is_active << "\t" << (int)datapath.Pipe_EX_MEM_RD().value << std::endl
+                    << "Pipe1: " << datapath.Pipe_EX_MEM_B().is_active << "\t" << (int)datapath.Pipe_EX_MEM_B().value << std::endl
+                    << "Pipe2: " << datapath.Pipe_EX_MEM_ALU_result().is_active << "\t" << (int)datapath.Pipe_EX_MEM_ALU_result().value << std::endl
+                    << "Pipe3: " << datapath.Pipe_EX_MEM_NPC().is_active << "\t" << (int)datapath.Pipe_EX_MEM_NPC().value << std::endl
                     << std::endl;
     }
 
@@ -1174,61 +2002,61 @@ catch(const std::exception& e){
     uint32_t pc_plus_imm = 0;
     bool take_branch = false;
 
-    uint32_t forwarded_a = datapath.Pipe_ID_EX_A_out.value;
-    uint32_t forwarded_b = datapath.Pipe_ID_EX_B_out.value;
+    uint32_t forwarded_a = datapath.Pipe_ID_EX_A_out().value;
+    uint32_t forwarded_b = datapath.Pipe_ID_EX_B_out().value;
 
     if (is_valid_instr_EX && handle_forwarding) {
         // --- FORWARDING UNIT LOGIC ---
         // Determina si necesitamos cortocircuitar datos desde las etapas MEM o WB a la etapa EX.
 
         // Registros fuente de la instrucción en la etapa EX (leídos desde el registro ID/EX)
-        uint8_t ex_rs1_addr = datapath.Pipe_ID_EX_RS1_out.value;
-        uint8_t ex_rs2_addr = datapath.Pipe_ID_EX_RS2_out.value;
+        uint8_t ex_rs1_addr = datapath.Pipe_ID_EX_RS1_out().value;
+        uint8_t ex_rs2_addr = datapath.Pipe_ID_EX_RS2_out().value;
 
         // Registros destino de las instrucciones en etapas posteriores
-        uint8_t ex_mem_rd = datapath.Pipe_EX_MEM_RD_out.value;
-        uint8_t mem_wb_rd = datapath.Pipe_MEM_WB_RD_out.value;
+        uint8_t ex_mem_rd = datapath.Pipe_EX_MEM_RD_out().value;
+        uint8_t mem_wb_rd = datapath.Pipe_MEM_WB_RD_out().value;
 
         // Señales de control de escritura en registro de etapas posteriores
-        bool ex_mem_reg_write = datapath.Pipe_EX_MEM_Control_out.is_active && controlSignal(datapath.Pipe_EX_MEM_Control_out.value, "BRwr");
-        bool mem_wb_reg_write = datapath.Pipe_MEM_WB_Control_out.is_active && controlSignal(datapath.Pipe_MEM_WB_Control_out.value, "BRwr");
+        bool ex_mem_reg_write = datapath.Pipe_EX_MEM_Control_out().is_active && controlSignal(datapath.Pipe_EX_MEM_Control_out().value, "BRwr");
+        bool mem_wb_reg_write = datapath.Pipe_MEM_WB_Control_out().is_active && controlSignal(datapath.Pipe_MEM_WB_Control_out().value, "BRwr");
 
         // Lógica para Forward A (operando rs1)
         if (ex_mem_reg_write && ex_mem_rd != 0 && ex_mem_rd == ex_rs1_addr) { // <-- ex_mem_rd != 0
-            datapath.bus_ControlForwardA = {1, 1, true}; // Forward desde MEM (ALU result)
-            forwarded_a = datapath.Pipe_EX_MEM_ALU_result_out.value;
+            datapath.bus_ControlForwardA() = {1, 1, true}; // Forward desde MEM (ALU result)
+            forwarded_a = datapath.Pipe_EX_MEM_ALU_result_out().value;
         } else if (mem_wb_reg_write && mem_wb_rd != 0 && mem_wb_rd == ex_rs1_addr) { // <-- mem_wb_rd != 0
-            datapath.bus_ControlForwardA = {2, 1, true}; // Forward desde WB (resultado final)
-            forwarded_a = datapath.bus_C.value; // bus_C contiene el resultado final de la etapa WB
+            datapath.bus_ControlForwardA() = {2, 1, true}; // Forward desde WB (resultado final)
+            forwarded_a = datapath.bus_C().value; // bus_C contiene el resultado final de la etapa WB
         } else {
-            datapath.bus_ControlForwardA = {0, 1, false}; // Sin forwarding
+            datapath.bus_ControlForwardA() = {0, 1, false}; // Sin forwarding
         }
 
         // Lógica para Forward B (operando rs2)
         if (ex_mem_reg_write && ex_mem_rd != 0 && ex_mem_rd == ex_rs2_addr) { // <-- ex_mem_rd != 0
-            datapath.bus_ControlForwardB = {1, 1, true}; // Forward desde MEM
-            forwarded_b = datapath.Pipe_EX_MEM_ALU_result_out.value;
+            datapath.bus_ControlForwardB() = {1, 1, true}; // Forward desde MEM
+            forwarded_b = datapath.Pipe_EX_MEM_ALU_result_out().value;
         } else if (mem_wb_reg_write && mem_wb_rd != 0 && mem_wb_rd == ex_rs2_addr) {
-            datapath.bus_ControlForwardB = {2, 1, true}; // Forward desde WB
-            forwarded_b = datapath.bus_C.value;
+            datapath.bus_ControlForwardB() = {2, 1, true}; // Forward desde WB
+            forwarded_b = datapath.bus_C().value;
         } else {
-            datapath.bus_ControlForwardB = {0, 1, false}; // Sin forwarding
+            datapath.bus_ControlForwardB() = {0, 1, false}; // Sin forwarding
         }
 
         // Actualizamos los buses de datos que salen de los Mux de Forwarding
-        datapath.bus_ForwardA = {forwarded_a, 1, datapath.bus_ControlForwardA.is_active};
-        datapath.bus_ForwardB = {forwarded_b, 1, datapath.bus_ControlForwardB.is_active};
+        datapath.bus_ForwardA() = {forwarded_a, 1, datapath.bus_ControlForwardA().is_active};
+        datapath.bus_ForwardB() = {forwarded_b, 1, datapath.bus_ControlForwardB().is_active};
     }
     uint32_t alu_op_b=INDETERMINADO;
     try{
-    if (datapath.Pipe_ID_EX_Control_out.is_active) {
-        uint16_t ex_control = datapath.Pipe_ID_EX_Control_out.value;
+    if (datapath.Pipe_ID_EX_Control_out().is_active) {
+        uint16_t ex_control = datapath.Pipe_ID_EX_Control_out().value;
         uint8_t ALUsrc = controlSignal(ex_control, "ALUsrc");
         uint8_t ALUctr = controlSignal(ex_control, "ALUctr");
         uint8_t PCsrc = controlSignal(ex_control, "PCsrc");
 
         // MUX B: Selects the second operand for the ALU.
-        alu_op_b = mux_B.select(datapath.Pipe_ID_EX_Imm_out.value, forwarded_b, ALUsrc);
+        alu_op_b = mux_B.select(datapath.Pipe_ID_EX_Imm_out().value, forwarded_b, ALUsrc);
 
         if(m_logfile.is_open()&&DEBUG_INFO) m_logfile << "ALUsrc: "<< ALUsrc << std::endl;
 
@@ -1238,12 +2066,12 @@ catch(const std::exception& e){
 
         // *** BUG FIX ***: Correct branch target calculation.
         // It uses the PC from the ID/EX register, not the current global PC.
-        pc_plus_imm = datapath.Pipe_ID_EX_PC_out.value + datapath.Pipe_ID_EX_Imm_out.value;
+        pc_plus_imm = datapath.Pipe_ID_EX_PC_out().value + datapath.Pipe_ID_EX_Imm_out().value;
         
         bool condition_met = false;
         if (PCsrc == 1) { // Salto condicional (B-type) o JAL
             if (controlSignal(ex_control, "BRwr") == 0) { // Es un salto condicional (no escribe en registro)
-                uint8_t funct3 = datapath.Pipe_ID_EX_RD_out.value; // funct3 se pasó en el campo RD
+                uint8_t funct3 = datapath.Pipe_ID_EX_RD_out().value; // funct3 se pasó en el campo RD
                 switch (funct3) {
                     case 0b000: // beq
                         condition_met = alu_zero;
@@ -1258,9 +2086,9 @@ catch(const std::exception& e){
             }
         }
         take_branch = (PCsrc == 1 && condition_met) || PCsrc == 2; // PCsrc=2 para JALR
-        datapath.bus_ALUsrc={ALUsrc,1,is_valid_instr_EX};
-        datapath.bus_ALUctr={ALUctr,1,is_valid_instr_EX};
-        datapath.bus_PCsrc={PCsrc,1,is_valid_instr_EX};
+        datapath.bus_ALUsrc()={ALUsrc,1,is_valid_instr_EX};
+        datapath.bus_ALUctr()={ALUctr,1,is_valid_instr_EX};
+        datapath.bus_PCsrc()={PCsrc,1,is_valid_instr_EX};
 
 
     }
@@ -1281,28 +2109,28 @@ catch(const std::exception& e){
     }
 
     // Pass data to the next stage's register (EX/MEM)
-    datapath.Pipe_EX_MEM_ALU_result ={ alu_result,1, is_valid_instr_EX}; // Pass the ALU result
-    datapath.Pipe_EX_MEM_B  = {forwarded_b,1, is_valid_instr_EX}; // Pass the (potentially forwarded) value of rs2 for stores
-    datapath.Pipe_EX_MEM_RD         = {datapath.Pipe_ID_EX_RD_out.value,1, is_valid_instr_EX};
+    datapath.Pipe_EX_MEM_ALU_result() ={ alu_result,1, is_valid_instr_EX}; // Pass the ALU result
+    datapath.Pipe_EX_MEM_B()  = {forwarded_b,1, is_valid_instr_EX}; // Pass the (potentially forwarded) value of rs2 for stores
+    datapath.Pipe_EX_MEM_RD()         = {datapath.Pipe_ID_EX_RD_out().value,1, is_valid_instr_EX};
 
-    datapath.Pipe_EX_MEM_Control    =datapath.Pipe_ID_EX_Control_out;
-    datapath.Pipe_EX_MEM_NPC        = datapath.Pipe_ID_EX_NPC_out;
+    datapath.Pipe_EX_MEM_Control()    =datapath.Pipe_ID_EX_Control_out();
+    datapath.Pipe_EX_MEM_NPC()        = datapath.Pipe_ID_EX_NPC_out();
 
     // Internal buses for this stage
-    datapath.bus_PC_dest = {pc_plus_imm, 1, is_valid_instr_EX}; // Pass the branch target to the next stage
-    datapath.bus_ALU_result = {alu_result, 1, is_valid_instr_EX}; // Pass the ALU result to the next stage
-    datapath.bus_ALU_zero = {alu_zero, 1, is_valid_instr_EX}; // Pass the ALU zero flag to the next stage
-    datapath.bus_branch_taken = {take_branch, 1, is_valid_instr_EX}; // Pass the branch taken signal to the next stage
-    datapath.bus_ALU_B = {alu_op_b, 1, is_valid_instr_EX}; // Pass the second ALU operand to the next stage
+    datapath.bus_PC_dest() = {pc_plus_imm, 1, is_valid_instr_EX}; // Pass the branch target to the next stage
+    datapath.bus_ALU_result() = {alu_result, 1, is_valid_instr_EX}; // Pass the ALU result to the next stage
+    datapath.bus_ALU_zero() = {alu_zero, 1, is_valid_instr_EX}; // Pass the ALU zero flag to the next stage
+    datapath.bus_branch_taken() = {take_branch, 1, is_valid_instr_EX}; // Pass the branch taken signal to the next stage
+    datapath.bus_ALU_B() = {alu_op_b, 1, is_valid_instr_EX}; // Pass the second ALU operand to the next stage
     
     if(m_logfile.is_open()&&DEBUG_INFO){
         m_logfile << "EX Stage: " << std::endl
-                  << "ID/EX RDestino: " << datapath.Pipe_ID_EX_RD.is_active << "\t" << (int)datapath.Pipe_ID_EX_RD.value << std::endl
-                  << "ID/EX A: " << datapath.Pipe_ID_EX_A.is_active << "\t" << (int)datapath.Pipe_ID_EX_A.value << std::endl
-                  << "ID/EX B: " << datapath.Pipe_ID_EX_B.is_active << "\t" << (int)datapath.Pipe_ID_EX_B.value << std::endl
-                  << "ID/EX Imm: " << datapath.Pipe_ID_EX_Imm.is_active << "\t" << (int)datapath.Pipe_ID_EX_Imm.value << std::endl
-                  << "ID/EX NPC: " << datapath.Pipe_ID_EX_NPC.is_active << "\t" << (int)datapath.Pipe_ID_EX_NPC.value << std::endl
-                  << "ID/EX PC: " << datapath.Pipe_ID_EX_PC.is_active << "\t" << (int)datapath.Pipe_ID_EX_PC.value << std::endl
+                  << "ID/EX RDestino: " << datapath.Pipe_ID_EX_RD().is_active << "\t" << (int)datapath.Pipe_ID_EX_RD().value << std::endl
+                  << "ID/EX A: " << datapath.Pipe_ID_EX_A().is_active << "\t" << (int)datapath.Pipe_ID_EX_A().value << std::endl
+                  << "ID/EX B: " << datapath.Pipe_ID_EX_B().is_active << "\t" << (int)datapath.Pipe_ID_EX_B().value << std::endl
+                  << "ID/EX Imm: " << datapath.Pipe_ID_EX_Imm().is_active << "\t" << (int)datapath.Pipe_ID_EX_Imm().value << std::endl
+                  << "ID/EX NPC: " << datapath.Pipe_ID_EX_NPC().is_active << "\t" << (int)datapath.Pipe_ID_EX_NPC().value << std::endl
+                  << "ID/EX PC: " << datapath.Pipe_ID_EX_PC().is_active << "\t" << (int)datapath.Pipe_ID_EX_PC().value << std::endl
                   << "alu_op_b: " << alu_op_b << std::endl
 
                   << "ALU Result: " << alu_result << ", Zero: " << alu_zero 
@@ -1326,16 +2154,16 @@ catch(const std::exception& e){
         // A load-use hazard occurs if the instruction in the EX stage is a load (lw)
         // and its destination register (rd) is one of the source registers (rs1 or rs2)
         // of the instruction currently in the ID stage.
-        if (datapath.Pipe_ID_EX_Control_out.is_active) {
-            uint16_t ex_control = datapath.Pipe_ID_EX_Control_out.value;
+        if (datapath.Pipe_ID_EX_Control_out().is_active) {
+            uint16_t ex_control = datapath.Pipe_ID_EX_Control_out().value;
             uint8_t ex_ResSrc = controlSignal(ex_control, "ResSrc");
             uint8_t ex_BRwr = controlSignal(ex_control, "BRwr");
 
             if (ex_ResSrc == 0 && ex_BRwr == 1) { // Es load
-                uint8_t ex_rd = datapath.Pipe_ID_EX_RD_out.value;
+                uint8_t ex_rd = datapath.Pipe_ID_EX_RD_out().value;
 
                 // Get the source registers for the instruction currently in the ID stage
-                uint32_t id_instr = datapath.Pipe_IF_ID_Instr_out.value;
+                uint32_t id_instr = datapath.Pipe_IF_ID_Instr_out().value;
                 uint8_t id_rs1 = (id_instr >> 15) & 0x1F;
                 uint8_t id_rs2 = (id_instr >> 20) & 0x1F;
 
@@ -1348,9 +2176,23 @@ catch(const std::exception& e){
         }
     }
 
+    // --- MARCADOR DE CARGAS PENDIENTES (segmentado con cachés) ---
+    // La instrucción en ID espera mientras alguno de sus operandos venga de
+    // una carga cuyo bloque todavía no ha llegado.
+    if (pipeline_caches && !stall && is_valid_instr_ID) {
+        uint32_t id_instr = datapath.Pipe_IF_ID_Instr_out().value;
+        uint8_t id_rs1 = (id_instr >> 15) & 0x1F;
+        uint8_t id_rs2 = (id_instr >> 20) & 0x1F;
+        if ((id_rs1 != 0 && timing.reg_ready_at[id_rs1] > cache_clock) ||
+            (id_rs2 != 0 && timing.reg_ready_at[id_rs2] > cache_clock)) {
+            stall = true;
+            pipeline_stats.scoreboard_stall_cycles++;
+        }
+    }
+
     // Asignamos el estado de los buses de riesgo después de haberlos calculado.
-    datapath.bus_stall = { stall, 1, stall };
-    datapath.bus_flush = { flush, 1, flush };
+    datapath.bus_stall() = { stall, 1, stall };
+    datapath.bus_flush() = { flush, 1, flush };
 
     if (flush) {
         // Squash the instruction in the ID stage by passing a NOP to the EX stage.
@@ -1360,32 +2202,32 @@ catch(const std::exception& e){
 
 
 
-        datapath.Pipe_ID_EX_Control = {0, 1, false}; // Control signals for NOP, inactive
-        datapath.Pipe_ID_EX_A = {0, 1, false};
-        datapath.Pipe_ID_EX_B = {0, 1, false};
-        datapath.Pipe_ID_EX_RD = {0, 1, false};
-        datapath.Pipe_ID_EX_Imm = {0, 1, false};
-        datapath.Pipe_ID_EX_NPC = {0, 1, false};
-        datapath.Pipe_ID_EX_PC = {0, 1, false};
+        datapath.Pipe_ID_EX_Control() = {0, 1, false}; // Control signals for NOP, inactive
+        datapath.Pipe_ID_EX_A() = {0, 1, false};
+        datapath.Pipe_ID_EX_B() = {0, 1, false};
+        datapath.Pipe_ID_EX_RD() = {0, 1, false};
+        datapath.Pipe_ID_EX_Imm() = {0, 1, false};
+        datapath.Pipe_ID_EX_NPC() = {0, 1, false};
+        datapath.Pipe_ID_EX_PC() = {0, 1, false};
 
-        strcpy(datapath.Pipe_IF_instruction_cptr , "nop (flush)");
+        datapath.stage_text[STAGE_IF] = text_id("nop (flush)");
         if(m_logfile.is_open()&&DEBUG_INFO)        m_logfile << "Flush detectado: " << std::endl;
 
     } else if (stall) {
         // Inject a "bubble" (NOP) into the pipeline
-        datapath.Pipe_ID_EX_Control = {0, 1, false};        if(m_logfile.is_open()&&DEBUG_INFO)        m_logfile << "Stall detectado: " << std::endl;
-        datapath.Pipe_ID_EX_A = {0, 1, false};
-        datapath.Pipe_ID_EX_B = {0, 1, false};
-        datapath.Pipe_ID_EX_RD = {0, 1, false};
-        datapath.Pipe_ID_EX_Imm = {0, 1, false};
-        datapath.Pipe_ID_EX_NPC = {0, 1, false};
-        datapath.Pipe_ID_EX_PC = {0, 1, false};
+        datapath.Pipe_ID_EX_Control() = {0, 1, false};        if(m_logfile.is_open()&&DEBUG_INFO)        m_logfile << "Stall detectado: " << std::endl;
+        datapath.Pipe_ID_EX_A() = {0, 1, false};
+        datapath.Pipe_ID_EX_B() = {0, 1, false};
+        datapath.Pipe_ID_EX_RD() = {0, 1, false};
+        datapath.Pipe_ID_EX_Imm() = {0, 1, false};
+        datapath.Pipe_ID_EX_NPC() = {0, 1, false};
+        datapath.Pipe_ID_EX_PC() = {0, 1, false};
 
 
     } else {
         // Normal operation
 
-        uint32_t instruction_in_id = datapath.Pipe_IF_ID_Instr_out.value;
+        uint32_t instruction_in_id = datapath.Pipe_IF_ID_Instr_out().value;
         uint8_t rs1_addr = (instruction_in_id >> 15) & 0x1F;
         uint8_t rs2_addr = (instruction_in_id >> 20) & 0x1F;
         uint8_t rd_addr  = (instruction_in_id >> 7)  & 0x1F;
@@ -1394,11 +2236,11 @@ catch(const std::exception& e){
         uint32_t regBcontent=register_file.readB(rs2_addr);
         if(!WRITEFIRST)
         {
-            if(rs1_addr==datapath.Pipe_MEM_WB_RD_out.value && BRwr)regAcontent=oldDestinationRegister;
-            if(rs2_addr==datapath.Pipe_MEM_WB_RD_out.value && BRwr)regBcontent=oldDestinationRegister;
+            if(rs1_addr==datapath.Pipe_MEM_WB_RD_out().value && BRwr)regAcontent=oldDestinationRegister;
+            if(rs2_addr==datapath.Pipe_MEM_WB_RD_out().value && BRwr)regBcontent=oldDestinationRegister;
         }
-        datapath.Pipe_ID_EX_A = {regAcontent,1,is_valid_instr_ID};
-        datapath.Pipe_ID_EX_B = {regBcontent,1,is_valid_instr_ID};
+        datapath.Pipe_ID_EX_A() = {regAcontent,1,is_valid_instr_ID};
+        datapath.Pipe_ID_EX_B() = {regBcontent,1,is_valid_instr_ID};
 
 
         // --- REUTILIZACIÓN DE Pipe_ID_EX_RD para funct3 en saltos ---
@@ -1406,41 +2248,46 @@ catch(const std::exception& e){
         // para pasar el campo funct3 a la siguiente etapa.
         if (is_valid_instr_ID && decoded_info->type == 'B') {
             uint8_t funct3 = (instruction_in_id >> 12) & 0x7;
-            datapath.Pipe_ID_EX_RD = {funct3, 1, is_valid_instr_ID};
+            datapath.Pipe_ID_EX_RD() = {funct3, 1, is_valid_instr_ID};
         } else if (is_valid_instr_ID && decoded_info->type == 'S') {
             // Para SW, necesitamos rs2 para el forwarding MEM->MEM. Lo pasamos por el campo RD.
             uint8_t funct3 = rs2_addr; // El registro a escribir en memoria
-            datapath.Pipe_ID_EX_RD = {funct3, 1, is_valid_instr_ID};
+            datapath.Pipe_ID_EX_RD() = {funct3, 1, is_valid_instr_ID};
         } else {
-            datapath.Pipe_ID_EX_RD = {rd_addr,1,is_valid_instr_ID};
+            datapath.Pipe_ID_EX_RD() = {rd_addr,1,is_valid_instr_ID};
         }
 
-        datapath.Pipe_ID_EX_RS1 = {rs1_addr, 1, is_valid_instr_ID};
-        datapath.Pipe_ID_EX_RS2 = {rs2_addr, 1, is_valid_instr_ID};
+        datapath.Pipe_ID_EX_RS1() = {rs1_addr, 1, is_valid_instr_ID};
+        datapath.Pipe_ID_EX_RS2() = {rs2_addr, 1, is_valid_instr_ID};
+
+        datapath.Pipe_ID_EX_Imm() = {sign_extender.extender(instruction_in_id, ImmSrc),1,is_valid_instr_ID};
 
-        datapath.Pipe_ID_EX_Imm = {sign_extender.extender(instruction_in_id, ImmSrc),1,is_valid_instr_ID};
+        datapath.Pipe_ID_EX_Control()= {id_control_word,1,is_valid_instr_ID}; //No necesitaríamos todo. Parte ya se ha consumido en ID.
 
-        datapath.Pipe_ID_EX_Control= {id_control_word,1,is_valid_instr_ID}; //No necesitaríamos todo. Parte ya se ha consumido en ID.
-        datapath.Pipe_ID_EX_NPC = datapath.Pipe_IF_ID_NPC_out;
-        datapath.Pipe_ID_EX_PC = datapath.Pipe_IF_ID_PC_out;
+        // Un escritor más reciente hace obsoleta la espera por una carga anterior.
+        if (pipeline_caches && is_valid_instr_ID && controlSignal(id_control_word, "BRwr") == 1) {
+            timing.reg_ready_at[rd_addr] = 0;
+        }
+        datapath.Pipe_ID_EX_NPC() = datapath.Pipe_IF_ID_NPC_out();
+        datapath.Pipe_ID_EX_PC() = datapath.Pipe_IF_ID_PC_out();
 
         //Buses de esta etapa
-        datapath.bus_DA = { rs1_addr, 1, is_valid_instr_ID }; // DA is the address of the first source register
-        datapath.bus_DB = { rs2_addr, 1, is_valid_instr_ID }; // DB is the address of the second source register
-        datapath.bus_DC = { rd_addr, 1, is_valid_instr_ID }; // DC is the address of the destination register
-        datapath.bus_opcode = { (uint8_t)(instruction_in_id & 0x7F), 1, is_valid_instr_ID }; // Opcode is the last 7 bits
-        datapath.bus_funct3 = { (uint8_t)((instruction_in_id >> 12) & 0x07), 1, is_valid_instr_ID }; // Funct3 is bits 12-14
-        datapath.bus_funct7 = { (uint8_t)((instruction_in_id >> 25) & 0x7F), 1, is_valid_instr_ID }; // Funct7 is bits 25-31
-        //datapath.bus_Instr = { instruction_in_id, 1, is_valid_instr_ID }; // The instruction itself
-        //datapath.bus_stall = { stall, 1, stall };
-        //datapath.bus_flush = { flush, 1, flush };
-
-        datapath.bus_A = { datapath.Pipe_ID_EX_A.value, 1, is_valid_instr_ID }; // Value of the first source register
-        datapath.bus_B = { datapath.Pipe_ID_EX_B.value, 1, is_valid_instr_ID }; // Value of the second source register
-        datapath.bus_imm = { instruction_in_id, 1, is_valid_instr_ID }; // Immediate value (not yet extended)
-        datapath.bus_immExt = { datapath.Pipe_ID_EX_Imm.value, 1, is_valid_instr_ID }; // Extended immediate value
-
-        datapath.bus_ImmSrc = { ImmSrc, 1, is_valid_instr_ID }; // ImmSrc
+        datapath.bus_DA() = { rs1_addr, 1, is_valid_instr_ID }; // DA is the address of the first source register
+        datapath.bus_DB() = { rs2_addr, 1, is_valid_instr_ID }; // DB is the address of the second source register
+        datapath.bus_DC() = { rd_addr, 1, is_valid_instr_ID }; // DC is the address of the destination register
+        datapath.bus_opcode() = { (uint8_t)(instruction_in_id & 0x7F), 1, is_valid_instr_ID }; // Opcode is the last 7 bits
+        datapath.bus_funct3() = { (uint8_t)((instruction_in_id >> 12) & 0x07), 1, is_valid_instr_ID }; // Funct3 is bits 12-14
+        datapath.bus_funct7() = { (uint8_t)((instruction_in_id >> 25) & 0x7F), 1, is_valid_instr_ID }; // Funct7 is bits 25-31
+        //datapath.bus_Instr() = { instruction_in_id, 1, is_valid_instr_ID }; // The instruction itself
+        //datapath.bus_stall() = { stall, 1, stall };
+        //datapath.bus_flush() = { flush, 1, flush };
+
+        datapath.bus_A() = { datapath.Pipe_ID_EX_A().value, 1, is_valid_instr_ID }; // Value of the first source register
+        datapath.bus_B() = { datapath.Pipe_ID_EX_B().value, 1, is_valid_instr_ID }; // Value of the second source register
+        datapath.bus_imm() = { instruction_in_id, 1, is_valid_instr_ID }; // Immediate value (not yet extended)
+        datapath.bus_immExt() = { datapath.Pipe_ID_EX_Imm().value, 1, is_valid_instr_ID }; // Extended immediate value
+
+        datapath.bus_ImmSrc() = { ImmSrc, 1, is_valid_instr_ID }; // ImmSrc
         if(m_logfile.is_open()&&DEBUG_INFO)        m_logfile << "No flush no stall: " << std::endl;
 
     }
@@ -1450,26 +2297,26 @@ catch(const std::exception& e){
                   << "id control" << id_control_word << std::endl
                   << "if control" << if_control_word << std::endl
                   << "immSrc" << (int)ImmSrc << std::endl
-                  << "IDctr: " << datapath.Pipe_ID_EX_Control.value << std::endl
-                  << "Pipe0: " << datapath.Pipe_IF_ID_Instr.is_active << "\t" << (int)datapath.Pipe_IF_ID_Instr.value << std::endl
-                  << "Pipe1: " << datapath.Pipe_ID_EX_Control.is_active << "\t" << (int)datapath.Pipe_ID_EX_Control.value << std::endl
-                  << "Pipe2: " << datapath.Pipe_ID_EX_NPC.is_active << "\t" << (int)datapath.Pipe_ID_EX_NPC.value << std::endl
-                  << "Pipe3: " << datapath.Pipe_ID_EX_PC.is_active << "\t" << (int)datapath.Pipe_ID_EX_PC.value << std::endl
-                  << "Pipe4: " << datapath.Pipe_ID_EX_A.is_active << "\t" << (int)datapath.Pipe_ID_EX_A.value << std::endl
-                  << "Pipe5: " << datapath.Pipe_ID_EX_B.is_active << "\t" << (int)datapath.Pipe_ID_EX_B.value << std::endl
-                  << "Pipe6: " << datapath.Pipe_ID_EX_RD.is_active << "\t" << (int)datapath.Pipe_ID_EX_RD.value << std::endl
-                  << "Pipe7: " << datapath.Pipe_ID_EX_Imm.is_active  << "\t"  << (int)datapath.Pipe_ID_EX_Imm.value  << std::endl;
+                  << "IDctr: " << datapath.Pipe_ID_EX_Control().value << std::endl
+                  << "Pipe0: " << datapath.Pipe_IF_ID_Instr().is_active << "\t" << (int)datapath.Pipe_IF_ID_Instr().value << std::endl
+                  << "Pipe1: " << datapath.Pipe_ID_EX_Control().is_active << "\t" << (int)datapath.Pipe_ID_EX_Control().value << std::endl
+                  << "Pipe2: " << datapath.Pipe_ID_EX_NPC().is_active << "\t" << (int)datapath.Pipe_ID_EX_NPC().value << std::endl
+                  << "Pipe3: " << datapath.Pipe_ID_EX_PC().is_active << "\t" << (int)datapath.Pipe_ID_EX_PC().value << std::endl
+                  << "Pipe4: " << datapath.Pipe_ID_EX_A().is_active << "\t" << (int)datapath.Pipe_ID_EX_A().value << std::endl
+                  << "Pipe5: " << datapath.Pipe_ID_EX_B().is_active << "\t" << (int)datapath.Pipe_ID_EX_B().value << std::endl
+                  << "Pipe6: " << datapath.Pipe_ID_EX_RD().is_active << "\t" << (int)datapath.Pipe_ID_EX_RD().value << std::endl
+                  << "Pipe7: " << datapath.Pipe_ID_EX_Imm().is_active  << "\t"  << (int)datapath.Pipe_ID_EX_Imm().value  << std::endl;
                   //<< "Instruction: "  + instructionString 
                   //<< ", Opcode: " + std::to_string(datapath.bus_Opcode.value)
-                  //<< ", Funct3: " + std::to_string(datapath.bus_funct3.value)
-                  //<< ", Funct7: " + std::to_string(datapath.bus_funct7.value)
-                  //<< ", DA: " + std::to_string(datapath.bus_DA.value)
-                  //<< ", DB: " + std::to_string(datapath.bus_DB.value)
-                  //<< ", DC: " + std::to_string(datapath.bus_DC.value)
-                  //<< ", A: " + std::to_string(datapath.bus_A.value)
-                  //<< ", B: " + std::to_string(datapath.bus_B.value)
-                  //<< ", Imm: " + std::to_string(datapath.bus_imm.value)
-                  //<< ", ImmExt: " + std::to_string(datapath.bus_imm
+                  //<< ", Funct3: " + std::to_string(datapath.bus_funct3().value)
+                  //<< ", Funct7: " + std::to_string(datapath.bus_funct7().value)
+                  //<< ", DA: " + std::to_string(datapath.bus_DA().value)
+                  //<< ", DB: " + std::to_string(datapath.bus_DB().value)
+                  //<< ", DC: " + std::to_string(datapath.bus_DC().value)
+                  //<< ", A: " + std::to_string(datapath.bus_A().value)
+                  //<< ", B: " + std::to_string(datapath.bus_B().value)
+                  //<< ", Imm: " + std::to_string(datapath.bus_imm().value)
+                  //<< ", ImmExt: " + std::to_string(datapath.bus_imm()
     }
     // =================================================================================
     // ETAPA 1: INSTRUCTION FETCH (IF)
@@ -1479,41 +2326,41 @@ catch(const std::exception& e){
     if(!handle_branch_flush) flush=false;
 
 
-    datapath.bus_Control = { id_control_word, 1 }; //En dart es 'Control'
+    datapath.bus_Control() = { id_control_word, 1 }; //En dart es 'Control'
 
 
     // Registro pipeline a final de etapa
-    datapath.Pipe_IF_ID_Instr = {instruction,1, is_valid_instr_IF}; // PC + 4 
-    datapath.Pipe_IF_ID_NPC = {pc+4,1, is_valid_instr_IF}; // PC + 4 
-    datapath.Pipe_IF_ID_PC =  {pc ,1, is_valid_instr_IF};
+    datapath.Pipe_IF_ID_Instr() = {instruction,1, is_valid_instr_IF}; // PC + 4 
+    datapath.Pipe_IF_ID_NPC() = {pc+4,1, is_valid_instr_IF}; // PC + 4 
+    datapath.Pipe_IF_ID_PC() =  {pc ,1, is_valid_instr_IF};
 
     if(flush){
-        datapath.Pipe_IF_ID_Instr = { 0x00000013, 1, false };// No sólo nop en ID, también en IF
+        datapath.Pipe_IF_ID_Instr() = { 0x00000013, 1, false };// No sólo nop en ID, también en IF
         is_valid_instr_IF = false;
-        datapath.Pipe_IF_ID_NPC = {0, 1, false}; //Este cero se usa en el visualizador para ponerla en gris
-        datapath.Pipe_IF_ID_PC = {0, 1, false};
-        datapath.bus_Control={0,1,false};
+        datapath.Pipe_IF_ID_NPC() = {0, 1, false}; //Este cero se usa en el visualizador para ponerla en gris
+        datapath.Pipe_IF_ID_PC() = {0, 1, false};
+        datapath.bus_Control()={0,1,false};
 
     }
     if(stall){
-        datapath.Pipe_IF_ID_Instr = datapath.Pipe_IF_ID_Instr_out; //;// No change, we keep the previous instruction in IF/ID
+        datapath.Pipe_IF_ID_Instr() = datapath.Pipe_IF_ID_Instr_out(); //;// No change, we keep the previous instruction in IF/ID
     }
 
 
     //No calculamos los bits de control. Le pasamos la instrucción a la siguiente etapa
 
     // Buses internos de esta etapa
-    datapath.bus_PC = { pc, 1, true }; // El PC se actualiza en la etapa IF
-    datapath.bus_PC_plus4 = { pc +4, 1, true }; // PC + 4 para la siguiente instrucción
-    datapath.bus_Instr={instruction,1,is_valid_instr_IF}; // La instrucción se lee en la etapa IF
-    //datapath.bus_DC = { (uint8_t)((instruction >> 7) & 0x1F), 1, is_valid_instr_IF }; // DC is the destination register address
+    datapath.bus_PC() = { pc, 1, true }; // El PC se actualiza en la etapa IF
+    datapath.bus_PC_plus4() = { pc +4, 1, true }; // PC + 4 para la siguiente instrucción
+    datapath.bus_Instr()={instruction,1,is_valid_instr_IF}; // La instrucción se lee en la etapa IF
+    //datapath.bus_DC() = { (uint8_t)((instruction >> 7) & 0x1F), 1, is_valid_instr_IF }; // DC is the destination register address
 
 
     if(m_logfile.is_open() && DEBUG_INFO) {
         m_logfile << "IF Stage: " << std::endl
-                  << "PipeI: " << datapath.Pipe_IF_ID_Instr.is_active << "\t" << (int)datapath.Pipe_IF_ID_Instr.value << std::endl
-                  << "PipeN: " << datapath.Pipe_IF_ID_NPC.is_active << "\t" << (int)datapath.Pipe_IF_ID_NPC.value << std::endl
-                  << "PipeP: " << datapath.Pipe_IF_ID_PC.is_active << "\t" << (int)datapath.Pipe_IF_ID_PC.value << std::endl
+                  << "PipeI: " << datapath.Pipe_IF_ID_Instr().is_active << "\t" << (int)datapath.Pipe_IF_ID_Instr().value << std::endl
+                  << "PipeN: " << datapath.Pipe_IF_ID_NPC().is_active << "\t" << (int)datapath.Pipe_IF_ID_NPC().value << std::endl
+                  << "PipeP: " << datapath.Pipe_IF_ID_PC().is_active << "\t" << (int)datapath.Pipe_IF_ID_PC().value << std::endl
                   << "Instruction: " + instructionString 
                   << ", PC: " + std::to_string(pc)
                   << ", PC+4: " + std::to_string(pc + 4)
@@ -1530,7 +2377,7 @@ catch(const std::exception& e){
         if (take_branch) {
             // Para JALR (I-type jump), el destino es el resultado de la ALU.
             // Para JAL (J-type) y branches (B-type), es PC + inmediato.
-            uint16_t ex_control = datapath.Pipe_ID_EX_Control_out.value;
+            uint16_t ex_control = datapath.Pipe_ID_EX_Control_out().value;
             if (controlSignal(ex_control, "PCsrc") == 2 && controlSignal(ex_control, "ImmSrc") == 0) { // JALR (ImmSrc I-type)
                 pc = alu_result;
             } else { // JAL o Branch
@@ -1540,7 +2387,7 @@ catch(const std::exception& e){
             pc = pc + 4;
         }
     }
-    datapath.bus_PC_next={pc ,1,true};
+    datapath.bus_PC_next()={pc ,1,true};
 
     // If stalling, the PC is not updated, freezing the fetch stage.
 
@@ -1559,19 +2406,19 @@ catch(const std::exception& e){
     if (flush) { //El flush se detecta en la etapa ex
         datapath.Pipe_IF_instruction = 0x00000013; // Bubble 2 (replaces instruction from IF)
         datapath.Pipe_ID_instruction = 0x00000013; // Bubble 1 (replaces instruction from ID)
-        datapath.Pipe_IF_ID_Instr_out = { 0x00000013, 1, false }; // Bubble
-        datapath.bus_imm={ 0x00000013, 1, false };
-        datapath.bus_DA= datapath.bus_DB= datapath.bus_DC= { 0, 1, false };
-        datapath.bus_immExt={ 0, 1, false };
+        datapath.Pipe_IF_ID_Instr_out() = { 0x00000013, 1, false }; // Bubble
+        datapath.bus_imm()={ 0x00000013, 1, false };
+        datapath.bus_DA()= datapath.bus_DB()= datapath.bus_DC()= { 0, 1, false };
+        datapath.bus_immExt()={ 0, 1, false };
         
     } else if (stall) { //Se detecta en ex, al descubrir que la que hay en id depende
         // Data hazard (load-use): Insert a bubble in EX and freeze ID/IF.
         datapath.Pipe_ID_instruction = 0x00000013; // Bubble
         datapath.Pipe_IF_instruction = prev_if_instr;
-        datapath.Pipe_IF_ID_Instr_out = { 0x00000013, 1, false }; // Bubble
-        datapath.bus_imm={ 0x00000013, 1, false };
-        datapath.bus_DA= datapath.bus_DB= datapath.bus_DC= { 0, 1, false };
-        datapath.bus_immExt={ 0, 1, false };
+        datapath.Pipe_IF_ID_Instr_out() = { 0x00000013, 1, false }; // Bubble
+        datapath.bus_imm()={ 0x00000013, 1, false };
+        datapath.bus_DA()= datapath.bus_DB()= datapath.bus_DC()= { 0, 1, false };
+        datapath.bus_immExt()={ 0, 1, false };
     } else {
         // Normal operation: Advance instructions.
         datapath.Pipe_ID_instruction = prev_if_instr;
@@ -1580,28 +2427,78 @@ catch(const std::exception& e){
     // The IF stage always fetches the next instruction, which is correct
     // because the PC was updated based on the branch outcome.
 
-    // Usamos strncpy para evitar desbordamientos de búfer.
-    strncpy(datapath.instruction_cptr, instructionString.c_str(), sizeof(datapath.instruction_cptr) - 1);
-    datapath.instruction_cptr[sizeof(datapath.instruction_cptr) - 1] = '\0'; // Aseguramos la terminación nula.
+    datapath.instruction_text = text_id(instructionString);
 
-    // Now, generate the disassembled strings from the final instruction values
-    auto copy_safe = [this](char* dest, const std::string& src) {
-        strncpy(dest, src.c_str(), sizeof(datapath.instruction_cptr) - 1);
-        dest[sizeof(datapath.instruction_cptr) - 1] = '\0';
-    };
-
-    copy_safe(datapath.Pipe_IF_instruction_cptr, disassemble(datapath.Pipe_IF_instruction, control_unit.decode(datapath.Pipe_IF_instruction)));
-    copy_safe(datapath.Pipe_ID_instruction_cptr, disassemble(datapath.Pipe_ID_instruction, control_unit.decode(datapath.Pipe_ID_instruction)));
-    copy_safe(datapath.Pipe_EX_instruction_cptr, disassemble(datapath.Pipe_EX_instruction, control_unit.decode(datapath.Pipe_EX_instruction)));
-    copy_safe(datapath.Pipe_MEM_instruction_cptr, disassemble(datapath.Pipe_MEM_instruction, control_unit.decode(datapath.Pipe_MEM_instruction)));
-    copy_safe(datapath.Pipe_WB_instruction_cptr, disassemble(datapath.Pipe_WB_instruction, control_unit.decode(datapath.Pipe_WB_instruction)));
+    // Los textos de las etapas son el desensamblado de sus instrucciones: se
+    // generan solo cuando se piden (get_datapath_state).
+    std::fill(std::begin(datapath.stage_text), std::end(datapath.stage_text), TEXT_FROM_INSTRUCTION);
     if(m_logfile.is_open() && DEBUG_INFO) {
-        m_logfile << "Pipeline Stage 1 (IF): " << datapath.Pipe_IF_instruction_cptr << std::endl;
-        m_logfile << "Pipeline Stage 2 (ID): " << datapath.Pipe_ID_instruction_cptr << std::endl;
-        m_logfile << "Pipeline Stage 3 (EX): " << datapath.Pipe_EX_instruction_cptr << std::endl;
-        m_logfile << "Pipeline Stage 4 (MEM): " << datapath.Pipe_MEM_instruction_cptr << std::endl;
-        m_logfile << "Pipeline Stage 5 (WB): " << datapath.Pipe_WB_instruction_cptr << std::endl;
+        m_logfile << "Pipeline Stage 1 (IF): " << stage_text(datapath, STAGE_IF) << std::endl;
+        m_logfile << "Pipeline Stage 2 (ID): " << stage_text(datapath, STAGE_ID) << std::endl;
+        m_logfile << "Pipeline Stage 3 (EX): " << stage_text(datapath, STAGE_EX) << std::endl;
+        m_logfile << "Pipeline Stage 4 (MEM): " << stage_text(datapath, STAGE_MEM) << std::endl;
+        m_logfile << "Pipeline Stage 5 (WB): " << stage_text(datapath, STAGE_WB) << std::endl;
         m_logfile << "Next PC: " << std::hex << pc << std::endl;
     }
     
 }
+
+uint64_t Simulator::sync_state_version() {
+    const uint64_t next = state_version + 1;
+    bool changed = false;
+    auto mark = [&](uint64_t& field_version, bool differs) {
+        if (differs || state_version == 0) {
+            field_version = next;
+            changed = true;
+        }
+    };
+
+    const PackedDatapath& before = versioned_datapath;
+    for (size_t i = 0; i < DATAPATH_SIGNAL_COUNT; ++i) {
+        const DatapathSignal signal = static_cast<DatapathSignal>(i);
+        mark(field_versions[i], datapath.value(signal) != before.value(signal) ||
+                                datapath.ready_at[i] != before.ready_at[i] ||
+                                datapath.is_active(signal) != before.is_active(signal));
+    }
+    mark(field_versions[JSON_CRITICAL_TIME], datapath.criticalTime != before.criticalTime);
+    mark(field_versions[JSON_MICRO_CYCLES], datapath.total_micro_cycles != before.total_micro_cycles);
+    mark(field_versions[JSON_INSTRUCTION_TEXT], datapath.instruction_text != before.instruction_text);
+    const uint32_t words[STAGE_COUNT] = {datapath.Pipe_IF_instruction, datapath.Pipe_ID_instruction, datapath.Pipe_EX_instruction,
+                                         datapath.Pipe_MEM_instruction, datapath.Pipe_WB_instruction};
+    const uint32_t words_before[STAGE_COUNT] = {before.Pipe_IF_instruction, before.Pipe_ID_instruction, before.Pipe_EX_instruction,
+                                                before.Pipe_MEM_instruction, before.Pipe_WB_instruction};
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        const bool word_changed = words[stage] != words_before[stage];
+        // El texto de una etapa sin texto propio es el desensamblado de su instrucción.
+        mark(field_versions[JSON_STAGE_TEXT + stage], datapath.stage_text[stage] != before.stage_text[stage] ||
+                                                      (word_changed && datapath.stage_text[stage] == TEXT_FROM_INSTRUCTION));
+        mark(field_versions[JSON_STAGE_INSTRUCTION + stage], word_changed);
+    }
+    for (uint8_t r = 0; r < 32; ++r) {
+        const uint32_t value = register_file.readA(r);
+        mark(register_versions[r], value != versioned_registers[r]);
+        versioned_registers[r] = value;
+    }
+
+    if (changed) {
+        state_version = next;
+        versioned_datapath = datapath;
+    }
+    return state_version;
+}
+
+StateJsonMask Simulator::changed_fields_since(uint64_t version) const {
+    StateJsonMask fields;
+    for (size_t i = 0; i < STATE_JSON_FIELD_COUNT; ++i) {
+        if (field_versions[i] > version) fields.set(i);
+    }
+    return fields;
+}
+
+uint32_t Simulator::changed_registers_since(uint64_t version) const {
+    uint32_t registers = 0;
+    for (uint32_t r = 0; r < 32; ++r) {
+        if (register_versions[r] > version) registers |= 1u << r;
+    }
+    return registers;
+}
@@ -0,0 +1,52 @@
+#include "SimulatorPool.h"
+#include <algorithm>
+
+SimulatorPool::SimulatorPool(size_t capacity) : capacity(capacity) {}
+
+void SimulatorPool::prewarm(size_t count, size_t mem_size, PipelineModel model) {
+    count = std::min(count, capacity);
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (free_list.size() >= count) return;
+        }
+        // Se construye fuera del cerrojo: es lo lento.
+        auto sim = std::make_unique<Simulator>(mem_size, model);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_list.size() >= count) return;
+        free_list.push_back(std::move(sim));
+    }
+}
+
+Simulator* SimulatorPool::acquire(size_t mem_size, PipelineModel model, bool hazards) {
+    std::unique_ptr<Simulator> sim;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free_list.empty()) {
+            sim = std::move(free_list.back());
+            free_list.pop_back();
+        }
+    }
+    if (!sim) {
+        sim = std::make_unique<Simulator>(mem_size, model);
+        sim->set_hazard_options(hazards, hazards, hazards);
+    } else {
+        sim->reconfigure(model, mem_size, hazards);
+    }
+    return sim.release();
+}
+
+void SimulatorPool::release(Simulator* sim) {
+    if (!sim) return;
+    // Una ejecución en segundo plano no puede seguir en una instancia reutilizada.
+    sim->cancel_run();
+    sim->wait_run();
+    std::unique_ptr<Simulator> owned(sim);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_list.size() < capacity) free_list.push_back(std::move(owned));
+}
+
+size_t SimulatorPool::idle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return free_list.size();
+}
@@ -0,0 +1,162 @@
+#include "StateBinary.h"
+#include "Simulator.h"
+#include <algorithm>
+#include <cstring>
+#include <nlohmann/json.hpp>
+
+namespace {
+    void put32(uint8_t* p, uint32_t value) {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+        p[2] = static_cast<uint8_t>(value >> 16);
+        p[3] = static_cast<uint8_t>(value >> 24);
+    }
+
+    uint32_t align4(size_t size) { return static_cast<uint32_t>((size + 3) & ~static_cast<size_t>(3)); }
+
+    // Rango de líneas consecutivas de una misma memoria.
+    struct DirtyRange {
+        uint32_t memory;
+        uint32_t address;
+        uint32_t length;
+    };
+}
+
+const std::string& state_binary_schema() {
+    static const std::string schema = [] {
+        nlohmann::ordered_json fields = {
+            {"pc", {{"offset", STATE_BINARY_OFFSET_PC}, {"type", "u32"}}},
+            {"status_register", {{"offset", STATE_BINARY_OFFSET_STATUS}, {"type", "u32"}}},
+            {"cycle", {{"offset", STATE_BINARY_OFFSET_CYCLE}, {"type", "u32"}}},
+            {"model", {{"offset", STATE_BINARY_OFFSET_MODEL}, {"type", "u32"}}},
+            {"registers", {{"offset", STATE_BINARY_OFFSET_REGISTERS}, {"type", "u32"}, {"count", 32}}},
+            {"criticalTime", {{"offset", STATE_BINARY_OFFSET_CRITICAL_TIME}, {"type", "u32"}}},
+            {"totalMicroCycles", {{"offset", STATE_BINARY_OFFSET_MICRO_CYCLES}, {"type", "u32"}}},
+            {"stage_instructions", {{"offset", STATE_BINARY_OFFSET_STAGE_INSTRUCTIONS}, {"type", "u32"}, {"count", STAGE_COUNT},
+                                    {"stages", {"IF", "ID", "EX", "MEM", "WB"}}}},
+            {"instruction_text", {{"offset", STATE_BINARY_OFFSET_INSTRUCTION_TEXT}, {"type", "u32"}}},
+            {"stage_texts", {{"offset", STATE_BINARY_OFFSET_STAGE_TEXTS}, {"type", "u32"}, {"count", STAGE_COUNT},
+                             {"from_instruction", TEXT_FROM_INSTRUCTION}}},
+        };
+        nlohmann::ordered_json signals = nlohmann::ordered_json::array();
+        for (size_t i = 0; i < DATAPATH_SIGNAL_COUNT; ++i) {
+            const DatapathSignal signal = static_cast<DatapathSignal>(i);
+            signals.push_back({{"name", datapath_signal_name(signal)}, {"bits", datapath_signal_bits(signal)}});
+        }
+        nlohmann::ordered_json schema = {
+            {"magic", "RVSB"},
+            {"version", STATE_BINARY_VERSION},
+            {"endianness", "little"},
+            {"header_size", STATE_BINARY_HEADER_SIZE},
+            {"header", {
+                {"total_size", 8}, {"flags", 12}, {"signal_count", 16}, {"values_offset", 20},
+                {"ready_at_offset", 24}, {"is_active_offset", 28}, {"memory_offset", 32},
+            }},
+            {"flags", {{"memory", STATE_BINARY_MEMORY}, {"memory_resync", STATE_BINARY_MEMORY_RESYNC}}},
+            {"fields", fields},
+            {"signals", signals},
+            {"memory", {
+                {"range_fields", {"memory", "address", "length"}},
+                {"memories", {"data", "main"}},
+                {"line", STATE_BINARY_DIRTY_LINE},
+            }},
+        };
+        return schema.dump();
+    }();
+    return schema;
+}
+
+size_t Simulator::get_state_binary(uint8_t* buffer, size_t capacity, uint32_t flags) {
+    const uint32_t count = DATAPATH_SIGNAL_COUNT;
+    const uint32_t values_offset = STATE_BINARY_OFFSET_SIGNALS;
+    const uint32_t ready_offset = values_offset + 4 * count;
+    const uint32_t active_offset = ready_offset + 4 * count;
+    uint32_t size = active_offset + align4(count);
+
+    // Líneas escritas agrupadas en rangos.
+    const bool with_memory = (flags & STATE_BINARY_MEMORY) != 0;
+    std::vector<DirtyRange> ranges;
+    uint32_t memory_offset = 0;
+    if (with_memory) {
+        for (uint64_t line : dirty_lines) {
+            const uint32_t memory = static_cast<uint32_t>(line >> 32);
+            const uint32_t address = static_cast<uint32_t>(line) * STATE_BINARY_DIRTY_LINE;
+            const Memory& target = memory ? *main_memory : d_mem;
+            if (address >= target.size()) continue;
+            const uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(STATE_BINARY_DIRTY_LINE, target.size() - address));
+            if (!ranges.empty() && ranges.back().memory == memory &&
+                ranges.back().address + ranges.back().length == address) {
+                ranges.back().length += length;
+            } else {
+                ranges.push_back(DirtyRange{memory, address, length});
+            }
+        }
+        memory_offset = size;
+        size += 8;
+        for (const DirtyRange& range : ranges) size += 12 + align4(range.length);
+    }
+    if (!buffer || capacity < size) return size;
+
+    std::memset(buffer, 0, size);
+    put32(buffer, STATE_BINARY_MAGIC);
+    put32(buffer + 4, STATE_BINARY_VERSION | (STATE_BINARY_HEADER_SIZE << 16));
+    put32(buffer + 8, size);
+    put32(buffer + 12, (with_memory ? STATE_BINARY_MEMORY : 0) | (with_memory && memory_resync ? STATE_BINARY_MEMORY_RESYNC : 0));
+    put32(buffer + 16, count);
+    put32(buffer + 20, values_offset);
+    put32(buffer + 24, ready_offset);
+    put32(buffer + 28, active_offset);
+    put32(buffer + 32, memory_offset);
+
+    put32(buffer + STATE_BINARY_OFFSET_PC, pc);
+    put32(buffer + STATE_BINARY_OFFSET_STATUS, status_reg);
+    put32(buffer + STATE_BINARY_OFFSET_CYCLE, current_cycle);
+    put32(buffer + STATE_BINARY_OFFSET_MODEL, static_cast<uint32_t>(model));
+    for (uint32_t r = 0; r < 32; ++r) {
+        put32(buffer + STATE_BINARY_OFFSET_REGISTERS + 4 * r, register_file.readA(static_cast<uint8_t>(r)));
+    }
+    put32(buffer + STATE_BINARY_OFFSET_CRITICAL_TIME, datapath.criticalTime);
+    put32(buffer + STATE_BINARY_OFFSET_MICRO_CYCLES, datapath.total_micro_cycles);
+    const uint32_t stage_words[STAGE_COUNT] = {datapath.Pipe_IF_instruction, datapath.Pipe_ID_instruction, datapath.Pipe_EX_instruction,
+                                               datapath.Pipe_MEM_instruction, datapath.Pipe_WB_instruction};
+    for (uint32_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        put32(buffer + STATE_BINARY_OFFSET_STAGE_INSTRUCTIONS + 4 * stage, stage_words[stage]);
+        put32(buffer + STATE_BINARY_OFFSET_STAGE_TEXTS + 4 * stage, datapath.stage_text[stage]);
+    }
+    put32(buffer + STATE_BINARY_OFFSET_INSTRUCTION_TEXT, datapath.instruction_text);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const DatapathSignal signal = static_cast<DatapathSignal>(i);
+        put32(buffer + values_offset + 4 * i, datapath.value(signal));
+        put32(buffer + ready_offset + 4 * i, datapath.ready_at[i]);
+        buffer[active_offset + i] = datapath.is_active(signal);
+    }
+
+    if (with_memory) {
+        uint8_t* p = buffer + memory_offset;
+        put32(p, static_cast<uint32_t>(ranges.size()));
+        p += 8;
+        for (const DirtyRange& range : ranges) {
+            put32(p, range.memory);
+            put32(p + 4, range.address);
+            put32(p + 8, range.length);
+            p += 12;
+            Memory& target = range.memory ? *main_memory : d_mem;
+            // Lo que sigue en el buffer de escritura de la caché también cuenta.
+            const bool cached = model == PipelineModel::General ? &target == main_memory
+                                                                : (timed_pipeline() && &target == &d_mem);
+            for (uint32_t offset = 0; offset < range.length; offset += 4) {
+                put32(p + offset, read_stored(target, range.address + offset, 4, cached));
+            }
+            p += align4(range.length);
+        }
+        dirty_lines.clear();
+        memory_resync = false;
+    }
+    return size;
+}
+
+std::string Simulator::get_instruction_text(uint32_t id, uint32_t instruction) const {
+    if (id == TEXT_FROM_INSTRUCTION) return disassemble(instruction, control_unit.decode(instruction));
+    return id < texts.size() ? texts[id] : std::string();
+}
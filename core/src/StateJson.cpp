@@ -0,0 +1,133 @@
+#include "StateJson.h"
+#include "Datapath.h"
+#include <algorithm>
+#include <charconv>
+#include <type_traits>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace {
+    enum class FieldKind : uint8_t { SignalU32, SignalU16, SignalU8, SignalBool, Number, Text };
+
+    struct Field {
+        std::string key;     // Nombre en el JSON
+        StateJsonField id;
+        FieldKind kind;
+        size_t offset;       // Desplazamiento del miembro en DatapathState
+        std::string prefix;  // "key":
+    };
+
+    // Tabla de campos ordenada por nombre, con los prefijos preparados.
+    std::vector<Field> build_fields() {
+        std::vector<Field> fields;
+#define STATE_JSON_SIGNAL(kind, name) \
+        fields.push_back(Field{datapath_signal_name(SIGNAL_##name), static_cast<StateJsonField>(SIGNAL_##name), kind, \
+                               offsetof(DatapathState, name), {}});
+#define STATE_JSON_U32(name) STATE_JSON_SIGNAL(FieldKind::SignalU32, name)
+#define STATE_JSON_U16(name) STATE_JSON_SIGNAL(FieldKind::SignalU16, name)
+#define STATE_JSON_U8(name) STATE_JSON_SIGNAL(FieldKind::SignalU8, name)
+#define STATE_JSON_BOOL(name) STATE_JSON_SIGNAL(FieldKind::SignalBool, name)
+        DATAPATH_U32_SIGNALS(STATE_JSON_U32)
+        DATAPATH_U16_SIGNALS(STATE_JSON_U16)
+        DATAPATH_U8_SIGNALS(STATE_JSON_U8)
+        DATAPATH_BOOL_SIGNALS(STATE_JSON_BOOL)
+#undef STATE_JSON_U32
+#undef STATE_JSON_U16
+#undef STATE_JSON_U8
+#undef STATE_JSON_BOOL
+#undef STATE_JSON_SIGNAL
+#define STATE_JSON_FIELD(key, id, kind, member) \
+        fields.push_back(Field{key, static_cast<StateJsonField>(id), kind, offsetof(DatapathState, member), {}});
+        STATE_JSON_FIELD("criticalTime", JSON_CRITICAL_TIME, FieldKind::Number, criticalTime)
+        STATE_JSON_FIELD("totalMicroCycles", JSON_MICRO_CYCLES, FieldKind::Number, total_micro_cycles)
+        STATE_JSON_FIELD("instruction_cptr", JSON_INSTRUCTION_TEXT, FieldKind::Text, instruction_cptr)
+        STATE_JSON_FIELD("Pipe_IF_instruction_cptr", JSON_STAGE_TEXT + STAGE_IF, FieldKind::Text, Pipe_IF_instruction_cptr)
+        STATE_JSON_FIELD("Pipe_ID_instruction_cptr", JSON_STAGE_TEXT + STAGE_ID, FieldKind::Text, Pipe_ID_instruction_cptr)
+        STATE_JSON_FIELD("Pipe_EX_instruction_cptr", JSON_STAGE_TEXT + STAGE_EX, FieldKind::Text, Pipe_EX_instruction_cptr)
+        STATE_JSON_FIELD("Pipe_MEM_instruction_cptr", JSON_STAGE_TEXT + STAGE_MEM, FieldKind::Text, Pipe_MEM_instruction_cptr)
+        STATE_JSON_FIELD("Pipe_WB_instruction_cptr", JSON_STAGE_TEXT + STAGE_WB, FieldKind::Text, Pipe_WB_instruction_cptr)
+        STATE_JSON_FIELD("Pipe_IF_instruction", JSON_STAGE_INSTRUCTION + STAGE_IF, FieldKind::Number, Pipe_IF_instruction)
+        STATE_JSON_FIELD("Pipe_ID_instruction", JSON_STAGE_INSTRUCTION + STAGE_ID, FieldKind::Number, Pipe_ID_instruction)
+        STATE_JSON_FIELD("Pipe_EX_instruction", JSON_STAGE_INSTRUCTION + STAGE_EX, FieldKind::Number, Pipe_EX_instruction)
+        STATE_JSON_FIELD("Pipe_MEM_instruction", JSON_STAGE_INSTRUCTION + STAGE_MEM, FieldKind::Number, Pipe_MEM_instruction)
+        STATE_JSON_FIELD("Pipe_WB_instruction", JSON_STAGE_INSTRUCTION + STAGE_WB, FieldKind::Number, Pipe_WB_instruction)
+#undef STATE_JSON_FIELD
+
+        std::sort(fields.begin(), fields.end(), [](const Field& a, const Field& b) { return a.key < b.key; });
+        for (Field& field : fields) field.prefix = "\"" + field.key + "\":";
+        return fields;
+    }
+
+    void append_number(std::string& out, uint32_t value) {
+        char digits[10];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+    }
+
+    // Cadena con los mismos escapes que nlohmann::json::dump().
+    void append_text(std::string& out, const char* text, size_t capacity) {
+        static const char hex[] = "0123456789abcdef";
+        out.push_back('"');
+        const size_t length = strnlen(text, capacity);
+        for (size_t i = 0; i < length; ++i) {
+            const unsigned char c = static_cast<unsigned char>(text[i]);
+            switch (c) {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\b': out.append("\\b"); break;
+                case '\f': out.append("\\f"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    if (c < 0x20) {
+                        const char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                        out.append(escaped, sizeof(escaped));
+                    } else {
+                        out.push_back(static_cast<char>(c));
+                    }
+            }
+        }
+        out.push_back('"');
+    }
+
+    template<typename T>
+    void append_signal(std::string& out, const void* member) {
+        const Signal<T>& signal = *static_cast<const Signal<T>*>(member);
+        out.append("{\"is_active\":");
+        append_number(out, signal.is_active);
+        out.append(",\"ready_at\":");
+        append_number(out, signal.ready_at);
+        out.append(",\"value\":");
+        if constexpr (std::is_same_v<T, bool>) {
+            out.append(signal.value ? "true" : "false");
+        } else {
+            append_number(out, signal.value);
+        }
+        out.push_back('}');
+    }
+}
+
+void append_state_json(const DatapathState& state, std::string& out, const StateJsonMask* selected) {
+    static const std::vector<Field> fields = build_fields();
+    const char* base = reinterpret_cast<const char*>(&state);
+    char separator = '{';
+    for (const Field& field : fields) {
+        if (selected && !selected->test(field.id)) continue;
+        out.push_back(separator);
+        separator = ',';
+        out.append(field.prefix);
+        const char* member = base + field.offset;
+        switch (field.kind) {
+            case FieldKind::SignalU32: append_signal<uint32_t>(out, member); break;
+            case FieldKind::SignalU16: append_signal<uint16_t>(out, member); break;
+            case FieldKind::SignalU8: append_signal<uint8_t>(out, member); break;
+            case FieldKind::SignalBool: append_signal<bool>(out, member); break;
+            case FieldKind::Number: append_number(out, *reinterpret_cast<const uint32_t*>(member)); break;
+            case FieldKind::Text: append_text(out, member, sizeof(state.instruction_cptr)); break;
+        }
+    }
+    if (separator == '{') out.push_back('{');
+    out.push_back('}');
+}
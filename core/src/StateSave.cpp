@@ -0,0 +1,506 @@
+#include "StateSave.h"
+#include "Simulator.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+    void write_memory(StateWriter& writer, uint32_t id, const Memory& memory) {
+        const size_t start = writer.begin_section(STATE_SECTION_MEMORY);
+        writer.u32(id);
+        writer.u64(memory.size());
+        memory.for_each_page([&](uint32_t address, const uint8_t* data, size_t length) {
+            // Una página a ceros se lee igual que una que no existe.
+            if (std::all_of(data, data + length, [](uint8_t byte) { return byte == 0; })) return;
+            writer.u32(address);
+            writer.u32(static_cast<uint32_t>(length));
+            writer.bytes(data, length);
+        });
+        writer.end_section(start);
+    }
+
+    // Memoria dentro de otra sección (las de las copias del historial).
+    void write_pages(StateWriter& writer, const Memory& memory) {
+        writer.u64(memory.size());
+        std::vector<uint32_t> pages;
+        memory.for_each_page([&](uint32_t address, const uint8_t*, size_t) { pages.push_back(address); });
+        writer.u32(static_cast<uint32_t>(pages.size()));
+        memory.for_each_page([&](uint32_t address, const uint8_t* data, size_t length) {
+            writer.u32(address);
+            writer.u32(static_cast<uint32_t>(length));
+            writer.bytes(data, length);
+        });
+    }
+
+    Memory read_pages(StateReader& in) {
+        Memory memory(static_cast<size_t>(in.u64()));
+        const uint32_t count = in.count(4 + 4);
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t address = in.u32();
+            const uint32_t length = in.u32();
+            memory.load_program(in.bytes(length), length, address);
+        }
+        return memory;
+    }
+
+    void write_datapath(StateWriter& writer, const PackedDatapath& datapath) {
+        writer.u32(DATAPATH_U32_COUNT);
+        writer.u32(DATAPATH_U16_COUNT);
+        writer.u32(DATAPATH_U8_COUNT);
+        writer.u32(DATAPATH_BOOL_COUNT);
+        for (uint32_t value : datapath.u32) writer.u32(value);
+        for (uint16_t value : datapath.u16) writer.u32(value);
+        for (uint8_t value : datapath.u8) writer.u8(value);
+        for (bool value : datapath.flags) writer.u8(value);
+        for (uint32_t value : datapath.ready_at) writer.u32(value);
+        for (uint64_t word : datapath.active) writer.u64(word);
+        writer.u32(datapath.criticalTime);
+        writer.u32(datapath.total_micro_cycles);
+        writer.u32(datapath.Pipe_IF_instruction);
+        writer.u32(datapath.Pipe_ID_instruction);
+        writer.u32(datapath.Pipe_EX_instruction);
+        writer.u32(datapath.Pipe_MEM_instruction);
+        writer.u32(datapath.Pipe_WB_instruction);
+        writer.u32(datapath.instruction_text);
+        for (uint32_t text : datapath.stage_text) writer.u32(text);
+    }
+
+    void read_datapath(StateReader& in, PackedDatapath& datapath) {
+        if (in.u32() != DATAPATH_U32_COUNT || in.u32() != DATAPATH_U16_COUNT ||
+            in.u32() != DATAPATH_U8_COUNT || in.u32() != DATAPATH_BOOL_COUNT) {
+            throw std::runtime_error("El estado guardado tiene otras señales del datapath");
+        }
+        for (uint32_t& value : datapath.u32) value = in.u32();
+        for (uint16_t& value : datapath.u16) value = static_cast<uint16_t>(in.u32());
+        for (uint8_t& value : datapath.u8) value = in.u8();
+        for (bool& value : datapath.flags) value = in.u8() != 0;
+        for (uint32_t& value : datapath.ready_at) value = in.u32();
+        for (uint64_t& word : datapath.active) word = in.u64();
+        datapath.criticalTime = in.u32();
+        datapath.total_micro_cycles = in.u32();
+        datapath.Pipe_IF_instruction = in.u32();
+        datapath.Pipe_ID_instruction = in.u32();
+        datapath.Pipe_EX_instruction = in.u32();
+        datapath.Pipe_MEM_instruction = in.u32();
+        datapath.Pipe_WB_instruction = in.u32();
+        datapath.instruction_text = in.u32();
+        for (uint32_t& text : datapath.stage_text) text = in.u32();
+    }
+
+    void write_timing(StateWriter& writer, const PipelineTiming& timing) {
+        for (uint64_t ready : timing.reg_ready_at) writer.u64(ready);
+        writer.u32(timing.freeze);
+        writer.u8(timing.fetch_pending);
+        writer.u32(timing.pending_instruction);
+        writer.u64(timing.cache_clock);
+    }
+
+    void read_timing(StateReader& in, PipelineTiming& timing) {
+        for (uint64_t& ready : timing.reg_ready_at) ready = in.u64();
+        timing.freeze = in.u32();
+        timing.fetch_pending = in.u8() != 0;
+        timing.pending_instruction = in.u32();
+        timing.cache_clock = in.u64();
+    }
+
+    void write_csrs(StateWriter& writer, const TrapCsrs& csrs) {
+        writer.u32(csrs.mtvec);
+        writer.u32(csrs.mepc);
+        writer.u32(csrs.mcause);
+        writer.u32(csrs.mtval);
+    }
+
+    void read_csrs(StateReader& in, TrapCsrs& csrs) {
+        csrs.mtvec = in.u32();
+        csrs.mepc = in.u32();
+        csrs.mcause = in.u32();
+        csrs.mtval = in.u32();
+    }
+
+    // Tamaños de las estructuras a las que apuntan los trozos del historial.
+    constexpr uint32_t HISTORY_LAYOUT[] = {sizeof(PackedDatapath), sizeof(RegisterFile), sizeof(PipelineTiming), sizeof(TrapCsrs)};
+}
+
+void Simulator::save_state(std::vector<uint8_t>& out, uint32_t flags) const {
+    if (main_memory != &memory) {
+        throw std::runtime_error("No se puede guardar un hart con memoria compartida");
+    }
+    if (memory.has_mapped_files()) {
+        throw std::runtime_error("No se puede guardar una memoria con ficheros proyectados");
+    }
+    out.clear();
+    StateWriter writer(out);
+    writer.u32(STATE_SAVE_MAGIC);
+    writer.u32(STATE_SAVE_VERSION);
+    writer.u32(0); // Tamaño total y número de secciones, al final
+    writer.u32(0);
+
+    size_t section = writer.begin_section(STATE_SECTION_CONFIG);
+    writer.u32(static_cast<uint32_t>(model));
+    writer.u64(memory.size());
+    writer.u32(initial_pc);
+    writer.u8(handle_load_use_hazard);
+    writer.u8(handle_branch_flush);
+    writer.u8(handle_forwarding);
+    writer.u8(pipeline_caches);
+    writer.u32(static_cast<uint32_t>(d_cache.get_mshr_entries()));
+    writer.u32(static_cast<uint32_t>(i_cache.get_write_buffer_entries()));
+    writer.u32(static_cast<uint32_t>(d_cache.get_write_buffer_entries()));
+    writer.u32(static_cast<uint32_t>(i_cache.get_victim_entries()));
+    writer.u32(static_cast<uint32_t>(d_cache.get_victim_entries()));
+    writer.u32(static_cast<uint32_t>(hart_id));
+    writer.u64(history_budget);
+    const MmuConfig& mmu_config = mmu.get_config();
+    writer.u32(static_cast<uint32_t>(mmu_config.itlb_entries));
+    writer.u32(static_cast<uint32_t>(mmu_config.dtlb_entries));
+    writer.u32(static_cast<uint32_t>(mmu_config.l2_entries));
+    writer.u32(mmu_config.l2_hit_cycles);
+    writer.u8(dram != nullptr);
+    if (dram) {
+        const DramConfig& dram_config = dram->get_config();
+        writer.u32(static_cast<uint32_t>(dram_config.banks));
+        writer.u32(static_cast<uint32_t>(dram_config.row_size));
+        writer.u32(dram_config.t_rcd);
+        writer.u32(dram_config.t_cas);
+        writer.u32(dram_config.t_rp);
+        writer.u32(dram_config.t_burst);
+        writer.u32(static_cast<uint32_t>(dram_config.queue_depth));
+        writer.u32(static_cast<uint32_t>(dram_config.policy));
+    }
+    writer.end_section(section);
+
+    section = writer.begin_section(STATE_SECTION_CORE);
+    writer.u32(pc);
+    writer.u32(status_reg);
+    writer.u32(current_cycle);
+    writer.u64(cache_clock);
+    for (uint8_t r = 0; r < 32; ++r) writer.u32(register_file.readA(r));
+    write_csrs(writer, csrs);
+    writer.u32(mmu.get_satp());
+    writer.u8(fetch_faulted);
+    writer.u32(next_page_table);
+    writer.text(instructionString);
+    writer.u32(criticalTime);
+    writer.u32(static_cast<uint32_t>(total_micro_cycles));
+    writer.u64(state_version);
+    writer.end_section(section);
+
+    section = writer.begin_section(STATE_SECTION_DATAPATH);
+    write_datapath(writer, datapath);
+    writer.end_section(section);
+
+    section = writer.begin_section(STATE_SECTION_TEXTS);
+    writer.u32(static_cast<uint32_t>(texts.size()));
+    for (const std::string& text : texts) writer.text(text);
+    writer.end_section(section);
+
+    section = writer.begin_section(STATE_SECTION_TIMING);
+    write_timing(writer, timing);
+    writer.u64(pipeline_stats.icache_stall_cycles);
+    writer.u64(pipeline_stats.store_stall_cycles);
+    writer.u64(pipeline_stats.load_stall_cycles);
+    writer.u64(pipeline_stats.mshr_stall_cycles);
+    writer.u64(pipeline_stats.scoreboard_stall_cycles);
+    writer.end_section(section);
+
+    // Las escrituras que siguen en el buffer de escritura van con su caché.
+    if (!(flags & STATE_SAVE_WITHOUT_MEMORY)) {
+        write_memory(writer, STATE_MEMORY_MAIN, memory);
+        write_memory(writer, STATE_MEMORY_INSTRUCTIONS, i_mem);
+        write_memory(writer, STATE_MEMORY_DATA, d_mem);
+    }
+
+    for (CacheId id : {CacheId::Instruction, CacheId::Data}) {
+        section = writer.begin_section(STATE_SECTION_CACHE);
+        writer.u32(static_cast<uint32_t>(id));
+        get_cache(id).save_state(writer);
+        writer.end_section(section);
+    }
+    section = writer.begin_section(STATE_SECTION_MMU);
+    mmu.save_state(writer);
+    writer.end_section(section);
+    if (dram) {
+        section = writer.begin_section(STATE_SECTION_DRAM);
+        dram->save_state(writer);
+        writer.end_section(section);
+    }
+
+    if (flags & STATE_SAVE_HISTORY) {
+        section = writer.begin_section(STATE_SECTION_HISTORY);
+        for (uint32_t size : HISTORY_LAYOUT) writer.u32(size);
+        history.save_state(writer);
+        writer.u32(static_cast<uint32_t>(checkpoints.size()));
+        for (const Checkpoint& checkpoint : checkpoints) {
+            const StateSnapshot& state = checkpoint.state;
+            writer.u64(checkpoint.position);
+            writer.u64(checkpoint.bytes);
+            writer.u8(checkpoint.has_main_memory);
+            writer.u32(state.pc);
+            for (uint8_t r = 0; r < 32; ++r) writer.u32(state.register_file.readA(r));
+            write_datapath(writer, state.datapath);
+            writer.u32(state.current_cycle);
+            writer.text(state.instructionString);
+            write_pages(writer, state.d_mem);
+            write_timing(writer, state.timing);
+            write_csrs(writer, state.csrs);
+            write_pages(writer, state.main_mem);
+        }
+        writer.u32(static_cast<uint32_t>(pages_since_checkpoint.size()));
+        for (uint64_t page : pages_since_checkpoint) writer.u64(page);
+        writer.end_section(section);
+    }
+
+    writer.patch(8, static_cast<uint32_t>(out.size()));
+    writer.patch(12, writer.section_count());
+}
+
+void Simulator::load_state(const uint8_t* data, size_t size) {
+    // Se restaura primero en una instancia aparte y solo si sale bien se
+    // pasa a esta, como en fork_to (las memorias no se copian).
+    Simulator staged(0, PipelineModel::SingleCycle);
+    staged.restore_state(data, size);
+    staged.fork_to(*this);
+}
+
+void Simulator::restore_state(const uint8_t* data, size_t size) {
+    StateReader header(data, size);
+    if (size < STATE_SAVE_HEADER_SIZE || header.u32() != STATE_SAVE_MAGIC) {
+        throw std::runtime_error("No es un estado guardado del simulador");
+    }
+    if (header.u32() != STATE_SAVE_VERSION) {
+        throw std::runtime_error("Versión de estado guardado no soportada");
+    }
+    const uint32_t total_size = header.u32();
+    const uint32_t section_count = header.u32();
+    if (total_size > size || total_size < STATE_SAVE_HEADER_SIZE) throw std::runtime_error("Estado guardado truncado");
+
+    StateReader sections(data + STATE_SAVE_HEADER_SIZE, total_size - STATE_SAVE_HEADER_SIZE);
+    bool configured = false;
+    for (uint32_t i = 0; i < section_count; ++i) {
+        const uint32_t type = sections.u32();
+        const uint32_t length = sections.u32();
+        StateReader in(sections.bytes(length), length);
+        if (!configured && type != STATE_SECTION_CONFIG) {
+            throw std::runtime_error("El estado guardado no empieza por la configuración");
+        }
+
+        switch (type) {
+            case STATE_SECTION_CONFIG: {
+                const uint32_t saved_model = in.u32();
+                if (saved_model > static_cast<uint32_t>(PipelineModel::General)) {
+                    throw std::runtime_error("Modelo desconocido en el estado guardado");
+                }
+                const uint64_t mem_size = in.u64();
+                if (mem_size > (static_cast<uint64_t>(1) << 32)) {
+                    throw std::runtime_error("El estado guardado tiene otra memoria");
+                }
+                reconfigure(static_cast<PipelineModel>(saved_model), static_cast<size_t>(mem_size), true);
+                bind_cache_memories();
+                initial_pc = in.u32();
+                const bool stalls = in.u8();
+                const bool flushes = in.u8();
+                const bool forwarding = in.u8();
+                set_hazard_options(stalls, flushes, forwarding);
+                // Lo que reserva una entrada por unidad (víctimas, TLB, bancos)
+                // también la guarda después: no puede haber más que bytes.
+                auto entries = [size](uint32_t count) {
+                    if (count > size) throw std::runtime_error("El estado guardado tiene una configuración imposible");
+                    return count;
+                };
+                const bool caches = in.u8();
+                const uint32_t mshr_entries = in.u32();
+                set_pipeline_caches(caches, mshr_entries);
+                d_cache.set_mshr_entries(mshr_entries);
+                i_cache.set_write_buffer_entries(in.u32());
+                d_cache.set_write_buffer_entries(in.u32());
+                i_cache.set_victim_entries(entries(in.u32()));
+                d_cache.set_victim_entries(entries(in.u32()));
+                hart_id = static_cast<int32_t>(in.u32());
+                history_budget = static_cast<size_t>(in.u64());
+                MmuConfig mmu_config;
+                mmu_config.itlb_entries = entries(in.u32());
+                mmu_config.dtlb_entries = entries(in.u32());
+                mmu_config.l2_entries = entries(in.u32());
+                mmu_config.l2_hit_cycles = in.u32();
+                mmu.configure(mmu_config);
+                if (in.u8()) {
+                    DramConfig dram_config;
+                    dram_config.banks = entries(in.u32());
+                    dram_config.row_size = in.u32();
+                    dram_config.t_rcd = in.u32();
+                    dram_config.t_cas = in.u32();
+                    dram_config.t_rp = in.u32();
+                    dram_config.t_burst = in.u32();
+                    dram_config.queue_depth = in.u32();
+                    const uint32_t policy = in.u32();
+                    if (dram_config.banks == 0 || dram_config.row_size == 0 ||
+                        policy > static_cast<uint32_t>(DramPagePolicy::Closed)) {
+                        throw std::runtime_error("El estado guardado tiene una DRAM imposible");
+                    }
+                    dram_config.policy = static_cast<DramPagePolicy>(policy);
+                    attach_dram(dram_config);
+                }
+                configured = true;
+                break;
+            }
+            case STATE_SECTION_CORE: {
+                pc = in.u32();
+                status_reg = in.u32();
+                current_cycle = in.u32();
+                cache_clock = in.u64();
+                for (uint8_t r = 0; r < 32; ++r) register_file.write(r, in.u32());
+                read_csrs(in, csrs);
+                mmu.set_satp(in.u32());
+                fetch_faulted = in.u8();
+                next_page_table = in.u32();
+                instructionString = in.text();
+                criticalTime = in.u32();
+                total_micro_cycles = static_cast<int>(in.u32());
+                // Una versión por encima de la guardada en la que todo ha
+                // cambiado: los clientes que pidan deltas reciben el estado entero.
+                state_version = in.u64() + 1;
+                break;
+            }
+            case STATE_SECTION_DATAPATH:
+                read_datapath(in, datapath);
+                break;
+            case STATE_SECTION_TEXTS: {
+                const uint32_t count = in.count(4);
+                texts.clear();
+                text_ids.clear();
+                for (uint32_t id = 0; id < count; ++id) {
+                    texts.push_back(in.text());
+                    text_ids.emplace(texts.back(), id);
+                }
+                if (texts.empty()) {
+                    texts.emplace_back();
+                    text_ids.emplace("", 0);
+                }
+                break;
+            }
+            case STATE_SECTION_TIMING: {
+                read_timing(in, timing);
+                pipeline_stats.icache_stall_cycles = in.u64();
+                pipeline_stats.store_stall_cycles = in.u64();
+                pipeline_stats.load_stall_cycles = in.u64();
+                pipeline_stats.mshr_stall_cycles = in.u64();
+                pipeline_stats.scoreboard_stall_cycles = in.u64();
+                break;
+            }
+            case STATE_SECTION_MEMORY: {
+                const uint32_t id = in.u32();
+                if (id > STATE_MEMORY_DATA) throw std::runtime_error("El estado guardado tiene otra memoria");
+                Memory& target = id == STATE_MEMORY_MAIN ? memory : (id == STATE_MEMORY_INSTRUCTIONS ? i_mem : d_mem);
+                if (in.u64() != target.size()) throw std::runtime_error("El estado guardado tiene otra memoria");
+                while (in.remaining() > 0) {
+                    const uint32_t address = in.u32();
+                    const uint32_t page_length = in.u32();
+                    target.load_program(in.bytes(page_length), page_length, address);
+                }
+                break;
+            }
+            case STATE_SECTION_CACHE: {
+                const uint32_t id = in.u32();
+                if (id > static_cast<uint32_t>(CacheId::Data)) throw std::runtime_error("Caché desconocida en el estado guardado");
+                cache_by_id(static_cast<CacheId>(id)).load_state(in);
+                break;
+            }
+            case STATE_SECTION_MMU:
+                mmu.load_state(in);
+                break;
+            case STATE_SECTION_DRAM:
+                if (dram) dram->load_state(in);
+                break;
+            case STATE_SECTION_HISTORY: {
+                bool same_layout = true;
+                for (uint32_t size : HISTORY_LAYOUT) same_layout &= in.u32() == size;
+                if (!same_layout) break; // De otro simulador: se sigue sin historial
+                history.load_state(in, HISTORY_LAYOUT, std::size(HISTORY_LAYOUT));
+                for (size_t position = history.oldest(); position < history.newest(); ++position) {
+                    for (const MemoryWrite& write : history.at(position).writes) {
+                        const Memory& target = write.main_memory ? memory : d_mem;
+                        if (static_cast<uint64_t>(write.address) + write.bytes > target.size()) {
+                            throw std::runtime_error("Historial guardado incoherente");
+                        }
+                    }
+                }
+                const uint32_t count = in.count(8 + 8 + 1 + 4);
+                for (uint32_t c = 0; c < count; ++c) {
+                    const size_t position = static_cast<size_t>(in.u64());
+                    // En orden y dentro del historial: seek las busca así.
+                    if (position > history.newest() || (!checkpoints.empty() && position <= checkpoints.back().position)) {
+                        throw std::runtime_error("Historial guardado incoherente");
+                    }
+                    const size_t bytes = static_cast<size_t>(in.u64());
+                    const bool has_main_memory = in.u8() != 0;
+                    const uint32_t saved_pc = in.u32();
+                    RegisterFile registers;
+                    for (uint8_t r = 0; r < 32; ++r) registers.write(r, in.u32());
+                    PackedDatapath saved_datapath;
+                    read_datapath(in, saved_datapath);
+                    const uint32_t cycle = in.u32();
+                    const std::string instruction = in.text();
+                    Memory saved_d_mem = read_pages(in);
+                    PipelineTiming saved_timing;
+                    read_timing(in, saved_timing);
+                    TrapCsrs saved_csrs;
+                    read_csrs(in, saved_csrs);
+                    Memory saved_main = read_pages(in);
+                    if (saved_d_mem.size() != d_mem.size() || (saved_main.size() != 0 && saved_main.size() != memory.size())) {
+                        throw std::runtime_error("Historial guardado incoherente");
+                    }
+                    checkpoints.push_back(Checkpoint{position,
+                        StateSnapshot(saved_pc, registers, saved_datapath, cycle, instruction, saved_d_mem, saved_timing, saved_main, saved_csrs),
+                        bytes, has_main_memory});
+                    checkpoint_bytes += bytes;
+                }
+                const uint32_t pages = in.count(8);
+                for (uint32_t page = 0; page < pages; ++page) pages_since_checkpoint.insert(in.u64());
+                break;
+            }
+            default:
+                break; // Sección de una versión posterior compatible
+        }
+    }
+    if (!configured) throw std::runtime_error("El estado guardado no tiene configuración");
+    // Los identificadores de texto tienen que estar en la tabla guardada.
+    auto check_texts = [this](const PackedDatapath& state) {
+        auto valid = [this](uint32_t id) { return id == TEXT_FROM_INSTRUCTION || id < texts.size(); };
+        bool ok = valid(state.instruction_text);
+        for (uint32_t text : state.stage_text) ok &= valid(text);
+        if (!ok) throw std::runtime_error("Texto de instrucción desconocido en el estado guardado");
+    };
+    check_texts(datapath);
+    for (const Checkpoint& checkpoint : checkpoints) check_texts(checkpoint.state.datapath);
+
+    versioned_datapath = datapath;
+    for (uint8_t r = 0; r < 32; ++r) versioned_registers[r] = register_file.readA(r);
+    std::fill(std::begin(field_versions), std::end(field_versions), state_version);
+    std::fill(std::begin(register_versions), std::end(register_versions), state_version);
+    dirty_lines.clear();
+    memory_resync = true;
+    if (m_logfile.is_open()) m_logfile << "\n--- Estado restaurado (ciclo " << current_cycle << ") ---" << std::endl;
+}
+
+void Simulator::fork_to(Simulator& child) const {
+    if (&child == this) throw std::invalid_argument("Un simulador no se puede bifurcar sobre sí mismo");
+    // Todo menos las memorias y el historial pasa por el estado guardado:
+    // cachés, TLB y DRAM ocupan lo mismo sea cual sea la memoria.
+    std::vector<uint8_t> state;
+    save_state(state, STATE_SAVE_WITHOUT_MEMORY);
+    child.restore_state(state.data(), state.size());
+
+    // Las memorias se copian en escritura: solo se comparte el árbol de
+    // páginas. Las copias traen la DRAM de este simulador, no la del hijo.
+    child.memory = memory;
+    child.i_mem = i_mem;
+    child.d_mem = d_mem;
+    for (Memory* copy : {&child.memory, &child.i_mem, &child.d_mem}) copy->attach_dram(child.dram);
+
+    // El historial también: los deltas se comparten (ver UndoLog) y las
+    // copias completas de los checkpoints comparten las páginas.
+    child.history = history;
+    child.checkpoints = checkpoints;
+    child.checkpoint_bytes = checkpoint_bytes;
+    child.pages_since_checkpoint = pages_since_checkpoint;
+}
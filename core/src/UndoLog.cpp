@@ -0,0 +1,194 @@
+#include "UndoLog.h"
+#include "StateSave.h"
+#include <algorithm>
+#include <cstring>
+
+size_t StepDelta::cost() const {
+    size_t bytes = sizeof(StepDelta) + chunks.capacity() * sizeof(ChunkChange) + writes.capacity() * sizeof(MemoryWrite);
+    // Las cadenas cortas caben en el propio objeto.
+    if (instruction_before.capacity() > sizeof(std::string)) bytes += instruction_before.capacity();
+    if (instruction_after.capacity() > sizeof(std::string)) bytes += instruction_after.capacity();
+    return bytes;
+}
+
+void diff_chunks(const void* before, const void* after, size_t size, uint8_t object, std::vector<ChunkChange>& out) {
+    const uint8_t* old_bytes = static_cast<const uint8_t*>(before);
+    const uint8_t* new_bytes = static_cast<const uint8_t*>(after);
+    for (size_t offset = 0; offset < size; offset += 8) {
+        const size_t count = std::min<size_t>(8, size - offset);
+        if (std::memcmp(old_bytes + offset, new_bytes + offset, count) == 0) continue;
+        uint64_t old_bits = 0, new_bits = 0;
+        std::memcpy(&old_bits, old_bytes + offset, count);
+        std::memcpy(&new_bits, new_bytes + offset, count);
+        out.push_back(ChunkChange{static_cast<uint32_t>(offset), object, static_cast<uint8_t>(count), old_bits ^ new_bits});
+    }
+}
+
+void apply_chunks(void* target, uint8_t object, const std::vector<ChunkChange>& chunks) {
+    uint8_t* bytes = static_cast<uint8_t*>(target);
+    for (const ChunkChange& change : chunks) {
+        if (change.object != object) continue;
+        uint64_t value = 0;
+        std::memcpy(&value, bytes + change.offset, change.size);
+        value ^= change.bits;
+        std::memcpy(bytes + change.offset, &value, change.size);
+    }
+}
+
+UndoLog::UndoLog(const UndoLog& other)
+    : deltas(other.deltas), base(other.base), cursor(other.cursor), total_bytes(other.total_bytes) {
+    other.shared_end = other.newest();
+    shared_end = newest();
+}
+
+UndoLog& UndoLog::operator=(const UndoLog& other) {
+    if (this != &other) {
+        deltas = other.deltas;
+        base = other.base;
+        cursor = other.cursor;
+        total_bytes = other.total_bytes;
+        other.shared_end = other.newest();
+        shared_end = newest();
+    }
+    return *this;
+}
+
+void UndoLog::clear() {
+    deltas.clear();
+    base = 0;
+    cursor = 0;
+    total_bytes = 0;
+    shared_end = 0;
+}
+
+void UndoLog::push(StepDelta&& delta) {
+    discard_future();
+    total_bytes += delta.cost();
+    deltas.push_back(std::make_shared<StepDelta>(std::move(delta)));
+    cursor++;
+}
+
+const StepDelta& UndoLog::undo() {
+    return *deltas[--cursor];
+}
+
+const StepDelta& UndoLog::redo() {
+    return *deltas[cursor++];
+}
+
+void UndoLog::extend_newest(const std::vector<ChunkChange>& chunks, uint32_t cycle_after) {
+    if (newest() <= shared_end) {
+        // Compartido con otra copia: a partir de aquí este es solo nuestro.
+        deltas.back() = std::make_shared<StepDelta>(*deltas.back());
+        shared_end = newest() - 1;
+    }
+    StepDelta& delta = *deltas.back();
+    total_bytes -= delta.cost();
+    for (const ChunkChange& change : chunks) {
+        // Los XOR se acumulan: un trozo que ya cambió en el paso se combina.
+        auto same = std::find_if(delta.chunks.begin(), delta.chunks.end(), [&](const ChunkChange& other) {
+            return other.object == change.object && other.offset == change.offset;
+        });
+        if (same != delta.chunks.end()) {
+            same->bits ^= change.bits;
+        } else {
+            delta.chunks.push_back(change);
+        }
+    }
+    delta.cycle_after = cycle_after;
+    total_bytes += delta.cost();
+}
+
+void UndoLog::evict_oldest() {
+    if (deltas.empty()) return;
+    total_bytes -= deltas.front()->cost();
+    deltas.pop_front();
+    base++;
+    if (cursor > 0) cursor--;
+}
+
+void UndoLog::discard_future() {
+    while (deltas.size() > cursor) {
+        total_bytes -= deltas.back()->cost();
+        deltas.pop_back();
+    }
+}
+
+void UndoLog::save_state(StateWriter& out) const {
+    out.u64(base);
+    out.u64(cursor);
+    out.u32(static_cast<uint32_t>(deltas.size()));
+    for (const auto& stored : deltas) {
+        const StepDelta& delta = *stored;
+        out.u32(delta.pc_before);
+        out.u32(delta.pc_after);
+        out.u32(delta.cycle_before);
+        out.u32(delta.cycle_after);
+        out.u8(delta.instruction_changed);
+        out.text(delta.instruction_before);
+        out.text(delta.instruction_after);
+        out.u32(static_cast<uint32_t>(delta.chunks.size()));
+        for (const ChunkChange& change : delta.chunks) {
+            out.u32(change.offset);
+            out.u8(change.object);
+            out.u8(change.size);
+            out.u64(change.bits);
+        }
+        out.u32(static_cast<uint32_t>(delta.writes.size()));
+        for (const MemoryWrite& write : delta.writes) {
+            out.u32(write.address);
+            out.u32(write.old_value);
+            out.u32(write.new_value);
+            out.u8(write.bytes);
+            out.u8(write.main_memory);
+            out.u8(write.through_cache);
+        }
+    }
+}
+
+void UndoLog::load_state(StateReader& in, const uint32_t* object_sizes, size_t object_count) {
+    // Tamaños mínimos en el estado guardado, para acotar las reservas.
+    constexpr size_t DELTA_BYTES = 4 * 4 + 1 + 4 + 4 + 4 + 4;
+    constexpr size_t CHUNK_BYTES = 4 + 1 + 1 + 8;
+    constexpr size_t WRITE_BYTES = 3 * 4 + 3;
+    clear();
+    base = static_cast<size_t>(in.u64());
+    cursor = static_cast<size_t>(in.u64());
+    const uint32_t count = in.count(DELTA_BYTES);
+    for (uint32_t i = 0; i < count; ++i) {
+        StepDelta delta;
+        delta.pc_before = in.u32();
+        delta.pc_after = in.u32();
+        delta.cycle_before = in.u32();
+        delta.cycle_after = in.u32();
+        delta.instruction_changed = in.u8() != 0;
+        delta.instruction_before = in.text();
+        delta.instruction_after = in.text();
+        delta.chunks.resize(in.count(CHUNK_BYTES));
+        for (ChunkChange& change : delta.chunks) {
+            change.offset = in.u32();
+            change.object = in.u8();
+            change.size = in.u8();
+            change.bits = in.u64();
+            if (change.object >= object_count || change.size == 0 || change.size > sizeof(change.bits) ||
+                change.offset > object_sizes[change.object] - change.size) {
+                throw std::runtime_error("Historial guardado incoherente");
+            }
+        }
+        delta.writes.resize(in.count(WRITE_BYTES));
+        for (MemoryWrite& write : delta.writes) {
+            write.address = in.u32();
+            write.old_value = in.u32();
+            write.new_value = in.u32();
+            write.bytes = in.u8();
+            write.main_memory = in.u8() != 0;
+            write.through_cache = in.u8() != 0;
+            if (write.bytes != 1 && write.bytes != 2 && write.bytes != 4) {
+                throw std::runtime_error("Historial guardado incoherente");
+            }
+        }
+        total_bytes += delta.cost();
+        deltas.push_back(std::make_shared<StepDelta>(std::move(delta)));
+    }
+    if (cursor > deltas.size() || base > SIZE_MAX - deltas.size()) throw std::runtime_error("Historial guardado incoherente");
+}
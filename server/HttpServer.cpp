@@ -0,0 +1,729 @@
+#include "HttpServer.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint64_t LISTEN_ID = 0;
+    constexpr uint64_t WAKE_ID = 1;
+    constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+    constexpr size_t MAX_BODY_BYTES = 16u << 20;
+    constexpr size_t MAX_MESSAGE_BYTES = 1u << 20;
+    constexpr size_t MAX_QUEUED_MESSAGES = 64; // Por canal WebSocket
+    // Un cliente WebSocket que no lee se desconecta antes de que su cola crezca sin límite.
+    constexpr size_t MAX_PENDING_BYTES = 16u << 20;
+    const char* const WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    enum WebSocketOpcode : uint8_t {
+        WS_CONTINUATION = 0x0,
+        WS_TEXT = 0x1,
+        WS_BINARY = 0x2,
+        WS_CLOSE = 0x8,
+        WS_PING = 0x9,
+        WS_PONG = 0xA,
+    };
+
+    const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    uint32_t rotate_left(uint32_t value, unsigned bits) { return (value << bits) | (value >> (32 - bits)); }
+
+    // SHA-1, solo para Sec-WebSocket-Accept.
+    std::array<uint8_t, 20> sha1(const std::string& message) {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        std::string data = message;
+        const uint64_t bit_length = static_cast<uint64_t>(message.size()) * 8;
+        data.push_back(static_cast<char>(0x80));
+        while (data.size() % 64 != 56) data.push_back('\0');
+        for (int i = 7; i >= 0; --i) data.push_back(static_cast<char>(bit_length >> (8 * i)));
+
+        for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i) {
+                const auto* p = reinterpret_cast<const uint8_t*>(data.data() + chunk + 4 * i);
+                w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+            }
+            for (int i = 16; i < 80; ++i) w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i) {
+                uint32_t f, k;
+                if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+                else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+                else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+                else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+                const uint32_t t = rotate_left(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotate_left(b, 30);
+                b = a;
+                a = t;
+            }
+            h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+        }
+        std::array<uint8_t, 20> digest;
+        for (int i = 0; i < 20; ++i) digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+        return digest;
+    }
+
+    std::string lowercase(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    std::string trim(const std::string& text) {
+        const size_t first = text.find_first_not_of(" \t");
+        if (first == std::string::npos) return std::string();
+        return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+    }
+
+    int hex_digit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    std::string url_decode(const std::string& text, bool plus_is_space) {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '%' && i + 2 < text.size() && hex_digit(text[i + 1]) >= 0 && hex_digit(text[i + 2]) >= 0) {
+                out.push_back(static_cast<char>(hex_digit(text[i + 1]) * 16 + hex_digit(text[i + 2])));
+                i += 2;
+            } else if (text[i] == '+' && plus_is_space) {
+                out.push_back(' ');
+            } else {
+                out.push_back(text[i]);
+            }
+        }
+        return out;
+    }
+
+    const char* reason_phrase(int status) {
+        switch (status) {
+            case 101: return "Switching Protocols";
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 411: return "Length Required";
+            case 413: return "Payload Too Large";
+            case 409: return "Conflict";
+            case 422: return "Unprocessable Entity";
+            case 431: return "Request Header Fields Too Large";
+            case 500: return "Internal Server Error";
+            default: return "";
+        }
+    }
+
+    HttpResponse error_response(int status, const std::string& detail) {
+        return HttpResponse{status, "application/json", nlohmann::json{{"detail", detail}}.dump()};
+    }
+
+    // Cabeceras CORS equivalentes a las de CORSMiddleware con allow_origins=["*"]
+    // y allow_credentials=True: con credenciales hay que repetir el origen.
+    std::string cors_headers(const std::string& origin) {
+        if (origin.empty()) return std::string();
+        return "Access-Control-Allow-Origin: " + origin + "\r\nAccess-Control-Allow-Credentials: true\r\nVary: Origin\r\n";
+    }
+
+    std::string serialize_response(const HttpResponse& response, bool keep_alive, const std::string& origin,
+                                   const std::string& extra_headers = std::string()) {
+        std::string out = "HTTP/1.1 " + std::to_string(response.status) + " " + reason_phrase(response.status) + "\r\n";
+        out += "Content-Type: " + response.content_type + "\r\n";
+        out += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+        out += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        out += cors_headers(origin);
+        out += extra_headers;
+        out += "\r\n";
+        out += response.body;
+        return out;
+    }
+
+    std::string websocket_frame(uint8_t opcode, const std::string& payload) {
+        std::string frame;
+        frame.reserve(payload.size() + 10);
+        frame.push_back(static_cast<char>(0x80 | opcode));
+        const uint64_t size = payload.size();
+        if (size < 126) {
+            frame.push_back(static_cast<char>(size));
+        } else if (size <= 0xFFFF) {
+            frame.push_back(static_cast<char>(126));
+            frame.push_back(static_cast<char>(size >> 8));
+            frame.push_back(static_cast<char>(size));
+        } else {
+            frame.push_back(static_cast<char>(127));
+            for (int i = 7; i >= 0; --i) frame.push_back(static_cast<char>(size >> (8 * i)));
+        }
+        frame += payload;
+        return frame;
+    }
+
+    // Cierre con código de estado (RFC 6455, 7.4).
+    std::string websocket_close(uint16_t code) {
+        return websocket_frame(WS_CLOSE, std::string{static_cast<char>(code >> 8), static_cast<char>(code & 0xFF)});
+    }
+}
+
+std::string base64_encode(const uint8_t* data, size_t size) {
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (size_t i = 0; i < size; i += 3) {
+        const uint32_t chunk = (uint32_t(data[i]) << 16) | (i + 1 < size ? uint32_t(data[i + 1]) << 8 : 0) |
+                               (i + 2 < size ? data[i + 2] : 0);
+        out.push_back(BASE64_ALPHABET[(chunk >> 18) & 63]);
+        out.push_back(BASE64_ALPHABET[(chunk >> 12) & 63]);
+        out.push_back(i + 1 < size ? BASE64_ALPHABET[(chunk >> 6) & 63] : '=');
+        out.push_back(i + 2 < size ? BASE64_ALPHABET[chunk & 63] : '=');
+    }
+    return out;
+}
+
+bool base64_decode(const std::string& text, std::vector<uint8_t>& out) {
+    out.clear();
+    uint32_t chunk = 0;
+    int bits = 0;
+    size_t padding = 0;
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c))) continue;
+        if (c == '=') {
+            padding++;
+            continue;
+        }
+        const char* found = std::strchr(BASE64_ALPHABET, c);
+        if (!found || c == '\0' || padding > 0) return false;
+        chunk = (chunk << 6) | static_cast<uint32_t>(found - BASE64_ALPHABET);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<uint8_t>(chunk >> bits));
+        }
+    }
+    return padding <= 2;
+}
+
+const std::string* HttpRequest::query_param(const std::string& name) const {
+    auto found = query.find(name);
+    return found == query.end() ? nullptr : &found->second;
+}
+
+std::string HttpRequest::header(const std::string& name) const {
+    auto found = headers.find(name);
+    return found == headers.end() ? std::string() : found->second;
+}
+
+HttpServer::HttpServer(size_t workers) : worker_count(std::max<size_t>(1, workers)) {}
+
+HttpServer::~HttpServer() {
+    for (auto& entry : connections) ::close(entry.second.fd);
+    for (int fd : {listen_fd, wake_fd, epoll_fd}) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+void HttpServer::route(const std::string& method, const std::string& path, Handler handler) {
+    routes[{method, path}] = std::move(handler);
+}
+
+void HttpServer::websocket(const std::string& path, WebSocketHandlers handlers) {
+    websockets[path] = std::move(handlers);
+}
+
+void HttpServer::run(uint16_t port) {
+    listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) throw std::runtime_error(std::string("No se pudo crear el socket: ") + std::strerror(errno));
+    const int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listen_fd, SOMAXCONN) < 0) {
+        throw std::runtime_error("No se puede escuchar en el puerto " + std::to_string(port) + ": " + std::strerror(errno));
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) throw std::runtime_error(std::string("No se pudo crear epoll: ") + std::strerror(errno));
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.u64 = WAKE_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    workers_stopping = false;
+    for (size_t i = 0; i < worker_count; ++i) workers.emplace_back(&HttpServer::worker_loop, this);
+
+    epoll_event events[128];
+    while (!stopping.load()) {
+        const int count = epoll_wait(epoll_fd, events, 128, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                accept_connections();
+            } else if (id == WAKE_ID) {
+                drain_outgoing();
+            } else {
+                // Un cierre o un error también se ven al leer.
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) read_connection(id);
+                if (events[i].events & EPOLLOUT) flush(id);
+            }
+        }
+    }
+
+    // Al cerrar los canales WebSocket sus manejadores paran lo que tengan en marcha.
+    std::vector<uint64_t> open;
+    for (const auto& entry : connections) open.push_back(entry.first);
+    for (uint64_t id : open) close_connection(id);
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        workers_stopping = true;
+    }
+    jobs_ready.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+}
+
+void HttpServer::stop() {
+    stopping.store(true);
+    if (wake_fd >= 0) {
+        const uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = ::write(wake_fd, &one, sizeof(one));
+    }
+}
+
+void HttpServer::send_text(uint64_t id, const std::string& text) {
+    post(Outgoing{id, websocket_frame(WS_TEXT, text)});
+}
+
+void HttpServer::accept_connections() {
+    while (true) {
+        const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN: no quedan más
+        }
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        const uint64_t id = next_id++;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            continue;
+        }
+        connections[id].fd = fd;
+    }
+}
+
+void HttpServer::read_connection(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end()) return;
+    Connection& connection = found->second;
+    char buffer[16384];
+    while (true) {
+        const ssize_t count = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (count > 0) {
+            connection.in.append(buffer, static_cast<size_t>(count));
+            if (connection.in.size() > MAX_HEADER_BYTES + MAX_BODY_BYTES) {
+                close_connection(id);
+                return;
+            }
+            continue;
+        }
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close_connection(id); // Cerrada por el otro extremo o error
+        return;
+    }
+    process_input(id);
+}
+
+void HttpServer::process_input(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end()) return;
+    Connection& connection = found->second;
+    if (!connection.close_after_write) {
+        if (connection.websocket) {
+            process_websocket(id, connection);
+        } else {
+            while (!connection.busy && !connection.close_after_write && process_http(id, connection)) {}
+        }
+    }
+    flush(id);
+}
+
+bool HttpServer::process_http(uint64_t id, Connection& connection) {
+    auto reject = [&](int status, const std::string& detail) {
+        connection.out += serialize_response(error_response(status, detail), false, std::string());
+        connection.close_after_write = true;
+        connection.in.clear();
+        return false;
+    };
+
+    const size_t header_end = connection.in.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+        if (connection.in.size() > MAX_HEADER_BYTES) return reject(431, "Cabeceras demasiado grandes");
+        return false;
+    }
+
+    HttpRequest request;
+    const size_t line_end = connection.in.find("\r\n");
+    const std::string line = connection.in.substr(0, line_end);
+    const size_t first_space = line.find(' ');
+    const size_t second_space = line.find(' ', first_space + 1);
+    if (first_space == std::string::npos || second_space == std::string::npos) return reject(400, "Petición mal formada");
+    request.method = line.substr(0, first_space);
+    const std::string target = line.substr(first_space + 1, second_space - first_space - 1);
+    const std::string version = line.substr(second_space + 1);
+
+    for (size_t position = line_end + 2; position < header_end;) {
+        const size_t end = connection.in.find("\r\n", position);
+        const std::string header = connection.in.substr(position, end - position);
+        position = end + 2;
+        const size_t colon = header.find(':');
+        if (colon == std::string::npos) return reject(400, "Cabecera mal formada");
+        std::string& value = request.headers[lowercase(trim(header.substr(0, colon)))];
+        value += value.empty() ? trim(header.substr(colon + 1)) : ", " + trim(header.substr(colon + 1));
+    }
+
+    if (!request.header("transfer-encoding").empty()) return reject(411, "Se necesita Content-Length");
+    size_t length = 0;
+    const std::string content_length = request.header("content-length");
+    if (!content_length.empty()) {
+        if (content_length.find_first_not_of("0123456789") != std::string::npos || content_length.size() > 12) {
+            return reject(400, "Content-Length no válido");
+        }
+        length = std::stoull(content_length);
+    }
+    if (length > MAX_BODY_BYTES) return reject(413, "Cuerpo demasiado grande");
+    if (connection.in.size() < header_end + 4 + length) return false;
+    request.body = connection.in.substr(header_end + 4, length);
+    connection.in.erase(0, header_end + 4 + length);
+
+    const std::string connection_header = lowercase(request.header("connection"));
+    const bool keep_alive = version == "HTTP/1.1" ? connection_header.find("close") == std::string::npos
+                                                  : connection_header.find("keep-alive") != std::string::npos;
+    const std::string origin = request.header("origin");
+
+    const size_t question = target.find('?');
+    request.path = url_decode(target.substr(0, question), false);
+    if (question != std::string::npos) {
+        const std::string query = target.substr(question + 1);
+        for (size_t position = 0; position <= query.size();) {
+            size_t end = query.find('&', position);
+            if (end == std::string::npos) end = query.size();
+            const std::string pair = query.substr(position, end - position);
+            position = end + 1;
+            if (pair.empty()) continue;
+            const size_t equals = pair.find('=');
+            request.query[url_decode(pair.substr(0, equals), true)] =
+                equals == std::string::npos ? std::string() : url_decode(pair.substr(equals + 1), true);
+        }
+    }
+
+    // Petición previa de CORS: se contesta aquí, sin pasar por las rutas.
+    if (request.method == "OPTIONS") {
+        std::string allow = "Access-Control-Allow-Methods: DELETE, GET, HEAD, OPTIONS, PATCH, POST, PUT\r\nAccess-Control-Max-Age: 600\r\n";
+        const std::string requested_headers = request.header("access-control-request-headers");
+        if (!requested_headers.empty()) allow += "Access-Control-Allow-Headers: " + requested_headers + "\r\n";
+        connection.out += serialize_response(HttpResponse{200, "text/plain", "OK"}, keep_alive, origin, allow);
+        if (!keep_alive) connection.close_after_write = true;
+        return keep_alive;
+    }
+
+    if (lowercase(request.header("upgrade")) == "websocket") {
+        auto socket = websockets.find(request.path);
+        if (socket == websockets.end()) return reject(404, "Not Found");
+        if (request.header("sec-websocket-key").empty() || request.header("sec-websocket-version") != "13") {
+            return reject(400, "Handshake de WebSocket no válido");
+        }
+        const WebSocketHandlers* handlers = &socket->second;
+        connection.busy = true;
+        dispatch([this, id, handlers, request = std::move(request), keep_alive, origin]() {
+            HttpResponse response{101, "text/plain", std::string()};
+            try {
+                if (handlers->open) response = handlers->open(id, request);
+            } catch (const std::exception& e) {
+                response = error_response(500, e.what());
+            }
+            Outgoing outgoing{id, std::string()};
+            outgoing.response = true;
+            if (response.status == 101) {
+                const auto digest = sha1(request.header("sec-websocket-key") + WEBSOCKET_GUID);
+                outgoing.data = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                "Sec-WebSocket-Accept: " + base64_encode(digest.data(), digest.size()) + "\r\n\r\n";
+                outgoing.upgrade = handlers;
+            } else {
+                outgoing.data = serialize_response(response, keep_alive, origin);
+                outgoing.close = !keep_alive;
+            }
+            post(std::move(outgoing));
+        });
+        return false;
+    }
+
+    auto route = routes.find({request.method, request.path});
+    if (route == routes.end()) {
+        const bool other_method = std::any_of(routes.begin(), routes.end(),
+                                              [&](const auto& entry) { return entry.first.second == request.path; });
+        connection.out += serialize_response(other_method ? error_response(405, "Method Not Allowed") : error_response(404, "Not Found"),
+                                             keep_alive, origin);
+        if (!keep_alive) connection.close_after_write = true;
+        return keep_alive;
+    }
+
+    const Handler* handler = &route->second;
+    connection.busy = true;
+    dispatch([this, id, handler, request = std::move(request), keep_alive, origin]() {
+        HttpResponse response;
+        try {
+            response = (*handler)(request);
+        } catch (const std::exception& e) {
+            response = error_response(500, e.what());
+        }
+        Outgoing outgoing{id, serialize_response(response, keep_alive, origin)};
+        outgoing.response = true;
+        outgoing.close = !keep_alive;
+        post(std::move(outgoing));
+    });
+    return false;
+}
+
+bool HttpServer::process_websocket(uint64_t id, Connection& connection) {
+    auto fail = [&](uint16_t code) {
+        connection.out += websocket_close(code);
+        connection.close_after_write = true;
+        connection.in.clear();
+        return false;
+    };
+
+    std::string& in = connection.in;
+    while (in.size() >= 2) {
+        const uint8_t first = static_cast<uint8_t>(in[0]);
+        const uint8_t second = static_cast<uint8_t>(in[1]);
+        const bool fin = first & 0x80;
+        const uint8_t opcode = first & 0x0F;
+        if (!(second & 0x80)) return fail(1002); // Los clientes siempre enmascaran
+        uint64_t length = second & 0x7F;
+        size_t header = 2;
+        if (length == 126) {
+            if (in.size() < 4) return true;
+            length = (uint64_t(uint8_t(in[2])) << 8) | uint8_t(in[3]);
+            header = 4;
+        } else if (length == 127) {
+            if (in.size() < 10) return true;
+            length = 0;
+            for (int i = 0; i < 8; ++i) length = (length << 8) | uint8_t(in[2 + i]);
+            header = 10;
+        }
+        if (length > MAX_MESSAGE_BYTES) return fail(1009);
+        if (in.size() < header + 4 + length) return true;
+
+        const char* mask = in.data() + header;
+        std::string payload = in.substr(header + 4, static_cast<size_t>(length));
+        for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+        in.erase(0, header + 4 + static_cast<size_t>(length));
+
+        switch (opcode) {
+            case WS_CONTINUATION:
+            case WS_TEXT:
+            case WS_BINARY: {
+                if (opcode != WS_CONTINUATION) {
+                    if (connection.fragment_opcode) return fail(1002);
+                    connection.fragment_opcode = opcode;
+                } else if (!connection.fragment_opcode) {
+                    return fail(1002);
+                }
+                connection.fragments += payload;
+                if (connection.fragments.size() > MAX_MESSAGE_BYTES) return fail(1009);
+                if (!fin) break;
+                std::string message = std::move(connection.fragments);
+                const bool text = connection.fragment_opcode == WS_TEXT;
+                connection.fragments.clear();
+                connection.fragment_opcode = 0;
+                if (!text) return fail(1003); // Solo se admiten mensajes de texto
+                const WebSocketHandlers* handlers = connection.websocket;
+                if (handlers->urgent && handlers->urgent(id, message)) break;
+                if (handlers->message && !queue_message(id, handlers, std::move(message))) return fail(1008);
+                break;
+            }
+            case WS_CLOSE:
+                // Se contesta con el mismo código y se cierra al terminar de enviar.
+                connection.out += websocket_frame(WS_CLOSE, payload.substr(0, 2));
+                connection.close_after_write = true;
+                in.clear();
+                return false;
+            case WS_PING:
+                connection.out += websocket_frame(WS_PONG, payload);
+                break;
+            case WS_PONG:
+                break;
+            default:
+                return fail(1002);
+        }
+    }
+    return true;
+}
+
+void HttpServer::dispatch(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobs_ready.notify_one();
+}
+
+bool HttpServer::queue_message(uint64_t id, const WebSocketHandlers* handlers, std::string message) {
+    {
+        std::lock_guard<std::mutex> lock(messages_mutex);
+        std::deque<std::string>& pending = pending_messages[id];
+        if (pending.size() >= MAX_QUEUED_MESSAGES) return false;
+        pending.push_back(std::move(message));
+        if (pending.size() > 1) return true; // Lo atenderá quien lleva el anterior
+    }
+    dispatch([this, id, handlers]() { run_next_message(id, handlers); });
+    return true;
+}
+
+void HttpServer::run_next_message(uint64_t id, const WebSocketHandlers* handlers) {
+    std::string message;
+    {
+        std::lock_guard<std::mutex> lock(messages_mutex);
+        message = std::move(pending_messages[id].front());
+    }
+    try {
+        handlers->message(id, message);
+    } catch (const std::exception&) {
+    }
+    {
+        std::lock_guard<std::mutex> lock(messages_mutex);
+        auto found = pending_messages.find(id);
+        found->second.pop_front();
+        if (found->second.empty()) {
+            pending_messages.erase(found);
+            return;
+        }
+    }
+    // El siguiente vuelve a la cola general: un canal con muchos mensajes no
+    // acapara un hilo mientras esperan otros.
+    dispatch([this, id, handlers]() { run_next_message(id, handlers); });
+}
+
+void HttpServer::post(Outgoing item) {
+    {
+        std::lock_guard<std::mutex> lock(outgoing_mutex);
+        outgoing.push_back(std::move(item));
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd, &one, sizeof(one));
+}
+
+void HttpServer::drain_outgoing() {
+    uint64_t count;
+    [[maybe_unused]] ssize_t bytes = ::read(wake_fd, &count, sizeof(count));
+    std::vector<Outgoing> batch;
+    {
+        std::lock_guard<std::mutex> lock(outgoing_mutex);
+        batch.swap(outgoing);
+    }
+    for (Outgoing& item : batch) {
+        auto found = connections.find(item.id);
+        if (found == connections.end()) continue; // Ya cerrada
+        Connection& connection = found->second;
+        if (connection.close_after_write) continue;
+        connection.out += item.data;
+        if (item.close) connection.close_after_write = true;
+        if (connection.websocket && connection.out.size() - connection.out_sent > MAX_PENDING_BYTES) {
+            close_connection(item.id);
+            continue;
+        }
+        if (item.response) {
+            connection.busy = false;
+            if (item.upgrade) connection.websocket = item.upgrade;
+            // Lo que llegó mientras tanto: la siguiente petición o los primeros mensajes.
+            process_input(item.id);
+        } else {
+            flush(item.id);
+        }
+    }
+}
+
+void HttpServer::flush(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end()) return;
+    Connection& connection = found->second;
+    while (connection.out_sent < connection.out.size()) {
+        const ssize_t count = ::send(connection.fd, connection.out.data() + connection.out_sent,
+                                     connection.out.size() - connection.out_sent, MSG_NOSIGNAL);
+        if (count > 0) {
+            connection.out_sent += static_cast<size_t>(count);
+            continue;
+        }
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!connection.writing) update_events(connection, id, true);
+            return;
+        }
+        close_connection(id);
+        return;
+    }
+    connection.out.clear();
+    connection.out_sent = 0;
+    if (connection.writing) update_events(connection, id, false);
+    if (connection.close_after_write) close_connection(id);
+}
+
+void HttpServer::close_connection(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end()) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, found->second.fd, nullptr);
+    ::close(found->second.fd);
+    const WebSocketHandlers* handlers = found->second.websocket;
+    connections.erase(found);
+    if (handlers) {
+        // Los mensajes que aún no se empezaron ya no tienen a quién contestar.
+        std::lock_guard<std::mutex> lock(messages_mutex);
+        auto pending = pending_messages.find(id);
+        if (pending != pending_messages.end()) pending->second.resize(1);
+    }
+    if (handlers && handlers->close) handlers->close(id);
+}
+
+void HttpServer::update_events(Connection& connection, uint64_t id, bool writing) {
+    epoll_event event{};
+    event.events = EPOLLIN | (writing ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.writing = writing;
+}
+
+void HttpServer::worker_loop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_ready.wait(lock, [this] { return workers_stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Petición HTTP ya leída entera.
+struct HttpRequest {
+    std::string method;
+    std::string path;                                      // Sin la cadena de consulta
+    std::unordered_map<std::string, std::string> query;    // Ya decodificada
+    std::unordered_map<std::string, std::string> headers;  // Nombres en minúsculas
+    std::string body;
+
+    // Parámetro de la consulta, o nullptr si no está.
+    const std::string* query_param(const std::string& name) const;
+    std::string header(const std::string& name) const;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string body;
+};
+
+// Base64 estándar (con relleno), para el handshake de WebSocket y los
+// programas en binario de la API.
+std::string base64_encode(const uint8_t* data, size_t size);
+// Devuelve false si `text` no es Base64 válido.
+bool base64_decode(const std::string& text, std::vector<uint8_t>& out);
+
+/**
+ * @class HttpServer
+ * @brief Servidor HTTP/1.1 con WebSocket sobre epoll (solo Linux).
+ *
+ * Un único hilo lleva todas las conexiones: acepta, lee y escribe sin
+ * bloquearse nunca. Las peticiones completas y los mensajes WebSocket se
+ * atienden en un grupo de hilos, para que una ejecución larga no pare a los
+ * demás clientes, y lo que hay que enviar vuelve al hilo de epoll por una
+ * cola y un eventfd. Cada conexión HTTP atiende sus peticiones de una en
+ * una y responde en orden (admite keep-alive y peticiones encadenadas).
+ *
+ * Las respuestas llevan las cabeceras CORS que ponía la API de Python
+ * (cualquier origen) y las peticiones OPTIONS previas se contestan aquí.
+ */
+class HttpServer {
+public:
+    using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+    // Canal WebSocket. Cada conexión tiene un identificador que no se
+    // reutiliza; sus mensajes se atienden de uno en uno y en el orden en que
+    // llegaron, aunque cada uno pueda ir a un hilo distinto del grupo.
+    struct WebSocketHandlers {
+        // Con la petición del handshake, en un hilo del grupo. Un status 101
+        // acepta la conexión; cualquier otro se envía como respuesta.
+        std::function<HttpResponse(uint64_t id, const HttpRequest&)> open;
+        // Opcional: cada mensaje de texto completo pasa antes por aquí, en el
+        // hilo de epoll. Si devuelve true ya está atendido y no se encola
+        // (así uno de parar no espera a que acabe el que está en curso). Debe
+        // ser breve.
+        std::function<bool(uint64_t id, const std::string& text)> urgent;
+        // Mensaje de texto completo, en un hilo del grupo.
+        std::function<void(uint64_t id, const std::string& text)> message;
+        // Al cerrarse la conexión, en el hilo de epoll: debe ser breve.
+        std::function<void(uint64_t id)> close;
+    };
+
+    explicit HttpServer(size_t workers);
+    ~HttpServer();
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    void route(const std::string& method, const std::string& path, Handler handler);
+    void websocket(const std::string& path, WebSocketHandlers handlers);
+
+    // Escucha en `port` y atiende hasta stop(). Lanza std::runtime_error si
+    // no puede escuchar.
+    void run(uint16_t port);
+    // Se puede llamar desde cualquier hilo y desde un manejador de señales.
+    void stop();
+
+    // Envía un mensaje de texto por el canal `id`, si sigue abierto. Se
+    // puede llamar desde cualquier hilo.
+    void send_text(uint64_t id, const std::string& text);
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string in;            // Recibido y aún sin procesar
+        std::string out;           // Pendiente de enviar
+        size_t out_sent = 0;
+        bool busy = false;         // Con una petición en el grupo de hilos
+        bool writing = false;      // Registrada en epoll para EPOLLOUT
+        bool close_after_write = false;
+        const WebSocketHandlers* websocket = nullptr; // Después del handshake
+        uint8_t fragment_opcode = 0;
+        std::string fragments;     // Mensaje WebSocket fragmentado en curso
+    };
+
+    // Lo que un hilo del grupo deja para el hilo de epoll.
+    struct Outgoing {
+        uint64_t id;
+        std::string data;
+        bool response = false;     // Fin de una petición HTTP (la conexión queda libre)
+        bool close = false;        // Cerrar después de enviarlo
+        const WebSocketHandlers* upgrade = nullptr;
+    };
+
+    void accept_connections();
+    void read_connection(uint64_t id);
+    void process_input(uint64_t id);
+    bool process_http(uint64_t id, Connection& connection);
+    bool process_websocket(uint64_t id, Connection& connection);
+    void dispatch(std::function<void()> job);
+    // Encola un mensaje del canal `id` y, si no había otro, lo atiende en
+    // el grupo de hilos. Devuelve false si el canal tiene demasiados pendientes.
+    bool queue_message(uint64_t id, const WebSocketHandlers* handlers, std::string message);
+    void run_next_message(uint64_t id, const WebSocketHandlers* handlers);
+    void post(Outgoing outgoing);
+    void drain_outgoing();
+    void flush(uint64_t id);
+    void close_connection(uint64_t id);
+    void update_events(Connection& connection, uint64_t id, bool writing);
+    void worker_loop();
+
+    std::map<std::pair<std::string, std::string>, Handler> routes; // (método, ruta)
+    std::unordered_map<std::string, WebSocketHandlers> websockets;
+
+    int epoll_fd = -1;
+    int listen_fd = -1;
+    int wake_fd = -1;
+    std::atomic<bool> stopping{false};
+    uint64_t next_id = 2; // 0 y 1 son el socket de escucha y el eventfd
+    std::unordered_map<uint64_t, Connection> connections;
+
+    std::mutex outgoing_mutex;
+    std::vector<Outgoing> outgoing;
+
+    // Mensajes WebSocket por canal, en orden. El primero es el que se está
+    // atendiendo; el canal sale del mapa cuando no le quedan.
+    std::mutex messages_mutex;
+    std::unordered_map<uint64_t, std::deque<std::string>> pending_messages;
+
+    size_t worker_count;
+    std::vector<std::thread> workers;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_ready;
+    std::deque<std::function<void()>> jobs;
+    bool workers_stopping = false;
+};
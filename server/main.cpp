@@ -0,0 +1,479 @@
+// Servidor nativo del simulador: los endpoints de api/main.py que usa la
+// interfaz, atendidos directamente desde el núcleo (sin Python ni ctypes en
+// el camino de cada paso), más un canal WebSocket que va enviando el estado
+// mientras dura una ejecución.
+//
+// Uso: simulator_server [--port 8070] [--threads N] [--program programs/bin/completo.bin]
+//
+// Lee las mismas variables de entorno que la API: SIMULATOR_POOL_PREWARM,
+// SESSION_MEMORY_BUDGET_MB, SESSION_IDLE_SECONDS y SIMULATOR_LOG_DIR.
+#include "HttpServer.h"
+#include "SessionRegistry.h"
+#include "Simulator.h"
+#include "SimulatorPool.h"
+#include "StateJson.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+    using json = nlohmann::json;
+
+    // Memoria de las sesiones, la misma que en la API (el espacio de 32 bits, disperso).
+    constexpr size_t SESSION_MEM_SIZE = size_t(1) << 32;
+    // Pasos entre dos estados enviados por el WebSocket si el cliente no pide otra cosa.
+    constexpr int DEFAULT_FRAME_EVERY = 10;
+    const char* const SESSION_NOT_FOUND = "Session ID not found. Please start a new session.";
+
+    // Error con el status y el detail que devolvería FastAPI.
+    struct HttpError : std::runtime_error {
+        int status;
+        HttpError(int status, const std::string& detail) : std::runtime_error(detail), status(status) {}
+    };
+
+    HttpResponse error_response(int status, const std::string& detail) {
+        return HttpResponse{status, "application/json", json{{"detail", detail}}.dump()};
+    }
+
+    long env_number(const char* name, long fallback) {
+        const char* value = std::getenv(name);
+        return value && *value ? std::strtol(value, nullptr, 10) : fallback;
+    }
+
+    // Identificador aleatorio con el formato de uuid.uuid4().
+    std::string new_session_id() {
+        thread_local std::mt19937_64 random{std::random_device{}()};
+        const uint64_t high = (random() & 0xFFFFFFFFFFFF0FFFull) | 0x0000000000004000ull;
+        const uint64_t low = (random() & 0x3FFFFFFFFFFFFFFFull) | 0x8000000000000000ull;
+        char text[37];
+        std::snprintf(text, sizeof(text), "%08x-%04x-%04x-%04x-%012llx", static_cast<unsigned>(high >> 32),
+                      static_cast<unsigned>((high >> 16) & 0xFFFF), static_cast<unsigned>(high & 0xFFFF),
+                      static_cast<unsigned>(low >> 48), static_cast<unsigned long long>(low & 0xFFFFFFFFFFFFull));
+        return text;
+    }
+
+    bool model_from_name(const std::string& name, PipelineModel& model) {
+        static const std::pair<const char*, PipelineModel> names[] = {
+            {"SingleCycle", PipelineModel::SingleCycle},
+            {"PipeLined", PipelineModel::PipeLined},
+            {"MultiCycle", PipelineModel::MultiCycle},
+            {"General", PipelineModel::General},
+        };
+        for (const auto& entry : names) {
+            if (name == entry.first) {
+                model = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Estado con la forma de SimulatorStateModel de la API: las señales van
+    // en "datapath" y los demás campos del datapath en la raíz.
+    std::string state_json(const Simulator& sim) {
+        static const std::pair<StateJsonMask, StateJsonMask> masks = [] {
+            StateJsonMask signals;
+            for (size_t i = 0; i < DATAPATH_SIGNAL_COUNT; ++i) signals.set(i);
+            return std::make_pair(signals, ~signals);
+        }();
+        const DatapathState state = sim.get_datapath_state();
+        const RegisterFile& registers = sim.get_registers();
+
+        std::string out = "{\"pc\":" + std::to_string(sim.get_pc());
+        out += ",\"instruction\":";
+        out += json(std::string(state.instruction_cptr, strnlen(state.instruction_cptr, sizeof(state.instruction_cptr))))
+                   .dump(-1, ' ', false, json::error_handler_t::replace);
+        out += ",\"status_register\":" + std::to_string(sim.get_status_register());
+        out += ",\"registers\":{";
+        for (uint8_t r = 0; r < 32; ++r) {
+            if (r) out += ',';
+            out += "\"x" + std::to_string(r) + " (" + GPR_NAMES[r] + ")\":" + std::to_string(registers.readA(r));
+        }
+        out += "},\"datapath\":";
+        append_state_json(state, out, &masks.first);
+        std::string extras;
+        append_state_json(state, extras, &masks.second);
+        out += ',';
+        out.append(extras, 1, std::string::npos); // Sin su '{'; su '}' cierra el objeto
+        return out;
+    }
+
+    /**
+     * Simulador de una sesión, con su cerrojo exclusivo, mientras dura el
+     * objeto (el locked_session de la API).
+     */
+    class SessionLease {
+    public:
+        SessionLease(SessionRegistry& registry, const std::string& id) : registry(registry), id(id) {
+            try {
+                sim = registry.acquire(id);
+            } catch (const std::exception& e) {
+                throw HttpError(500, std::string("No se pudo restaurar la sesión: ") + e.what());
+            }
+            if (!sim) throw HttpError(404, SESSION_NOT_FOUND);
+            lock = std::unique_lock<std::shared_mutex>(sim->get_mutex());
+        }
+        ~SessionLease() {
+            if (lock.owns_lock()) lock.unlock();
+            registry.release(id);
+        }
+        SessionLease(const SessionLease&) = delete;
+        SessionLease& operator=(const SessionLease&) = delete;
+
+        Simulator& operator*() const { return *sim; }
+        Simulator* operator->() const { return sim; }
+
+    private:
+        SessionRegistry& registry;
+        std::string id;
+        Simulator* sim = nullptr;
+        std::unique_lock<std::shared_mutex> lock;
+    };
+
+    const std::string& session_id(const HttpRequest& request) {
+        const std::string* id = request.query_param("session_id");
+        if (!id) throw HttpError(422, "Falta el parámetro session_id");
+        return *id;
+    }
+
+    json parse_body(const std::string& body) {
+        try {
+            json parsed = json::parse(body);
+            if (!parsed.is_object()) throw HttpError(422, "El cuerpo debe ser un objeto JSON");
+            return parsed;
+        } catch (const json::exception&) {
+            throw HttpError(422, "El cuerpo no es JSON válido");
+        }
+    }
+
+    std::vector<uint32_t> parse_breakpoints(const json& body) {
+        auto found = body.find("breakpoints");
+        if (found == body.end() || !found->is_array()) throw HttpError(422, "Falta la lista breakpoints");
+        std::vector<uint32_t> breakpoints;
+        for (const json& value : *found) {
+            if (!value.is_number_integer()) throw HttpError(422, "Los breakpoints deben ser enteros");
+            breakpoints.push_back(value.get<uint32_t>());
+        }
+        return breakpoints;
+    }
+
+    /**
+     * Los endpoints y el canal WebSocket, sobre un SimulatorPool y un
+     * SessionRegistry propios y configurados como los de la API.
+     */
+    class SimulatorServer {
+    public:
+        SimulatorServer(HttpServer& server, std::vector<uint8_t> default_program)
+            : server(server), registry(pool), default_program(std::move(default_program)) {
+            pool.prewarm(static_cast<size_t>(env_number("SIMULATOR_POOL_PREWARM", 8)), SESSION_MEM_SIZE, PipelineModel::General);
+            registry.set_budget(static_cast<size_t>(env_number("SESSION_MEMORY_BUDGET_MB", 256)) << 20);
+            registry.set_idle_timeout(std::chrono::seconds(env_number("SESSION_IDLE_SECONDS", SESSION_IDLE_SECONDS)));
+            const char* log_directory = std::getenv("SIMULATOR_LOG_DIR");
+            registry.set_log_directory(log_directory ? log_directory : "");
+
+            server.route("POST", "/session/start", handler(&SimulatorServer::start_session));
+            server.route("GET", "/state", handler(&SimulatorServer::get_state));
+            server.route("POST", "/reset", handler(&SimulatorServer::reset));
+            server.route("POST", "/step", handler(&SimulatorServer::step));
+            server.route("POST", "/step_back", handler(&SimulatorServer::step_back));
+            server.route("POST", "/run", handler(&SimulatorServer::run));
+            server.route("GET", "/memory/data", handler(&SimulatorServer::data_memory));
+            server.route("GET", "/memory/instructions", handler(&SimulatorServer::instruction_memory));
+            server.route("POST", "/assemble", handler(&SimulatorServer::assemble));
+
+            HttpServer::WebSocketHandlers socket;
+            socket.open = [this](uint64_t id, const HttpRequest& request) { return socket_open(id, request); };
+            socket.urgent = [this](uint64_t id, const std::string& text) { return socket_urgent(id, text); };
+            socket.message = [this](uint64_t id, const std::string& text) { socket_message(id, text); };
+            socket.close = [this](uint64_t id) { socket_close(id); };
+            server.websocket("/ws", std::move(socket));
+        }
+
+    private:
+        // Estado de un canal WebSocket. `stop` lo pone un mensaje "stop" o el
+        // cierre de la conexión y lo mira la ejecución en curso tras cada paso.
+        struct Channel {
+            std::string session_id;
+            std::atomic<bool> stop{false};
+        };
+
+        HttpServer::Handler handler(HttpResponse (SimulatorServer::*method)(const HttpRequest&)) {
+            return [this, method](const HttpRequest& request) {
+                try {
+                    return (this->*method)(request);
+                } catch (const HttpError& e) {
+                    return error_response(e.status, e.what());
+                }
+            };
+        }
+
+        static HttpResponse json_response(std::string body) { return HttpResponse{200, "application/json", std::move(body)}; }
+
+        HttpResponse start_session(const HttpRequest&) {
+            const std::string id = new_session_id();
+            if (!registry.create(id, PipelineModel::General, SESSION_MEM_SIZE)) {
+                throw HttpError(500, "No se pudo crear la sesión.");
+            }
+            std::printf("Nueva sesión iniciada: %s\n", id.c_str());
+            return json_response(json{{"session_id", id}}.dump());
+        }
+
+        HttpResponse get_state(const HttpRequest& request) {
+            SessionLease sim(registry, session_id(request));
+            return json_response(state_json(*sim));
+        }
+
+        HttpResponse reset(const HttpRequest& request) {
+            const json config = parse_body(request.body);
+            PipelineModel model = PipelineModel::SingleCycle;
+            uint32_t initial_pc = 0;
+            bool load_test_program = true;
+            bool hazards_enabled = true;
+            std::string bin_code, assembly_code;
+            try {
+                if (!model_from_name(config.value("model", std::string("SingleCycle")), model)) {
+                    throw HttpError(422, "model debe ser 'SingleCycle', 'PipeLined', 'MultiCycle' o 'General'");
+                }
+                initial_pc = config.value("initial_pc", 0u);
+                load_test_program = config.value("load_test_program", true);
+                hazards_enabled = config.value("hazards_enabled", true);
+                if (config.contains("bin_code") && !config["bin_code"].is_null()) bin_code = config["bin_code"].get<std::string>();
+                if (config.contains("assembly_code") && !config["assembly_code"].is_null()) {
+                    assembly_code = config["assembly_code"].get<std::string>();
+                }
+            } catch (const json::exception&) {
+                throw HttpError(422, "Configuración de reset no válida");
+            }
+
+            SessionLease sim(registry, session_id(request));
+            sim->reconfigure(model, SESSION_MEM_SIZE, hazards_enabled);
+            if (!bin_code.empty()) {
+                // Como en la API, un bin_code que no se puede decodificar carga el programa por defecto.
+                std::vector<uint8_t> program;
+                if (!base64_decode(bin_code, program)) program = default_program;
+                sim->load_program(program, model);
+            } else if (!assembly_code.empty()) {
+                try {
+                    sim->load_program(assembly_code.c_str(), model);
+                } catch (const std::exception& e) {
+                    throw HttpError(400, std::string("Error cargando assembly_code: ") + e.what());
+                }
+            } else if (load_test_program) {
+                sim->load_program(default_program, model);
+            }
+            sim->reset(model, initial_pc);
+            return json_response(state_json(*sim));
+        }
+
+        HttpResponse step(const HttpRequest& request) {
+            SessionLease sim(registry, session_id(request));
+            sim->step();
+            return json_response(state_json(*sim));
+        }
+
+        HttpResponse step_back(const HttpRequest& request) {
+            SessionLease sim(registry, session_id(request));
+            sim->step_back();
+            return json_response(state_json(*sim));
+        }
+
+        HttpResponse run(const HttpRequest& request) {
+            const std::vector<uint32_t> breakpoints = parse_breakpoints(parse_body(request.body));
+            SessionLease sim(registry, session_id(request));
+            sim->stepsUntil(breakpoints);
+            return json_response(state_json(*sim));
+        }
+
+        HttpResponse data_memory(const HttpRequest& request) {
+            SessionLease sim(registry, session_id(request));
+            const std::vector<uint8_t> memory = sim->get_d_mem();
+            std::string body(DMEM_SIZE, '\0');
+            std::memcpy(&body[0], memory.data(), std::min<size_t>(memory.size(), body.size()));
+            return HttpResponse{200, "application/octet-stream", std::move(body)};
+        }
+
+        HttpResponse instruction_memory(const HttpRequest& request) {
+            SessionLease sim(registry, session_id(request));
+            json items = json::array();
+            for (const auto& entry : sim->get_i_mem()) items.push_back({{"value", entry.first}, {"instruction", entry.second}});
+            return json_response(items.dump(-1, ' ', false, json::error_handler_t::replace));
+        }
+
+        HttpResponse assemble(const HttpRequest& request) {
+            const json body = parse_body(request.body);
+            auto code = body.find("assembly_code");
+            if (code == body.end() || !code->is_string()) throw HttpError(422, "Falta assembly_code");
+            SessionLease sim(registry, session_id(request));
+            std::vector<uint8_t> machine_code;
+            try {
+                machine_code = sim->assemble(code->get_ref<const std::string&>().c_str());
+            } catch (const std::exception& e) {
+                throw HttpError(400, std::string("Error durante el ensamblado: ") + e.what());
+            }
+            return json_response(json{{"machine_code_b64", base64_encode(machine_code.data(), machine_code.size())},
+                                      {"size_bytes", machine_code.size()}}
+                                     .dump());
+        }
+
+        // --- WebSocket /ws?session_id=... ---
+        // Mensajes del cliente (JSON): {"action":"run","breakpoints":[...],"every":N},
+        // {"action":"stop"}, {"action":"step"}, {"action":"step_back"} y
+        // {"action":"state"}. Respuestas: {"type":"state","steps":n,"state":{...}}
+        // durante y después de cada acción, {"type":"done","steps":n,"stopped":b,"state":{...}}
+        // al terminar una ejecución y {"type":"error","status":s,"detail":"..."}.
+
+        HttpResponse socket_open(uint64_t id, const HttpRequest& request) {
+            try {
+                const std::string& session = session_id(request);
+                { SessionLease check(registry, session); }
+                auto channel = std::make_shared<Channel>();
+                channel->session_id = session;
+                std::lock_guard<std::mutex> lock(channels_mutex);
+                channels[id] = std::move(channel);
+            } catch (const HttpError& e) {
+                return error_response(e.status, e.what());
+            }
+            return HttpResponse{101, "text/plain", std::string()};
+        }
+
+        void socket_close(uint64_t id) {
+            std::lock_guard<std::mutex> lock(channels_mutex);
+            auto found = channels.find(id);
+            if (found == channels.end()) return;
+            found->second->stop = true;
+            channels.erase(found);
+        }
+
+        // En el hilo de epoll: los mensajes del canal se atienden en orden,
+        // así que "stop" no puede esperar su turno detrás de la ejecución que
+        // tiene que parar. Solo pone la marca; el resto va a socket_message.
+        bool socket_urgent(uint64_t id, const std::string& text) {
+            if (text.size() > 256 || text.find("stop") == std::string::npos) return false;
+            const json message = json::parse(text, nullptr, false);
+            if (!message.is_object() || message.value("action", std::string()) != "stop") return false;
+            std::lock_guard<std::mutex> lock(channels_mutex);
+            auto found = channels.find(id);
+            if (found != channels.end()) found->second->stop = true;
+            return true;
+        }
+
+        void socket_message(uint64_t id, const std::string& text) {
+            std::shared_ptr<Channel> channel;
+            {
+                std::lock_guard<std::mutex> lock(channels_mutex);
+                auto found = channels.find(id);
+                if (found == channels.end()) return;
+                channel = found->second;
+            }
+            try {
+                const json message = parse_body(text);
+                const std::string action = message.value("action", std::string());
+                if (action == "run") {
+                    socket_run(id, *channel, message);
+                } else if (action == "step" || action == "step_back" || action == "state") {
+                    SessionLease sim(registry, channel->session_id);
+                    if (action == "step") sim->step();
+                    if (action == "step_back") sim->step_back();
+                    server.send_text(id, state_frame("state", 0, *sim));
+                } else {
+                    throw HttpError(422, "Acción desconocida: " + action);
+                }
+            } catch (const HttpError& e) {
+                server.send_text(id, json{{"type", "error"}, {"status", e.status}, {"detail", e.what()}}.dump());
+            } catch (const std::exception& e) {
+                server.send_text(id, json{{"type", "error"}, {"status", 500}, {"detail", e.what()}}.dump());
+            }
+        }
+
+        // Ejecuta como /run y envía el estado cada `every` pasos. La sesión
+        // queda bloqueada mientras dura, igual que con /run, y los mensajes
+        // que lleguen por el canal esperan a que termine (salvo "stop").
+        void socket_run(uint64_t id, Channel& channel, const json& message) {
+            const std::vector<uint32_t> breakpoints = parse_breakpoints(message);
+            const int every = std::max(1, message.value("every", DEFAULT_FRAME_EVERY));
+            channel.stop = false;
+
+            SessionLease sim(registry, channel.session_id);
+            const int steps = sim->stepsUntil(breakpoints, [&](int done) {
+                if (done % every == 0) server.send_text(id, state_frame("state", done, *sim));
+                return !channel.stop.load();
+            });
+            std::string frame = state_frame("done", steps, *sim);
+            frame.insert(frame.size() - 1, std::string(",\"stopped\":") + (channel.stop.load() ? "true" : "false"));
+            server.send_text(id, frame);
+        }
+
+        static std::string state_frame(const char* type, int steps, const Simulator& sim) {
+            return std::string("{\"type\":\"") + type + "\",\"steps\":" + std::to_string(steps) + ",\"state\":" + state_json(sim) + "}";
+        }
+
+        HttpServer& server;
+        SimulatorPool pool{SIMULATOR_POOL_CAPACITY};
+        SessionRegistry registry;
+        std::vector<uint8_t> default_program;
+        std::mutex channels_mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<Channel>> channels;
+    };
+
+    HttpServer* running_server = nullptr;
+
+    void handle_signal(int) {
+        if (running_server) running_server->stop();
+    }
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = 8070;
+    size_t threads = std::max(4u, std::thread::hardware_concurrency());
+    std::string program_path = "programs/bin/completo.bin";
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (i + 1 < argc && option == "--port") {
+            port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (i + 1 < argc && option == "--threads") {
+            threads = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (i + 1 < argc && option == "--program") {
+            program_path = argv[++i];
+        } else {
+            std::fprintf(stderr, "Uso: %s [--port N] [--threads N] [--program fichero.bin]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<uint8_t> program;
+    std::ifstream file(program_path, std::ios::binary);
+    if (file) {
+        program.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        std::fprintf(stderr, "Aviso: no se encontró el programa por defecto %s\n", program_path.c_str());
+    }
+
+    HttpServer server(threads);
+    SimulatorServer simulator_server(server, std::move(program));
+    running_server = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+    try {
+        std::printf("Servidor del simulador en el puerto %u (%zu hilos)\n", port, threads);
+        std::fflush(stdout);
+        server.run(port);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -317,4 +317,94 @@ const List<InstructionInfo> controlTable = [
     cycles: 4,
     controlWord: 0x1088,
   ),
+  const InstructionInfo._internal(
+    instr: "lb",
+    pcSrc: 0,
+    brWr: true,
+    aluSrc: 0,
+    aluCtr: 0,
+    memWr: false,
+    resSrc: 0,
+    immSrc: 0,
+    mask: 0x707F,
+    value: 0x3,
+    type: 'I',
+    cycles: 5,
+    controlWord: 0x0008,
+  ),
+  const InstructionInfo._internal(
+    instr: "lh",
+    pcSrc: 0,
+    brWr: true,
+    aluSrc: 0,
+    aluCtr: 0,
+    memWr: false,
+    resSrc: 0,
+    immSrc: 0,
+    mask: 0x707F,
+    value: 0x1003,
+    type: 'I',
+    cycles: 5,
+    controlWord: 0x0008,
+  ),
+  const InstructionInfo._internal(
+    instr: "lbu",
+    pcSrc: 0,
+    brWr: true,
+    aluSrc: 0,
+    aluCtr: 0,
+    memWr: false,
+    resSrc: 0,
+    immSrc: 0,
+    mask: 0x707F,
+    value: 0x4003,
+    type: 'I',
+    cycles: 5,
+    controlWord: 0x0008,
+  ),
+  const InstructionInfo._internal(
+    instr: "lhu",
+    pcSrc: 0,
+    brWr: true,
+    aluSrc: 0,
+    aluCtr: 0,
+    memWr: false,
+    resSrc: 0,
+    immSrc: 0,
+    mask: 0x707F,
+    value: 0x5003,
+    type: 'I',
+    cycles: 5,
+    controlWord: 0x0008,
+  ),
+  const InstructionInfo._internal(
+    instr: "sb",
+    pcSrc: 0,
+    brWr: false,
+    aluSrc: 0,
+    aluCtr: 0,
+    memWr: true,
+    resSrc: -1,
+    immSrc: 1,
+    mask: 0x707F,
+    value: 0x23,
+    type: 'S',
+    cycles: 4,
+    controlWord: 0x1904,
+  ),
+  const InstructionInfo._internal(
+    instr: "sh",
+    pcSrc: 0,
+    brWr: false,
+    aluSrc: 0,
+    aluCtr: 0,
+    memWr: true,
+    resSrc: -1,
+    immSrc: 1,
+    mask: 0x707F,
+    value: 0x1023,
+    type: 'S',
+    cycles: 4,
+    controlWord: 0x1904,
+  ),
 ];
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdio>
+#include <iostream>
+
+// Comprobaciones mínimas para los tests del núcleo. Cada tests/test_*.cpp es
+// un ejecutable que ctest da por bueno si termina con 0: las comprobaciones
+// que fallan se escriben en stderr y test_result() devuelve 1.
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::fprintf(stderr, "%s:%d: falla CHECK(%s)\n", __FILE__, __LINE__, #condition); \
+            test_failures()++;                                                             \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                         \
+    do {                                                                                   \
+        const auto check_actual = (actual);                                                \
+        const auto check_expected = (expected);                                            \
+        if (!(check_actual == check_expected)) {                                           \
+            std::cerr << std::dec << __FILE__ << ":" << __LINE__ << ": falla CHECK_EQ(" #actual ", " #expected \
+                      << "): " << check_actual << " != " << check_expected << std::endl;   \
+            test_failures()++;                                                             \
+        }                                                                                  \
+    } while (0)
+
+// Comprueba que `statement` lanza una excepción.
+#define CHECK_THROWS(statement)                                                            \
+    do {                                                                                   \
+        bool check_threw = false;                                                          \
+        try {                                                                              \
+            statement;                                                                     \
+        } catch (...) {                                                                    \
+            check_threw = true;                                                            \
+        }                                                                                  \
+        if (!check_threw) {                                                                \
+            std::fprintf(stderr, "%s:%d: no lanza: %s\n", __FILE__, __LINE__, #statement); \
+            test_failures()++;                                                             \
+        }                                                                                  \
+    } while (0)
+
+inline int test_result() {
+    if (test_failures()) std::fprintf(stderr, "%d comprobaciones fallidas\n", test_failures());
+    return test_failures() ? 1 : 0;
+}
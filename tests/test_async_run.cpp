@@ -0,0 +1,82 @@
+#include "Simulator.h"
+#include "TestSupport.h"
+#include <mutex>
+#include <shared_mutex>
+
+namespace {
+    const char* COUNT_PROGRAM =
+        "loop: addi x1, x1, 1\n"
+        "jal x0, loop\n";
+
+    // Un cancel_run antes de que el hilo consiga el cerrojo para la ejecución
+    // sin dar ningún paso.
+    void test_cancel_before_first_step() {
+        Simulator sim(1 << 16, PipelineModel::SingleCycle);
+        sim.load_program(COUNT_PROGRAM, PipelineModel::SingleCycle);
+        {
+            std::unique_lock<std::shared_mutex> busy(sim.get_mutex());
+            CHECK(sim.run_async({}));
+            CHECK(sim.run_in_progress());
+            CHECK(!sim.run_async({})); // Ya hay una en marcha
+            sim.cancel_run();
+            const RunProgress progress = sim.poll_run(); // Sin esperar al cerrojo
+            CHECK(progress.running);
+            CHECK(progress.cancelled);
+        }
+        sim.wait_run();
+        const RunProgress progress = sim.poll_run();
+        CHECK(!progress.running);
+        CHECK(progress.cancelled);
+        CHECK(!progress.failed);
+        CHECK_EQ(progress.steps, 0);
+        CHECK_EQ(sim.get_registers().readA(1), 0u);
+    }
+
+    // Cancelar a mitad: para tras el paso en curso y el avance es el final.
+    void test_cancel_while_running() {
+        Simulator sim(1 << 16, PipelineModel::SingleCycle);
+        sim.load_program(COUNT_PROGRAM, PipelineModel::SingleCycle);
+        CHECK(sim.run_async({}));
+        while (sim.poll_run().running && sim.poll_run().steps == 0) {}
+        sim.cancel_run();
+        sim.wait_run();
+        const RunProgress progress = sim.poll_run();
+        CHECK(!progress.running);
+        CHECK(progress.steps > 0);
+        CHECK_EQ(progress.pc, sim.get_pc());
+        // Los pasos son las instrucciones ejecutadas: la mitad son addi.
+        CHECK_EQ(sim.get_registers().readA(1), static_cast<uint32_t>((progress.steps + 1) / 2));
+        // Y se puede lanzar otra.
+        CHECK(sim.run_async({}));
+        sim.cancel_run();
+        sim.wait_run();
+        CHECK(!sim.poll_run().running);
+    }
+
+    // Una excepción en el hilo no termina el proceso: queda como `failed`.
+    void test_failed_run_is_reported() {
+        Simulator sim(1 << 16, PipelineModel::MultiCycle);
+        sim.load_program("addi x1, x0, 1024\naddi x2, x0, 7\nsw x2, 0(x1)\n", PipelineModel::MultiCycle);
+        CHECK(sim.run_async({}));
+        sim.wait_run();
+        const RunProgress progress = sim.poll_run();
+        CHECK(!progress.running);
+        CHECK(progress.failed);
+        CHECK(!progress.cancelled);
+        CHECK(!sim.run_in_progress());
+        // La instancia sigue usable y la siguiente ejecución empieza limpia.
+        sim.reset(PipelineModel::SingleCycle, 0);
+        sim.load_program(COUNT_PROGRAM, PipelineModel::SingleCycle);
+        CHECK(sim.run_async({}));
+        sim.cancel_run();
+        sim.wait_run();
+        CHECK(!sim.poll_run().failed);
+    }
+}
+
+int main() {
+    test_cancel_before_first_step();
+    test_cancel_while_running();
+    test_failed_run_is_reported();
+    return test_result();
+}
@@ -0,0 +1,126 @@
+#include "Cache.h"
+#include "Memory.h"
+#include "Simulator.h"
+#include "TestSupport.h"
+
+namespace {
+    constexpr size_t BLOCK = 16;
+
+    void test_write_buffer_coalesces_and_defers() {
+        Memory memory(1 << 16);
+        DataCache cache(256, BLOCK, memory);
+        cache.set_write_buffer_entries(2);
+        for (uint32_t i = 0; i < 4; ++i) cache.write(0x100 + 4 * i, 0xA0 + i, 4);
+        CHECK_EQ(cache.get_stats().write_buffer_coalesced, 3u);
+        CHECK_EQ(cache.get_write_buffer_occupancy(), 1u);
+        CHECK_EQ(memory.read_word(0x104), 0u);       // Aún en el buffer
+        CHECK_EQ(cache.peek(0x104, 4), 0xA1u);       // Pero el programa ya lo ve
+        cache.flush();
+        CHECK_EQ(cache.get_write_buffer_occupancy(), 0u);
+        for (uint32_t i = 0; i < 4; ++i) CHECK_EQ(memory.read_word(0x100 + 4 * i), 0xA0 + i);
+    }
+
+    void test_write_buffer_full_stalls() {
+        Memory memory(1 << 16);
+        DataCache cache(256, BLOCK, memory);
+        cache.set_write_buffer_entries(2);
+        for (uint32_t block = 0; block < 3; ++block) cache.write(0x200 + block * BLOCK, block, 4);
+        CHECK_EQ(cache.get_stats().write_buffer_full_stalls, 1u);
+        CHECK(cache.get_write_buffer_occupancy() <= 2u);
+    }
+
+    void test_misaligned_store_at_block_end() {
+        Memory memory(1 << 16);
+        DataCache cache(256, BLOCK, memory);
+        cache.set_write_buffer_entries(4);
+        cache.write(BLOCK - 2, 0x44332211, 4); // Cruza al bloque siguiente
+        CHECK_EQ(cache.peek(BLOCK - 2, 4), 0x44332211u);
+        cache.flush();
+        CHECK_EQ(memory.read_byte(BLOCK - 2), 0x11u);
+        CHECK_EQ(memory.read_byte(BLOCK - 1), 0x22u);
+        CHECK_EQ(memory.read_byte(BLOCK), 0x33u);
+        CHECK_EQ(memory.read_byte(BLOCK + 1), 0x44u);
+        CHECK_EQ(memory.read_byte(BLOCK + 2), 0u);
+    }
+
+    void test_victim_cache_absorbs_conflicts() {
+        Memory memory(1 << 16);
+        memory.write_word(0x000, 1);
+        memory.write_word(0x100, 2); // Misma línea que 0x000 en una caché de 256 bytes
+        DataCache plain(256, BLOCK, memory);
+        DataCache with_victims(256, BLOCK, memory);
+        with_victims.set_victim_entries(1);
+        for (int round = 0; round < 4; ++round) {
+            for (uint32_t address : {0x000u, 0x100u}) {
+                CHECK_EQ(plain.read(address, 4), address ? 2u : 1u);
+                CHECK_EQ(with_victims.read(address, 4), address ? 2u : 1u);
+            }
+        }
+        CHECK_EQ(plain.get_stats().read_misses, 8u);
+        CHECK_EQ(with_victims.get_stats().victim_hits, 6u);
+    }
+
+    // Dos pasadas por ocho bloques seguidos: no caben en la caché del
+    // segmentado, así que la segunda pasada también falla.
+    const char* STREAM_PROGRAM =
+        "addi x9, x0, 2\n"
+        "loop: lw x2, 0(x1)\n"
+        "lw x3, 16(x1)\n"
+        "lw x4, 32(x1)\n"
+        "lw x5, 48(x1)\n"
+        "lw x6, 64(x1)\n"
+        "lw x7, 80(x1)\n"
+        "lw x8, 96(x1)\n"
+        "lw x10, 112(x1)\n"
+        "addi x9, x9, -1\n"
+        "bne x9, x0, loop\n"
+        "add x11, x2, x10\n";
+    constexpr uint32_t STREAM_PROGRAM_END = 44; // Dirección tras la última instrucción
+
+    // Ciclos hasta que el add final sale de WB.
+    uint64_t run_stream(size_t mshr_entries, PipelineMemoryStats& stats, uint64_t& misses) {
+        Simulator sim(1 << 16, PipelineModel::PipeLined);
+        sim.load_program(STREAM_PROGRAM, PipelineModel::PipeLined);
+        sim.set_pipeline_caches(true, mshr_entries);
+        uint64_t cycles = 0;
+        while (sim.get_pc() < STREAM_PROGRAM_END + 16 && cycles < 2000) {
+            sim.step();
+            ++cycles;
+        }
+        stats = sim.get_pipeline_memory_stats();
+        misses = sim.get_cache(CacheId::Data).get_stats().read_misses;
+        return cycles;
+    }
+
+    void test_mshrs_overlap_pipeline_misses() {
+        PipelineMemoryStats blocking, one, four;
+        uint64_t blocking_misses = 0, one_misses = 0, four_misses = 0;
+        const uint64_t blocking_cycles = run_stream(0, blocking, blocking_misses);
+        const uint64_t one_cycles = run_stream(1, one, one_misses);
+        const uint64_t four_cycles = run_stream(4, four, four_misses);
+
+        // La caché es menor que d_mem: fallan las dieciséis cargas.
+        CHECK_EQ(blocking_misses, 16u);
+        CHECK_EQ(one_misses, 16u);
+        CHECK_EQ(four_misses, 16u);
+
+        // Bloqueante: cada fallo congela la segmentación entera.
+        CHECK_EQ(blocking.load_stall_cycles, 16u * MEMORY_LATENCY_CYCLES);
+        CHECK_EQ(blocking.mshr_stall_cycles, 0u);
+
+        // Con un MSHR cada carga espera a la anterior; con cuatro se solapan.
+        CHECK(one.mshr_stall_cycles > 0);
+        CHECK(four.mshr_stall_cycles < one.mshr_stall_cycles);
+        CHECK(four_cycles < one_cycles);
+        CHECK(one_cycles <= blocking_cycles);
+    }
+}
+
+int main() {
+    test_write_buffer_coalesces_and_defers();
+    test_write_buffer_full_stalls();
+    test_misaligned_store_at_block_end();
+    test_victim_cache_absorbs_conflicts();
+    test_mshrs_overlap_pipeline_misses();
+    return test_result();
+}
@@ -0,0 +1,119 @@
+#include "Cache.h"
+#include "Coherence.h"
+#include "Memory.h"
+#include "MultiHart.h"
+#include "TestSupport.h"
+
+namespace {
+    constexpr size_t BLOCK = 16;
+    constexpr uint32_t X = 0x100;
+
+    struct TwoCaches {
+        Memory memory{1 << 16};
+        CoherenceBus bus;
+        DataCache a{256, BLOCK, memory};
+        DataCache b{256, BLOCK, memory};
+        explicit TwoCaches(CoherenceProtocol protocol) : bus(protocol) {
+            bus.attach(a);
+            bus.attach(b);
+        }
+    };
+
+    void test_mesi_transitions() {
+        TwoCaches c(CoherenceProtocol::MESI);
+        c.memory.write_word(X, 5);
+        CHECK_EQ(c.a.read_word(X), 5u);
+        CHECK(c.a.get_line_state(X) == CoherenceState::Exclusive); // Única copia
+
+        CHECK_EQ(c.b.read_word(X), 5u);
+        CHECK(c.a.get_line_state(X) == CoherenceState::Shared);
+        CHECK(c.b.get_line_state(X) == CoherenceState::Shared);
+        CHECK_EQ(c.bus.get_stats().bus_reads, 2u);
+
+        c.a.write_word(X, 6); // S -> M con BusUpgr
+        CHECK(c.a.get_line_state(X) == CoherenceState::Modified);
+        CHECK(c.b.get_line_state(X) == CoherenceState::Invalid);
+        CHECK_EQ(c.bus.get_stats().bus_upgrades, 1u);
+        CHECK_EQ(c.bus.get_stats().invalidations, 1u);
+        CHECK_EQ(c.memory.read_word(X), 5u); // Write-back: aún en la caché
+        CHECK_EQ(c.bus.read_word(c.memory, X), 6u);
+
+        // B vuelve a leer: A vuelca la línea y ambas quedan en S.
+        CHECK_EQ(c.b.read_word(X), 6u);
+        CHECK(c.a.get_line_state(X) == CoherenceState::Shared);
+        CHECK(c.b.get_line_state(X) == CoherenceState::Shared);
+        CHECK_EQ(c.bus.get_stats().interventions, 1u);
+        CHECK_EQ(c.bus.get_stats().coherence_misses, 1u);
+        CHECK_EQ(c.memory.read_word(X), 6u);
+
+        // B escribe sin tener la línea: BusRdX.
+        c.b.write_word(X + 0x40, 1);
+        CHECK(c.b.get_line_state(X + 0x40) == CoherenceState::Modified);
+        CHECK_EQ(c.bus.get_stats().bus_read_exclusive, 1u);
+    }
+
+    // En MESI una copia en E pasa a M sin usar el bus; en MSI no hay E.
+    void test_exclusive_upgrade_is_silent() {
+        TwoCaches mesi(CoherenceProtocol::MESI);
+        mesi.a.read_word(X);
+        mesi.a.write_word(X, 1);
+        CHECK(mesi.a.get_line_state(X) == CoherenceState::Modified);
+        CHECK_EQ(mesi.bus.get_stats().bus_upgrades, 0u);
+
+        TwoCaches msi(CoherenceProtocol::MSI);
+        msi.a.read_word(X);
+        CHECK(msi.a.get_line_state(X) == CoherenceState::Shared);
+        msi.a.write_word(X, 1);
+        CHECK(msi.a.get_line_state(X) == CoherenceState::Modified);
+        CHECK_EQ(msi.bus.get_stats().bus_upgrades, 1u);
+    }
+
+    void test_false_sharing_report() {
+        TwoCaches c(CoherenceProtocol::MESI);
+        // Verdadero compartir: B escribe la misma palabra que leyó A.
+        c.a.read_word(X + 4);
+        c.b.write_word(X + 4, 1);
+        CHECK_EQ(c.bus.get_stats().invalidations, 1u);
+        CHECK_EQ(c.bus.get_stats().false_sharing, 0u);
+
+        // Falso compartir: A usa la palabra 0 y B escribe la 2 del mismo bloque.
+        c.a.read_word(X);
+        c.b.read_word(X + 8);
+        c.b.write_word(X + 8, 2);
+        CHECK_EQ(c.bus.get_stats().false_sharing, 1u);
+        CHECK_EQ(c.bus.get_false_sharing().size(), 1u);
+        CHECK_EQ(c.bus.get_false_sharing().begin()->second, 1u);
+        CHECK_EQ(c.bus.get_false_sharing().begin()->first, X);
+
+        c.bus.reset();
+        CHECK(c.bus.get_false_sharing().empty());
+    }
+
+    // Dos harts escriben palabras distintas de un mismo bloque en bucle.
+    void test_multihart_false_sharing() {
+        MultiHart multi(2, 1 << 16, CoherenceProtocol::MSI);
+        multi.load_program(
+            "add x5, x10, x10\n"
+            "add x5, x5, x5\n"      // x5 = 4 * hartid
+            "addi x6, x0, 8\n"
+            "loop: lw x7, 1024(x5)\n"
+            "addi x7, x7, 1\n"
+            "sw x7, 1024(x5)\n"
+            "addi x6, x6, -1\n"
+            "bne x6, x0, loop\n"
+            "park: jal x0, park\n");
+        multi.run(200);
+        CHECK_EQ(multi.read_word(1024), 8u);
+        CHECK_EQ(multi.read_word(1028), 8u);
+        CHECK(multi.get_bus().get_stats().false_sharing > 0);
+        CHECK_EQ(multi.get_bus().get_false_sharing().count(1024), 1u);
+    }
+}
+
+int main() {
+    test_mesi_transitions();
+    test_exclusive_upgrade_is_silent();
+    test_false_sharing_report();
+    test_multihart_false_sharing();
+    return test_result();
+}
@@ -0,0 +1,206 @@
+#include "Simulator.h"
+#include "TestSupport.h"
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Cargas que fallan en la caché de datos: con un solo MSHR el segmentado
+    // se congela varios ciclos esperando a memoria.
+    const char* LOAD_PROGRAM =
+        "addi x1, x0, 256\n"
+        "lw x2, 0(x1)\n"
+        "lw x3, 512(x1)\n"
+        "add x4, x2, x3\n"
+        "sw x4, 1024(x1)\n"
+        "lw x5, 1536(x1)\n"
+        "addi x6, x5, 1\n";
+
+    // Cinco sw seguidos a partir de 1024 y una carga al final: 23 pasos.
+    const char* STORE_PROGRAM =
+        "addi x1, x0, 1024\n"
+        "addi x2, x0, 5\n"
+        "loop: sw x2, 0(x1)\n"
+        "addi x1, x1, 4\n"
+        "addi x2, x2, -1\n"
+        "bne x2, x0, loop\n"
+        "lw x3, 1024(x0)\n";
+    constexpr int STORE_PROGRAM_STEPS = 23;
+
+    uint32_t data_word(const Simulator& sim, uint32_t address) {
+        uint8_t bytes[4] = {};
+        sim.read_data_memory(address, bytes, 4);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    void load_timed_pipeline(Simulator& sim) {
+        sim.load_program(LOAD_PROGRAM, PipelineModel::PipeLined);
+        sim.set_pipeline_caches(true, 1);
+    }
+
+    void test_frozen_cycles_leave_no_entries() {
+        Simulator sim(1 << 16, PipelineModel::PipeLined);
+        load_timed_pipeline(sim);
+        for (int i = 0; i < 120; ++i) sim.step();
+        CHECK_EQ(sim.get_history_last_cycle(), 120u);
+        CHECK(sim.get_history_depth() < 120u);
+        const uint32_t final_pc = sim.get_pc();
+
+        // Cada paso que se deshace es una instrucción que avanzó, no un ciclo
+        // congelado: al volver al principio el estado es el del reset.
+        const size_t depth = sim.get_history_depth();
+        for (size_t i = 0; i < depth; ++i) sim.step_back();
+        CHECK_EQ(sim.get_history_depth(), 0u);
+        CHECK_EQ(sim.get_pc(), 0u);
+
+        // Rehacer lleva al mismo sitio que ejecutar.
+        sim.seek(120);
+        CHECK_EQ(sim.get_history_depth(), depth);
+        CHECK_EQ(sim.get_pc(), final_pc);
+        CHECK_EQ(sim.get_history_last_cycle(), 120u);
+    }
+
+    void test_seek_into_frozen_cycles() {
+        Simulator reference(1 << 16, PipelineModel::PipeLined);
+        load_timed_pipeline(reference);
+        for (int i = 0; i < 50; ++i) reference.step();
+
+        Simulator sim(1 << 16, PipelineModel::PipeLined);
+        load_timed_pipeline(sim);
+        for (int i = 0; i < 120; ++i) sim.step();
+        sim.seek(50);
+        CHECK_EQ(sim.get_pc(), reference.get_pc());
+        CHECK(sim.get_history_depth() <= reference.get_history_depth());
+        // Seguir desde ahí rehace lo grabado sin volver a ejecutarlo.
+        sim.seek(120);
+        CHECK_EQ(sim.get_history_last_cycle(), 120u);
+    }
+
+    void test_undo_redo_round_trip() {
+        Simulator sim(1 << 20, PipelineModel::General);
+        sim.load_program(STORE_PROGRAM, PipelineModel::General);
+        for (int i = 0; i < STORE_PROGRAM_STEPS; ++i) sim.step();
+        const uint32_t final_pc = sim.get_pc();
+        CHECK_EQ(sim.get_registers().readA(3), 5u);
+        CHECK_EQ(data_word(sim, 1040), 1u);
+
+        while (sim.get_history_depth() > 0) sim.step_back();
+        CHECK_EQ(sim.get_pc(), 0u);
+        for (uint8_t r = 1; r <= 3; ++r) CHECK_EQ(sim.get_registers().readA(r), 0u);
+        for (uint32_t address = 1024; address < 1044; address += 4) CHECK_EQ(data_word(sim, address), 0u);
+
+        // Los pasos deshechos se rehacen con sus deltas.
+        for (int i = 0; i < STORE_PROGRAM_STEPS; ++i) sim.step();
+        CHECK_EQ(sim.get_pc(), final_pc);
+        CHECK_EQ(sim.get_registers().readA(3), 5u);
+        for (uint32_t i = 0; i < 5; ++i) CHECK_EQ(data_word(sim, 1024 + 4 * i), 5 - i);
+    }
+
+    void test_mapped_file_writes_are_not_undone() {
+        const char* path = "test_history_mapped.bin";
+        std::remove(path);
+        {
+            Simulator sim(1 << 20, PipelineModel::General);
+            sim.load_program("lui x1, 16\naddi x2, x0, 77\nsw x2, 0(x1)\n", PipelineModel::General);
+            sim.map_file(path, 0x10000, PAGE_SIZE);
+            for (int i = 0; i < 3; ++i) sim.step();
+            sim.sync_mapped_files();
+            CHECK_EQ(data_word(sim, 0x10000), 77u);
+            // El fichero está fuera del simulador: volver atrás no lo cambia.
+            while (sim.get_history_depth() > 0) sim.step_back();
+            CHECK_EQ(sim.get_pc(), 0u);
+            CHECK_EQ(data_word(sim, 0x10000), 77u);
+        }
+        std::remove(path);
+    }
+
+    // Cambiar la jerarquía de memoria cambia lo que harían los pasos
+    // deshechos: ya no se pueden rehacer.
+    void test_hierarchy_changes_discard_redo() {
+        const std::vector<void (*)(Simulator&)> changes = {
+            [](Simulator& sim) { sim.add_prefetcher(CacheId::Data, PrefetcherKind::NextLine, 1, 1); },
+            [](Simulator& sim) { sim.clear_prefetchers(CacheId::Data); },
+            [](Simulator& sim) { sim.set_write_buffer_entries(CacheId::Data, 2); },
+            [](Simulator& sim) { sim.set_victim_entries(CacheId::Data, 2); },
+            [](Simulator& sim) { sim.attach_dram(DramConfig{}); },
+            [](Simulator& sim) { sim.detach_dram(); },
+        };
+        for (const auto& change : changes) {
+            Simulator sim(1 << 20, PipelineModel::General);
+            sim.load_program(STORE_PROGRAM, PipelineModel::General);
+            for (int i = 0; i < 10; ++i) sim.step();
+            for (int i = 0; i < 3; ++i) sim.step_back();
+            CHECK_EQ(sim.get_history_last_cycle(), 10u);
+            change(sim);
+            CHECK_EQ(sim.get_history_depth(), 7u);
+            CHECK_EQ(sim.get_history_last_cycle(), 7u);
+        }
+    }
+
+    // Un fork comparte memoria e historial con su padre, pero cada uno sigue
+    // por su cuenta, también desde hilos distintos.
+    void test_fork_is_isolated() {
+        Simulator parent(1 << 20, PipelineModel::General);
+        parent.load_program(STORE_PROGRAM, PipelineModel::General);
+        for (int i = 0; i < 10; ++i) parent.step(); // Dos sw hechos
+        Simulator first(1 << 16, PipelineModel::SingleCycle);
+        Simulator second(1 << 16, PipelineModel::SingleCycle);
+        parent.fork_to(first);
+        parent.fork_to(second);
+        CHECK_EQ(first.get_history_depth(), 10u);
+        CHECK_EQ(data_word(first, 1028), 4u);
+
+        auto run = [](Simulator* sim, int from) {
+            for (int round = 0; round < 20; ++round) {
+                for (int i = from; i < STORE_PROGRAM_STEPS; ++i) sim->step();
+                while (sim->get_history_depth() > 0) sim->step_back();
+                from = 0;
+            }
+        };
+        std::thread other(run, &first, 10);
+        for (int i = 10; i < STORE_PROGRAM_STEPS; ++i) parent.step();
+        other.join();
+
+        // El padre terminó; el primer hijo volvió al principio y el segundo
+        // sigue donde se bifurcó.
+        for (uint32_t i = 0; i < 5; ++i) CHECK_EQ(data_word(parent, 1024 + 4 * i), 5 - i);
+        for (uint32_t i = 0; i < 5; ++i) CHECK_EQ(data_word(first, 1024 + 4 * i), 0u);
+        CHECK_EQ(data_word(second, 1028), 4u);
+        CHECK_EQ(data_word(second, 1032), 0u);
+        CHECK_EQ(second.get_history_depth(), 10u);
+        while (second.get_history_depth() > 0) second.step_back();
+        CHECK_EQ(second.get_pc(), 0u);
+        CHECK_EQ(data_word(second, 1024), 0u);
+        CHECK_EQ(data_word(parent, 1024), 5u);
+        CHECK_EQ(parent.get_registers().readA(3), 5u);
+    }
+
+    // Los ciclos congelados se suman al último paso: si el padre los suma
+    // tras el fork, el paso del hijo no cambia.
+    void test_fork_keeps_newest_step() {
+        Simulator parent(1 << 16, PipelineModel::PipeLined);
+        load_timed_pipeline(parent);
+        for (int i = 0; i < 30; ++i) parent.step();
+        Simulator child(1 << 16, PipelineModel::SingleCycle);
+        parent.fork_to(child);
+        const uint32_t pc = child.get_pc();
+        for (int i = 0; i < 40; ++i) parent.step();
+        CHECK_EQ(child.get_history_last_cycle(), 30u);
+        child.step_back();
+        child.seek(30);
+        CHECK_EQ(child.get_pc(), pc);
+        CHECK_EQ(child.get_history_last_cycle(), 30u);
+        CHECK_EQ(parent.get_history_last_cycle(), 70u);
+    }
+}
+
+int main() {
+    test_undo_redo_round_trip();
+    test_mapped_file_writes_are_not_undone();
+    test_hierarchy_changes_discard_redo();
+    test_frozen_cycles_leave_no_entries();
+    test_seek_into_frozen_cycles();
+    test_fork_is_isolated();
+    test_fork_keeps_newest_step();
+    return test_result();
+}
@@ -0,0 +1,146 @@
+#include "Loader.h"
+#include "Memory.h"
+#include "Simulator.h"
+#include "TestSupport.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    void put16(std::vector<uint8_t>& out, size_t at, uint16_t value) {
+        out[at] = value & 0xFF;
+        out[at + 1] = value >> 8;
+    }
+
+    void put32(std::vector<uint8_t>& out, size_t at, uint32_t value) {
+        for (int i = 0; i < 4; ++i) out[at + i] = (value >> (8 * i)) & 0xFF;
+    }
+
+    // ELF32 RISC-V con un PT_LOAD: página y media del fichero desde 0x1000
+    // en 0x10000, y memsz con .bss hasta 0x13000.
+    std::vector<uint8_t> elf_image(uint16_t machine = 243) {
+        std::vector<uint8_t> elf(0x2800, 0);
+        elf[0] = 0x7F; elf[1] = 'E'; elf[2] = 'L'; elf[3] = 'F';
+        elf[4] = 1; elf[5] = 1; elf[6] = 1;
+        put16(elf, 16, 2);        // ET_EXEC
+        put16(elf, 18, machine);
+        put32(elf, 24, 0x10040);  // Entrada
+        put32(elf, 28, 52);       // phoff
+        put16(elf, 42, 32);
+        put16(elf, 44, 1);
+        put32(elf, 52, 1);        // PT_LOAD
+        put32(elf, 56, 0x1000);   // offset
+        put32(elf, 60, 0x10000);  // vaddr
+        put32(elf, 64, 0x10000);  // paddr
+        put32(elf, 68, 0x1800);   // filesz
+        put32(elf, 72, 0x3000);   // memsz
+        for (size_t i = 0x1000; i < elf.size(); ++i) elf[i] = static_cast<uint8_t>(i * 7);
+        return elf;
+    }
+
+    std::string write_file(const std::string& name, const std::vector<uint8_t>& bytes) {
+        std::ofstream(name, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        return name;
+    }
+
+    // Direcciones de las páginas que leen directamente de la proyección.
+    std::vector<uint32_t> pages_in(const Memory& memory, const MappedFile& file) {
+        std::vector<uint32_t> pages;
+        memory.for_each_page([&](uint32_t address, const uint8_t* data, size_t) {
+            if (data >= file.data() && data < file.data() + file.size()) pages.push_back(address);
+        });
+        return pages;
+    }
+
+    void test_elf_segments_share_full_pages() {
+        const std::vector<uint8_t> elf = elf_image();
+        const auto file = MappedFile::open(write_file("test_loader.elf", elf));
+        Memory memory(1 << 20);
+        memory.write_word(0x20000, 1); // load_image borra lo anterior
+        const LoadedImage image = load_image(memory, file);
+        CHECK(image.elf);
+        CHECK_EQ(image.entry, 0x10040u);
+        CHECK_EQ(image.shared_pages, 1u);
+        CHECK_EQ(image.copied_bytes, 0x800u);
+        CHECK(memory.read_bytes(0x10000, 0x1800) == std::vector<uint8_t>(elf.begin() + 0x1000, elf.end()));
+        CHECK_EQ(memory.read_word(0x11800), 0u); // .bss
+        CHECK_EQ(memory.read_word(0x20000), 0u);
+        CHECK(pages_in(memory, *file) == std::vector<uint32_t>{0x10000});
+        CHECK_EQ(memory.resident_pages(), 1u); // Solo la media página copiada
+
+        // Dos memorias con la misma imagen leen de la misma proyección; la
+        // primera escritura copia la página sin tocar el fichero ni la otra.
+        Memory other(1 << 20);
+        load_image(other, file);
+        CHECK(pages_in(other, *file) == std::vector<uint32_t>{0x10000});
+        other.write_word(0x10000, 0xDEADBEEF);
+        CHECK(pages_in(other, *file).empty());
+        CHECK_EQ(other.read_word(0x10000), 0xDEADBEEFu);
+        CHECK_EQ(memory.read_word(0x10000), static_cast<uint32_t>(elf[0x1000] | (elf[0x1001] << 8) | (elf[0x1002] << 16) | (elf[0x1003] << 24)));
+        CHECK_EQ(file->data()[0x1000], elf[0x1000]);
+        std::remove("test_loader.elf");
+    }
+
+    void test_raw_image_loads_at_zero() {
+        std::vector<uint8_t> raw(2 * PAGE_SIZE + 12);
+        for (size_t i = 0; i < raw.size(); ++i) raw[i] = static_cast<uint8_t>(i ^ 0x5A);
+        const auto file = MappedFile::open(write_file("test_loader.bin", raw));
+        Memory memory(1 << 20);
+        const LoadedImage image = load_image(memory, file);
+        CHECK(!image.elf);
+        CHECK_EQ(image.entry, 0u);
+        CHECK_EQ(image.shared_pages, 2u);
+        CHECK_EQ(image.copied_bytes, 12u);
+        CHECK(memory.read_bytes(0, raw.size()) == raw);
+        CHECK_EQ(pages_in(memory, *file).size(), 2u);
+        std::remove("test_loader.bin");
+    }
+
+    void test_invalid_images_are_rejected() {
+        Memory memory(1 << 20);
+        const auto wrong_machine = MappedFile::open(write_file("test_loader.elf", elf_image(62)));
+        CHECK_THROWS(load_image(memory, wrong_machine));
+        Memory small(0x8000);
+        const auto elf = MappedFile::open(write_file("test_loader.elf", elf_image()));
+        CHECK_THROWS(load_image(small, elf));
+        std::remove("test_loader.elf");
+    }
+
+    // Un binario plano en modo General: el fetch lee el código cargado y las
+    // páginas del fichero se comparten también con la memoria de instrucciones.
+    void test_simulator_runs_raw_file() {
+        Simulator sim(1 << 20, PipelineModel::General);
+        std::vector<uint8_t> program = sim.assemble(
+            "addi x1, x0, 3\n"
+            "addi x2, x1, 4\n"
+            "lui x3, 2\n"
+            "sw x2, 0(x3)\n"
+            "park: jal x0, park\n");
+        program.resize(PAGE_SIZE, 0);
+        write_file("test_loader.bin", program);
+        CHECK_EQ(sim.load_file("test_loader.bin", PipelineModel::General), 0u);
+        CHECK(sim.get_footprint().memory_bytes < PAGE_SIZE); // La página del fichero no es propia
+        sim.reset(PipelineModel::General, 0);
+        for (int i = 0; i < 5; ++i) sim.step();
+        CHECK_EQ(sim.get_registers().readA(2), 7u);
+        uint8_t bytes[4] = {};
+        sim.read_data_memory(0x2000, bytes, 4);
+        CHECK_EQ(bytes[0], 7u);
+
+        Simulator didactic(1 << 16, PipelineModel::SingleCycle);
+        write_file("test_loader.elf", elf_image());
+        CHECK_THROWS(didactic.load_file("test_loader.elf", PipelineModel::SingleCycle));
+        std::remove("test_loader.bin");
+        std::remove("test_loader.elf");
+    }
+}
+
+int main() {
+    test_elf_segments_share_full_pages();
+    test_raw_image_loads_at_zero();
+    test_invalid_images_are_rejected();
+    test_simulator_runs_raw_file();
+    return test_result();
+}
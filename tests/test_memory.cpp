@@ -0,0 +1,57 @@
+#include "Memory.h"
+#include "TestSupport.h"
+#include <cstdio>
+
+namespace {
+    void test_copies_are_copy_on_write() {
+        Memory original(1 << 20);
+        for (uint32_t page = 0; page < 4; ++page) original.write_word(page * PAGE_SIZE, page + 1);
+        Memory copy(original);
+        copy.write_word(0, 0xAA);
+        CHECK_EQ(original.read_word(0), 1u);
+        CHECK_EQ(copy.read_word(0), 0xAAu);
+        CHECK_EQ(copy.read_word(PAGE_SIZE), 2u);
+    }
+
+    void test_shared_pages_count_once() {
+        Memory original(1 << 20);
+        for (uint32_t page = 0; page < 4; ++page) original.write_word(page * PAGE_SIZE, page + 1);
+        CHECK_EQ(original.shared_resident_bytes(), 4 * PAGE_SIZE);
+        {
+            Memory copy(original);
+            CHECK_EQ(original.shared_resident_bytes() + copy.shared_resident_bytes(), 4 * PAGE_SIZE);
+            copy.write_word(0, 0xAA); // La copia duplica una página
+            CHECK_EQ(original.shared_resident_bytes() + copy.shared_resident_bytes(), 5 * PAGE_SIZE);
+            CHECK_EQ(original.resident_pages(), 4u);
+        }
+        CHECK_EQ(original.shared_resident_bytes(), 4 * PAGE_SIZE);
+    }
+
+    void test_assignment_keeps_mapped_files() {
+        const char* path = "test_memory_mapped.bin";
+        std::remove(path);
+        {
+            Memory original(1 << 20);
+            original.map_file(path, 0x10000, PAGE_SIZE);
+            Memory assigned(1 << 20);
+            assigned = original;
+            CHECK(assigned.has_mapped_files());
+            // Las dos proyectan el mismo fichero.
+            assigned.write_word(0x10000, 0x12345678);
+            CHECK_EQ(original.read_word(0x10000), 0x12345678u);
+            assigned.sync_mapped_files();
+        }
+        Memory reopened(1 << 20);
+        reopened.map_file(path, 0, PAGE_SIZE);
+        CHECK_EQ(reopened.read_word(0), 0x12345678u);
+        reopened.clear();
+        std::remove(path);
+    }
+}
+
+int main() {
+    test_copies_are_copy_on_write();
+    test_shared_pages_count_once();
+    test_assignment_keeps_mapped_files();
+    return test_result();
+}
@@ -0,0 +1,122 @@
+#include "Memory.h"
+#include "Mmu.h"
+#include "Simulator.h"
+#include "TestSupport.h"
+
+namespace {
+    constexpr uint32_t ROOT = 0x1000;  // Tabla de primer nivel
+    constexpr uint32_t LEAF = 0x2000;  // Tabla de segundo nivel
+
+    uint32_t pte(uint32_t pa, uint32_t flags) { return ((pa / PAGE_SIZE) << 10) | flags | PTE_V; }
+
+    // va 0x00403000 -> pa 0x5000 (R/W) y va 0x00404000 -> pa 0x6000 (R/X);
+    // va 0x00800000 es una megapágina R/W sobre pa 0.
+    void build_tables(Memory& memory) {
+        memory.write_word(ROOT + 1 * 4, pte(LEAF, 0));
+        memory.write_word(ROOT + 2 * 4, pte(0, PTE_R | PTE_W));
+        memory.write_word(LEAF + 3 * 4, pte(0x5000, PTE_R | PTE_W));
+        memory.write_word(LEAF + 4 * 4, pte(0x6000, PTE_R | PTE_X));
+    }
+
+    // Recorrido de dos niveles, acierto en el TLB de primer nivel y acierto
+    // en el compartido desde el otro TLB.
+    void test_walk_and_tlb_hits() {
+        Memory memory(1 << 20);
+        build_tables(memory);
+        Mmu mmu(memory);
+        mmu.set_satp((1u << 31) | (ROOT / PAGE_SIZE));
+
+        uint32_t pa = 0;
+        CHECK(mmu.translate(0x00403abc, AccessType::Load, 0, pa));
+        CHECK_EQ(pa, 0x5abcu);
+        CHECK_EQ(mmu.get_stats().dtlb_misses, 1u);
+        CHECK_EQ(mmu.get_stats().l2_misses, 1u);
+        CHECK_EQ(mmu.get_stats().walk_reads, 2u);
+        CHECK(mmu.get_last_latency() > 0);
+
+        CHECK(mmu.translate(0x00403ffc, AccessType::Store, 0, pa));
+        CHECK_EQ(pa, 0x5ffcu);
+        CHECK_EQ(mmu.get_stats().dtlb_misses, 1u);
+        CHECK_EQ(mmu.get_stats().walk_reads, 2u);
+        CHECK_EQ(mmu.get_last_latency(), 0u);
+
+        // Primer fetch de la página de código: falla el ITLB y se recorre la tabla;
+        // después el DTLB la encuentra en el TLB compartido, sin recorrido.
+        CHECK(mmu.translate(0x00404010, AccessType::Fetch, 0, pa));
+        CHECK_EQ(pa, 0x6010u);
+        CHECK_EQ(mmu.get_stats().itlb_misses, 1u);
+        CHECK_EQ(mmu.get_stats().walk_reads, 4u);
+        CHECK(mmu.translate(0x00404020, AccessType::Load, 0, pa));
+        CHECK_EQ(mmu.get_stats().dtlb_misses, 2u);
+        CHECK_EQ(mmu.get_stats().l2_misses, 2u);
+        CHECK_EQ(mmu.get_stats().walk_reads, 4u);
+        CHECK_EQ(mmu.get_last_latency(), mmu.get_config().l2_hit_cycles);
+
+        // Megapágina: una sola PTE leída y el desplazamiento de 22 bits.
+        CHECK(mmu.translate(0x00812345, AccessType::Load, 0, pa));
+        CHECK_EQ(pa, 0x12345u);
+        CHECK_EQ(mmu.get_stats().walk_reads, 5u);
+        CHECK_EQ(mmu.get_stats().page_faults, 0u);
+    }
+
+    void test_page_fault_causes() {
+        Memory memory(1 << 20);
+        build_tables(memory);
+        Mmu mmu(memory);
+        mmu.set_satp((1u << 31) | (ROOT / PAGE_SIZE));
+
+        uint32_t pa = 0;
+        CHECK(!mmu.translate(0x00405000, AccessType::Load, 0, pa)); // PTE no válida
+        CHECK_EQ(mmu.get_fault_cause(), static_cast<uint32_t>(CAUSE_LOAD_PAGE_FAULT));
+        CHECK(!mmu.translate(0x00404000, AccessType::Store, 0, pa)); // Sin W
+        CHECK_EQ(mmu.get_fault_cause(), static_cast<uint32_t>(CAUSE_STORE_PAGE_FAULT));
+        CHECK(!mmu.translate(0x00403000, AccessType::Fetch, 0, pa)); // Sin X
+        CHECK_EQ(mmu.get_fault_cause(), static_cast<uint32_t>(CAUSE_FETCH_PAGE_FAULT));
+        CHECK_EQ(mmu.get_stats().page_faults, 3u);
+
+        // Sin satp.MODE la dirección pasa tal cual.
+        mmu.set_satp(0);
+        CHECK(mmu.translate(0x00405000, AccessType::Load, 0, pa));
+        CHECK_EQ(pa, 0x00405000u);
+    }
+
+    // Un lw a una página sin mapear salta al manejador con mcause/mtval/mepc.
+    void test_simulator_traps_on_unmapped_load() {
+        Simulator sim(1 << 20, PipelineModel::General);
+        sim.load_program(
+            "lui x1, 4\n"
+            "addi x2, x0, 42\n"
+            "sw x2, 0(x1)\n"
+            "lw x3, 0(x1)\n"
+            "lui x4, 16\n"
+            "lw x5, 4(x4)\n", PipelineModel::General);
+        sim.reset(PipelineModel::General, 0);
+        sim.map_page(0x0000, 0x0000, PTE_R | PTE_X);
+        sim.map_page(0x4000, 0x8000, PTE_R | PTE_W);
+        CHECK(sim.write_csr(CSR_MTVEC, 0x200));
+        // Tras el reset el primer paso avanza el PC dos instrucciones: el lw
+        // a la página sin mapear llega en el quinto.
+        for (int i = 0; i < 5; ++i) sim.step();
+
+        CHECK_EQ(sim.get_registers().readA(3), 42u);
+        uint8_t bytes[4] = {};
+        sim.read_data_memory(0x8000, bytes, 4); // Física
+        CHECK_EQ(bytes[0], 42u);
+        uint32_t value = 0;
+        CHECK(sim.read_csr(CSR_MCAUSE, value));
+        CHECK_EQ(value, static_cast<uint32_t>(CAUSE_LOAD_PAGE_FAULT));
+        CHECK(sim.read_csr(CSR_MTVAL, value));
+        CHECK_EQ(value, 0x10004u);
+        CHECK(sim.read_csr(CSR_MEPC, value));
+        CHECK_EQ(value, 20u);
+        CHECK_EQ(sim.get_pc(), 0x200u);
+        CHECK_EQ(sim.get_registers().readA(5), 0u);
+    }
+}
+
+int main() {
+    test_walk_and_tlb_hits();
+    test_page_fault_causes();
+    test_simulator_traps_on_unmapped_load();
+    return test_result();
+}
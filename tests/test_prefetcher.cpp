@@ -0,0 +1,61 @@
+#include "Cache.h"
+#include "Memory.h"
+#include "Prefetcher.h"
+#include "TestSupport.h"
+
+namespace {
+    constexpr size_t BLOCK = 16;
+
+    // Recorrido con stride fijo desde una instrucción en `pc`.
+    void stride_walk(Cache& cache, std::optional<uint32_t> pc) {
+        for (uint32_t i = 0; i < 8; ++i) cache.read(0x1000 + i * 64, 4, pc);
+    }
+
+    void test_stride_trains_at_pc_zero() {
+        Memory memory(1 << 16);
+        DataCache cache(256, BLOCK, memory);
+        cache.add_prefetcher(make_prefetcher(PrefetcherKind::Stride, 1, 1));
+        stride_walk(cache, 0u); // El PC 0 es una dirección válida
+        const PrefetchStats& stats = cache.get_prefetchers()[0]->stats();
+        CHECK(stats.issued > 0);
+        CHECK(stats.useful + stats.late > 0);
+    }
+
+    void test_stride_ignores_accesses_without_pc() {
+        Memory memory(1 << 16);
+        DataCache cache(256, BLOCK, memory);
+        cache.add_prefetcher(make_prefetcher(PrefetcherKind::Stride, 1, 1));
+        stride_walk(cache, std::nullopt);
+        CHECK_EQ(cache.get_prefetchers()[0]->stats().issued, 0u);
+    }
+
+    void test_next_line_turns_sequential_misses_into_hits() {
+        Memory memory(1 << 16);
+        DataCache plain(256, BLOCK, memory);
+        DataCache prefetching(256, BLOCK, memory);
+        prefetching.add_prefetcher(make_prefetcher(PrefetcherKind::NextLine, 1, 1));
+        for (uint32_t address = 0; address < 8 * BLOCK; address += 4) {
+            plain.read(address, 4, 0u);
+            prefetching.read(address, 4, 0u);
+        }
+        CHECK_EQ(plain.get_stats().read_misses, 8u);
+        CHECK(prefetching.get_stats().read_misses < plain.get_stats().read_misses);
+        CHECK(prefetching.get_prefetchers()[0]->stats().issued > 0);
+    }
+
+    void test_prefetched_block_returns_memory_data() {
+        Memory memory(1 << 16);
+        for (uint32_t address = 0; address < 4 * BLOCK; address += 4) memory.write_word(address, address * 3 + 1);
+        DataCache cache(256, BLOCK, memory);
+        cache.add_prefetcher(make_prefetcher(PrefetcherKind::StreamBuffer, 2, 1));
+        for (uint32_t address = 0; address < 4 * BLOCK; address += 4) CHECK_EQ(cache.read(address, 4, 0u), address * 3 + 1);
+    }
+}
+
+int main() {
+    test_stride_trains_at_pc_zero();
+    test_stride_ignores_accesses_without_pc();
+    test_next_line_turns_sequential_misses_into_hits();
+    test_prefetched_block_returns_memory_data();
+    return test_result();
+}
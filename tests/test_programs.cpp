@@ -0,0 +1,65 @@
+#include "Simulator.h"
+#include "TestSupport.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+    std::string read_program(const char* name) {
+        std::ifstream file(std::string(PROGRAMS_DIR) + "/" + name);
+        std::stringstream source;
+        source << file.rdbuf();
+        return source.str();
+    }
+
+    uint32_t data_word(const Simulator& sim, uint32_t address) {
+        uint8_t bytes[4] = {};
+        sim.read_data_memory(address, bytes, 4);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    // completo.s guarda datos a partir de la dirección 16, encima de su propio
+    // código si ambos compartieran memoria.
+    void run_completo(PipelineModel model) {
+        const std::string source = read_program("completo.s");
+        CHECK(!source.empty());
+        Simulator sim(1 << 20, model);
+        sim.load_program(source.c_str(), model);
+        sim.reset(model, 0);
+        for (int i = 0; i < 400; ++i) sim.step();
+
+        const RegisterFile& regs = sim.get_registers();
+        CHECK_EQ(regs.readA(12), 60u);  // 10 + 20 + 30
+        CHECK_EQ(regs.readA(18), 40u);
+        CHECK_EQ(regs.readA(19), 140u);
+        CHECK_EQ(regs.readA(5), 0xFFu);
+        CHECK_EQ(regs.readA(7), 0xFFu);
+        CHECK_EQ(data_word(sim, 0x10), 60u);
+        CHECK_EQ(data_word(sim, 0x80), 10u);
+        CHECK_EQ(data_word(sim, 0x88), 30u);
+    }
+
+    void test_completo_single_cycle() { run_completo(PipelineModel::SingleCycle); }
+
+    void test_completo_general() { run_completo(PipelineModel::General); }
+
+    void test_general_data_view() {
+        Simulator sim(1 << 20, PipelineModel::General);
+        sim.load_program("addi x1, x0, 77\nsw x1, 8(x0)\n", PipelineModel::General);
+        sim.reset(PipelineModel::General, 0);
+        sim.set_write_buffer_entries(CacheId::Data, 4); // El sw se queda en el buffer
+        for (int i = 0; i < 2; ++i) sim.step();
+        const std::vector<uint8_t> data = sim.get_d_mem();
+        CHECK_EQ(data.size(), static_cast<size_t>(DMEM_SIZE));
+        CHECK_EQ(data[8], 77u);
+        // El código sigue intacto: la segunda instrucción no se ha pisado.
+        CHECK_EQ(sim.get_i_mem()[1].second.substr(0, 2), std::string("sw"));
+    }
+}
+
+int main() {
+    test_completo_single_cycle();
+    test_completo_general();
+    test_general_data_view();
+    return test_result();
+}
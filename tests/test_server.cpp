@@ -0,0 +1,394 @@
+#include "HttpServer.h"
+#include "TestSupport.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace {
+    // Puerto libre en este momento (el que elige el sistema para el puerto 0).
+    uint16_t free_port() {
+        const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+        ::close(fd);
+        return ntohs(address.sin_port);
+    }
+
+    // Cliente de prueba: una conexión TCP con lecturas de hasta 5 s.
+    class Client {
+    public:
+        explicit Client(uint16_t port) {
+            for (int attempt = 0; attempt < 500; ++attempt) {
+                fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(port);
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) break;
+                ::close(fd);
+                fd = -1;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10)); // El servidor aún no escucha
+            }
+            if (fd < 0) throw std::runtime_error("No se puede conectar al servidor");
+            timeval timeout{5, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+        ~Client() { if (fd >= 0) ::close(fd); }
+
+        void send(const std::string& data) { ::send(fd, data.data(), data.size(), MSG_NOSIGNAL); }
+
+        // Respuesta HTTP completa: estado, cabeceras y cuerpo (por Content-Length).
+        struct Response {
+            int status = 0;
+            std::string headers;
+            std::string body;
+        };
+        Response response() {
+            Response out;
+            size_t end;
+            while ((end = in.find("\r\n\r\n")) == std::string::npos) if (!fill()) return out;
+            out.headers = in.substr(0, end + 2);
+            in.erase(0, end + 4);
+            out.status = std::stoi(out.headers.substr(9, 3));
+            const size_t length_at = out.headers.find("Content-Length: ");
+            const size_t length = length_at == std::string::npos ? 0 : std::stoul(out.headers.substr(length_at + 16));
+            while (in.size() < length) if (!fill()) return out;
+            out.body = in.substr(0, length);
+            in.erase(0, length);
+            return out;
+        }
+
+        Response request(const std::string& method, const std::string& target, const std::string& body = std::string()) {
+            send(method + " " + target + " HTTP/1.1\r\nHost: test\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+            return response();
+        }
+
+        // --- WebSocket ---
+        Response upgrade(const std::string& target, const std::string& key = "dGhlIHNhbXBsZSBub25jZQ==") {
+            send("GET " + target + " HTTP/1.1\r\nHost: test\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: " + key + "\r\nSec-WebSocket-Version: 13\r\n\r\n");
+            return response();
+        }
+
+        void send_frame(uint8_t opcode, const std::string& payload, bool fin = true, bool masked = true) {
+            std::string frame(1, static_cast<char>((fin ? 0x80 : 0) | opcode));
+            const char mask_bit = masked ? static_cast<char>(0x80) : 0;
+            if (payload.size() < 126) {
+                frame += static_cast<char>(mask_bit | payload.size());
+            } else {
+                frame += static_cast<char>(mask_bit | 126);
+                frame += static_cast<char>(payload.size() >> 8);
+                frame += static_cast<char>(payload.size());
+            }
+            const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+            if (masked) frame.append(mask, 4);
+            for (size_t i = 0; i < payload.size(); ++i) frame += masked ? static_cast<char>(payload[i] ^ mask[i % 4]) : payload[i];
+            send(frame);
+        }
+        void send_text(const std::string& text) { send_frame(0x1, text); }
+
+        // Siguiente trama del servidor (sin máscara). opcode 0 si se cerró.
+        std::pair<uint8_t, std::string> frame() {
+            while (in.size() < 2) if (!fill()) return {0, std::string()};
+            const uint8_t opcode = static_cast<uint8_t>(in[0]) & 0x0F;
+            uint64_t length = static_cast<uint8_t>(in[1]) & 0x7F;
+            size_t header = 2;
+            if (length >= 126) {
+                header = length == 126 ? 4 : 10;
+                while (in.size() < header) if (!fill()) return {0, std::string()};
+                length = 0;
+                for (size_t i = 2; i < header; ++i) length = (length << 8) | static_cast<uint8_t>(in[i]);
+            }
+            while (in.size() < header + length) if (!fill()) return {0, std::string()};
+            std::string payload = in.substr(header, static_cast<size_t>(length));
+            in.erase(0, header + static_cast<size_t>(length));
+            return {opcode, payload};
+        }
+
+        // Código de estado de una trama de cierre.
+        static int close_code(const std::pair<uint8_t, std::string>& frame) {
+            if (frame.first != 0x8 || frame.second.size() < 2) return -1;
+            return (static_cast<uint8_t>(frame.second[0]) << 8) | static_cast<uint8_t>(frame.second[1]);
+        }
+
+    private:
+        bool fill() {
+            char buffer[16384];
+            const ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (count <= 0) return false;
+            in.append(buffer, static_cast<size_t>(count));
+            return true;
+        }
+
+        int fd = -1;
+        std::string in;
+    };
+
+    // HttpServer en un hilo propio mientras dura el objeto.
+    class RunningServer {
+    public:
+        explicit RunningServer(HttpServer& server) : server(server), port(free_port()) {
+            thread = std::thread([this] { this->server.run(port); });
+        }
+        ~RunningServer() {
+            server.stop();
+            thread.join();
+        }
+        HttpServer& server;
+        const uint16_t port;
+
+    private:
+        std::thread thread;
+    };
+
+    void test_http_routes() {
+        HttpServer server(2);
+        server.route("GET", "/echo", [](const HttpRequest& request) {
+            const std::string* q = request.query_param("q");
+            return HttpResponse{200, "text/plain", q ? *q : std::string("-")};
+        });
+        server.route("POST", "/body", [](const HttpRequest& request) {
+            return HttpResponse{200, "text/plain", request.body};
+        });
+        server.route("GET", "/fail", [](const HttpRequest&) -> HttpResponse { throw std::runtime_error("roto"); });
+        RunningServer running(server);
+        Client client(running.port);
+
+        Client::Response response = client.request("GET", "/echo?q=a%2Fb+c");
+        CHECK_EQ(response.status, 200);
+        CHECK_EQ(response.body, std::string("a/b c"));
+        CHECK_EQ(client.request("POST", "/body", "hola").body, std::string("hola"));
+        CHECK_EQ(client.request("POST", "/echo").status, 405);
+        CHECK_EQ(client.request("GET", "/nope").status, 404);
+        response = client.request("GET", "/fail");
+        CHECK_EQ(response.status, 500);
+        CHECK_EQ(json::parse(response.body)["detail"], "roto");
+
+        // Dos peticiones encadenadas: se contestan en orden por la misma conexión.
+        client.send("GET /echo?q=1 HTTP/1.1\r\n\r\nGET /echo?q=2 HTTP/1.1\r\n\r\n");
+        CHECK_EQ(client.response().body, std::string("1"));
+        CHECK_EQ(client.response().body, std::string("2"));
+
+        // Petición previa de CORS, sin pasar por las rutas.
+        client.send("OPTIONS /body HTTP/1.1\r\nOrigin: http://ui\r\nAccess-Control-Request-Headers: content-type\r\n\r\n");
+        response = client.response();
+        CHECK_EQ(response.status, 200);
+        CHECK(response.headers.find("Access-Control-Allow-Origin: http://ui") != std::string::npos);
+        CHECK(response.headers.find("Access-Control-Allow-Headers: content-type") != std::string::npos);
+    }
+
+    void test_http_limits() {
+        HttpServer server(1);
+        server.route("POST", "/body", [](const HttpRequest& request) { return HttpResponse{200, "text/plain", request.body}; });
+        RunningServer running(server);
+        {
+            Client client(running.port);
+            client.send("POST /body HTTP/1.1\r\nContent-Length: 999999999\r\n\r\n");
+            CHECK_EQ(client.response().status, 413);
+        }
+        {
+            Client client(running.port);
+            client.send("POST /body HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+            CHECK_EQ(client.response().status, 411);
+        }
+        {
+            Client client(running.port);
+            client.send("POST /body HTTP/1.1\r\nX: " + std::string(70 * 1024, 'a'));
+            CHECK_EQ(client.response().status, 431);
+        }
+    }
+
+    // Canal de eco: "block" espera a que el test lo suelte.
+    struct EchoSocket {
+        std::mutex mutex;
+        std::condition_variable released;
+        bool blocked = true;
+
+        HttpServer::WebSocketHandlers handlers(HttpServer& server) {
+            HttpServer::WebSocketHandlers socket;
+            socket.open = [](uint64_t, const HttpRequest& request) {
+                return request.query_param("reject") ? HttpResponse{404, "application/json", "{}"} : HttpResponse{101, "text/plain", ""};
+            };
+            socket.message = [this, &server](uint64_t id, const std::string& text) {
+                if (text == "block") {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    released.wait(lock, [this] { return !blocked; });
+                }
+                server.send_text(id, "echo:" + text);
+            };
+            return socket;
+        }
+        void release() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                blocked = false;
+            }
+            released.notify_all();
+        }
+    };
+
+    void test_websocket_framing() {
+        HttpServer server(2);
+        EchoSocket echo;
+        server.websocket("/ws", echo.handlers(server));
+        RunningServer running(server);
+
+        Client client(running.port);
+        const Client::Response handshake = client.upgrade("/ws");
+        CHECK_EQ(handshake.status, 101);
+        // Ejemplo de la RFC 6455, sección 1.3.
+        CHECK(handshake.headers.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos);
+
+        client.send_text("uno");
+        CHECK_EQ(client.frame().second, std::string("echo:uno"));
+        // Mensaje fragmentado: texto sin FIN y una continuación.
+        client.send_frame(0x1, "ab", false);
+        client.send_frame(0x0, "cd");
+        CHECK_EQ(client.frame().second, std::string("echo:abcd"));
+        // Longitud de 16 bits.
+        const std::string long_text(300, 'x');
+        client.send_text(long_text);
+        CHECK_EQ(client.frame().second, "echo:" + long_text);
+        // Ping -> pong con los mismos datos.
+        client.send_frame(0x9, "p");
+        const auto pong = client.frame();
+        CHECK_EQ(static_cast<int>(pong.first), 0xA);
+        CHECK_EQ(pong.second, std::string("p"));
+        // Los mensajes de un canal se atienden en orden.
+        for (int i = 0; i < 5; ++i) client.send_text(std::to_string(i));
+        for (int i = 0; i < 5; ++i) CHECK_EQ(client.frame().second, "echo:" + std::to_string(i));
+        // Cierre: se contesta con el mismo código.
+        client.send_frame(0x8, std::string("\x03\xE8", 2));
+        CHECK_EQ(Client::close_code(client.frame()), 1000);
+
+        Client rejected(running.port);
+        CHECK_EQ(rejected.upgrade("/ws?reject=1").status, 404);
+        Client unknown(running.port);
+        CHECK_EQ(unknown.upgrade("/otro").status, 404);
+        echo.release();
+    }
+
+    void test_websocket_limits() {
+        HttpServer server(2);
+        EchoSocket echo;
+        server.websocket("/ws", echo.handlers(server));
+        RunningServer running(server);
+        auto closed_with = [&](const std::function<void(Client&)>& send) {
+            Client client(running.port);
+            client.upgrade("/ws");
+            send(client);
+            return Client::close_code(client.frame());
+        };
+
+        CHECK_EQ(closed_with([](Client& c) { c.send_frame(0x1, "sin máscara", true, false); }), 1002);
+        CHECK_EQ(closed_with([](Client& c) { c.send_frame(0x0, "continuación suelta"); }), 1002);
+        CHECK_EQ(closed_with([](Client& c) { c.send_frame(0x2, "binario"); }), 1003);
+        // Cabecera de un mensaje de 2 MiB: se rechaza sin esperar al contenido.
+        CHECK_EQ(closed_with([](Client& c) { c.send(std::string("\x81\xFF\0\0\0\0\0\x20\0\0", 10)); }), 1009);
+        // Un cliente que envía más mensajes de los que caben en la cola del canal.
+        CHECK_EQ(closed_with([](Client& c) {
+            c.send_text("block");
+            for (int i = 0; i < 80; ++i) c.send_text("m");
+        }), 1008);
+        echo.release();
+    }
+
+    // simulator_server como proceso aparte: las rutas de la interfaz y el canal /ws.
+    class ServerProcess {
+    public:
+        ServerProcess() : port(free_port()) {
+            pid = ::fork();
+            if (pid == 0) {
+                ::setenv("SIMULATOR_POOL_PREWARM", "0", 1);
+                const std::string port_text = std::to_string(port);
+                ::execl(SIMULATOR_SERVER, SIMULATOR_SERVER, "--port", port_text.c_str(), "--threads", "2",
+                        "--program", DEFAULT_PROGRAM, static_cast<char*>(nullptr));
+                ::_exit(127);
+            }
+        }
+        ~ServerProcess() {
+            ::kill(pid, SIGTERM);
+            int status = 0;
+            ::waitpid(pid, &status, 0);
+        }
+        const uint16_t port;
+
+    private:
+        pid_t pid;
+    };
+
+    void test_simulator_routes() {
+        ServerProcess process;
+        Client client(process.port);
+
+        Client::Response response = client.request("POST", "/session/start");
+        CHECK_EQ(response.status, 200);
+        const std::string id = json::parse(response.body)["session_id"];
+        const std::string query = "?session_id=" + id;
+
+        response = client.request("POST", "/reset" + query,
+                                  json{{"model", "General"}, {"assembly_code", "addi x1, x0, 5\nsw x1, 8(x0)\naddi x2, x1, 1\n"}}.dump());
+        CHECK_EQ(response.status, 200);
+        client.request("POST", "/step" + query);
+        response = client.request("POST", "/step" + query);
+        CHECK_EQ(json::parse(response.body)["registers"]["x1 (ra)"], 5);
+
+        response = client.request("GET", "/memory/data" + query);
+        CHECK_EQ(response.status, 200);
+        CHECK_EQ(response.body.size(), static_cast<size_t>(256));
+        if (response.body.size() > 8) CHECK_EQ(static_cast<int>(response.body[8]), 5);
+
+        response = client.request("GET", "/memory/instructions" + query);
+        CHECK_EQ(json::parse(response.body)[0]["instruction"].get<std::string>().substr(0, 4), std::string("addi"));
+
+        response = client.request("POST", "/assemble" + query, R"({"assembly_code": "addi x1, x0, 1\naddi x2, x0, 2"})");
+        CHECK_EQ(json::parse(response.body)["size_bytes"], 8);
+
+        CHECK_EQ(client.request("GET", "/state?session_id=nadie").status, 404);
+        CHECK_EQ(client.request("GET", "/state").status, 422);
+        CHECK_EQ(client.request("POST", "/reset" + query, R"({"model": "Otro"})").status, 422);
+        CHECK_EQ(client.request("POST", "/run" + query, "{}").status, 422);
+
+        // Canal /ws de la misma sesión.
+        Client socket(process.port);
+        CHECK_EQ(socket.upgrade("/ws" + query).status, 101);
+        socket.send_text(R"({"action": "step"})");
+        json frame = json::parse(socket.frame().second);
+        CHECK_EQ(frame["type"], "state");
+        CHECK_EQ(frame["state"]["registers"]["x2 (sp)"], 6);
+        socket.send_text(R"({"action": "volar"})");
+        frame = json::parse(socket.frame().second);
+        CHECK_EQ(frame["type"], "error");
+        CHECK_EQ(frame["status"], 422);
+        Client no_session(process.port);
+        CHECK_EQ(no_session.upgrade("/ws?session_id=nadie").status, 404);
+    }
+}
+
+int main() {
+    std::signal(SIGPIPE, SIG_IGN);
+    test_http_routes();
+    test_http_limits();
+    test_websocket_framing();
+    test_websocket_limits();
+    test_simulator_routes();
+    return test_result();
+}
@@ -0,0 +1,96 @@
+#include "Simulator.h"
+#include "TestSupport.h"
+#include <cstring>
+#include <string>
+
+// Punto de entrada de la API C (Api.cpp), sin cabecera propia.
+extern "C" bool Simulator_get_snapshot(void* sim_ptr, SnapshotView* view);
+
+namespace {
+    const char* STORE_PROGRAM =
+        "addi x1, x0, 18\n"
+        "sw x1, 16(x0)\n"
+        "addi x2, x0, 52\n"
+        "sw x2, 252(x0)\n";
+
+    SnapshotView empty_view(uint32_t window_count) {
+        SnapshotView view;
+        std::memset(&view, 0, sizeof(view));
+        view.window_count = window_count;
+        return view;
+    }
+
+    // Las ventanas se recortan al final de la memoria de datos; fuera de ella,
+    // o sin buffer, no se copia nada.
+    void test_windows_are_clamped() {
+        Simulator sim(1 << 16, PipelineModel::SingleCycle);
+        sim.load_program(STORE_PROGRAM, PipelineModel::SingleCycle);
+        for (int i = 0; i < 4; ++i) sim.step();
+
+        uint8_t low[8], tail[16], beyond[4];
+        std::memset(tail, 0xEE, sizeof(tail));
+        SnapshotView view = empty_view(4);
+        view.windows[0] = {16, sizeof(low), low, 0};
+        view.windows[1] = {DMEM_SIZE - 4, sizeof(tail), tail, 0};
+        view.windows[2] = {DMEM_SIZE + 4, sizeof(beyond), beyond, 0};
+        view.windows[3] = {0, 32, nullptr, 0};
+        CHECK(Simulator_get_snapshot(&sim, &view));
+
+        CHECK_EQ(view.windows[0].copied, 8u);
+        CHECK_EQ(low[0], 18u);
+        CHECK_EQ(view.windows[1].copied, 4u);
+        CHECK_EQ(tail[0], 52u);
+        CHECK_EQ(tail[4], 0xEEu); // Lo que queda fuera no se toca
+        CHECK_EQ(view.windows[2].copied, 0u);
+        CHECK_EQ(view.windows[3].copied, 0u);
+
+        CHECK_EQ(view.pc, sim.get_pc());
+        CHECK_EQ(view.registers[1], 18u);
+        CHECK_EQ(view.registers[2], 52u);
+        CHECK_EQ(std::string(view.instruction), sim.get_instruction_string());
+    }
+
+    // Más ventanas de las que caben: solo se atienden SNAPSHOT_MAX_WINDOWS.
+    void test_window_count_is_bounded() {
+        Simulator sim(1 << 16, PipelineModel::SingleCycle);
+        uint8_t buffers[SNAPSHOT_MAX_WINDOWS][4];
+        SnapshotView view = empty_view(1000);
+        for (size_t i = 0; i < SNAPSHOT_MAX_WINDOWS; ++i) view.windows[i] = {static_cast<uint32_t>(4 * i), 4, buffers[i], 0};
+        CHECK(Simulator_get_snapshot(&sim, &view));
+        for (size_t i = 0; i < SNAPSHOT_MAX_WINDOWS; ++i) CHECK_EQ(view.windows[i].copied, 4u);
+
+        view.window_count = 0;
+        view.windows[0].copied = 99;
+        CHECK(Simulator_get_snapshot(&sim, &view));
+        CHECK_EQ(view.windows[0].copied, 99u);
+        CHECK(!Simulator_get_snapshot(nullptr, &view));
+        CHECK(!Simulator_get_snapshot(&sim, nullptr));
+    }
+
+    // En modo General las ventanas leen la memoria principal, con lo que aún
+    // está en el buffer de escritura encima.
+    void test_general_windows_see_pending_writes() {
+        Simulator sim(1 << 20, PipelineModel::General);
+        sim.load_program(STORE_PROGRAM, PipelineModel::General);
+        sim.reset(PipelineModel::General, 0);
+        sim.set_write_buffer_entries(CacheId::Data, 4);
+        for (int i = 0; i < 3; ++i) sim.step();
+
+        uint8_t data[4] = {}, far[4] = {};
+        SnapshotView view = empty_view(2);
+        view.windows[0] = {16, 4, data, 0};
+        view.windows[1] = {0x80000, 4, far, 0};
+        CHECK(Simulator_get_snapshot(&sim, &view));
+        CHECK_EQ(view.windows[0].copied, 4u);
+        CHECK_EQ(data[0], 18u);
+        CHECK_EQ(view.windows[1].copied, 4u); // Más allá de DMEM_SIZE
+        CHECK_EQ(far[0], 0u);
+    }
+}
+
+int main() {
+    test_windows_are_clamped();
+    test_window_count_is_bounded();
+    test_general_windows_see_pending_writes();
+    return test_result();
+}
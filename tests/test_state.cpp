@@ -0,0 +1,447 @@
+#include "MultiHart.h"
+#include "SessionRegistry.h"
+#include "Simulator.h"
+#include "StateBinary.h"
+#include "StateJson.h"
+#include "StateSave.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <cstring>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace {
+    // Treinta instrucciones distintas: cada una añade un texto a la tabla.
+    std::string distinct_program() {
+        std::string program;
+        for (int i = 1; i <= 30; ++i) program += "addi x1, x1, " + std::to_string(i) + "\n";
+        return program;
+    }
+
+    // Escribe una palabra en cada una de 8188 líneas a partir de 64 KB.
+    const char* LINES_PROGRAM =
+        "lui x1, 16\n"
+        "addi x2, x0, 2047\n"
+        "add x2, x2, x2\n"
+        "add x2, x2, x2\n"
+        "loop: sw x2, 0(x1)\n"
+        "addi x1, x1, 64\n"
+        "addi x2, x2, -1\n"
+        "bne x2, x0, loop\n"
+        "park: jal x0, park\n";
+
+    std::vector<uint8_t> state_binary(Simulator& sim, uint32_t flags = 0) {
+        std::vector<uint8_t> buffer(sim.get_state_binary(nullptr, 0, flags));
+        sim.get_state_binary(buffer.data(), buffer.size(), flags);
+        return buffer;
+    }
+
+    uint32_t field(const std::vector<uint8_t>& buffer, uint32_t offset) {
+        uint32_t value = 0;
+        std::memcpy(&value, buffer.data() + offset, sizeof(value));
+        return value;
+    }
+
+    uint32_t binary_field(Simulator& sim, uint32_t offset) {
+        return field(state_binary(sim), offset);
+    }
+
+    // Rangos de memoria del estado binario con memoria.
+    uint32_t memory_ranges(const std::vector<uint8_t>& buffer) {
+        return field(buffer, field(buffer, 32));
+    }
+
+    bool memory_resync(const std::vector<uint8_t>& buffer) {
+        return (field(buffer, 12) & STATE_BINARY_MEMORY_RESYNC) != 0;
+    }
+
+    uint32_t instruction_text(Simulator& sim) {
+        return binary_field(sim, STATE_BINARY_OFFSET_INSTRUCTION_TEXT);
+    }
+
+    // El JSON de estado tal y como lo construía Api.cpp con nlohmann::json.
+    nlohmann::json reference_state_json(const DatapathState& state) {
+        nlohmann::json j;
+#define REFERENCE_SIGNAL(name) \
+        j[datapath_signal_name(SIGNAL_##name)] = {{"value", state.name.value}, {"ready_at", state.name.ready_at}, {"is_active", state.name.is_active}};
+        DATAPATH_U32_SIGNALS(REFERENCE_SIGNAL)
+        DATAPATH_U16_SIGNALS(REFERENCE_SIGNAL)
+        DATAPATH_U8_SIGNALS(REFERENCE_SIGNAL)
+        DATAPATH_BOOL_SIGNALS(REFERENCE_SIGNAL)
+#undef REFERENCE_SIGNAL
+        j["criticalTime"] = state.criticalTime;
+        j["totalMicroCycles"] = state.total_micro_cycles;
+        j["instruction_cptr"] = state.instruction_cptr;
+        j["Pipe_IF_instruction_cptr"] = state.Pipe_IF_instruction_cptr;
+        j["Pipe_ID_instruction_cptr"] = state.Pipe_ID_instruction_cptr;
+        j["Pipe_EX_instruction_cptr"] = state.Pipe_EX_instruction_cptr;
+        j["Pipe_MEM_instruction_cptr"] = state.Pipe_MEM_instruction_cptr;
+        j["Pipe_WB_instruction_cptr"] = state.Pipe_WB_instruction_cptr;
+        j["Pipe_IF_instruction"] = state.Pipe_IF_instruction;
+        j["Pipe_ID_instruction"] = state.Pipe_ID_instruction;
+        j["Pipe_EX_instruction"] = state.Pipe_EX_instruction;
+        j["Pipe_MEM_instruction"] = state.Pipe_MEM_instruction;
+        j["Pipe_WB_instruction"] = state.Pipe_WB_instruction;
+        return j;
+    }
+
+    std::string streamed_state_json(const DatapathState& state, const StateJsonMask* fields = nullptr) {
+        std::string out;
+        append_state_json(state, out, fields);
+        return out;
+    }
+
+    void test_reset_clears_instruction_texts() {
+        Simulator sim(1 << 16, PipelineModel::PipeLined);
+        const std::string program = distinct_program();
+        sim.load_program(program.c_str(), PipelineModel::PipeLined);
+        uint32_t highest = 0;
+        for (int i = 0; i < 30; ++i) {
+            sim.step();
+            highest = std::max(highest, instruction_text(sim));
+        }
+        CHECK(highest > 0);
+        CHECK(!sim.get_instruction_text(highest, 0).empty());
+
+        // Tras el reset la tabla vuelve a empezar: los identificadores del
+        // programa anterior ya no resuelven a nada.
+        sim.reset(PipelineModel::PipeLined, 0);
+        sim.load_program(program.c_str(), PipelineModel::PipeLined);
+        CHECK(instruction_text(sim) < highest);
+        CHECK(sim.get_instruction_text(highest, 0).empty());
+    }
+
+    void test_streamed_json_matches_nlohmann() {
+        const std::string program = distinct_program() + "beq x1, x1, 8\naddi x3, x0, -1\nsub x4, x0, x1\n";
+        for (PipelineModel model : {PipelineModel::SingleCycle, PipelineModel::PipeLined, PipelineModel::MultiCycle}) {
+            Simulator sim(1 << 16, model);
+            sim.reset(model, 0);
+            sim.load_program(program.c_str(), model);
+            for (int i = 0; i < 36; ++i) {
+                const DatapathState state = sim.get_datapath_state();
+                CHECK_EQ(streamed_state_json(state), reference_state_json(state).dump());
+                sim.step();
+            }
+        }
+
+        // Valores extremos y textos con todo lo que hay que escapar.
+        DatapathState state{};
+        state.bus_PC.value = 0xFFFFFFFFu;
+        state.bus_PC.ready_at = 0xFFFFFFFFu;
+        state.bus_Control.value = 0xFFFF;
+        state.bus_opcode.value = 0xFF;
+        state.bus_stall.value = true;
+        state.criticalTime = 4000000000u;
+        std::strcpy(state.instruction_cptr, "lw \"x\\y\"\n\t\b\f\r\x01\x1f ñ");
+        std::strcpy(state.Pipe_WB_instruction_cptr, "nop (flush)");
+        CHECK_EQ(streamed_state_json(state), reference_state_json(state).dump());
+
+        // Con máscara solo salen los campos marcados, en el mismo orden.
+        StateJsonMask fields;
+        fields.set(SIGNAL_bus_PC);
+        fields.set(SIGNAL_bus_stall);
+        fields.set(JSON_INSTRUCTION_TEXT);
+        fields.set(JSON_STAGE_INSTRUCTION + STAGE_WB);
+        nlohmann::json subset;
+        const nlohmann::json full = reference_state_json(state);
+        for (const char* key : {"PC", "bus_stall", "instruction_cptr", "Pipe_WB_instruction"}) {
+            if (full.contains(key)) subset[key] = full[key];
+        }
+        CHECK_EQ(subset.size(), 4u);
+        CHECK_EQ(streamed_state_json(state, &fields), subset.dump());
+    }
+
+    // Un cliente que aplica solo lo cambiado desde su versión acaba con el
+    // mismo estado que pidiéndolo entero.
+    void test_versions_send_only_changes() {
+        Simulator sim(1 << 16, PipelineModel::PipeLined);
+        sim.reset(PipelineModel::PipeLined, 0);
+        sim.load_program(distinct_program().c_str(), PipelineModel::PipeLined);
+
+        uint64_t version = sim.sync_state_version();
+        CHECK_EQ(version, 1u);
+        CHECK_EQ(sim.changed_fields_since(0).count(), static_cast<size_t>(STATE_JSON_FIELD_COUNT));
+        CHECK_EQ(sim.changed_registers_since(0), 0xFFFFFFFFu);
+        nlohmann::json client = nlohmann::json::parse(streamed_state_json(sim.get_datapath_state()));
+        uint32_t registers[32];
+        for (uint8_t r = 0; r < 32; ++r) registers[r] = sim.get_registers().readA(r);
+
+        // Sin cambios no hay versión nueva.
+        CHECK_EQ(sim.sync_state_version(), version);
+        CHECK(sim.changed_fields_since(version).none());
+        CHECK_EQ(sim.changed_registers_since(version), 0u);
+
+        for (int i = 0; i < 24; ++i) {
+            if (i == 16) {
+                sim.step_back();
+                sim.step_back();
+            } else {
+                sim.step();
+            }
+            const uint64_t next = sim.sync_state_version();
+            CHECK(next > version);
+            const StateJsonMask fields = sim.changed_fields_since(version);
+            CHECK(fields.count() < static_cast<size_t>(STATE_JSON_FIELD_COUNT));
+            const DatapathState state = sim.get_datapath_state();
+            client.update(nlohmann::json::parse(streamed_state_json(state, &fields)));
+            CHECK_EQ(client.dump(), reference_state_json(state).dump());
+
+            const uint32_t changed = sim.changed_registers_since(version);
+            for (uint8_t r = 0; r < 32; ++r) {
+                if (changed & (1u << r)) registers[r] = sim.get_registers().readA(r);
+                CHECK_EQ(registers[r], sim.get_registers().readA(r));
+            }
+            version = next;
+        }
+    }
+
+    // Una instancia reconfigurada (SimulatorPool) no se distingue de una nueva.
+    void test_reconfigure_resets_versions_and_texts() {
+        const std::string program = distinct_program();
+        Simulator reused(1 << 16, PipelineModel::PipeLined);
+        reused.reset(PipelineModel::PipeLined, 0);
+        reused.load_program(program.c_str(), PipelineModel::PipeLined);
+        for (int i = 0; i < 20; ++i) {
+            reused.step();
+            reused.sync_state_version();
+        }
+        reused.reconfigure(PipelineModel::PipeLined, 1 << 16, true);
+
+        Simulator fresh(1 << 16, PipelineModel::PipeLined);
+        for (Simulator* sim : {&reused, &fresh}) {
+            sim->reset(PipelineModel::PipeLined, 0);
+            sim->load_program(program.c_str(), PipelineModel::PipeLined);
+        }
+        for (int i = 0; i < 10; ++i) {
+            CHECK_EQ(reused.sync_state_version(), fresh.sync_state_version());
+            CHECK(reused.changed_fields_since(0) == fresh.changed_fields_since(0));
+            CHECK_EQ(instruction_text(reused), instruction_text(fresh));
+            reused.step();
+            fresh.step();
+        }
+        CHECK_EQ(reused.changed_fields_since(0).count(), static_cast<size_t>(STATE_JSON_FIELD_COUNT));
+    }
+
+    // Una sesión hibernada vuelve con su historial: step_back sigue funcionando.
+    void test_hibernation_keeps_history() {
+        SimulatorPool pool;
+        SessionRegistry registry(pool);
+        CHECK(registry.create("a", PipelineModel::PipeLined, 1 << 16));
+        Simulator* sim = registry.acquire("a");
+        sim->load_program(distinct_program().c_str(), PipelineModel::PipeLined);
+        for (int i = 0; i < 12; ++i) sim->step();
+        const uint32_t pc = sim->get_pc();
+        const uint32_t x1 = sim->get_registers().readA(1);
+        registry.release("a");
+
+        CHECK(registry.hibernate("a"));
+        CHECK_EQ(registry.get_stats().hibernated, 1u);
+        sim = registry.acquire("a");
+        CHECK_EQ(registry.get_stats().resumes, 1u);
+        CHECK_EQ(sim->get_pc(), pc);
+        CHECK_EQ(sim->get_registers().readA(1), x1);
+        CHECK_EQ(sim->get_history_depth(), 12u);
+        sim->step_back();
+        CHECK_EQ(sim->get_pc(), pc - 4);
+        registry.release("a");
+        CHECK(registry.remove("a"));
+    }
+
+    // El id va al nombre del log: nada de separadores ni puntos.
+    void test_session_ids_are_validated() {
+        SimulatorPool pool;
+        SessionRegistry registry(pool);
+        CHECK_THROWS(registry.create("../../etc/x", PipelineModel::SingleCycle, 1 << 16));
+        CHECK_THROWS(registry.create("", PipelineModel::SingleCycle, 1 << 16));
+        CHECK_THROWS(registry.create(std::string(65, 'a'), PipelineModel::SingleCycle, 1 << 16));
+        CHECK(registry.create("3f2a-b_C", PipelineModel::SingleCycle, 1 << 16));
+        CHECK_THROWS(registry.fork("a/b", "3f2a-b_C"));
+        CHECK_EQ(registry.get_stats().sessions, 1u);
+        CHECK(registry.remove("3f2a-b_C"));
+    }
+
+    // Terminar una sesión espera a su ejecución en segundo plano sin tener
+    // parado el registro mientras tanto.
+    void test_remove_waits_outside_the_registry() {
+        SimulatorPool pool;
+        SessionRegistry registry(pool);
+        CHECK(registry.create("a", PipelineModel::SingleCycle, 1 << 16));
+        Simulator* sim = registry.acquire("a");
+        sim->load_program("loop: jal x0, loop\n", PipelineModel::SingleCycle);
+        std::unique_lock<std::shared_mutex> busy(sim->get_mutex()); // La ejecución no arranca
+        CHECK(sim->run_async({}));
+        registry.release("a");
+
+        bool removed = false;
+        std::thread remover([&] { removed = registry.remove("a"); });
+        while (registry.get_stats().sessions != 0) std::this_thread::yield();
+        CHECK(registry.create("b", PipelineModel::SingleCycle, 1 << 16));
+        busy.unlock();
+        remover.join();
+        CHECK(removed);
+        CHECK(registry.remove("b"));
+    }
+
+    // Bucle con cargas y almacenamientos: historial con escrituras en memoria.
+    const char* SAVE_PROGRAM =
+        "addi x1, x0, 1024\n"
+        "addi x2, x0, 12\n"
+        "loop: sw x2, 0(x1)\n"
+        "lw x3, 0(x1)\n"
+        "add x4, x4, x3\n"
+        "addi x1, x1, 68\n"
+        "addi x2, x2, -1\n"
+        "bne x2, x0, loop\n";
+
+    void load_saved_program(Simulator& sim) {
+        sim.reset(PipelineModel::PipeLined, 0);
+        sim.load_program(SAVE_PROGRAM, PipelineModel::PipeLined);
+        sim.set_pipeline_caches(true, 2);
+        sim.add_prefetcher(CacheId::Data, PrefetcherKind::Stride, 1, 1);
+        sim.set_victim_entries(CacheId::Data, 2);
+        sim.attach_dram(DramConfig{});
+    }
+
+    bool same_state(Simulator& a, Simulator& b) {
+        bool same = state_binary(a) == state_binary(b);
+        for (uint32_t address = 1024; address < 1024 + 12 * 68; address += 4) {
+            uint8_t left[4] = {}, right[4] = {};
+            a.read_data_memory(address, left, 4);
+            b.read_data_memory(address, right, 4);
+            same &= std::memcmp(left, right, 4) == 0;
+        }
+        return same;
+    }
+
+    void test_save_load_round_trip() {
+        Simulator original(1 << 16, PipelineModel::PipeLined);
+        load_saved_program(original);
+        for (int i = 0; i < 40; ++i) original.step();
+        std::vector<uint8_t> saved;
+        original.save_state(saved, STATE_SAVE_HISTORY);
+
+        Simulator restored(1 << 16, PipelineModel::SingleCycle);
+        restored.load_state(saved.data(), saved.size());
+        CHECK(restored.get_model() == PipelineModel::PipeLined);
+        CHECK(same_state(original, restored));
+        CHECK_EQ(restored.get_history_depth(), original.get_history_depth());
+
+        // Los dos siguen igual hacia delante y hacia atrás.
+        for (int i = 0; i < 30; ++i) {
+            original.step();
+            restored.step();
+        }
+        CHECK(same_state(original, restored));
+        for (int i = 0; i < 50; ++i) {
+            original.step_back();
+            restored.step_back();
+        }
+        CHECK(same_state(original, restored));
+    }
+
+    // Un estado manipulado lanza y deja el simulador como estaba.
+    void test_corrupted_state_is_rejected() {
+        Simulator original(1 << 16, PipelineModel::PipeLined);
+        load_saved_program(original);
+        for (int i = 0; i < 40; ++i) original.step();
+        std::vector<uint8_t> saved;
+        original.save_state(saved, STATE_SAVE_HISTORY);
+
+        Simulator target(1 << 16, PipelineModel::PipeLined);
+        target.reset(PipelineModel::PipeLined, 0);
+        target.load_program(distinct_program().c_str(), PipelineModel::PipeLined);
+        for (int i = 0; i < 7; ++i) target.step();
+        const std::vector<uint8_t> before = state_binary(target);
+
+        // Truncado en cualquier punto.
+        for (size_t length = 0; length < saved.size(); length += 1 + length / 8) {
+            std::vector<uint8_t> cut(saved.begin(), saved.begin() + length);
+            CHECK_THROWS(target.load_state(cut.data(), cut.size()));
+        }
+        CHECK(state_binary(target) == before);
+        // Modelo fuera de rango (primer campo de la configuración).
+        std::vector<uint8_t> bad_model = saved;
+        bad_model[STATE_SAVE_HEADER_SIZE + 8] = 9;
+        CHECK_THROWS(target.load_state(bad_model.data(), bad_model.size()));
+        CHECK(state_binary(target) == before);
+
+        // Bytes cambiados al azar: o lanza o carga algo que se puede usar.
+        uint32_t seed = 12345;
+        for (int round = 0; round < 400; ++round) {
+            std::vector<uint8_t> mutated = saved;
+            for (int flips = 0; flips < 4; ++flips) {
+                seed = seed * 1664525u + 1013904223u;
+                mutated[STATE_SAVE_HEADER_SIZE + seed % (mutated.size() - STATE_SAVE_HEADER_SIZE)] ^= static_cast<uint8_t>(1u << (seed >> 29));
+            }
+            Simulator sim(1 << 16, PipelineModel::SingleCycle);
+            try {
+                sim.load_state(mutated.data(), mutated.size());
+            } catch (const std::exception&) {
+                continue;
+            }
+            try {
+                for (int i = 0; i < 5; ++i) sim.step_back();
+                for (int i = 0; i < 10; ++i) sim.step();
+                sim.get_datapath_state();
+                state_binary(sim, STATE_BINARY_MEMORY);
+            } catch (const std::exception&) {
+                // Un historial con valores absurdos puede fallar al aplicarse,
+                // pero sin salirse de las estructuras.
+            }
+        }
+    }
+
+    void test_dirty_lines_are_bounded() {
+        Simulator sim(1 << 20, PipelineModel::General);
+        sim.load_program(LINES_PROGRAM, PipelineModel::General);
+        for (int i = 0; i < 4; ++i) sim.step();
+        CHECK(memory_resync(state_binary(sim, STATE_BINARY_MEMORY)));
+
+        // Pocas líneas: llegan como rangos, sin resincronizar.
+        for (int i = 0; i < 4 * 4; ++i) sim.step();
+        std::vector<uint8_t> binary = state_binary(sim, STATE_BINARY_MEMORY);
+        CHECK(!memory_resync(binary));
+        CHECK_EQ(memory_ranges(binary), 1u);
+
+        // Muchas: se descartan y se pide la memoria entera.
+        for (int i = 0; i < 4 * (DIRTY_LINES_LIMIT + 1); ++i) sim.step();
+        binary = state_binary(sim, STATE_BINARY_MEMORY);
+        CHECK(memory_resync(binary));
+        CHECK_EQ(memory_ranges(binary), 0u);
+    }
+
+    void test_shared_memory_writes_reach_every_hart() {
+        // El hart 0 escribe; el 1 se queda parado desde el principio.
+        MultiHart multi(2, 1 << 16);
+        multi.load_program(
+            "bne x10, x0, park\n"
+            "addi x2, x0, 7\n"
+            "sw x2, 1024(x0)\n"
+            "park: jal x0, park\n");
+        for (size_t hart = 0; hart < multi.size(); ++hart) state_binary(multi.hart(hart), STATE_BINARY_MEMORY);
+        multi.run(16);
+        for (size_t hart = 0; hart < multi.size(); ++hart) {
+            const std::vector<uint8_t> binary = state_binary(multi.hart(hart), STATE_BINARY_MEMORY);
+            CHECK(!memory_resync(binary));
+            CHECK_EQ(memory_ranges(binary), 1u);
+        }
+    }
+}
+
+int main() {
+    test_reset_clears_instruction_texts();
+    test_streamed_json_matches_nlohmann();
+    test_versions_send_only_changes();
+    test_reconfigure_resets_versions_and_texts();
+    test_hibernation_keeps_history();
+    test_session_ids_are_validated();
+    test_remove_waits_outside_the_registry();
+    test_save_load_round_trip();
+    test_corrupted_state_is_rejected();
+    test_dirty_lines_are_bounded();
+    test_shared_memory_writes_reach_every_hart();
+    return test_result();
+}